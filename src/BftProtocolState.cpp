@@ -17,6 +17,8 @@
 #include "CrusaderAgreementState.h"
 #include "messaging/StringBody.h"
 #include "messaging/QueryRequest.h"
+#include "messaging/MulticastOverlayMessage.h"
+#include "messaging/OnionBuilder.h"
 #include "messaging/OverlayTransportMessage.h"
 #include "messaging/SignatureResponse.h"
 #include "messaging/ValueContribution.h"
@@ -56,24 +58,24 @@ void BftProtocolState::handle_overlay_message_impl(const std::shared_ptr<Overlay
          * it was just received here), but a PathOverlayMessage that still needs to be forwarded will
          * have its destination already set to the next hop by the superclass handle_overlay_message.
          */
-        if(auto enclosed_message = std::dynamic_pointer_cast<messaging::OverlayMessage>(overlay_message->body)){
-            waiting_messages.emplace_back(enclosed_message);
+        if(auto enclosed_message = messaging::body_pointer_cast<messaging::OverlayMessage>(overlay_message->body)){
+            relay_message(enclosed_message, message->sender_round);
         } else if(overlay_message->destination == meter_id){
             if(protocol_phase == BftProtocolPhase::SHUFFLE) {
                 handle_shuffle_phase_message(*overlay_message);
             } else if(protocol_phase == BftProtocolPhase::AGREEMENT) {
                 handle_agreement_phase_message(*overlay_message);
             }
-        } //If destination didn't match, it was already added to waiting_messages
+        } //If destination didn't match, it was already relayed
     }
-    if(message->is_final_message && is_in_overlay_phase()) {
+    if(message->is_final_message && is_in_overlay_phase() && received_all_final_messages()) {
         end_overlay_round();
     }
 }
 
 void BftProtocolState::handle_shuffle_phase_message(const messaging::OverlayMessage& message) {
     //Drop messages that are received in the wrong phase (i.e. not ValueContributions) or have the wrong round number
-    if(auto contribution = std::dynamic_pointer_cast<ValueContribution>(message.body)) {
+    if(auto contribution = messaging::body_pointer_cast<ValueContribution>(message.body)) {
         if(contribution->value.query_num == my_contribution->query_num) {
             //Verify the owner's signature
             if(crypto.rsa_verify(contribution->value, contribution->signature, -1)) {
@@ -106,9 +108,10 @@ void BftProtocolState::send_aggregate_if_done() {
 void BftProtocolState::end_overlay_round_impl() {
     //Determine if the Shuffle phase has ended
     if(protocol_phase == BftProtocolPhase::SHUFFLE
-            && overlay_round >= 2 * FAILURES_TOLERATED + log2n * log2n + 1) {
+            && overlay_round >= 2 * FAILURES_TOLERATED + logkn * log2n + 1) {
         logger->debug("Meter {} is finished with Shuffle", meter_id);
         //Sign each received value and multicast it to the other proxies
+        const std::set<int> avoided_meters = presumed_failed_meters();
         for(const auto& proxy_value : proxy_values) {
             //Create a SignedValue object to hold this value, and add this node's signature to it
             auto signed_value = std::make_shared<messaging::SignedValue>();
@@ -120,11 +123,18 @@ void BftProtocolState::end_overlay_round_impl() {
             std::remove_copy(proxy_value->value.proxies.begin(),
                     proxy_value->value.proxies.end(), other_proxies.begin(), meter_id);
             //Find paths that start at the next round - we send before receive, so we've already sent messages for the current round
-            auto proxy_paths = util::find_paths(meter_id, other_proxies, num_meters, overlay_round+1);
-            for(const auto& proxy_path : proxy_paths) {
-                //Encrypt with the destination's public key, but don't make an onion
-                outgoing_messages.emplace_back(crypto.rsa_encrypt(std::make_shared<messaging::PathOverlayMessage>(
-                        get_current_query_num(), proxy_path, signed_value), proxy_path.back()));
+            if(MULTICAST_ECHO) {
+                auto proxy_tree = util::find_multicast_tree(meter_id, other_proxies, num_meters, overlay_round+1, avoided_meters);
+                for(const auto& branch : messaging::build_encrypted_multicast(proxy_tree, signed_value, get_current_query_num(), crypto)) {
+                    outgoing_messages.emplace_back(branch);
+                }
+            } else {
+                auto proxy_paths = util::find_paths(meter_id, other_proxies, num_meters, overlay_round+1, avoided_meters);
+                for(const auto& proxy_path : proxy_paths) {
+                    //Encrypt with the destination's public key, but don't make an onion
+                    outgoing_messages.emplace_back(crypto.rsa_encrypt(std::make_shared<messaging::PathOverlayMessage>(
+                            get_current_query_num(), proxy_path, signed_value), proxy_path.back()));
+                }
             }
         }
         agreement_start_round = overlay_round;
@@ -134,7 +144,7 @@ void BftProtocolState::end_overlay_round_impl() {
     }
     //Detect finishing phase 2 of Agreement
     else if(protocol_phase == BftProtocolPhase::AGREEMENT
-            && overlay_round >= agreement_start_round + 4 * FAILURES_TOLERATED + 2 * log2n * log2n + 2
+            && overlay_round >= agreement_start_round + 4 * FAILURES_TOLERATED + 2 * logkn * log2n + 2
             && agreement_phase_state->is_phase1_finished()) {
         logger->debug("Meter {} finished phase 2 of Agreement", meter_id);
         accepted_proxy_values = agreement_phase_state->finish_phase_2();
@@ -147,11 +157,11 @@ void BftProtocolState::end_overlay_round_impl() {
     }
     //Detect finishing phase 1 of Agreement
     else if(protocol_phase == BftProtocolPhase::AGREEMENT
-            && overlay_round >= agreement_start_round + 2 * FAILURES_TOLERATED + log2n * log2n + 1
+            && overlay_round >= agreement_start_round + 2 * FAILURES_TOLERATED + logkn * log2n + 1
             && !agreement_phase_state->is_phase1_finished()) {
         logger->debug("Meter {} finished phase 1 of Agreement", meter_id);
 
-        auto accept_messages = agreement_phase_state->finish_phase_1(overlay_round);
+        auto accept_messages = agreement_phase_state->finish_phase_1(overlay_round, presumed_failed_meters());
         outgoing_messages.insert(outgoing_messages.end(), accept_messages.begin(), accept_messages.end());
     }
 }
@@ -11,8 +11,12 @@
 #pragma once
 
 #include <functional>
+#include <cstddef>
 #include <cstdint>
 
+#include "messaging/WireFormat.h"
+#include "networking/ReactorType.h"
+
 namespace pddm {
 
 //Forward declare these types to avoid circular includes of configuration.h
@@ -36,6 +40,7 @@ class DummyCrypto;
 
 namespace networking {
 class TcpNetworkClient;
+class UdpNetworkClient;
 class TcpUtilityClient;
 }
 
@@ -43,6 +48,7 @@ class TcpUtilityClient;
 using ProtocolState_t = CtProtocolState;
 using Meter_t = simulation::Meter;
 using NetworkClient_t = networking::TcpNetworkClient;
+//using NetworkClient_t = networking::UdpNetworkClient; //Built with networking::udp_network_client_builder
 //using NetworkClient_t = simulation::SimNetworkClient;
 using UtilityNetworkClient_t = networking::TcpUtilityClient;
 //using UtilityNetworkClient_t = simulation::SimUtilityNetworkClient;
@@ -51,6 +57,147 @@ using TimerManager_t = util::LinuxTimerManager;
 //using CryptoLibrary_t = simulation::SimCryptoWrapper;
 using CryptoLibrary_t = util::DummyCrypto;
 
+//The base k of the gossip overlay. In round t, meter i sends to each of
+//i + j*k^t mod N for j = 1..k-1, so larger bases trade more messages per round
+//for fewer rounds (log_k(N) instead of log_2(N)). N is padded up to the next
+//prime with primitive root k (see util::get_valid_prime_modulus), and some
+//meters send and receive on behalf of the padding IDs; see util::gossip_targets.
+constexpr int GOSSIP_BASE = 2;
+
+//If true, meters piggyback acknowledgement certificates on overlay messages
+//and end a phase as soon as they can prove all of its messages were delivered,
+//rather than always waiting for the phase's worst-case number of rounds.
+//Currently only used by CtProtocolState.
+constexpr bool EARLY_PHASE_COMPLETION = true;
+
+//If true, meters forward onion layers and path messages as soon as they
+//receive them, labeled with the round in which they would have been sent,
+//instead of holding them until that round starts. Rounds then only act as
+//logical timestamps for relayed messages, so a slow meter delays just the
+//messages that pass through it rather than every later round.
+constexpr bool ASYNC_OVERLAY_FORWARDING = false;
+
+//If true, a meter that must send the same value to several other proxies (in
+//CT's Echo phase and BFT's Shuffle-end and Agreement multicasts) sends it along
+//a single multicast tree, which shares hops between its paths, instead of along
+//one independent path per proxy. Each proxy's copy is still encrypted for it,
+//but the tree's paths are not node-disjoint like find_paths' paths are, so one
+//failed relay can cut off several proxies, and the protocols' FAILURES_TOLERATED
+//bounds no longer hold. It is off by default for that reason.
+constexpr bool MULTICAST_ECHO = false;
+
+//The number of routing records in every onion's header, which is the longest
+//path an onion can be sent along. Every onion has this many records no matter
+//how long its path is. Onion paths are searched for with this as their maximum
+//length, so it should be well above the length of the paths util::find_paths
+//usually returns (about 12 hops at 5000 meters), or some meters won't find
+//paths for their onions.
+constexpr int ONION_MAX_HOPS = 24;
+//Onion payloads are padded to a multiple of this many bytes, so that the
+//payload's size doesn't reveal what kind of message it contains.
+constexpr int ONION_PAYLOAD_SIZE = 512;
+
+//How long each meter keeps forwarding a flood message after it first receives
+//it, as a fraction of the FAILURES_TOLERATED extra rounds a flooding phase
+//allows on top of the log_k(N) rounds any meter needs to reach any other. At
+//1.0 every meter forwards a message until the end of the phase, which keeps
+//the guarantee that messages survive FAILURES_TOLERATED failed meters; smaller
+//values trade that margin for fewer bytes. Meters never send a flood message
+//to a target that reported already holding it, regardless of this setting.
+//Currently only used by HftProtocolState.
+constexpr double FLOOD_REDUNDANCY = 1.0;
+
+//The size of the Bloom filter in each flood digest (see
+//messaging::FloodDigestMessage), in bits per flood message ID it summarizes.
+//10 bits per ID gives about a 1% false positive rate.
+constexpr int FLOOD_DIGEST_BITS_PER_ID = 10;
+
+//Bounds on the timeouts that meters and the utility derive from their
+//measurements of how long rounds and pings take. The fixed defaults (e.g.
+//ProtocolState::OVERLAY_ROUND_TIMEOUT) are only used until the first
+//measurement; see util::TimeoutEstimator. A measured timeout is never less
+//than MIN_ADAPTIVE_TIMEOUT_PERCENT percent of the fixed default it replaces,
+//so a run of fast rounds can't leave too little slack for a slow one, and
+//never more than MAX_ADAPTIVE_TIMEOUT milliseconds.
+constexpr int MIN_ADAPTIVE_TIMEOUT_PERCENT = 25;
+constexpr int MAX_ADAPTIVE_TIMEOUT = 1000;
+
+//The format meters and the utility send messages in. Each TCP connection
+//starts by announcing the format and layout version its sender uses, and
+//receivers accept messages in either format, so meters can be switched to
+//WireFormat::COMPACT one at a time once they all run a build that announces
+//the same version (see messaging::WIRE_FORMAT_VERSION). Connections from
+//builds that don't announce a version are closed.
+constexpr messaging::WireFormat WIRE_FORMAT = messaging::WireFormat::MUTILS;
+
+//How long, in milliseconds, a TCP connection to another meter may take to
+//open before the meter gives up on it and reports the frames queued on it as
+//failed. Connections open in the background, on the reactor, so a send never
+//waits for one. After a failure, sends to that meter fail immediately, without trying to connect,
+//until a backoff delay has passed; the delay starts at MIN_RECONNECT_BACKOFF
+//and doubles with each consecutive failure, up to MAX_RECONNECT_BACKOFF.
+constexpr int CONNECT_TIMEOUT = 250;
+constexpr int MIN_RECONNECT_BACKOFF = 50;
+constexpr int MAX_RECONNECT_BACKOFF = 5000;
+
+//The number of threads each TCP client (a meter's or the utility's) uses to
+//accept connections and receive and deserialize messages. With more than
+//one, each thread listens on its own SO_REUSEPORT socket, so the kernel
+//spreads incoming connections across them, and the messages they deserialize
+//are handed to the thread that called monitor_incoming_messages(), which
+//still handles every message. This helps the utility, which receives a
+//message from every meter at once, more than it helps meters.
+constexpr int TCP_RECEIVE_THREADS = 1;
+
+//The most bytes a TCP client queues for one peer that isn't reading them fast
+//enough (or whose connection is still opening). Sends to a peer whose queue is
+//this full fail, like sends to a peer that can't be connected to, instead of
+//buffering without bound; the peer's queued frames are still sent.
+constexpr std::size_t MAX_QUEUED_SEND_BYTES = 4 * 1024 * 1024;
+
+//The largest frame, in bytes, that a client will receive over TCP. A peer that
+//announces a larger frame is sending garbage (or trying to make the receiver
+//allocate it), so its connection is closed instead of the frame being read.
+//This is far more than any real frame, even a utility's query to every meter.
+constexpr std::size_t MAX_RECEIVED_FRAME_SIZE = 64 * 1024 * 1024;
+
+//The smallest write, in bytes, that a TCP client sends with MSG_ZEROCOPY, which
+//lets the kernel read the frames from their buffers instead of copying them.
+//Pinning the buffers and waiting for the kernel to release them costs more
+//than copying a small write, so this is only worthwhile for writes of at least
+//about 10KB, such as the backlog of a peer that has fallen behind. 0 disables
+//MSG_ZEROCOPY, as does a kernel older than 4.14.
+constexpr std::size_t ZEROCOPY_SEND_THRESHOLD = 0;
+
+//The system calls TCP clients use to receive messages and to write batches of
+//sends, unless a client is constructed with a different ReactorType. IO_URING
+//needs Linux 6.0 or later, and falls back to EPOLL on older kernels. It saves
+//the most system calls for the utility, which sends a query to every meter at
+//once and receives a message from each of them; see reactor_benchmark.
+constexpr networking::ReactorType TCP_REACTOR = networking::ReactorType::EPOLL;
+
+//The largest datagram, in bytes, that UdpNetworkClient sends overlay batches
+//and pings in. A batch that doesn't fit, as BFT's often don't, is split into
+//fragments that the receiver reassembles. The default keeps each datagram
+//within a 1500-byte Ethernet MTU, so IP never has to fragment it; every meter
+//must use the same value, since receivers drop datagrams larger than theirs.
+constexpr std::size_t UDP_MAX_DATAGRAM_SIZE = 1472;
+//How long, in milliseconds, a receiver keeps the fragments of a batch that
+//hasn't been completed. A batch with a lost fragment is then dropped, like a
+//batch lost in one datagram, and the protocol's round timeouts and pings
+//recover from it the same way they recover from a failed meter.
+constexpr int UDP_REASSEMBLY_TIMEOUT = 1000;
+
+//If true, TCP clients send frames to clients on the same host through rings
+//in shared memory instead of through loopback TCP connections, which lets one
+//machine emulate many more meters. Each client creates a ring of
+//SHARED_MEMORY_RING_SIZE bytes (a power of 2), which must hold at least two
+//of the largest frames it receives; larger frames still go over TCP. Clients
+//in the same process skip the ring and pass frames to each other directly, so
+//the ring's memory is only used by senders in other processes.
+constexpr bool SHARED_MEMORY_TRANSPORT = false;
+constexpr std::size_t SHARED_MEMORY_RING_SIZE = 1024 * 1024;
+
 using NetworkClientBuilderFunc = std::function<NetworkClient_t (MeterClient&)>;
 using CryptoLibraryBuilderFunc = std::function<CryptoLibrary_t (MeterClient&)>;
 using TimerManagerBuilderFunc = std::function<TimerManager_t (MeterClient&)>;
@@ -12,6 +12,8 @@
 #include "CrusaderAgreementState.h"
 #include "Configuration.h"
 #include "ConfigurationIncludes.h"
+#include "messaging/MulticastOverlayMessage.h"
+#include "messaging/OnionBuilder.h"
 #include "messaging/OverlayMessage.h"
 #include "messaging/ValueContribution.h"
 #include "messaging/SignedValue.h"
@@ -26,10 +28,13 @@ namespace pddm {
  * to each other node in the agreement group.
  * @param current_round The current round in the peer-to-peer overlay
  *        that messages will be sent over.
+ * @param avoid_nodes Meters that are believed to have failed, which the
+ *        accept messages should not be routed through
  * @return A list of message IDs of accept messages to send to other nodes
  *         in this node's agreement group
  */
-std::vector<std::shared_ptr<messaging::OverlayMessage> > CrusaderAgreementState::finish_phase_1(int current_round) {
+std::vector<std::shared_ptr<messaging::OverlayMessage> > CrusaderAgreementState::finish_phase_1(int current_round,
+        const std::set<int>& avoid_nodes) {
     std::vector<std::shared_ptr<messaging::OverlayMessage>> accept_messages;
     for(const auto& signed_value_entry : signed_proxy_values) {
         if(signed_value_entry.second.signatures.size() < (unsigned) log2n + 1) {
@@ -43,10 +48,17 @@ std::vector<std::shared_ptr<messaging::OverlayMessage> > CrusaderAgreementState:
         std::vector<int> other_proxies(signed_value_entry.first->value.proxies.size()-1);
         std::remove_copy(signed_value_entry.first->value.proxies.begin(),
                 signed_value_entry.first->value.proxies.end(), other_proxies.begin(), node_id);
-        auto proxy_paths = util::find_paths(node_id, other_proxies, num_nodes, current_round+1);
-        for(const auto& proxy_path : proxy_paths) {
-            accept_messages.emplace_back(crypto_library.rsa_encrypt(std::make_shared<messaging::PathOverlayMessage>(
-                    query_num, proxy_path, signed_accepted_value), proxy_path.back()));
+        if(MULTICAST_ECHO) {
+            auto proxy_tree = util::find_multicast_tree(node_id, other_proxies, num_nodes, current_round+1, avoid_nodes);
+            for(const auto& branch : messaging::build_encrypted_multicast(proxy_tree, signed_accepted_value, query_num, crypto_library)) {
+                accept_messages.emplace_back(branch);
+            }
+        } else {
+            auto proxy_paths = util::find_paths(node_id, other_proxies, num_nodes, current_round+1, avoid_nodes);
+            for(const auto& proxy_path : proxy_paths) {
+                accept_messages.emplace_back(crypto_library.rsa_encrypt(std::make_shared<messaging::PathOverlayMessage>(
+                        query_num, proxy_path, signed_accepted_value), proxy_path.back()));
+            }
         }
     }
     phase_1_finished = true;
@@ -78,9 +90,9 @@ util::unordered_ptr_set<messaging::ValueContribution> CrusaderAgreementState::fi
  * @param message A message received during Crusader Agreement.
  */
 void CrusaderAgreementState::handle_message(const messaging::OverlayMessage& message) {
-    if(auto signed_value = std::dynamic_pointer_cast<messaging::SignedValue>(message.body)) {
+    if(auto signed_value = messaging::body_pointer_cast<messaging::SignedValue>(message.body)) {
         handle_phase_1_message(signed_value);
-    } else if (auto agreement_value = std::dynamic_pointer_cast<messaging::AgreementValue>(message.body)) {
+    } else if (auto agreement_value = messaging::body_pointer_cast<messaging::AgreementValue>(message.body)) {
         handle_phase_2_message(agreement_value);
     }
 }
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <memory>
+#include <set>
 #include <unordered_map>
 #include <vector>
 #include <cmath>
@@ -52,7 +53,8 @@ class CrusaderAgreementState {
             phase_1_finished(false), crypto_library(crypto_library) {}
 
         bool is_phase1_finished() { return phase_1_finished; }
-        std::vector<std::shared_ptr<messaging::OverlayMessage>> finish_phase_1(int current_round);
+        std::vector<std::shared_ptr<messaging::OverlayMessage>> finish_phase_1(int current_round,
+                const std::set<int>& avoid_nodes);
         util::unordered_ptr_set<messaging::ValueContribution> finish_phase_2();
         void handle_message(const messaging::OverlayMessage& message);
 
@@ -14,6 +14,8 @@
 #include "messaging/OverlayTransportMessage.h"
 #include "messaging/QueryRequest.h"
 #include "messaging/OnionBuilder.h"
+#include "messaging/MulticastOverlayMessage.h"
+#include "messaging/PathOverlayMessage.h"
 #include "simulation/DebugState.h"
 #include "util/PathFinder.h"
 
@@ -28,6 +30,12 @@ void CtProtocolState::start_query_impl(const std::shared_ptr<messaging::QueryReq
     //We don't actually need to sign contributions in crash-tolerant mode, but use ValueContribution anyway
     auto signed_contribution = std::make_shared<messaging::ValueContribution>(*my_contribution);
 
+    //If meters can finish Shuffle and Echo early, they still need to relay until the last round Echo could end,
+    //unless they prove that Echo is over everywhere (see finish_overlay_early)
+    if(EARLY_PHASE_COMPLETION) {
+        final_overlay_round = 2 * phase_round_limit();
+    }
+    start_phase_certificate((int) CtProtocolPhase::SHUFFLE);
     encrypted_multicast_to_proxies(signed_contribution);
 }
 
@@ -42,17 +50,24 @@ void CtProtocolState::handle_overlay_message_impl(const std::shared_ptr<messagin
          * it was just received here), but a PathOverlayMessage that still needs to be forwarded will
          * have its destination already set to the next hop by the superclass handle_overlay_message.
          */
-        if(auto enclosed_message = std::dynamic_pointer_cast<messaging::OverlayMessage>(overlay_message->body)){
-            waiting_messages.emplace_back(enclosed_message);
+        if(auto enclosed_message = messaging::body_pointer_cast<messaging::OverlayMessage>(overlay_message->body)){
+            relay_message(enclosed_message, message->sender_round);
         } else if(overlay_message->destination == meter_id){
+            //Echo messages are the only Path or Multicast messages, and they may arrive before this meter finishes Shuffle
+            if(overlay_message->get_type() == messaging::MessageBodyType::PATH_OVERLAY
+                    || overlay_message->get_type() == messaging::MessageBodyType::MULTICAST_OVERLAY) {
+                record_phase_delivery((int) CtProtocolPhase::ECHO);
+            } else {
+                record_phase_delivery((int) CtProtocolPhase::SHUFFLE);
+            }
             if(protocol_phase == CtProtocolPhase::SHUFFLE) {
                 handle_shuffle_phase_message(*overlay_message);
             } else if(protocol_phase == CtProtocolPhase::ECHO) {
                 handle_echo_phase_message(*overlay_message);
             }
-        } //If destination didn't match, it was already added to waiting_messages
+        } //If destination didn't match, it was already relayed
     }
-    if(message->is_final_message && is_in_overlay_phase()) {
+    if(message->is_final_message && is_running_overlay() && received_all_final_messages()) {
         end_overlay_round();
     }
 }
@@ -60,7 +75,7 @@ void CtProtocolState::handle_overlay_message_impl(const std::shared_ptr<messagin
 
 void CtProtocolState::handle_shuffle_phase_message(const messaging::OverlayMessage& message) {
     //Drop messages that are received in the wrong phase (i.e. not ValueContributions) or have the wrong round number
-    if(auto contribution = std::dynamic_pointer_cast<messaging::ValueContribution>(message.body)) {
+    if(auto contribution = messaging::body_pointer_cast<messaging::ValueContribution>(message.body)) {
         if(contribution->value.query_num == my_contribution->query_num) {
             logger->debug("Meter {} received proxy value: {}", meter_id, *contribution);
             proxy_values.emplace(contribution);
@@ -73,7 +88,7 @@ void CtProtocolState::handle_shuffle_phase_message(const messaging::OverlayMessa
 }
 
 void CtProtocolState::handle_echo_phase_message(const messaging::OverlayMessage& message) {
-    if(auto contribution = std::dynamic_pointer_cast<messaging::ValueContribution>(message.body)) {
+    if(auto contribution = messaging::body_pointer_cast<messaging::ValueContribution>(message.body)) {
         if(contribution->value.query_num == my_contribution->query_num) {
             logger->debug("Meter {} received echoed proxy value in round {}: {}", meter_id, overlay_round, *contribution);
             proxy_values.emplace(contribution);
@@ -98,34 +113,59 @@ void CtProtocolState::send_aggregate_if_done() {
 void CtProtocolState::end_overlay_round_impl() {
     //Determine if the Shuffle phase has ended
     if(protocol_phase == CtProtocolPhase::SHUFFLE
-            && overlay_round >= FAILURES_TOLERATED + 2 * log2n + 1) {
+            && (overlay_round >= phase_round_limit()
+                    || phase_proven_complete((int) CtProtocolPhase::SHUFFLE))) {
         logger->debug("Meter {} is finished with Shuffle", meter_id);
+        //Only keep certifying if every onion is known to have arrived
+        if(phase_proven_complete((int) CtProtocolPhase::SHUFFLE)) {
+            start_phase_certificate((int) CtProtocolPhase::ECHO);
+        } else {
+            stop_phase_certificates();
+        }
         //Multicast each received value to its other proxies
+        const std::set<int> avoided_meters = presumed_failed_meters();
         for(const auto& proxy_value : proxy_values) {
             //Remove this meter's ID from the list of proxies
             std::vector<int> other_proxies(proxy_value->value.proxies.size()-1);
             std::remove_copy(proxy_value->value.proxies.begin(),
                     proxy_value->value.proxies.end(), other_proxies.begin(), meter_id);
-            auto proxy_paths = util::find_paths(meter_id, other_proxies, num_meters, overlay_round+1);
-            logger->trace("Meter {} chose these paths for echo: {}", meter_id, proxy_paths);
-            for(const auto& proxy_path : proxy_paths) {
-                //Encrypt with the destination's public key, but don't make an onion
-                outgoing_messages.emplace_back(crypto.rsa_encrypt(std::make_shared<messaging::PathOverlayMessage>(
-                        get_current_query_num(), proxy_path, proxy_value), proxy_path.back()));
-                //Does proxy_value need to be copied? I don't think so, it won't change
+            if(MULTICAST_ECHO) {
+                auto proxy_tree = util::find_multicast_tree(meter_id, other_proxies, num_meters, overlay_round+1, avoided_meters);
+                logger->trace("Meter {} chose this tree for echo: {}", meter_id, proxy_tree);
+                for(const auto& branch : messaging::build_encrypted_multicast(proxy_tree, proxy_value, get_current_query_num(), crypto)) {
+                    outgoing_messages.emplace_back(branch);
+                }
+            } else {
+                auto proxy_paths = util::find_paths(meter_id, other_proxies, num_meters, overlay_round+1, avoided_meters);
+                logger->trace("Meter {} chose these paths for echo: {}", meter_id, proxy_paths);
+                for(const auto& proxy_path : proxy_paths) {
+                    //Encrypt with the destination's public key, but don't make an onion
+                    outgoing_messages.emplace_back(crypto.rsa_encrypt(std::make_shared<messaging::PathOverlayMessage>(
+                            get_current_query_num(), proxy_path, proxy_value), proxy_path.back()));
+                    //Does proxy_value need to be copied? I don't think so, it won't change
+                }
             }
+            //Either way, each other proxy gets one copy, but copies to meters that are believed to have failed aren't counted
+            record_phase_sends((int) std::count_if(other_proxies.begin(), other_proxies.end(), [this](const int proxy) {
+                return !is_presumed_failed(proxy);
+            }));
         }
         echo_start_round = overlay_round;
         protocol_phase = CtProtocolPhase::ECHO;
         SIM_DEBUG(util::debug_state().num_finished_shuffle++;);
         SIM_DEBUG(util::print_shuffle_status(logger, num_meters););
     }
-    //Determine if the Echo phase has ended
+    //Determine if the Echo phase has ended. Since other proxies may have started Echo later than
+    //this meter did, the fallback is the round at which Echo would end if every meter started on time.
     else if (protocol_phase == CtProtocolPhase::ECHO
-            && overlay_round >= echo_start_round + FAILURES_TOLERATED + 2 * log2n + 1) {
-        logger->debug("Meter {} is finished with Echo", meter_id);
+            && (overlay_round >= 2 * phase_round_limit()
+                    || phase_proven_complete((int) CtProtocolPhase::ECHO))) {
+        logger->debug("Meter {} is finished with Echo after {} rounds", meter_id, overlay_round - echo_start_round);
         SIM_DEBUG(util::debug_state().num_finished_echo++;);
         SIM_DEBUG(util::print_echo_status(logger, meter_id, num_meters););
+        if(phase_proven_complete((int) CtProtocolPhase::ECHO)) {
+            finish_overlay_early();
+        }
         //Start the Aggregate phase
         protocol_phase = CtProtocolPhase::AGGREGATE;
         start_aggregate_phase();
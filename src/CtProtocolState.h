@@ -28,6 +28,8 @@ class CtProtocolState: public ProtocolState<CtProtocolState> {
         CtProtocolPhase protocol_phase;
         void handle_echo_phase_message(const messaging::OverlayMessage& message);
         void handle_shuffle_phase_message(const messaging::OverlayMessage& message);
+        /** The number of rounds that Shuffle and Echo each need to tolerate FAILURES_TOLERATED failures */
+        int phase_round_limit() const { return FAILURES_TOLERATED + 2 * logkn + 1; }
 
     public:
         CtProtocolState(NetworkClient_t& network, CryptoLibrary_t& crypto, TimerManager_t& timer_library,
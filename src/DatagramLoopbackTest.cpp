@@ -0,0 +1,223 @@
+/**
+ * @file DatagramLoopbackTest.cpp
+ * Checks DatagramSocket over the loopback interface, in both wire formats:
+ * an overlay batch large enough to be split into fragments and a ping are
+ * framed the way UdpNetworkClient frames them, sent between two sockets, and
+ * decoded the way TcpNetworkClient decodes frames. It then sends a truncated
+ * datagram, an oversized one, and one too short to have a header, which must
+ * all be dropped, followed by an intact copy that must still arrive.
+ * Prints each check's result, and exits with a nonzero status if any failed.
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Configuration.h"
+#include "FixedPoint_t.h"
+#include "messaging/OverlayTransportMessage.h"
+#include "messaging/PathOverlayMessage.h"
+#include "messaging/PingMessage.h"
+#include "messaging/ValueContribution.h"
+#include "messaging/ValueTuple.h"
+#include "networking/DatagramSocket.h"
+#include "networking/MessageFraming.h"
+#include "networking/Socket.h"
+
+using namespace pddm;
+using networking::DatagramSocket;
+
+/** How long to wait for datagrams that should arrive, in milliseconds */
+constexpr int RECEIVE_WAIT = 1000;
+/** How long to wait for datagrams that should be dropped, to be sure they aren't just late */
+constexpr int DROP_WAIT = 200;
+
+sockaddr_in loopback_address(const int port) {
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    return address;
+}
+
+/**
+ * Receives frames on a socket until a number of them have arrived or a
+ * timeout passes, whichever comes first.
+ */
+std::vector<DatagramSocket::ReceivedFrame> receive_frames(DatagramSocket& socket, const std::size_t expected, const int timeout_ms) {
+    std::vector<DatagramSocket::ReceivedFrame> frames;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while(frames.size() < expected) {
+        const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if(remaining.count() <= 0) {
+            break;
+        }
+        pollfd poll_fd{socket.get_fd(), POLLIN, 0};
+        if(poll(&poll_fd, 1, remaining.count()) > 0) {
+            socket.receive(frames);
+        }
+    }
+    return frames;
+}
+
+/**
+ * Decodes the messages in a frame received from a meter.
+ * @param received The frame and its format
+ * @param num_values Incremented for each overlay message that has a body
+ * @return The types of the messages, in order
+ * @throws messaging::DecodeError if the frame is malformed
+ */
+std::vector<messaging::MessageType> decode_frame(const DatagramSocket::ReceivedFrame& received, int& num_values) {
+    using namespace messaging;
+    const messaging::SharedBuffer& frame = received.first;
+    const WireFormat format = received.second;
+    std::vector<MessageType> types;
+    const char* buffer = frame->data();
+    const char* frame_end = buffer + frame->size();
+    std::size_t num_messages = networking::read_size_prefix(buffer, frame_end, format);
+    for(auto i = 0u; i < num_messages; ++i) {
+        std::size_t message_size = networking::read_message_size(buffer, frame_end, format);
+        MessageType message_type = networking::peek_message_type(buffer, format);
+        if(message_type == OverlayTransportMessage::type) {
+            auto message = networking::view_transport_message(buffer, message_size, format, frame);
+            if(message->body) {
+                ++num_values;
+            }
+        } else if(message_type == PingMessage::type) {
+            networking::decode_message<PingMessage>(buffer, message_size, format);
+        }
+        types.push_back(message_type);
+        buffer += message_size;
+    }
+    return types;
+}
+
+bool report(const std::string& check, const bool passed) {
+    std::cout << (passed ? "PASS: " : "FAIL: ") << check << std::endl;
+    return passed;
+}
+
+/**
+ * Runs every check in one wire format.
+ * @return The number of checks that failed
+ */
+int run_checks(const messaging::WireFormat format, const int first_port) {
+    using namespace messaging;
+    const std::string format_name = format == WireFormat::COMPACT ? "COMPACT" : "MUTILS";
+    int num_failed = 0;
+    DatagramSocket sender(first_port);
+    DatagramSocket receiver(first_port + 1);
+    const sockaddr_in receiver_address = loopback_address(first_port + 1);
+    std::vector<char> frame;
+    std::vector<std::size_t> message_sizes;
+
+    //An overlay batch large enough that it can't fit in one datagram
+    const int batch_size = 2 * UDP_MAX_DATAGRAM_SIZE / 64;
+    std::list<std::shared_ptr<OverlayTransportMessage>> batch;
+    for(int i = 0; i < batch_size; ++i) {
+        auto payload = std::make_shared<ValueContribution>(ValueTuple(2, {10, FixedPoint_t(static_cast<double>(i))}, {5, 15, i}));
+        auto message = std::make_shared<PathOverlayMessage>(2, std::list<int>{1, 2, 3, i}, payload);
+        batch.emplace_back(std::make_shared<OverlayTransportMessage>(1, 3, i == batch_size - 1, message));
+    }
+    networking::frame_messages(batch.begin(), batch.end(), format, frame, message_sizes);
+    num_failed += !report(format_name + " overlay batch needs more than one datagram", frame.size() > UDP_MAX_DATAGRAM_SIZE);
+    sender.queue_frame(1, receiver_address, frame, format);
+    auto ping = std::make_shared<PingMessage>(1, true);
+    networking::frame_messages(&ping, &ping + 1, format, frame, message_sizes);
+    sender.queue_frame(1, receiver_address, frame, format);
+    num_failed += !report(format_name + " send to loopback", sender.send_queued().empty());
+
+    std::vector<DatagramSocket::ReceivedFrame> frames = receive_frames(receiver, 2, RECEIVE_WAIT);
+    num_failed += !report(format_name + " both frames received", frames.size() == 2);
+    //Fragments of the batch may be reassembled after the ping arrives, so the frames can come in either order
+    bool batch_decoded = false;
+    bool ping_decoded = false;
+    for(const auto& received : frames) {
+        try {
+            int num_values = 0;
+            std::vector<MessageType> types = decode_frame(received, num_values);
+            if(received.second != format) {
+                continue;
+            }
+            if(types.size() == static_cast<std::size_t>(batch_size) && num_values == batch_size) {
+                batch_decoded = true;
+            } else if(types.size() == 1 && types.front() == PingMessage::type) {
+                ping_decoded = true;
+            }
+        } catch(const DecodeError& e) {
+            std::cout << format_name << " frame could not be decoded: " << e.what() << std::endl;
+        }
+    }
+    num_failed += !report(format_name + " overlay batch reassembled and decoded", batch_decoded);
+    num_failed += !report(format_name + " ping decoded", ping_decoded);
+
+    //Capture an intact datagram of the ping on a plain socket, so it can be resent with its bytes altered
+    int raw_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    const sockaddr_in raw_address = loopback_address(first_port + 2);
+    if(raw_fd < 0 || bind(raw_fd, (const sockaddr*) &raw_address, sizeof(raw_address)) < 0) {
+        report(format_name + " bind a plain UDP socket to port " + std::to_string(first_port + 2), false);
+        if(raw_fd >= 0) {
+            close(raw_fd);
+        }
+        return num_failed + 1;
+    }
+    sender.queue_frame(1, raw_address, frame, format);
+    sender.send_queued();
+    std::vector<char> datagram(UDP_MAX_DATAGRAM_SIZE + 1);
+    pollfd poll_fd{raw_fd, POLLIN, 0};
+    ssize_t datagram_size = poll(&poll_fd, 1, RECEIVE_WAIT) > 0 ? recv(raw_fd, datagram.data(), datagram.size(), 0) : -1;
+    if(datagram_size <= 0) {
+        report(format_name + " capture a datagram", false);
+        close(raw_fd);
+        return num_failed + 1;
+    }
+    datagram.resize(datagram_size);
+    auto send_raw = [&](const char* bytes, const std::size_t size) {
+        sendto(raw_fd, bytes, size, 0, (const sockaddr*) &receiver_address, sizeof(receiver_address));
+    };
+    //Missing its last byte, the datagram is shorter than the frame its header describes
+    send_raw(datagram.data(), datagram.size() - 1);
+    num_failed += !report(format_name + " truncated datagram dropped", receive_frames(receiver, 1, DROP_WAIT).empty());
+    //A datagram larger than UDP_MAX_DATAGRAM_SIZE doesn't fit in the receiver's buffers
+    std::vector<char> oversized(datagram);
+    oversized.resize(UDP_MAX_DATAGRAM_SIZE + 1, 0);
+    send_raw(oversized.data(), oversized.size());
+    num_failed += !report(format_name + " oversized datagram dropped", receive_frames(receiver, 1, DROP_WAIT).empty());
+    send_raw(datagram.data(), 4);
+    num_failed += !report(format_name + " datagram shorter than a header dropped", receive_frames(receiver, 1, DROP_WAIT).empty());
+    //The socket must still accept well-formed datagrams after dropping bad ones
+    send_raw(datagram.data(), datagram.size());
+    frames = receive_frames(receiver, 1, RECEIVE_WAIT);
+    num_failed += !report(format_name + " intact datagram received after the dropped ones", frames.size() == 1);
+    close(raw_fd);
+    return num_failed;
+}
+
+int main(int argc, char** argv) {
+    //Each format's checks use three consecutive ports, starting from this one
+    const int first_port = argc > 1 ? std::atoi(argv[1]) : 20000;
+    int num_failed = 0;
+    try {
+        num_failed += run_checks(messaging::WireFormat::MUTILS, first_port);
+        num_failed += run_checks(messaging::WireFormat::COMPACT, first_port + 3);
+    } catch(const networking::connection_failure& e) {
+        std::cout << "FAIL: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << (num_failed == 0 ? "All checks passed" : std::to_string(num_failed) + " checks failed") << std::endl;
+    return num_failed == 0 ? 0 : 1;
+}
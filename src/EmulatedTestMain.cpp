@@ -53,12 +53,6 @@ int main(int argc, char** argv) {
     std::map<int, networking::TcpAddress> meter_ips_by_id = util::read_ip_map_from_file(std::string(argv[3]));
 
     int num_meters = meter_ips_by_id.size();
-    int modulus = util::get_valid_prime_modulus(num_meters);
-    if(modulus != num_meters) {
-        std::cout << "ERROR: The number of meters specified in " << std::string(argv[3]) << " is not a valid prime. "
-                << "This experiment does not handle non-prime numbers of meters." << std::endl;
-        return -1;
-    }
     ProtocolState_t::init_failures_tolerated(num_meters);
 
     const int NUM_QUERIES = 3;
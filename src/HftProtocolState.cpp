@@ -10,14 +10,17 @@
 #include <spdlog/spdlog.h>
 #include <spdlog/fmt/ostr.h>
 #include <algorithm>
+#include <climits>
 #include <iterator>
 #include <list>
 #include <map>
 #include <numeric>
+#include <set>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 
+#include "messaging/FloodDigestMessage.h"
 #include "messaging/OverlayMessage.h"
 #include "messaging/OverlayTransportMessage.h"
 #include "messaging/QueryRequest.h"
@@ -34,6 +37,8 @@ namespace pddm {
 void HftProtocolState::start_query_impl(const std::shared_ptr<messaging::QueryRequest>& query_request, const std::vector<FixedPoint_t>& contributed_data) {
     protocol_phase = HftProtocolPhase::SCATTER;
     current_flood_messages.clear();
+    seen_flood_ids.clear();
+    target_digests.clear();
     relay_messages.clear();
     gather_start_round = 0;
 
@@ -56,7 +61,7 @@ void HftProtocolState::start_query_impl(const std::shared_ptr<messaging::QueryRe
         auto outer_layer = crypto.rsa_encrypt(std::make_shared<messaging::OverlayMessage>(
                 query_request->query_number, proxy_relay.second, inner_layer, true),
                 proxy_relay.second);
-        current_flood_messages.emplace(outer_layer);
+        start_flooding(outer_layer);
     }
     //Start the overlay by ending "round -1", which will send the messages at the start of round 0
     end_overlay_round();
@@ -70,23 +75,26 @@ void HftProtocolState::handle_overlay_message_impl(const std::shared_ptr<messagi
     if(overlay_message->body != nullptr) {
         //With this protocol there are no Path messages, only flood messages
         if(overlay_message->destination == meter_id) {
-            if(protocol_phase == HftProtocolPhase::SCATTER) {
-                handle_scatter_phase_message(*overlay_message);
-            } else if(protocol_phase == HftProtocolPhase::GATHER) {
-                handle_gather_phase_message(*overlay_message);
+            //Several predecessors may flood me the same message, but I only need to handle it once
+            if(seen_flood_ids.emplace(flood_message_id(*overlay_message)).second) {
+                if(protocol_phase == HftProtocolPhase::SCATTER) {
+                    handle_scatter_phase_message(*overlay_message);
+                } else if(protocol_phase == HftProtocolPhase::GATHER) {
+                    handle_gather_phase_message(*overlay_message);
+                }
             }
         } else {
-            //Messages not destined for me must continue to get sent on every round
-            current_flood_messages.emplace(overlay_message);
+            //Messages not destined for me must continue to get sent in later rounds
+            start_flooding(overlay_message);
         }
     }
-    if(message->is_final_message && is_in_overlay_phase()) {
+    if(message->is_final_message && is_in_overlay_phase() && received_all_final_messages()) {
         end_overlay_round();
     }
 }
 
 void HftProtocolState::handle_scatter_phase_message(const messaging::OverlayMessage& message) {
-    if(auto wrapped_message = std::dynamic_pointer_cast<messaging::OverlayMessage>(message.body)) {
+    if(auto wrapped_message = messaging::body_pointer_cast<messaging::OverlayMessage>(message.body)) {
         //Just unwrap the message and save it for Gather
         logger->debug("In round {}, meter {} got a relay message: {}", overlay_round, meter_id, *wrapped_message);
         relay_messages.emplace(wrapped_message);
@@ -96,7 +104,7 @@ void HftProtocolState::handle_scatter_phase_message(const messaging::OverlayMess
 }
 
 void HftProtocolState::handle_gather_phase_message(const messaging::OverlayMessage& message) {
-    if(auto contribution = std::dynamic_pointer_cast<messaging::ValueContribution>(message.body)) {
+    if(auto contribution = messaging::body_pointer_cast<messaging::ValueContribution>(message.body)) {
         if(contribution->value.query_num == my_contribution->query_num) {
             logger->debug("In round {}, meter {} received proxy value: {}", overlay_round, meter_id, *contribution);
             proxy_values.emplace(contribution);
@@ -111,45 +119,147 @@ void HftProtocolState::handle_gather_phase_message(const messaging::OverlayMessa
 void HftProtocolState::end_overlay_round_impl() {
     //Determine if the Scatter phase has ended
     if(protocol_phase == HftProtocolPhase::SCATTER
-            && overlay_round >= log2n + FAILURES_TOLERATED) {
+            && overlay_round >= logkn + FAILURES_TOLERATED) {
         logger->debug("Meter {} is finished with Scatter", meter_id);
         //Discard flood messages for the Scatter phase
         current_flood_messages.clear();
+        seen_flood_ids.clear();
+        gather_start_round = overlay_round;
         //Start flooding each relay message to its proxy
-        std::swap(current_flood_messages, relay_messages);
+        for(const auto& relay_message : relay_messages) {
+            start_flooding(relay_message);
+        }
+        relay_messages.clear();
 
-        gather_start_round = overlay_round;
         protocol_phase = HftProtocolPhase::GATHER;
         SIM_DEBUG(util::debug_state().num_finished_scatter++;);
         SIM_DEBUG(util::print_scatter_status(logger, num_meters););
     }
     //Determine if the Gather phase has ended
     else if(protocol_phase == HftProtocolPhase::GATHER
-            && overlay_round >= gather_start_round + log2n + FAILURES_TOLERATED) {
+            && overlay_round >= gather_start_round + logkn + FAILURES_TOLERATED) {
         logger->debug("Meter {} is finished with Gather", meter_id);
         SIM_DEBUG(util::debug_state().num_finished_gather++;);
         SIM_DEBUG(util::print_gather_status(logger, meter_id, num_meters););
         current_flood_messages.clear();
+        seen_flood_ids.clear();
 
         //Start the Aggregate phase
         protocol_phase = HftProtocolPhase::AGGREGATE;
         start_aggregate_phase();
     }
 
+    //Digests for the round that just ended are no longer needed
+    target_digests.erase(target_digests.begin(), target_digests.lower_bound(std::make_pair(overlay_round + 1, INT_MIN)));
     //If we're still in an overlay-using phase, send all current flood messages
     if(is_in_overlay_phase()) {
+        //Forwarding a message for log_k(N) rounds reaches every meter if none
+        //fail; the redundancy factor decides how many more rounds to keep trying
+        const int forwarding_rounds = logkn + (int) std::ceil(FLOOD_REDUNDANCY * FAILURES_TOLERATED);
         for(auto flood_message_iter = current_flood_messages.begin();
                 flood_message_iter != current_flood_messages.end(); ) {
-            outgoing_messages.emplace_back(*flood_message_iter);
+            const auto& flood_message = flood_message_iter->second.first;
+            if(overlay_round - flood_message_iter->second.second > forwarding_rounds) {
+                //Stop forwarding it, but keep its ID in seen_flood_ids so it isn't picked up again
+                flood_message_iter = current_flood_messages.erase(flood_message_iter);
+                continue;
+            }
+            outgoing_messages.emplace_back(flood_message);
             //If the message will be sent to its final destination, it's now
             //safe to remove it from current_flood_messages
-            if(util::gossip_target(meter_id, overlay_round+1, num_meters) == (*flood_message_iter)->destination) {
+            if(util::is_gossip_target(meter_id, overlay_round+1, num_meters, flood_message->destination)) {
                 flood_message_iter = current_flood_messages.erase(flood_message_iter);
             } else {
                 ++flood_message_iter;
             }
         }
+        send_flood_digest();
+    }
+}
+
+/**
+ * Starts forwarding a flood message in every round, unless this meter has
+ * already seen it during the current phase.
+ * @param message The flood message
+ * @return True if the message was new, false if it was a duplicate
+ */
+bool HftProtocolState::start_flooding(const std::shared_ptr<messaging::OverlayMessage>& message) {
+    const std::uint64_t message_id = flood_message_id(*message);
+    if(!seen_flood_ids.emplace(message_id).second) {
+        return false;
     }
+    current_flood_messages.emplace(message_id, std::make_pair(message, overlay_round));
+    return true;
+}
+
+/**
+ * Tells the meters that will gossip to this meter two rounds from now which
+ * flood messages it has already seen. A digest sent for the very next round
+ * would usually arrive after those meters had already sent their messages,
+ * so this trades one round of staleness for being on time. Since a meter
+ * never forgets a message it has seen, a stale digest is still accurate.
+ * The digest is only sent if that round is still in the current phase, since
+ * flood messages don't carry over between phases, and it isn't sent to
+ * predecessors that are presumed to have failed.
+ */
+void HftProtocolState::send_flood_digest() {
+    const int phase_end_round = (protocol_phase == HftProtocolPhase::SCATTER ? 0 : gather_start_round)
+            + logkn + FAILURES_TOLERATED;
+    if(seen_flood_ids.empty() || overlay_round + 2 > phase_end_round) {
+        return;
+    }
+    auto digest = std::make_shared<messaging::FloodDigestMessage>(meter_id, get_current_query_num(),
+            overlay_round + 2, messaging::FloodDigestMessage::build_filter(seen_flood_ids));
+    std::set<int> unreachable_ids;
+    for(const int predecessor : util::gossip_predecessors(meter_id, overlay_round + 2, num_meters)) {
+        if(is_presumed_failed(predecessor)) {
+            continue;
+        }
+        if(!network.send(digest, predecessor)) {
+            unreachable_ids.emplace(predecessor);
+        }
+    }
+    mark_meters_failed(unreachable_ids);
+}
+
+void HftProtocolState::handle_flood_digest(const std::shared_ptr<messaging::FloodDigestMessage>& message) {
+    if(!is_in_overlay_phase() || message->query_num != get_current_query_num()
+            || message->round <= overlay_round) {
+        logger->trace("Meter {} ignored an out-of-date flood digest: {}", meter_id, *message);
+        return;
+    }
+    target_digests[std::make_pair(message->round, message->sender_id)] = message;
+}
+
+bool HftProtocolState::should_flood_to(const messaging::OverlayMessage& message, const int target) const {
+    //Always send a message to its destination, so a false positive in the digest can't keep it from arriving
+    if(message.destination == target) {
+        return true;
+    }
+    auto digest_find = target_digests.find(std::make_pair(overlay_round, target));
+    if(digest_find == target_digests.end()) {
+        return true;
+    }
+    return !digest_find->second->might_hold(flood_message_id(message));
+}
+
+/**
+ * Computes an ID for a flood message from its serialized contents (using
+ * 64-bit FNV-1a), so that every meter assigns the same ID to the same message.
+ * The std::hash of an OverlayMessage can't be used for this, since it hashes
+ * the address of the message's body.
+ * @param message A flood message
+ * @return The message's ID
+ */
+std::uint64_t HftProtocolState::flood_message_id(const messaging::OverlayMessage& message) {
+    std::uint64_t hash = 14695981039346656037ull;
+    message.post_object([&hash](const char* const bytes, std::size_t size) {
+        for(std::size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<unsigned char>(bytes[i]);
+            hash *= 1099511628211ull;
+        }
+    });
+    return hash;
 }
 
 void HftProtocolState::send_aggregate_if_done() {
@@ -7,14 +7,25 @@
 
 #pragma once
 #include <cmath>
+#include <cstdint>
+#include <map>
 #include <vector>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <spdlog/spdlog.h>
 
 #include "ProtocolState.h"
 #include "FixedPoint_t.h"
 #include "util/PointerUtil.h"
 
+namespace pddm {
+namespace messaging {
+class FloodDigestMessage;
+} /* namespace messaging */
+} /* namespace pddm */
+
 namespace pddm {
 
 enum class HftProtocolPhase { IDLE, SCATTER, GATHER, AGGREGATE };
@@ -24,11 +35,22 @@ class HftProtocolState: public ProtocolState<HftProtocolState> {
         std::shared_ptr<spdlog::logger> logger;
         HftProtocolPhase protocol_phase;
         int gather_start_round;
-        util::unordered_ptr_set<messaging::OverlayMessage> current_flood_messages;
+        /** The flood messages this meter is still forwarding, indexed by
+         * message ID, each paired with the round in which this meter got it */
+        std::unordered_map<std::uint64_t, std::pair<std::shared_ptr<messaging::OverlayMessage>, int>> current_flood_messages;
+        /** The IDs of every flood message this meter has held in the current
+         * phase, including the ones it has stopped forwarding */
+        std::unordered_set<std::uint64_t> seen_flood_ids;
+        /** The digests of flood messages that meters this meter will gossip
+         * to in an upcoming round sent, indexed by (round, meter ID) */
+        std::map<std::pair<int, int>, std::shared_ptr<messaging::FloodDigestMessage>> target_digests;
         util::unordered_ptr_set<messaging::OverlayMessage> relay_messages;
         std::mt19937 random_engine;
         void handle_scatter_phase_message(const messaging::OverlayMessage& message);
         void handle_gather_phase_message(const messaging::OverlayMessage& message);
+        bool start_flooding(const std::shared_ptr<messaging::OverlayMessage>& message);
+        void send_flood_digest();
+        static std::uint64_t flood_message_id(const messaging::OverlayMessage& message);
     public:
         HftProtocolState(NetworkClient_t& network, CryptoLibrary_t& crypto,
                 TimerManager_t& timer_library, const int num_meters, const int meter_id) :
@@ -46,11 +68,19 @@ class HftProtocolState: public ProtocolState<HftProtocolState> {
             FAILURES_TOLERATED = (int) std::round(num_meters * 0.1f);
         }
 
+        /**
+         * Records which flood messages a meter that this meter will gossip
+         * to in an upcoming round already holds, so they won't be sent again.
+         * @param message The digest sent by that meter
+         */
+        void handle_flood_digest(const std::shared_ptr<messaging::FloodDigestMessage>& message);
+
     protected:
         void send_aggregate_if_done();
         void end_overlay_round_impl();
         void start_query_impl(const std::shared_ptr<messaging::QueryRequest>& query_request, const std::vector<FixedPoint_t>& contributed_data);
         void handle_overlay_message_impl(const std::shared_ptr<messaging::OverlayTransportMessage>& message);
+        bool should_flood_to(const messaging::OverlayMessage& message, const int target) const;
 
         friend class ProtocolState;
 };
@@ -7,6 +7,8 @@
 
 #include <type_traits>
 #include <memory>
+#include <set>
+#include <utility>
 #include <vector>
 
 
@@ -15,12 +17,14 @@
 #include "messaging/OverlayMessage.h"
 #include "messaging/OverlayTransportMessage.h"
 #include "messaging/AggregationMessage.h"
+#include "messaging/FloodDigestMessage.h"
 #include "messaging/SignatureRequest.h"
 #include "messaging/SignatureResponse.h"
 #include "messaging/PingMessage.h"
 #include "util/Overlay.h"
 
 #include "BftProtocolState.h" //I need to include this even if Configuration is set not to use BftProtocolState :(
+#include "HftProtocolState.h" //Same for HftProtocolState
 
 using std::shared_ptr;
 using namespace pddm::messaging;
@@ -28,79 +32,67 @@ using namespace pddm::messaging;
 namespace pddm {
 
 
-void MeterClient::set_second_id(const int id) {
-    second_id = id;
-    has_second_id = true;
-    secondary_protocol_state.emplace(network_client, crypto_library, timer_library, num_meters, id);
-}
-
-
 void MeterClient::handle_message(const std::shared_ptr<messaging::AggregationMessage>& message) {
-    if(util::aggregation_group_for(message->sender_id, primary_protocol_state.get_num_aggregation_groups(), num_meters) ==
-            util::aggregation_group_for(meter_id, primary_protocol_state.get_num_aggregation_groups(), num_meters)) {
-        if(primary_protocol_state.is_in_aggregate_phase()) {
-            primary_protocol_state.handle_aggregation_message(message);
-        //If it's a message for the right query, but I received it too early, buffer it for the future
-        } else if (message->query_num == primary_protocol_state.get_current_query_num()) {
-            primary_protocol_state.buffer_future_message(message);
-        } else {
-            logger->warn("Meter {} rejected a message from meter {} with the wrong query number: {}", meter_id, message->sender_id, *message);
-        }
-    } else if (has_second_id &&
-            util::aggregation_group_for(message->sender_id, secondary_protocol_state->get_num_aggregation_groups(), num_meters) ==
-                    util::aggregation_group_for(second_id, secondary_protocol_state->get_num_aggregation_groups(), num_meters)) {
-        if(secondary_protocol_state->is_in_aggregate_phase()) {
-            secondary_protocol_state->handle_aggregation_message(message);
-        } else if(message->query_num == secondary_protocol_state->get_current_query_num()) {
-            secondary_protocol_state->buffer_future_message(message);
-        } else {
-            logger->warn("Meter {} rejected a message from meter {} with the wrong query number: {}", second_id, message->sender_id, *message);
-        }
+    //Aggregation messages are always sent to the sender's parent in the aggregation tree
+    if(util::aggregation_tree_parent(message->sender_id, protocol_state.get_num_aggregation_groups(), num_meters) != meter_id) {
+        logger->warn("Meter {} rejected an aggregation message that was not for it: {}", meter_id, *message);
+        return;
+    }
+    if(protocol_state.is_in_aggregate_phase()) {
+        protocol_state.handle_aggregation_message(message);
+    //If it's a message for the right query, but I received it too early, buffer it for the future
+    } else if (message->query_num == protocol_state.get_current_query_num()) {
+        protocol_state.buffer_future_message(message);
+    } else {
+        logger->warn("Meter {} rejected a message from meter {} with the wrong query number: {}", meter_id, message->sender_id, *message);
     }
 }
 
 void MeterClient::handle_message(const std::shared_ptr<messaging::OverlayTransportMessage>& message) {
-    if(util::gossip_target(message->sender_id, message->sender_round, num_meters) == meter_id) {
-        std::shared_ptr<OverlayMessage> wrapped_message = std::static_pointer_cast<OverlayMessage>(message->body);
-        if(wrapped_message->query_num > primary_protocol_state.get_current_query_num()) {
-            //If the message is for a future query, buffer it until I get the query-start message
-            primary_protocol_state.buffer_future_message(message);
-        } else if (wrapped_message->query_num < primary_protocol_state.get_current_query_num()) {
-            logger->warn("Meter {} discarded an obsolete message from meter {} for an old query: {}", meter_id, message->sender_id, *message);
-        //At this point, we know the message is for the current query
-        } else if(message->sender_round == primary_protocol_state.get_current_overlay_round()) {
-            primary_protocol_state.handle_overlay_message(message);
-        } else if(message->sender_round > primary_protocol_state.get_current_overlay_round()) {
-            //If it's a message for a future round, buffer it until my round advances
-            primary_protocol_state.buffer_future_message(message);
-        } else {
-            logger->debug("Meter {}, already in round {}, rejected a message from meter {} as too old: {}", meter_id, primary_protocol_state.get_current_overlay_round(), message->sender_id, *message);
-        }
-    //Same handling but for messages intended for my second ID
-    } else if (has_second_id &&
-            util::gossip_target(message->sender_id, message->sender_round, num_meters) == second_id) {
-        std::shared_ptr<OverlayMessage> wrapped_message = std::static_pointer_cast<OverlayMessage>(message->body);
-        if(wrapped_message->query_num > secondary_protocol_state->get_current_query_num()) {
-            secondary_protocol_state->buffer_future_message(message);
-        } else if (wrapped_message->query_num < secondary_protocol_state->get_current_query_num()) {
-            logger->warn("Meter {} discarded an obsolete message from meter {} for an old query: {}", second_id, message->sender_id, *message);
-        } else if(message->sender_round == secondary_protocol_state->get_current_overlay_round()) {
-            secondary_protocol_state->handle_overlay_message(message);
-        } else if(message->sender_round > secondary_protocol_state->get_current_overlay_round()) {
-            secondary_protocol_state->buffer_future_message(message);
-        } else {
-            logger->debug("Meter {} rejected a message from meter {} as too old: {}", second_id, message->sender_id, *message);
-        }
-    } else {
+    if(!util::is_gossip_target(message->sender_id, message->sender_round, num_meters, meter_id)) {
         logger->warn("Meter {} rejected a message because it has the wrong gossip target: {}", meter_id, *message);
+        return;
+    }
+    std::shared_ptr<OverlayMessage> wrapped_message = std::static_pointer_cast<OverlayMessage>(message->body);
+    //Any message shows its sender is up, even one that is too old to use, so a suspected meter that has
+    //recovered is no longer routed around or skipped
+    protocol_state.detect_alive(message->sender_id);
+    if(wrapped_message->query_num > protocol_state.get_current_query_num()) {
+        //If the message is for a future query, buffer it until I get the query-start message
+        protocol_state.buffer_future_message(message);
+    } else if (wrapped_message->query_num < protocol_state.get_current_query_num()) {
+        logger->warn("Meter {} discarded an obsolete message from meter {} for an old query: {}", meter_id, message->sender_id, *message);
+    //At this point, we know the message is for the current query
+    } else if(message->sender_round == protocol_state.get_current_overlay_round()) {
+        protocol_state.handle_overlay_message(message);
+    } else if(message->sender_round > protocol_state.get_current_overlay_round()) {
+        //If it's a message for a future round, buffer it until my round advances
+        protocol_state.buffer_future_message(message);
+    } else {
+        logger->debug("Meter {}, already in round {}, rejected a message from meter {} as too old: {}", meter_id, protocol_state.get_current_overlay_round(), message->sender_id, *message);
     }
 }
 
 
 void MeterClient::handle_message(const std::shared_ptr<messaging::PingMessage>& message) {
-    primary_protocol_state.handle_ping_message(message);
-    if(has_second_id)
-        secondary_protocol_state->handle_ping_message(message);
+    protocol_state.handle_ping_message(message);
+}
+
+void MeterClient::handle_message(const std::shared_ptr<messaging::FloodDigestMessage>& message) {
+    //A digest is for the meters that will gossip to its sender in the round it names
+    if(util::is_gossip_target(meter_id, message->round, num_meters, message->sender_id)) {
+        handle_flood_digest(message, &protocol_state);
+    }
+}
+
+void MeterClient::flush_held_sends() {
+    std::set<int> failed_ids = network_client.flush_overlay_sends();
+    //Ending a round early sends the next round's messages, which may find more failed meters
+    while(!failed_ids.empty()) {
+        network_client.hold_overlay_sends();
+        protocol_state.handle_send_failures(failed_ids);
+        failed_ids = network_client.flush_overlay_sends();
+    }
 }
 
 /**
@@ -123,15 +115,12 @@ void MeterClient::handle_message(const std::shared_ptr<messaging::QueryRequest>&
     } else {
         logger->error("Meter {} received a message with unknown query type!", meter_id);
     }
-    primary_protocol_state.start_query(message, contributed_data);
-    if(has_second_id) {
-        secondary_protocol_state->start_query(message, std::vector<FixedPoint_t>{});
-    }
+    protocol_state.start_query(message, contributed_data);
 }
 
 void MeterClient::handle_message(const std::shared_ptr<messaging::SignatureResponse>& message) {
     //Using a raw pointer to a local value type is ugly, but it's the only way to select code at compile time based on the type of ProtocolState_t
-    handle_signature_response(message, &primary_protocol_state);
+    handle_signature_response(message, &protocol_state);
 }
 
 void MeterClient::handle_signature_response(const std::shared_ptr<messaging::SignatureResponse>& message, BftProtocolState* bft_protocol) {
@@ -142,7 +131,23 @@ void MeterClient::handle_signature_response(const std::shared_ptr<messaging::Sig
     /* Do nothing, non-BFT protocols will never get this message */
 }
 
+void MeterClient::handle_flood_digest(const std::shared_ptr<messaging::FloodDigestMessage>& message, HftProtocolState* hft_protocol) {
+    hft_protocol->handle_flood_digest(message);
+}
+
+void MeterClient::handle_flood_digest(const std::shared_ptr<messaging::FloodDigestMessage>& message, void* protocol_is_not_hft) {
+    /* Do nothing, only HftProtocolState floods messages */
+}
+
+void MeterClient::connect_to_peers() {
+    std::set<int> expected_peers = protocol_state.get_expected_peers();
+    expected_peers.erase(meter_id);
+    network_client.prewarm_connections(expected_peers);
+}
+
 void MeterClient::main_loop() {
+    //Connect to the meters that every query will send to before the first query needs them
+    connect_to_peers();
     network_client.monitor_incoming_messages();
 }
 
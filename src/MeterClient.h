@@ -7,8 +7,8 @@
 
 #pragma once
 
-#include <experimental/optional>
 #include <memory>
+#include <set>
 #include <spdlog/spdlog.h>
 
 #include "Configuration.h"
@@ -17,6 +17,7 @@
 namespace pddm {
 namespace messaging {
 class AggregationMessage;
+class FloodDigestMessage;
 class OverlayTransportMessage;
 class PingMessage;
 class QueryRequest;
@@ -63,11 +64,9 @@ class MeterClient {
         TimerManager_t timer_library;
 
     private:
-        int second_id;
-        bool has_second_id;
-
-        ProtocolState_t primary_protocol_state;
-        std::experimental::optional<ProtocolState_t> secondary_protocol_state;
+        /** The state of the protocol this meter is running, which uses this
+         * meter's network client, crypto library, and timers. */
+        ProtocolState_t protocol_state;
 
     public:
         MeterClient(const int id, const int num_meters, const std::shared_ptr<Meter_t>& meter, const NetworkClientBuilderFunc& network_builder,
@@ -79,17 +78,12 @@ class MeterClient {
                     network_client(network_builder(*this)),
                     crypto_library(crypto_library_builder(*this)),
                     timer_library(timer_library_builder(*this)),
-                    second_id(0),
-                    has_second_id(false),
-                    primary_protocol_state(network_client, crypto_library, timer_library, num_meters, meter_id),
-                    secondary_protocol_state() {};
+                    protocol_state(network_client, crypto_library, timer_library, num_meters, meter_id) {};
         /** Moving a MeterClient will invalidate the references to it held in
          * network_client, crypto_library, and/or timer_library. */
         MeterClient(MeterClient&&) = delete;
         virtual ~MeterClient() = default;
 
-        void set_second_id(const int id);
-
         /** Handles a message received from another meter or the utility.
          * This is a callback for NetworkClient to invoke when a message arrives from the network_client. */
         void handle_message(const std::shared_ptr<messaging::OverlayTransportMessage>& message);
@@ -98,10 +92,29 @@ class MeterClient {
         /** @copydoc handle_message(const std::shared_ptr<messaging::OverlayTransportMessage>&) */
         void handle_message(const std::shared_ptr<messaging::PingMessage>& message);
         /** @copydoc handle_message(const std::shared_ptr<messaging::OverlayTransportMessage>&) */
+        void handle_message(const std::shared_ptr<messaging::FloodDigestMessage>& message);
+        /** @copydoc handle_message(const std::shared_ptr<messaging::OverlayTransportMessage>&) */
         void handle_message(const std::shared_ptr<messaging::QueryRequest>& message);
         /** @copydoc handle_message(const std::shared_ptr<messaging::OverlayTransportMessage>&) */
         void handle_message(const std::shared_ptr<messaging::SignatureResponse>& message);
 
+        /**
+         * Sends the overlay messages that the network client has held since
+         * hold_overlay_sends(), and tells the protocol which recipients could
+         * not be reached. If it was only waiting for those meters, it ends its
+         * round, and the messages it sends for the next round are coalesced
+         * and flushed the same way.
+         * NetworkClient should call this instead of flush_overlay_sends()
+         * after handling each batch of messages or other event.
+         */
+        void flush_held_sends();
+
+        /** Opens connections to the meters that every query will send to, so
+         * the first query doesn't have to wait for them. main_loop() does this
+         * first; a program that drives the NetworkClient's receive loop itself
+         * should call this instead of main_loop(). */
+        void connect_to_peers();
+
         /** Starts the client, which will continuously wait for messages and
          * respond to them as they arrive. This function call never returns. */
         void main_loop();
@@ -118,6 +131,8 @@ class MeterClient {
         //A pointer to ProtocolState_t will match exactly one of these, depending on which protocol is being used
         void handle_signature_response(const std::shared_ptr<messaging::SignatureResponse>& message, BftProtocolState* bft_protocol);
         void handle_signature_response(const std::shared_ptr<messaging::SignatureResponse>& message, void* protocol_is_not_bft);
+        void handle_flood_digest(const std::shared_ptr<messaging::FloodDigestMessage>& message, HftProtocolState* hft_protocol);
+        void handle_flood_digest(const std::shared_ptr<messaging::FloodDigestMessage>& message, void* protocol_is_not_hft);
 
 };
 
@@ -0,0 +1,140 @@
+/**
+ * @file MultiMeterHostMain.cpp
+ * A "main" file for emulating many smart meters in one process, with a "real"
+ * network (TCP, or shared memory if SHARED_MEMORY_TRANSPORT is true) but
+ * simulated smart meter data. Unlike emulated_network_test, which runs one
+ * meter per process, this runs a contiguous range of meter IDs as MeterClients
+ * that share a small pool of reactor threads, pinned to cores, with each
+ * meter's network client assigned to one reactor by its ID. The meters on each
+ * reactor keep their timers in one timer wheel, whose timerfd that reactor
+ * watches, and all the meters share one logger, so thousands of them can run
+ * on one machine without a process, a set of threads, and a timerfd for each.
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <spdlog/spdlog.h>
+
+#include "MeterClient.h"
+#include "networking/ReactorPool.h"
+#include "networking/TcpAddress.h"
+#include "util/ConfigParser.h"
+#include "simulation/SimParameters.h"
+
+using namespace pddm;
+
+static_assert(TCP_REACTOR == networking::ReactorType::EPOLL && TCP_RECEIVE_THREADS == 1,
+        "Meters run by the reactor pool must use epoll with one receive thread");
+
+int main(int argc, char** argv) {
+    if(argc < 9) {
+        std::cout << "Expected arguments: <first meter ID> <number of meters> <utility IP address> "
+                "<meter IP configuration file> <device configuration files> [number of reactor threads]" << std::endl;
+        std::cout << "Device characteristic files are: power load, mean daily frequency, "
+                "hourly usage probability, and household saturation." << std::endl;
+        return -1;
+    }
+
+    //This host runs the meters with IDs [first_meter_id, first_meter_id + num_local_meters)
+    const int first_meter_id = std::atoi(argv[1]);
+    const int num_local_meters = std::atoi(argv[2]);
+    const std::size_t num_reactors = argc > 9 ? std::atoi(argv[9]) : std::max(std::thread::hardware_concurrency(), 1u);
+
+    //Set up static global logging framework, which all of the meters share
+    std::string filename("multi_meter_host_" + std::to_string(first_meter_id) + ".txt");
+    std::vector<spdlog::sink_ptr> log_sinks;
+    log_sinks.push_back(std::make_shared<spdlog::sinks::rotating_file_sink_mt>(filename, 1024 * 1024 * 500, 3));
+    std::shared_ptr<spdlog::logger> logger = spdlog::create("global_logger", log_sinks.begin(), log_sinks.end());
+    logger->set_pattern("[%H:%M:%S.%e] [%l] %v");
+    logger->set_level(spdlog::level::info);
+
+    //Each meter has a listening socket and connections to its peers, which is far more than the default limit
+    struct rlimit file_limit;
+    if(getrlimit(RLIMIT_NOFILE, &file_limit) == 0 && file_limit.rlim_cur < file_limit.rlim_max) {
+        file_limit.rlim_cur = file_limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &file_limit);
+    }
+
+    networking::TcpAddress utility_ip = networking::parse_tcp_string(std::string(argv[3]));
+    std::map<int, networking::TcpAddress> meter_ips_by_id = util::read_ip_map_from_file(std::string(argv[4]));
+
+    int num_meters = meter_ips_by_id.size();
+    ProtocolState_t::init_failures_tolerated(num_meters);
+
+    std::map<std::string, simulation::Device> possible_devices;
+    std::map<std::string, double> devices_saturation;
+    util::read_devices_from_files(std::string(argv[5]), std::string(argv[6]),
+            std::string(argv[7]), std::string(argv[8]),
+            possible_devices, devices_saturation);
+
+    //For now I'll just hard-code this in, since I'm not paying attention to prices
+    PriceFunction sim_energy_price = [](const int time_of_day) {
+        if(time_of_day > 17 && time_of_day < 20) {
+            return util::Money(0.0734);
+        } else {
+            return util::Money(0.0612);
+        }
+    };
+    //Seed with the first ID, so that hosts running different ranges of meters don't generate the same households
+    std::mt19937 random_engine(first_meter_id);
+    std::discrete_distribution<> income_distribution({25, 50, 25});
+
+    const auto TIME_PER_TIMESTEP = std::chrono::seconds(10);
+    std::vector<std::shared_ptr<simulation::Meter>> sim_meters;
+    std::vector<std::unique_ptr<MeterClient>> meter_clients;
+    networking::ReactorPool reactor_pool(num_reactors);
+    //One timer wheel per reactor, shared by the meters on it, so their callbacks run on the thread that handles their messages
+    std::vector<std::shared_ptr<util::TimerfdWheel>> reactor_timer_wheels;
+    for(std::size_t reactor_index = 0; reactor_index < reactor_pool.size(); ++reactor_index) {
+        reactor_timer_wheels.emplace_back(std::make_shared<util::TimerfdWheel>());
+        std::shared_ptr<util::TimerfdWheel> wheel = reactor_timer_wheels.back();
+        reactor_pool.add(reactor_index, wheel->get_fd(), [wheel]() {
+            wheel->handle_timer_event();
+            return false;
+        });
+    }
+    for(int meter_id = first_meter_id; meter_id < first_meter_id + num_local_meters; ++meter_id) {
+        networking::TcpAddress my_ip = meter_ips_by_id.at(meter_id);
+        sim_meters.emplace_back(simulation::generate_meter(income_distribution, possible_devices,
+                devices_saturation, sim_energy_price, random_engine).release());
+        meter_clients.emplace_back(std::make_unique<MeterClient>(meter_id, num_meters, sim_meters.back(),
+                networking::network_client_builder(my_ip, utility_ip, meter_ips_by_id),
+                util::crypto_library_builder(),
+                util::timer_manager_builder(reactor_timer_wheels[reactor_pool.reactor_for(meter_id)])));
+        NetworkClient_t& network_client = meter_clients.back()->get_network_client();
+        reactor_pool.add(meter_id, network_client.get_poll_fd(), [&network_client]() {
+            return network_client.poll_incoming_messages();
+        });
+    }
+    std::cout << "Started " << num_local_meters << " meters on " << reactor_pool.size() << " reactor threads" << std::endl;
+    //Start receiving before connecting, since the meters in this process connect to each other
+    reactor_pool.start();
+    for(auto& meter_client : meter_clients) {
+        meter_client->connect_to_peers();
+    }
+
+    //One thread pokes every simulated meter, instead of one thread per meter
+    std::thread sim_meter_advance_thread([TIME_PER_TIMESTEP, &sim_meters]() {
+        for(int timestep = 0; timestep < simulation::TOTAL_TIMESTEPS; ++timestep) {
+            for(const auto& sim_meter : sim_meters) {
+                sim_meter->simulate_usage_timestep();
+            }
+            std::cout << "Advanced simulated meters by " << simulation::USAGE_TIMESTEP_MIN << " minutes" << std::endl;
+            std::this_thread::sleep_for(TIME_PER_TIMESTEP);
+        }
+    });
+    sim_meter_advance_thread.join();
+    //Give the last query time to finish before stopping
+    std::this_thread::sleep_for(TIME_PER_TIMESTEP * 3);
+    reactor_pool.shut_down();
+    return 0;
+}
@@ -7,11 +7,14 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <list>
+#include <set>
 
 #include "messaging/OverlayTransportMessage.h"
 #include "messaging/AggregationMessage.h"
+#include "messaging/FloodDigestMessage.h"
 #include "messaging/PingMessage.h"
 #include "messaging/SignatureRequest.h"
 
@@ -49,9 +52,44 @@ class NetworkClient {
          * @return true if the send was successful, false if a connection could not be made.
          */
         virtual bool send(const std::shared_ptr<messaging::PingMessage>& message, const int recipient_id) = 0;
+        /**
+         * Sends a FloodDigestMessage over the network to another meter
+         * @param message The message to send
+         * @param recipient_id The ID of the recipient
+         * @return true if the send was successful, false if a connection could not be made.
+         */
+        virtual bool send(const std::shared_ptr<messaging::FloodDigestMessage>& message, const int recipient_id) = 0;
         /** Sends a signature request message to the utility. */
         virtual bool send(const std::shared_ptr<messaging::SignatureRequest>& message) = 0;
 
+        /**
+         * Starts holding overlay messages instead of sending them immediately.
+         * Until flush_overlay_sends() is called, sending a list of overlay
+         * messages only queues it, so that all the overlay messages this
+         * meter sends to the same host while handling one event
+         * (a batch of messages, or a timer) can be coalesced into one network
+         * send. Held sends always report success; whether they reached their
+         * recipients is reported by flush_overlay_sends(), which
+         * MeterClient::flush_held_sends() passes on to the protocol.
+         */
+        virtual void hold_overlay_sends() = 0;
+        /**
+         * Sends all the overlay messages held since hold_overlay_sends(),
+         * combining the messages for recipients at the same host into a single
+         * send, and stops holding overlay messages.
+         * @return The IDs of the recipients that could not be reached.
+         */
+        virtual std::set<int> flush_overlay_sends() = 0;
+
+        /**
+         * Opens connections to a set of meters before any messages are sent
+         * to them, if this client uses connections. This is only an
+         * optimization, so meters that can't be reached yet are not treated
+         * as failed.
+         * @param meter_ids The IDs of the meters this meter expects to send to
+         */
+        virtual void prewarm_connections(const std::set<int>& meter_ids) = 0;
+
         /**
          * Continuously polls for incoming messages to this meter, calling the
          * appropriate "handler" function in MeterClient each time a message is
@@ -59,6 +97,17 @@ class NetworkClient {
          * it once, in its own thread.
          */
         virtual void monitor_incoming_messages() = 0;
+
+        /**
+         * Has the loop in monitor_incoming_messages() call a function whenever
+         * a file descriptor becomes readable, on the same thread that handles
+         * messages, so that other sources of events (such as timers) can share
+         * it. This must be called before monitor_incoming_messages().
+         * @param fd The file descriptor to watch, which the function should
+         * read from so that it stops being readable
+         * @param on_readable The function to call
+         */
+        virtual void add_event_source(const int fd, std::function<void(void)> on_readable) = 0;
 };
 
 inline NetworkClient::~NetworkClient() { }
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <list>
+#include <map>
 #include <memory>
 #include <set>
 #include <vector>
@@ -16,13 +17,18 @@
 #include "Configuration.h"
 #include "FixedPoint_t.h"
 #include "messaging/ValueTuple.h"
+#include "util/FailureDetector.h"
 #include "util/PointerUtil.h"
+#include "util/TimeoutEstimator.h"
 #include "util/TimerManager.h"
 
 namespace pddm {
 class TreeAggregationState;
 namespace messaging {
+struct AckCertificate;
 class AggregationMessage;
+class MessageBody;
+class OpaqueBody;
 class OverlayMessage;
 class OverlayTransportMessage;
 class PingMessage;
@@ -60,12 +66,25 @@ class ProtocolState {
 
         void buffer_future_message(const std::shared_ptr<messaging::OverlayTransportMessage>& message);
         void buffer_future_message(const std::shared_ptr<messaging::AggregationMessage>& message);
+        void detect_alive(const int alive_id);
+        void mark_meters_failed(const std::set<int>& meter_ids);
+        void handle_send_failures(const std::set<int>& meter_ids);
 
         int get_num_aggregation_groups() const { return num_aggregation_groups; }
         int get_current_query_num() const { return my_contribution ? my_contribution->query_num : -1; }
         int get_current_overlay_round() const { return overlay_round; }
-
-        /** The maximum time (ms) any meter should wait on receiving a message in an overlay round */
+        /**
+         * Computes the meters this meter will send to in every query: its
+         * parent and children in the aggregation tree, and its gossip targets
+         * in the first logkn + FAILURES_TOLERATED overlay rounds, which every
+         * protocol's first overlay phase lasts for. Connections to them can be
+         * opened at startup.
+         * @return The IDs of those meters, not including the utility
+         */
+        std::set<int> get_expected_peers() const;
+
+        /** The time (ms) a meter should wait on receiving a message in an overlay round,
+         * before it has measured how long rounds actually take */
         static constexpr int OVERLAY_ROUND_TIMEOUT = 100;
         /** The number of failures tolerated by the currently running instance of the system.
          * This is set only once, at startup, once the number of meters in the system is known.
@@ -87,6 +106,12 @@ class ProtocolState {
         int num_meters;
         /** Log (base 2) of num_meters */
         int log2n;
+        /** Log (base GOSSIP_BASE) of num_meters, which is the number of rounds
+         * the overlay needs to connect any meter to any other meter, plus the
+         * rounds that failed hosts of padding IDs can cost (see
+         * util::padding_failure_rounds), so that phases bounded by
+         * logkn + FAILURES_TOLERATED keep their full margin for failures */
+        int logkn;
         /** This is a constant, but it must be set by the implementing subclass based on which algorithm it is using. */
         const int num_aggregation_groups;
         int overlay_round;
@@ -96,9 +121,39 @@ class ProtocolState {
          * connection to them, and we don't bother waiting for a message from a
          * meter that has failed. */
         std::set<int> failed_meter_ids;
+        /** The meters that were suspected of having failed when the query
+         * started (based on earlier queries), and have neither been confirmed
+         * as failed nor heard from since. They are treated like failed meters
+         * (not waited for, and routed around), but a message from one of them
+         * removes it from this set. This never overlaps failed_meter_ids. */
+        std::set<int> suspected_meter_ids;
+        /** Remembers failures across queries, so they can be assumed at the
+         * start of a query instead of rediscovered by timing out. */
+        util::FailureDetector failure_detector;
+        /** The set of predecessors (by ID) that have sent their final message
+         * for the current round. The round is over once every predecessor that
+         * has not failed appears in this set. */
+        std::set<int> final_message_senders;
         /** Handle for the timer registered to timeout the round. */
         util::timer_id_t round_timeout_timer;
-        bool ping_response_from_predecessor;
+        /** Measures how long it takes to hear from every predecessor in a round,
+         * which determines how long to wait before timing out a round. This
+         * persists across queries. */
+        util::TimeoutEstimator round_time_estimator;
+        /** Measures the round-trip time of pings to predecessors, which
+         * determines how often to re-ping a predecessor that is slow but alive. */
+        util::TimeoutEstimator ping_rtt_estimator;
+        /** The time (according to timers, in microseconds) at which the current round started */
+        long long round_start_time;
+        /** The time (in microseconds) each ping sent this round was sent, indexed by the ID of
+         * the meter it was sent to; used to measure ping round-trip times. */
+        std::map<int, long long> ping_send_times;
+        /** True if a pending predecessor has sent anything (an overlay
+         * message or a ping response) since the last round timeout. */
+        bool heard_from_predecessor;
+        /** True once the current round has timed out at least once, at which
+         * point this meter starts pinging the predecessors it's waiting on. */
+        bool round_went_quiet;
         template<typename T> using ptr_list = std::list<std::shared_ptr<T>>;
         ptr_list<messaging::OverlayTransportMessage> future_overlay_messages;
         ptr_list<messaging::AggregationMessage> future_aggregation_messages;
@@ -113,6 +168,29 @@ class ProtocolState {
          * measurement (they should have distinct proxy sets). */
         util::unordered_ptr_set<messaging::ValueContribution> proxy_values;
         std::unique_ptr<TreeAggregationState> aggregation_phase_state;
+        /** Acknowledgement certificates for each phase (identified by an
+         * integer the subclass chooses) that this meter knows about. */
+        std::map<int, std::shared_ptr<messaging::AckCertificate>> phase_certificates;
+        /** The phase whose certificate is piggybacked on outgoing overlay
+         * messages, or -1 if none is. */
+        int certificate_phase;
+        /** The highest phase for which a certificate has been received from
+         * another meter. A meter only starts a phase's certificate once it has
+         * proven the previous phase complete, so this proves every earlier
+         * phase complete too. */
+        int highest_peer_certificate_phase;
+        /** False once any phase has ended without a proof of completion, since
+         * later phases then can't be proven complete either. */
+        bool early_completion_possible;
+        /** The last overlay round this meter must take part in, even if it has
+         * already finished its own overlay phases, so that meters still in
+         * those phases are not left waiting for its messages. If this is -1,
+         * the overlay ends as soon as this meter's overlay phases end. */
+        int final_overlay_round;
+        /** True once this meter has proven that every message of its last
+         * overlay phase was delivered. After that it only needs to pass its
+         * certificate on, so it no longer waits for its predecessors. */
+        bool overlay_proven_complete;
 
         void handle_round_timeout();
         inline void end_overlay_round() {
@@ -120,6 +198,34 @@ class ProtocolState {
             super_end_overlay_round();
         }
         void super_end_overlay_round();
+        bool received_all_final_messages() const;
+        /** @return True if a meter has failed, or is still suspected of having failed */
+        bool is_presumed_failed(const int id) const {
+            return failed_meter_ids.count(id) > 0 || suspected_meter_ids.count(id) > 0;
+        }
+        std::set<int> presumed_failed_meters() const;
+        /** @return True if this meter is still sending and receiving overlay
+         * messages, either for its own overlay phase or to relay for others */
+        bool is_running_overlay() const {
+            return impl_this->is_in_overlay_phase() || overlay_round < final_overlay_round;
+        }
+
+        void relay_message(const std::shared_ptr<messaging::OverlayMessage>& message, const int received_round);
+
+        void start_phase_certificate(const int phase);
+        void stop_phase_certificates();
+        void record_phase_sends(const int num_messages);
+        void record_phase_delivery(const int phase);
+        bool phase_proven_complete(const int phase) const;
+        void finish_overlay_early();
+
+        /**
+         * Decides whether a flood message should be sent to one of this
+         * round's gossip targets. Subclasses can hide this to skip targets
+         * that are known to already hold the message; by default flood
+         * messages go to every target.
+         */
+        bool should_flood_to(const messaging::OverlayMessage& message, const int target) const { return true; }
 
         void encrypted_multicast_to_proxies(const std::shared_ptr<messaging::ValueContribution>& contribution);
         void start_aggregate_phase();
@@ -127,6 +233,9 @@ class ProtocolState {
 
     private:
         void send_overlay_message_batch();
+        std::shared_ptr<messaging::MessageBody> decode_received_body(const messaging::OpaqueBody& opaque_body);
+        void ping_pending_predecessors();
+        bool detect_failure(const int failed_id);
 };
 
 //Useless boilerplate to complete the declaration of the static member FAILURES_TOLERATED
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <iterator>
 #include <cmath>
+#include <cstddef>
 #include <memory>
 #include <vector>
 #include <list>
+#include <stdexcept>
 #include <spdlog/spdlog.h>
 #include <spdlog/fmt/ostr.h>
 
@@ -11,12 +15,17 @@
 #include "Configuration.h"
 #include "ConfigurationIncludes.h"
 #include "FixedPoint_t.h"
+#include "messaging/AckCertificate.h"
 #include "messaging/AggregationMessage.h"
+#include "messaging/MulticastOverlayMessage.h"
+#include "messaging/OnionPacket.h"
+#include "messaging/OpaqueBody.h"
 #include "messaging/OverlayMessage.h"
 #include "messaging/OverlayTransportMessage.h"
 #include "messaging/PathOverlayMessage.h"
 #include "messaging/ValueTuple.h"
 #include "messaging/ValueContribution.h"
+#include "messaging/WireFormat.h"
 #include "messaging/OnionBuilder.h"
 #include "util/PathFinder.h"
 #include "util/Overlay.h"
@@ -40,18 +49,35 @@ ProtocolState<Impl>::ProtocolState(Impl* subclass_ptr, NetworkClient_t& network,
         TimerManager_t& timer_library, const int num_meters, const int meter_id, const int num_aggregation_groups) :
         logger(spdlog::get("global_logger")), impl_this(subclass_ptr), network(network), crypto(crypto),
         timers(timer_library), meter_id(meter_id), num_meters(num_meters), log2n((int) std::ceil(std::log2(num_meters))),
+        logkn(util::log_gossip_base(num_meters) + util::padding_failure_rounds(num_meters, FAILURES_TOLERATED)),
         num_aggregation_groups(num_aggregation_groups), overlay_round(0), is_last_round(false),
-        round_timeout_timer(-1), ping_response_from_predecessor(false) {
+        round_timeout_timer(-1),
+        round_time_estimator(OVERLAY_ROUND_TIMEOUT, OVERLAY_ROUND_TIMEOUT * MIN_ADAPTIVE_TIMEOUT_PERCENT / 100,
+                MAX_ADAPTIVE_TIMEOUT),
+        ping_rtt_estimator(OVERLAY_ROUND_TIMEOUT, OVERLAY_ROUND_TIMEOUT * MIN_ADAPTIVE_TIMEOUT_PERCENT / 100,
+                MAX_ADAPTIVE_TIMEOUT),
+        round_start_time(0), heard_from_predecessor(false), round_went_quiet(false), certificate_phase(-1),
+        highest_peer_certificate_phase(-1), early_completion_possible(EARLY_PHASE_COMPLETION),
+        final_overlay_round(-1), overlay_proven_complete(false) {
 }
 
 template<typename Impl>
 void ProtocolState<Impl>::start_query(const std::shared_ptr<messaging::QueryRequest>& query_request, const std::vector<FixedPoint_t>& contributed_data) {
     overlay_round = -1;
     is_last_round = false;
-    ping_response_from_predecessor = false;
+    heard_from_predecessor = false;
+    round_went_quiet = false;
     timers.cancel_timer(round_timeout_timer);
     proxy_values.clear();
+    //Start out assuming that meters that failed recently are still down, until they're heard from
     failed_meter_ids.clear();
+    suspected_meter_ids = failure_detector.suspected_meters(query_request->query_number);
+    phase_certificates.clear();
+    certificate_phase = -1;
+    highest_peer_certificate_phase = -1;
+    early_completion_possible = EARLY_PHASE_COMPLETION;
+    final_overlay_round = -1;
+    overlay_proven_complete = false;
     SIM_DEBUG(util::init_debug_state(););
     aggregation_phase_state = std::make_unique<TreeAggregationState>(meter_id, num_aggregation_groups, num_meters,
             network, query_request);
@@ -71,22 +97,134 @@ void ProtocolState<Impl>::start_query(const std::shared_ptr<messaging::QueryRequ
  */
 template<typename Impl>
 void ProtocolState<Impl>::encrypted_multicast_to_proxies(const std::shared_ptr<messaging::ValueContribution>& contribution) {
-    //Find independent paths starting at round 0
-    auto proxy_paths = util::find_paths(meter_id, contribution->value.proxies, num_meters, 0);
+    //Find independent paths starting at round 0, each short enough to fit in an onion's header
+    const std::set<int> avoided_meters = presumed_failed_meters();
+    std::vector<std::list<int>> proxy_paths;
+    try {
+        proxy_paths = util::find_paths(meter_id, contribution->value.proxies, num_meters, 0, avoided_meters, ONION_MAX_HOPS);
+    } catch(std::runtime_error& e) {
+        //Without a path to each proxy, this meter's value is left out of the query, but it still relays for others
+        logger->error("Meter {} could not find onion paths to its proxies: {}", meter_id, e.what());
+    }
     logger->trace("Meter {} picked these proxy paths: {}", meter_id, proxy_paths);
     for(const auto& proxy_path : proxy_paths) {
         //Create an encrypted onion for this path and send it
         outgoing_messages.emplace_back(messaging::build_encrypted_onion(proxy_path,
                 contribution,  contribution->value.query_num, crypto));
     }
+    //Onions to meters that are believed to have failed aren't counted, since those meters are counted as receiving nothing
+    record_phase_sends((int) std::count_if(proxy_paths.begin(), proxy_paths.end(), [this](const auto& proxy_path) {
+        return !is_presumed_failed(proxy_path.back());
+    }));
     //Start the overlay by ending "round -1", which will send the messages at the start of round 0
     end_overlay_round();
 }
 
+/**
+ * Starts piggybacking an acknowledgement certificate for a new phase on this
+ * meter's overlay messages. This should only be called once the previous phase
+ * has been proven complete (or if this is the first phase), since receiving a
+ * certificate for a phase tells other meters that all earlier phases are done.
+ * @param phase The phase that is starting
+ */
+template<typename Impl>
+void ProtocolState<Impl>::start_phase_certificate(const int phase) {
+    if(!early_completion_possible)
+        return;
+    auto& certificate = phase_certificates[phase];
+    if(certificate == nullptr) {
+        certificate = std::make_shared<messaging::AckCertificate>(phase, num_meters);
+    }
+    //Deliveries for this phase may already have been counted
+    certificate->messages_sent[meter_id] = 0;
+    certificate->messages_received[meter_id] = std::max(certificate->messages_received[meter_id], 0);
+    //Meters that have already failed won't report their counts, so count them as sending and receiving
+    //nothing. If one is actually alive, its own counts are larger and replace these when they are merged.
+    for(const int failed_id : presumed_failed_meters()) {
+        certificate->messages_sent[failed_id] = std::max(certificate->messages_sent[failed_id], 0);
+        certificate->messages_received[failed_id] = std::max(certificate->messages_received[failed_id], 0);
+    }
+    certificate_phase = phase;
+}
+
+/**
+ * Stops piggybacking certificates for the rest of this query. This must be
+ * called when a phase ends by running out of rounds, since that means some
+ * meter might not have received all its messages.
+ */
+template<typename Impl>
+void ProtocolState<Impl>::stop_phase_certificates() {
+    early_completion_possible = false;
+    certificate_phase = -1;
+}
+
+/**
+ * Records in the current phase's certificate that this meter originated
+ * some messages. Does nothing if no certificate is being kept.
+ * @param num_messages The number of messages sent
+ */
+template<typename Impl>
+void ProtocolState<Impl>::record_phase_sends(const int num_messages) {
+    if(certificate_phase >= 0) {
+        phase_certificates.at(certificate_phase)->messages_sent[meter_id] += num_messages;
+    }
+}
+
+/**
+ * Records that this meter received a message that was sent to it during the
+ * specified phase. This may be a later phase than the one this meter is in,
+ * if the sender has already moved on.
+ * @param phase The phase in which the message was sent
+ */
+template<typename Impl>
+void ProtocolState<Impl>::record_phase_delivery(const int phase) {
+    if(!early_completion_possible)
+        return;
+    auto& certificate = phase_certificates[phase];
+    if(certificate == nullptr) {
+        certificate = std::make_shared<messaging::AckCertificate>(phase, num_meters);
+    }
+    certificate->messages_received[meter_id] = std::max(certificate->messages_received[meter_id], 0) + 1;
+}
+
+/**
+ * Determines whether this meter has proof that every message sent in a phase
+ * has been delivered, either because its certificate for the phase is complete
+ * or because another meter has already moved on to a later phase.
+ * @param phase The phase to check
+ * @return True if the phase can safely end now
+ */
+template<typename Impl>
+bool ProtocolState<Impl>::phase_proven_complete(const int phase) const {
+    if(!early_completion_possible)
+        return false;
+    if(highest_peer_certificate_phase > phase)
+        return true;
+    auto certificate_iter = phase_certificates.find(phase);
+    return certificate_iter != phase_certificates.end() && certificate_iter->second->is_complete();
+}
+
+/**
+ * Ends the overlay early once this meter's last overlay phase has been proven
+ * complete. Every message of the phase has been delivered, so this meter only
+ * keeps going long enough for its certificate, which now proves the same thing
+ * to any meter that merges it, to reach every other meter: logkn more rounds,
+ * or until the overlay would have ended anyway. Since those rounds carry
+ * nothing else, it doesn't wait for its predecessors in them.
+ */
+template<typename Impl>
+void ProtocolState<Impl>::finish_overlay_early() {
+    overlay_proven_complete = true;
+    final_overlay_round = std::min(final_overlay_round, overlay_round + logkn);
+}
+
 template<typename Impl>
 void ProtocolState<Impl>::start_aggregate_phase() {
-    //Since we're now done with the overlay, stop the timeout waiting for the next round
-    timers.cancel_timer(round_timeout_timer);
+    //If we're done with the overlay, stop the timeout waiting for the next round
+    if(overlay_round >= final_overlay_round) {
+        timers.cancel_timer(round_timeout_timer);
+    }
+    //Meters that are only suspected of failing might still send aggregates, so only skip confirmed failures
     //Initialize aggregation helper, assuming all value-arrays are the same size as the one this meter contributed
     aggregation_phase_state->initialize(my_contribution->value.size(), failed_meter_ids);
     //If this node is a leaf, aggregation might be done already
@@ -99,34 +237,105 @@ void ProtocolState<Impl>::start_aggregate_phase() {
             message_iter = future_aggregation_messages.erase(message_iter);
         }
     }
-    //Set this because we're done with the overlay
-    is_last_round = true;
+    //Set this because we're done with the overlay, unless we still need to relay messages
+    if(overlay_round >= final_overlay_round) {
+        is_last_round = true;
+    }
 }
 
 /**
  * Logic for handling a timeout waiting for a message in the current round.
- * If the predecessor node has responded to a ping recently, we ping it
- * again and keep waiting. If not, we give up and move to the next round.
+ * The first time a round goes quiet, we ping the predecessors we're still
+ * waiting on, which immediately detects any that have crashed. After that,
+ * as long as a predecessor has responded to a ping (or sent a message)
+ * recently, we ping it again and keep waiting for about one (measured) ping
+ * round-trip time. If not, we give up and move to the next round.
  */
 template<typename Impl>
 void ProtocolState<Impl>::handle_round_timeout() {
-    if(ping_response_from_predecessor) {
-        ping_response_from_predecessor = false;
-        const int predecessor = util::gossip_predecessor(meter_id, overlay_round, num_meters);
-        logger->trace("Meter {} continuing to wait for round {}, got a response from {} recently", meter_id, overlay_round, predecessor);
-        round_timeout_timer = timers.register_timer(OVERLAY_ROUND_TIMEOUT, [this](){handle_round_timeout();});
-        auto ping = std::make_shared<messaging::PingMessage>(meter_id, false);
-        auto success = network.send(ping, predecessor);
-        if(!success) {
-            logger->debug("Meter {} detected that meter {} just went down after responding to a ping", meter_id, predecessor);
-            failed_meter_ids.emplace(predecessor);
+    if(!round_went_quiet || heard_from_predecessor) {
+        if(round_went_quiet) {
+            logger->trace("Meter {} continuing to wait for round {}, heard from a predecessor recently", meter_id, overlay_round);
+        } else {
+            logger->trace("Meter {} pinging the predecessors it's still waiting on in round {}", meter_id, overlay_round);
+        }
+        round_went_quiet = true;
+        heard_from_predecessor = false;
+        ping_pending_predecessors();
+        if(received_all_final_messages()) {
+            logger->trace("Meter {} ending round early, remaining predecessors are dead", meter_id);
+            end_overlay_round();
+            return;
         }
+        //Check again once a ping should have had time to come back
+        round_timeout_timer = timers.register_timer(ping_rtt_estimator.timeout(), [this](){handle_round_timeout();});
     } else {
         logger->debug("Meter {} timed out waiting for an overlay message for round {}", meter_id, overlay_round);
         end_overlay_round();
     }
 }
 
+/**
+ * Pings each predecessor in the current round that hasn't sent its final
+ * message yet and isn't known to have failed. Checking whether these pings
+ * succeed is how this meter detects a predecessor that has crashed.
+ */
+template<typename Impl>
+void ProtocolState<Impl>::ping_pending_predecessors() {
+    for(const int predecessor : util::gossip_predecessors(meter_id, overlay_round, num_meters)) {
+        if(final_message_senders.find(predecessor) != final_message_senders.end()
+                || is_presumed_failed(predecessor)) {
+            continue;
+        }
+        auto ping = std::make_shared<messaging::PingMessage>(meter_id, false);
+        ping_send_times.emplace(predecessor, timers.current_time_us());
+        auto success = network.send(ping, predecessor);
+        if(!success) {
+            logger->debug("Meter {} detected that meter {} is down", meter_id, predecessor);
+            detect_failure(predecessor);
+        }
+    }
+}
+
+/**
+ * Records that another meter has been found to have failed during the current
+ * query, both for this query and in the failure detector.
+ * @param failed_id The ID of the meter that failed
+ * @return True if the meter was not already in failed_meter_ids
+ */
+template<typename Impl>
+bool ProtocolState<Impl>::detect_failure(const int failed_id) {
+    suspected_meter_ids.erase(failed_id);
+    failure_detector.report_failure(failed_id, get_current_query_num());
+    return failed_meter_ids.emplace(failed_id).second;
+}
+
+/**
+ * Records that another meter has been heard from, so it hasn't failed. If it
+ * was only suspected of having failed, this meter stops treating it as failed.
+ * This should be called for every message received from another meter, even
+ * one that arrives too late to be used, since it still shows the meter is up.
+ * @param alive_id The ID of the meter that was heard from
+ */
+template<typename Impl>
+void ProtocolState<Impl>::detect_alive(const int alive_id) {
+    failure_detector.report_alive(alive_id);
+    if(suspected_meter_ids.erase(alive_id) > 0) {
+        logger->debug("Meter {} heard from suspected meter {}, so it's not down", meter_id, alive_id);
+    }
+}
+
+/**
+ * @return The meters that paths should avoid: those that have failed, and
+ * those that are still suspected of having failed.
+ */
+template<typename Impl>
+std::set<int> ProtocolState<Impl>::presumed_failed_meters() const {
+    std::set<int> presumed_failed(failed_meter_ids);
+    presumed_failed.insert(suspected_meter_ids.begin(), suspected_meter_ids.end());
+    return presumed_failed;
+}
+
 template<typename Impl>
 void ProtocolState<Impl>::super_end_overlay_round() {
     timers.cancel_timer(round_timeout_timer);
@@ -134,26 +343,28 @@ void ProtocolState<Impl>::super_end_overlay_round() {
     //If the last round is ending, the only thing we need to do is cancel the timeout
     if(is_last_round)
         return;
+    //Learn how long rounds take, but only from rounds that didn't end by timing out
+    if(overlay_round >= 0 && received_all_final_messages()) {
+        round_time_estimator.add_sample(timers.current_time_us() - round_start_time);
+    }
+    //If this meter was only relaying messages for other meters, stop once they must be done too
+    if(!impl_this->is_in_overlay_phase() && overlay_round >= final_overlay_round) {
+        is_last_round = true;
+        return;
+    }
 
     overlay_round++;
-    ping_response_from_predecessor = false;
+    round_start_time = timers.current_time_us();
+    heard_from_predecessor = false;
+    round_went_quiet = false;
+    final_message_senders.clear();
+    ping_send_times.clear();
     //Send outgoing messages at the start of the next round
     send_overlay_message_batch();
 
-    round_timeout_timer = timers.register_timer(OVERLAY_ROUND_TIMEOUT, [this](){handle_round_timeout();});
-
-    const int predecessor = util::gossip_predecessor(meter_id, overlay_round, num_meters);
-    if(failed_meter_ids.find(predecessor) == failed_meter_ids.end()) {
-        //Send a ping to the predecessor meter to see if it's still alive
-        auto ping = std::make_shared<messaging::PingMessage>(meter_id, false);
-        //This turns out to be really important: Checking whether this ping succeeds
-        //is the most common way of detecting that a node has failed
-        auto success = network.send(ping, predecessor);
-        if(!success) {
-            logger->debug("Meter {} detected that meter {} is down", meter_id, predecessor);
-            failed_meter_ids.emplace(predecessor);
-        }
-    }
+    //Predecessors aren't pinged up front: their overlay messages show they're alive,
+    //so pings are only needed if the round goes quiet (see handle_round_timeout)
+    round_timeout_timer = timers.register_timer(round_time_estimator.timeout(), [this](){handle_round_timeout();});
 
     //Check future messages in case messages for the next round have already been received
     ptr_list<messaging::OverlayTransportMessage> received_messages;
@@ -178,25 +389,47 @@ void ProtocolState<Impl>::super_end_overlay_round() {
         handle_overlay_message(message);
     }
     //If end_overlay_round() hasn't already been called for another reason,
-    //and the predecessor is known to be dead, immediately end the current round
-    if(local_overlay_round == overlay_round && failed_meter_ids.find(predecessor) != failed_meter_ids.end()) {
-        logger->trace("Meter {} ending round early, predecessor {} is dead", meter_id, predecessor);
+    //and the predecessors we're still waiting on are known to be dead, immediately end the current round
+    if(local_overlay_round == overlay_round && received_all_final_messages()) {
+        logger->trace("Meter {} ending round early, remaining predecessors are dead", meter_id);
+        end_overlay_round();
+    } else if(local_overlay_round == overlay_round && overlay_proven_complete) {
+        logger->trace("Meter {} ending round {} without waiting, the overlay is proven complete", meter_id, overlay_round);
         end_overlay_round();
     }
 
 }
 
+/**
+ * Checks whether this meter has heard everything it is going to hear in the
+ * current round, i.e. each of its predecessors has either sent its final
+ * message or is known to have failed.
+ * @return True if no more overlay messages are expected this round
+ */
+template<typename Impl>
+bool ProtocolState<Impl>::received_all_final_messages() const {
+    for(const int predecessor : util::gossip_predecessors(meter_id, overlay_round, num_meters)) {
+        if(final_message_senders.find(predecessor) == final_message_senders.end()
+                && !is_presumed_failed(predecessor)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 template<typename Impl>
 void ProtocolState<Impl>::send_overlay_message_batch() {
-    const int comm_target = util::gossip_target(meter_id, overlay_round, num_meters);
-    ptr_list<messaging::OverlayTransportMessage> messages_to_send;
+    const auto& comm_targets = util::gossip_targets(meter_id, overlay_round, num_meters);
+    //One batch of messages for each gossip target, in the same order as comm_targets
+    std::vector<ptr_list<messaging::OverlayTransportMessage>> messages_to_send(comm_targets.size());
     //First, check waiting messages to see if some are now in the right round
     for(auto message_iter = waiting_messages.begin();
             message_iter != waiting_messages.end(); ) {
-        if((*message_iter)->destination == comm_target) {
+        auto target_pos = std::find(comm_targets.begin(), comm_targets.end(), (*message_iter)->destination);
+        if(target_pos != comm_targets.end()) {
             //wrap it up in a new OverlayTransportMessage, then delete from waiting_messages
-            messages_to_send.emplace_back(std::make_shared<messaging::OverlayTransportMessage>(
-                    meter_id, overlay_round, false, *message_iter));
+            messages_to_send[target_pos - comm_targets.begin()].emplace_back(
+                    std::make_shared<messaging::OverlayTransportMessage>(meter_id, overlay_round, false, *message_iter));
             message_iter = waiting_messages.erase(message_iter);
         } else {
             ++message_iter;
@@ -204,34 +437,51 @@ void ProtocolState<Impl>::send_overlay_message_batch() {
     }
     //Next, check messages generated by the protocol this round to see if they should be sent or held
     for(const auto& overlay_message : outgoing_messages) {
-        if(overlay_message->flood || overlay_message->destination == comm_target) {
-            messages_to_send.emplace_back(std::make_shared<messaging::OverlayTransportMessage>(
-                    meter_id, overlay_round, false, overlay_message));
+        auto target_pos = std::find(comm_targets.begin(), comm_targets.end(), overlay_message->destination);
+        if(overlay_message->flood) {
+            //Flood messages go to every target that doesn't already have them
+            for(std::size_t target_index = 0; target_index < comm_targets.size(); ++target_index) {
+                if(impl_this->should_flood_to(*overlay_message, comm_targets[target_index])) {
+                    messages_to_send[target_index].emplace_back(std::make_shared<messaging::OverlayTransportMessage>(
+                            meter_id, overlay_round, false, overlay_message));
+                }
+            }
+        } else if(target_pos != comm_targets.end()) {
+            messages_to_send[target_pos - comm_targets.begin()].emplace_back(
+                    std::make_shared<messaging::OverlayTransportMessage>(meter_id, overlay_round, false, overlay_message));
         } else {
             waiting_messages.emplace_back(overlay_message);
         }
     }
 //    logger->trace("Meter {} starting round {}. Size of messages_to_send: {}; size of waiting_messages: {}", meter_id, overlay_round, messages_to_send.size(), waiting_messages.size());
     outgoing_messages.clear();
-    //Now, send all the messages, marking the last one as final
-    if(!messages_to_send.empty()) {
-        messages_to_send.back()->is_final_message = true;
-        auto success = network.send(messages_to_send, comm_target);
-        if(!success) {
-            logger->debug("Meter {} detected that meter {} is down", meter_id, comm_target);
-            failed_meter_ids.emplace(comm_target);
+    //Piggyback a snapshot of the current phase's certificate on each batch
+    if(certificate_phase >= 0) {
+        auto certificate_copy = std::make_shared<messaging::AckCertificate>(*phase_certificates.at(certificate_phase));
+        for(std::size_t target_index = 0; target_index < comm_targets.size(); ++target_index) {
+            messages_to_send[target_index].emplace_back(std::make_shared<messaging::OverlayTransportMessage>(
+                    meter_id, overlay_round, false, std::make_shared<messaging::OverlayMessage>(
+                            get_current_query_num(), comm_targets[target_index], certificate_copy)));
         }
-    } else {
-        //If we didn't send anything this round, send an empty message to ensure the target can advance his round
-        auto dummy_message = std::make_shared<messaging::OverlayMessage>(
-                get_current_query_num(), comm_target, nullptr);
-        auto dummy_transport = std::make_shared<messaging::OverlayTransportMessage>(
-                meter_id, overlay_round, true, dummy_message);
-        logger->trace("Meter {} sending a dummy message to meter {}", meter_id, comm_target);
-        auto success = network.send({dummy_transport}, comm_target);
+    }
+    //Now, send each target's batch, marking the last one as final
+    for(std::size_t target_index = 0; target_index < comm_targets.size(); ++target_index) {
+        const int comm_target = comm_targets[target_index];
+        auto& target_batch = messages_to_send[target_index];
+        if(target_batch.empty()) {
+            //If we didn't send anything this round, send an empty message to ensure the target can advance his round
+            auto dummy_message = std::make_shared<messaging::OverlayMessage>(
+                    get_current_query_num(), comm_target, nullptr);
+            target_batch.emplace_back(std::make_shared<messaging::OverlayTransportMessage>(
+                    meter_id, overlay_round, true, dummy_message));
+            logger->trace("Meter {} sending a dummy message to meter {}", meter_id, comm_target);
+        } else {
+            target_batch.back()->is_final_message = true;
+        }
+        auto success = network.send(target_batch, comm_target);
         if(!success) {
             logger->debug("Meter {} detected that meter {} is down", meter_id, comm_target);
-            failed_meter_ids.emplace(comm_target);
+            detect_failure(comm_target);
         }
     }
 }
@@ -239,7 +489,7 @@ void ProtocolState<Impl>::send_overlay_message_batch() {
 /**
  * Processes an overlay message that has been received for the current
  * round. The superclass implementation only resets the message timeout for
- * this round and appends the message to waiting_messages if it needs to be
+ * this round and relays the message (see relay_message) if it needs to be
  * forwarded. Subclasses should add phase-specific handling for the message
  * and end the round if it is the final message
  * @param message An overlay message that should be handled by this meter
@@ -247,29 +497,120 @@ void ProtocolState<Impl>::send_overlay_message_batch() {
  */
 template<typename Impl>
 void ProtocolState<Impl>::handle_overlay_message(const std::shared_ptr<messaging::OverlayTransportMessage>& message) {
-    if(impl_this->is_in_overlay_phase()) {
+    if(is_running_overlay()) {
         timers.cancel_timer(round_timeout_timer);
-        round_timeout_timer = timers.register_timer(OVERLAY_ROUND_TIMEOUT, [this](){handle_round_timeout();});
+        round_timeout_timer = timers.register_timer(round_time_estimator.timeout(), [this](){handle_round_timeout();});
+    }
+    //The sender was already marked alive when the message was received (see MeterClient)
+    if(message->is_final_message) {
+        final_message_senders.emplace(message->sender_id);
+    }
+    //Any message from a predecessor is as good as a ping response
+    if(util::is_gossip_target(message->sender_id, overlay_round, num_meters, meter_id)) {
+        heard_from_predecessor = true;
     }
     //The only valid MessageBody for an OverlayTransportMessage is an OverlayMessage
     auto wrapped_message = std::static_pointer_cast<messaging::OverlayMessage>(message->body);
-    if(wrapped_message->is_encrypted) {
+    //Dispatch on the body's type tag without copying any shared_ptrs; the bodies stay alive in wrapped_message
+    if(auto* onion = messaging::body_cast<messaging::OnionPacket>(wrapped_message->body.get())) {
+        const int next_hop = crypto.peel_onion(*onion);
+        if(next_hop == messaging::OnionPacket::FINAL_HOP) {
+            //Give the subclass the payload as if it had arrived in an ordinary OverlayMessage
+            std::shared_ptr<messaging::MessageBody> payload;
+            try {
+                payload = onion->open_payload();
+            } catch(const messaging::DecodeError& e) {
+                logger->warn("Meter {} dropped the payload of an onion it couldn't decode: {}", meter_id, e.what());
+            }
+            message->body = std::make_shared<messaging::OverlayMessage>(
+                    wrapped_message->query_num, meter_id, payload);
+        } else {
+            //Point the same message at the next hop and relay it; the subclass will see it isn't the destination
+            wrapped_message->destination = next_hop;
+            relay_message(wrapped_message, message->sender_round);
+        }
+    } else if(wrapped_message->is_encrypted) {
         //Replace the pointer in the OTM with the decrypted body, throwing away the encrypted data,
         //since this makes it easier to pass the decrypted message to the subclass handler method
         message->body = crypto.rsa_decrypt(wrapped_message);
+    } else if(messaging::AckCertificate::holds_certificate(wrapped_message->body.get())) {
+        //Received certificates stay opaque, and are only decoded if they could still end a phase early
+        std::shared_ptr<const messaging::AckCertificate> certificate;
+        if(early_completion_possible && wrapped_message->query_num == get_current_query_num()) {
+            try {
+                certificate = messaging::AckCertificate::from_body(wrapped_message->body);
+            } catch(const messaging::DecodeError& e) {
+                logger->warn("Meter {} ignored a certificate it couldn't decode: {}", meter_id, e.what());
+            }
+        }
+        if(certificate) {
+            auto& known_certificate = phase_certificates[certificate->phase];
+            if(known_certificate == nullptr) {
+                known_certificate = std::make_shared<messaging::AckCertificate>(*certificate);
+            } else {
+                known_certificate->merge(*certificate);
+            }
+            highest_peer_certificate_phase = std::max(highest_peer_certificate_phase, certificate->phase);
+        }
+        //The subclass should see this as an empty message, just like a dummy
+        message->body = std::make_shared<messaging::OverlayMessage>(
+                wrapped_message->query_num, wrapped_message->destination, nullptr);
     }
-    if(auto path_overlay_message = std::dynamic_pointer_cast<messaging::PathOverlayMessage>(message->body)) {
+    if(auto* path_overlay_message = messaging::body_cast<messaging::PathOverlayMessage>(message->body.get())) {
         if(!path_overlay_message->remaining_path.empty()) {
-            //Pop remaining_path into destination and add to waiting_messages
+            //Pop remaining_path into destination and relay it to the next hop
             path_overlay_message->destination = path_overlay_message->remaining_path.front();
 //            path_overlay_message->remaining_path.erase(path_overlay_message->remaining_path.begin());
             path_overlay_message->remaining_path.pop_front();
-            waiting_messages.emplace_back(path_overlay_message);
+            relay_message(std::static_pointer_cast<messaging::OverlayMessage>(message->body), message->sender_round);
+        }
+    } else if(auto* multicast_message = messaging::body_cast<messaging::MulticastOverlayMessage>(message->body.get())) {
+        //Split the message at this point in the tree, and relay each branch's paths and bodies down it
+        auto branches = messaging::MulticastOverlayMessage::branch(multicast_message->query_num,
+                multicast_message->remaining_paths, multicast_message->path_bodies);
+        for(const auto& branch : branches) {
+            relay_message(branch, message->sender_round);
+        }
+        if(auto own_body = multicast_message->recipient_body()) {
+            //Decrypt this meter's own copy, and give the subclass its payload as the message's body
+            if(auto* opaque_body = messaging::body_cast<messaging::OpaqueBody>(own_body.get())) {
+                own_body = decode_received_body(*opaque_body);
+            }
+            auto own_message = messaging::body_pointer_cast<messaging::OverlayMessage>(own_body);
+            multicast_message->body = own_message ? crypto.rsa_decrypt(own_message)->body : nullptr;
+        } else if(!branches.empty()) {
+            //If this meter only relays it, point the destination elsewhere, just like a relayed PathOverlayMessage
+            multicast_message->destination = branches.front()->destination;
+        }
+    }
+    //Bodies of relayed messages stay as views of the receive buffer, but one delivered here must be decoded
+    auto delivered_message = std::static_pointer_cast<messaging::OverlayMessage>(message->body);
+    if(delivered_message->destination == meter_id) {
+        if(auto* opaque_body = messaging::body_cast<messaging::OpaqueBody>(delivered_message->body.get())) {
+            delivered_message->body = decode_received_body(*opaque_body);
         }
     }
     impl_this->handle_overlay_message_impl(message);
 }
 
+/**
+ * Decodes a body that was received as a view of a receive buffer. Bodies
+ * are only decoded once they reach their destination, so a body that turns
+ * out to be malformed is dropped there, and the message carrying it is
+ * handled as if it had no body.
+ * @param opaque_body The received body
+ * @return The decoded body, or null if it could not be decoded
+ */
+template<typename Impl>
+std::shared_ptr<messaging::MessageBody> ProtocolState<Impl>::decode_received_body(const messaging::OpaqueBody& opaque_body) {
+    try {
+        return opaque_body.decode();
+    } catch(const messaging::DecodeError& e) {
+        logger->warn("Meter {} dropped a message body it couldn't decode: {}", meter_id, e.what());
+        return nullptr;
+    }
+}
+
 /**
  * Processes a ping message from another meter, for the purpose of
  * detecting failures. Either responds if it is a request, or locally
@@ -278,20 +619,107 @@ void ProtocolState<Impl>::handle_overlay_message(const std::shared_ptr<messaging
  */
 template<typename Impl>
 void ProtocolState<Impl>::handle_ping_message(const std::shared_ptr<messaging::PingMessage>& message) {
+    detect_alive(message->sender_id);
     if(!message->is_response) {
+        //A meter that ended a proven-complete overlay has nothing left to send, so it lets the pinger time out
+        if(overlay_proven_complete && is_last_round) {
+            return;
+        }
         //If this is a ping request, send a response back
         auto reply = std::make_shared<messaging::PingMessage>(meter_id, true);
         logger->trace("Meter {} replying to a ping from {}", meter_id, message->sender_id);
         network.send(reply, message->sender_id);
-    } else if (message->sender_id == util::gossip_predecessor(meter_id, overlay_round, num_meters)) {
-        //If this is a ping response and we still care about it
-        //(the sender is our predecessor), take note
-        ping_response_from_predecessor = true;
+    } else {
+        auto send_time = ping_send_times.find(message->sender_id);
+        if(send_time != ping_send_times.end()) {
+            ping_rtt_estimator.add_sample(timers.current_time_us() - send_time->second);
+            ping_send_times.erase(send_time);
+        }
+        if (util::is_gossip_target(message->sender_id, overlay_round, num_meters, meter_id)) {
+            //If this is a ping response and we still care about it
+            //(the sender is one of our predecessors), take note
+            heard_from_predecessor = true;
+        }
+    }
+}
+
+/**
+ * Sets aside an overlay message that this meter must forward to its next hop.
+ * Normally it waits in waiting_messages until the first round in which its
+ * destination is one of this meter's gossip targets. With asynchronous
+ * forwarding, it is sent immediately, labeled with that round, so that it
+ * doesn't have to wait for this meter to finish the rounds in between.
+ * @param message The message to forward
+ * @param received_round The round in which this meter received the message
+ */
+template<typename Impl>
+void ProtocolState<Impl>::relay_message(const std::shared_ptr<messaging::OverlayMessage>& message, const int received_round) {
+    if(ASYNC_OVERLAY_FORWARDING && !message->flood) {
+        //Paths rarely wait at a hop for more than logkn rounds; anything that would can wait for its batch
+        for(int send_round = std::max(received_round, overlay_round) + 1;
+                send_round <= received_round + logkn; ++send_round) {
+            if(util::is_gossip_target(meter_id, send_round, num_meters, message->destination)) {
+                ptr_list<messaging::OverlayTransportMessage> relay_batch{
+                    std::make_shared<messaging::OverlayTransportMessage>(meter_id, send_round, false, message)};
+                auto success = network.send(relay_batch, message->destination);
+                if(!success) {
+                    logger->debug("Meter {} detected that meter {} is down", meter_id, message->destination);
+                    detect_failure(message->destination);
+                }
+                return;
+            }
+        }
     }
+    waiting_messages.emplace_back(message);
 }
 
 template<typename Impl>
 void ProtocolState<Impl>::buffer_future_message(const std::shared_ptr<messaging::OverlayTransportMessage>& message) {
+    auto wrapped_message = std::static_pointer_cast<messaging::OverlayMessage>(message->body);
+    //With asynchronous forwarding, a message that only passes through this meter can be relayed
+    //right away; only the fact that its sender sent it (if it was final) needs to wait for its round
+    if(ASYNC_OVERLAY_FORWARDING && is_running_overlay()
+            && wrapped_message->query_num == get_current_query_num() && !wrapped_message->flood) {
+        if(auto* onion = messaging::body_cast<messaging::OnionPacket>(wrapped_message->body.get())) {
+            const int next_hop = crypto.peel_onion(*onion);
+            if(next_hop == messaging::OnionPacket::FINAL_HOP) {
+                //Store the opened payload, so handle_overlay_message doesn't peel it again
+                message->body = std::make_shared<messaging::OverlayMessage>(
+                        wrapped_message->query_num, meter_id, onion->open_payload());
+                future_overlay_messages.push_back(message);
+                return;
+            }
+            wrapped_message->destination = next_hop;
+            relay_message(wrapped_message, message->sender_round);
+            if(message->is_final_message) {
+                message->body = std::make_shared<messaging::OverlayMessage>(
+                        wrapped_message->query_num, wrapped_message->destination, nullptr);
+                future_overlay_messages.push_back(message);
+            }
+            return;
+        }
+        auto contents = wrapped_message->is_encrypted ? crypto.rsa_decrypt(wrapped_message) : wrapped_message;
+        auto* enclosed_message = messaging::body_cast<messaging::OverlayMessage>(contents->body.get());
+        auto* path_overlay_message = messaging::body_cast<messaging::PathOverlayMessage>(contents.get());
+        if(path_overlay_message && !path_overlay_message->remaining_path.empty()) {
+            path_overlay_message->destination = path_overlay_message->remaining_path.front();
+            path_overlay_message->remaining_path.pop_front();
+            relay_message(contents, message->sender_round);
+        } else if(!path_overlay_message && enclosed_message && !enclosed_message->flood) {
+            relay_message(std::static_pointer_cast<messaging::OverlayMessage>(contents->body), message->sender_round);
+        } else {
+            //It's for this meter, so it must be handled in its round; don't decrypt it again
+            message->body = contents;
+            future_overlay_messages.push_back(message);
+            return;
+        }
+        if(message->is_final_message) {
+            message->body = std::make_shared<messaging::OverlayMessage>(
+                    wrapped_message->query_num, wrapped_message->destination, nullptr);
+            future_overlay_messages.push_back(message);
+        }
+        return;
+    }
     future_overlay_messages.push_back(message);
 }
 
@@ -300,8 +728,58 @@ void ProtocolState<Impl>::buffer_future_message(const std::shared_ptr<messaging:
     future_aggregation_messages.push_back(message);
 }
 
+template<typename Impl>
+std::set<int> ProtocolState<Impl>::get_expected_peers() const {
+    std::set<int> peers;
+    for(int round = 0; round < logkn + FAILURES_TOLERATED; ++round) {
+        const auto& targets = util::gossip_targets(meter_id, round, num_meters);
+        peers.insert(targets.begin(), targets.end());
+    }
+    //The root of the tree has no parent (-1), since it sends to the utility instead
+    const int parent = util::aggregation_tree_parent(meter_id, num_aggregation_groups, num_meters);
+    const auto children = util::aggregation_tree_children(meter_id, num_aggregation_groups, num_meters);
+    for(const int tree_neighbor : {parent, children.first, children.second}) {
+        if(tree_neighbor >= 0) {
+            peers.insert(tree_neighbor);
+        }
+    }
+    return peers;
+}
+
+/**
+ * Records that some meters could not be reached by a send.
+ * @param meter_ids The IDs of the meters that could not be reached
+ */
+template<typename Impl>
+void ProtocolState<Impl>::mark_meters_failed(const std::set<int>& meter_ids) {
+    for(const int failed_id : meter_ids) {
+        if(detect_failure(failed_id)) {
+            logger->debug("Meter {} detected that meter {} is down", meter_id, failed_id);
+        }
+    }
+}
+
+/**
+ * Records that some meters could not be reached by sends that the network
+ * client deferred (to coalesce them with other sends), and so could only
+ * report when it flushed them. If they were the last predecessors this meter
+ * was waiting for, the round ends now rather than when it times out.
+ * @param meter_ids The IDs of the meters that could not be reached
+ */
+template<typename Impl>
+void ProtocolState<Impl>::handle_send_failures(const std::set<int>& meter_ids) {
+    const std::size_t num_failed = failed_meter_ids.size();
+    mark_meters_failed(meter_ids);
+    if(failed_meter_ids.size() > num_failed && !is_last_round && is_running_overlay()
+            && received_all_final_messages()) {
+        logger->trace("Meter {} ending round early, remaining predecessors are dead", meter_id);
+        end_overlay_round();
+    }
+}
+
 template<typename Impl>
 void ProtocolState<Impl>::handle_aggregation_message(const std::shared_ptr<messaging::AggregationMessage>& message) {
+    detect_alive(message->sender_id);
     aggregation_phase_state->handle_message(*message);
     impl_this->send_aggregate_if_done();
 }
@@ -0,0 +1,278 @@
+/**
+ * @file ReactorBenchmark.cpp
+ * Measures how quickly the utility can send a query to every meter and receive
+ * a reply from each of them, once with BaseTcpClient's epoll reactor and once
+ * with its io_uring reactor. The meters are emulated by a few threads that
+ * reply to each query as soon as it arrives, which work the same way in both
+ * runs, so only the utility's reactor differs.
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Configuration.h"
+#include "messaging/AggregationMessage.h"
+#include "messaging/QueryRequest.h"
+#include "networking/BaseTcpClient.h"
+#include "networking/FrameReader.h"
+#include "networking/IoUring.h"
+#include "networking/MessageFraming.h"
+#include "networking/Socket.h"
+#include "networking/TcpAddress.h"
+
+using namespace pddm;
+using networking::ReactorType;
+
+/**
+ * A utility that sends queries to every meter and counts their replies, which
+ * sends and receives the same way as TcpUtilityClient but has no UtilityClient.
+ */
+class BenchmarkUtility : public networking::BaseTcpClient<BenchmarkUtility> {
+        friend class networking::BaseTcpClient<BenchmarkUtility>;
+    private:
+        const int num_meters;
+        std::vector<char> query_frame;
+        std::mutex replies_mutex;
+        std::condition_variable all_replies_received;
+        int num_replies;
+    protected:
+        void decode_frame(const messaging::SharedBuffer& frame, const messaging::WireFormat format,
+                std::vector<TypeMessagePair>& messages) {
+            const char* buffer = frame->data();
+            if(networking::peek_message_type(buffer, format) == messaging::AggregationMessage::type) {
+                messages.emplace_back(messaging::AggregationMessage::type, std::shared_ptr<messaging::AggregationMessage>(
+                        networking::decode_message<messaging::AggregationMessage>(buffer, frame->size(), format)));
+            }
+        }
+        void handle_messages(const std::vector<TypeMessagePair>& messages) {
+            std::lock_guard<std::mutex> lock(replies_mutex);
+            num_replies += messages.size();
+            if(num_replies >= num_meters) {
+                all_replies_received.notify_all();
+            }
+        }
+    public:
+        BenchmarkUtility(const networking::TcpAddress& my_address, const std::map<int, networking::TcpAddress>& meter_addresses,
+                const ReactorType reactor_type) :
+            BaseTcpClient(this, my_address, meter_addresses, reactor_type),
+            num_meters(meter_addresses.size()),
+            num_replies(0) {}
+        /**
+         * Sends a query to every meter, in one batch of sends like
+         * TcpUtilityClient does, and waits for every meter to reply.
+         */
+        void run_query(const std::shared_ptr<messaging::QueryRequest>& query) {
+            networking::frame_messages(&query, &query + 1, WIRE_FORMAT, query_frame, message_sizes);
+            begin_send_batch();
+            for(int meter_id = 0; meter_id < num_meters; ++meter_id) {
+                auto& frame = send_buffers[meter_id];
+                frame.assign(query_frame.begin(), query_frame.end());
+                send_frame(meter_id, frame);
+            }
+            end_send_batch();
+            std::unique_lock<std::mutex> lock(replies_mutex);
+            all_replies_received.wait(lock, [this]() { return num_replies >= num_meters; });
+            num_replies = 0;
+        }
+};
+
+/**
+ * Emulates meters that reply to every query with an AggregationMessage. Each
+ * meter listens on its own port, and a few threads share the meters between
+ * them, each waiting on its meters' sockets with epoll.
+ */
+class MeterEmulator {
+    private:
+        struct Meter {
+            int listen_fd;
+            networking::Socket utility_socket;
+            std::vector<char> reply_frame;
+        };
+        std::vector<Meter> meters;
+        std::atomic<bool> running;
+        std::vector<std::thread> threads;
+        void run(const int thread_index, const int num_threads) {
+            int epoll_fd = epoll_create1(0);
+            std::map<int, int> meter_by_listen_fd;
+            for(int meter_id = thread_index; meter_id < (int) meters.size(); meter_id += num_threads) {
+                epoll_event event;
+                std::memset(&event, 0, sizeof(event));
+                event.data.fd = meters[meter_id].listen_fd;
+                event.events = EPOLLIN;
+                epoll_ctl(epoll_fd, EPOLL_CTL_ADD, meters[meter_id].listen_fd, &event);
+                meter_by_listen_fd[meters[meter_id].listen_fd] = meter_id;
+            }
+            //The meter each of the utility's connections goes to, and its read state, by FD
+            std::map<int, std::pair<int, networking::FrameReader>> connections;
+            std::vector<char> read_buffer(64 * 1024);
+            std::vector<messaging::SharedBuffer> queries;
+            epoll_event events[64];
+            while(running) {
+                int num_events = epoll_wait(epoll_fd, events, 64, 100);
+                for(int i = 0; i < num_events; ++i) {
+                    const int fd = events[i].data.fd;
+                    auto listener_find = meter_by_listen_fd.find(fd);
+                    if(listener_find != meter_by_listen_fd.end()) {
+                        int connection_fd = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK);
+                        if(connection_fd < 0) {
+                            continue;
+                        }
+                        connections.emplace(connection_fd, std::make_pair(listener_find->second, networking::FrameReader()));
+                        epoll_event event;
+                        std::memset(&event, 0, sizeof(event));
+                        event.data.fd = connection_fd;
+                        event.events = EPOLLIN;
+                        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connection_fd, &event);
+                        continue;
+                    }
+                    auto connection_find = connections.find(fd);
+                    if(connection_find == connections.end()) {
+                        continue;
+                    }
+                    queries.clear();
+                    auto status = connection_find->second.second.read_from(fd, read_buffer, read_buffer.size(), queries);
+                    Meter& meter = meters[connection_find->second.first];
+                    for(std::size_t query = 0; query < queries.size(); ++query) {
+                        meter.utility_socket.write(meter.reply_frame.data(), meter.reply_frame.size());
+                    }
+                    if(status == networking::FrameReader::Status::CLOSED) {
+                        close(fd);
+                        connections.erase(connection_find);
+                    }
+                }
+            }
+            for(const auto& connection : connections) {
+                close(connection.first);
+            }
+            close(epoll_fd);
+        }
+    public:
+        MeterEmulator(const int num_meters, const int first_port, const networking::TcpAddress& utility_address,
+                const int num_threads) :
+                meters(num_meters),
+                running(true) {
+            for(int meter_id = 0; meter_id < num_meters; ++meter_id) {
+                Meter& meter = meters[meter_id];
+                meter.listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+                int reuse_addr = 1;
+                setsockopt(meter.listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse_addr, sizeof(reuse_addr));
+                sockaddr_in address;
+                std::memset(&address, 0, sizeof(address));
+                address.sin_family = AF_INET;
+                address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                address.sin_port = htons(first_port + meter_id);
+                if(bind(meter.listen_fd, (sockaddr*) &address, sizeof(address)) < 0) {
+                    throw networking::connection_failure("Could not bind meter " + std::to_string(meter_id) + "'s port");
+                }
+                listen(meter.listen_fd, SOMAXCONN);
+                meter.utility_socket = networking::Socket(utility_address.ip_addr, utility_address.port);
+                std::uint64_t announcement = networking::wire_format_announcement(WIRE_FORMAT);
+                meter.utility_socket.write((char*) &announcement, sizeof(announcement));
+                messaging::AggregationMessage reply(meter_id, 0,
+                        std::make_shared<messaging::AggregationMessageValue>(1, FixedPoint_t(2.5)));
+                networking::frame_utility_message(reply, WIRE_FORMAT, meter.reply_frame);
+            }
+            for(int thread_index = 0; thread_index < num_threads; ++thread_index) {
+                threads.emplace_back([this, thread_index, num_threads]() { run(thread_index, num_threads); });
+            }
+        }
+        ~MeterEmulator() {
+            running = false;
+            for(auto& thread : threads) {
+                thread.join();
+            }
+            for(const auto& meter : meters) {
+                close(meter.listen_fd);
+            }
+        }
+};
+
+/** @return The CPU time this process has used so far, in milliseconds */
+double cpu_time_ms() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0
+            + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+/**
+ * Runs queries between a utility using one reactor and a set of emulated
+ * meters, and reports the average time and CPU time each query took.
+ */
+void benchmark_reactor(const std::string& name, const ReactorType reactor_type, const int num_meters,
+        const int num_queries, const int utility_port) {
+    std::map<int, networking::TcpAddress> meter_addresses;
+    for(int meter_id = 0; meter_id < num_meters; ++meter_id) {
+        meter_addresses.emplace(meter_id, networking::TcpAddress{"127.0.0.1", utility_port + 1 + meter_id});
+    }
+    BenchmarkUtility utility(networking::TcpAddress{"127.0.0.1", utility_port}, meter_addresses, reactor_type);
+    std::thread monitor_thread([&utility]() { utility.monitor_incoming_messages(); });
+    {
+        MeterEmulator meters(num_meters, utility_port + 1, networking::TcpAddress{"127.0.0.1", utility_port}, 4);
+        std::set<int> meter_ids;
+        for(int meter_id = 0; meter_id < num_meters; ++meter_id) {
+            meter_ids.insert(meter_id);
+        }
+        utility.prewarm_connections(meter_ids);
+        //Let every connection finish opening before measuring
+        const int warmup_queries = 10;
+        for(int query_num = 0; query_num < warmup_queries; ++query_num) {
+            utility.run_query(std::make_shared<messaging::QueryRequest>(messaging::QueryType::CURR_USAGE_SUM, 5, query_num));
+        }
+        const double start_cpu_time = cpu_time_ms();
+        auto start_time = std::chrono::steady_clock::now();
+        for(int query_num = warmup_queries; query_num < warmup_queries + num_queries; ++query_num) {
+            utility.run_query(std::make_shared<messaging::QueryRequest>(messaging::QueryType::CURR_USAGE_SUM, 5, query_num));
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start_time;
+        double micros_per_query = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / (double) num_queries;
+        double cpu_micros_per_query = 1000.0 * (cpu_time_ms() - start_cpu_time) / num_queries;
+        std::cout << std::left << std::setw(24) << name << std::right << std::setw(12)
+                  << std::fixed << std::setprecision(1) << micros_per_query << " us/query" << std::setw(12)
+                  << cpu_micros_per_query << " us CPU/query" << std::endl;
+    }
+    utility.shut_down();
+    monitor_thread.join();
+}
+
+int main(int argc, char** argv) {
+    const int num_meters = argc > 1 ? std::atoi(argv[1]) : 1000;
+    const int num_queries = argc > 2 ? std::atoi(argv[2]) : 200;
+    //The default ports are below Linux's range for outgoing connections, which would take some of them
+    const int first_port = argc > 3 ? std::atoi(argv[3]) : 20000;
+    //Each meter needs a listening socket and three connections, on top of the utility's
+    rlimit file_limit;
+    getrlimit(RLIMIT_NOFILE, &file_limit);
+    file_limit.rlim_cur = file_limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &file_limit);
+    std::cout << "Each measurement is the average over " << num_queries << " queries, each sent to "
+              << num_meters << " meters, which each reply to the utility" << std::endl;
+    benchmark_reactor("epoll", ReactorType::EPOLL, num_meters, num_queries, first_port);
+    if(!networking::IoUring::is_supported()) {
+        std::cout << "io_uring is not supported by this kernel" << std::endl;
+        return 0;
+    }
+    benchmark_reactor("io_uring", ReactorType::IO_URING, num_meters, num_queries, first_port + num_meters + 1);
+    return 0;
+}
@@ -0,0 +1,238 @@
+/**
+ * @file SerializationBenchmark.cpp
+ * Measures how long it takes to frame and deserialize each type of message
+ * that meters send to each other over TCP, how many heap allocations that
+ * takes, and how large the frames are, in each WireFormat.
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "messaging/AgreementValue.h"
+#include "messaging/AggregationMessage.h"
+#include "messaging/FloodDigestMessage.h"
+#include "messaging/MulticastOverlayMessage.h"
+#include "messaging/OnionPacket.h"
+#include "messaging/OverlayTransportMessage.h"
+#include "messaging/PathOverlayMessage.h"
+#include "messaging/PingMessage.h"
+#include "messaging/ReceiveBuffer.h"
+#include "messaging/SignedValue.h"
+#include "messaging/ValueContribution.h"
+#include "messaging/ValueTuple.h"
+#include "networking/MessageFraming.h"
+
+using namespace pddm;
+
+//Counts every heap allocation, so that each measurement can report how many it makes
+static std::size_t allocation_count = 0;
+
+void* operator new(std::size_t size) {
+    ++allocation_count;
+    if(void* pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    ++allocation_count;
+    const std::size_t align = static_cast<std::size_t>(alignment);
+    if(void* pointer = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+
+/**
+ * Runs a function the given number of times and reports the average time it
+ * took and the average number of heap allocations it made.
+ * @param name The name to print for this measurement
+ * @param iterations The number of times to run the function
+ * @param function The function to measure
+ */
+void time_iterations(const std::string& name, const int iterations, const std::function<void()>& function) {
+    const std::size_t start_allocations = allocation_count;
+    auto start_time = std::chrono::steady_clock::now();
+    for(int i = 0; i < iterations; ++i) {
+        function();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start_time;
+    double nanos_per_iteration = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / (double) iterations;
+    double allocations_per_iteration = (allocation_count - start_allocations) / (double) iterations;
+    std::cout << std::left << std::setw(56) << name << std::right << std::setw(12)
+              << std::fixed << std::setprecision(1) << nanos_per_iteration << " ns" << std::setw(12)
+              << allocations_per_iteration << " allocs" << std::endl;
+}
+
+/**
+ * Measures framing a batch of messages into a reused buffer, as TcpNetworkClient
+ * does when sending, and then receiving the frame into a new ReceiveBuffer and
+ * deserializing every message in it, as BaseTcpClient and TcpNetworkClient do.
+ * Overlay messages are deserialized both completely and as views of the
+ * receive buffer allocated in its arena. Each measurement is made once for
+ * each WireFormat.
+ */
+template<typename MessageType>
+void benchmark_message_type(const std::string& name, const std::list<std::shared_ptr<MessageType>>& batch,
+        const int iterations) {
+    for(const auto format : {messaging::WireFormat::MUTILS, messaging::WireFormat::COMPACT}) {
+        const std::string format_name = name + (format == messaging::WireFormat::COMPACT ? " [compact]" : " [mutils]");
+        std::vector<char> frame;
+        std::vector<std::size_t> message_sizes;
+        time_iterations(format_name + " frame", iterations, [&]() {
+            networking::frame_messages(batch.begin(), batch.end(), format, frame, message_sizes);
+        });
+        std::cout << std::left << std::setw(56) << (format_name + " frame size") << std::right << std::setw(12)
+                  << frame.size() << " bytes" << std::endl;
+        //Skip the frame size, like BaseTcpClient does before calling receive_message
+        const char* frame_start = frame.data();
+        networking::read_size_prefix(frame_start, frame.data() + frame.size(), format);
+        const std::size_t received_size = frame.data() + frame.size() - frame_start;
+        auto receive_and_deserialize = [&](const bool as_views) {
+            auto received_frame = std::make_shared<messaging::ReceiveBuffer>(received_size);
+            std::memcpy(received_frame->data(), frame_start, received_size);
+            const char* buffer = received_frame->data();
+            const char* frame_end = buffer + received_size;
+            const std::size_t num_messages = networking::read_size_prefix(buffer, frame_end, format);
+            for(std::size_t i = 0; i < num_messages; ++i) {
+                std::size_t message_size = networking::read_message_size(buffer, frame_end, format);
+                if constexpr(std::is_same<MessageType, messaging::OverlayTransportMessage>::value) {
+                    if(as_views) {
+                        auto message = networking::view_transport_message(buffer, message_size, format, received_frame);
+                        buffer += message_size;
+                        continue;
+                    }
+                }
+                auto message = networking::decode_message<MessageType>(buffer, message_size, format);
+                buffer += message_size;
+            }
+        };
+        time_iterations(format_name + " deserialize", iterations, [&]() { receive_and_deserialize(false); });
+        if constexpr(std::is_same<MessageType, messaging::OverlayTransportMessage>::value) {
+            time_iterations(format_name + " deserialize as view", iterations, [&]() { receive_and_deserialize(true); });
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 100000;
+    const int batch_size = argc > 2 ? std::atoi(argv[2]) : 20;
+    const int bft_batch_size = argc > 3 ? std::atoi(argv[3]) : 1000;
+    //Keep the total number of messages deserialized in the BFT batch about the same as in the others
+    const int bft_iterations = std::max(1, iterations * batch_size / bft_batch_size);
+    std::cout << "Each measurement is the average over " << iterations << " iterations, with "
+              << batch_size << " messages per frame (" << bft_iterations << " iterations with "
+              << bft_batch_size << " messages for the BFT batch)" << std::endl;
+
+    auto contribution = std::make_shared<messaging::ValueContribution>(
+            messaging::ValueTuple(1, std::vector<FixedPoint_t>(24, FixedPoint_t(1.5)), {5, 15, 25, 35}));
+    std::map<int, util::SignatureArray> signatures;
+    for(int signer = 0; signer < 4; ++signer) {
+        signatures[signer].fill(0);
+    }
+    messaging::SignedValue signed_value(contribution, signatures);
+    auto agreement_value = std::make_shared<messaging::AgreementValue>(signed_value, 5);
+
+    std::list<int> path = {3, 1, 4, 1, 5, 9, 2, 6};
+    auto onion = messaging::OnionPacket::assemble(path, *contribution);
+    std::vector<std::list<int>> multicast_paths = {{1, 2, 3}, {1, 2, 4}, {1, 5, 6}, {7, 8, 9}};
+    //Like messaging::build_encrypted_multicast, but with the encryption flag set directly, as DummyCrypto does
+    auto multicast_of = [&multicast_paths](const std::shared_ptr<messaging::MessageBody>& payload) {
+        std::vector<std::shared_ptr<messaging::MessageBody>> path_bodies;
+        for(const auto& multicast_path : multicast_paths) {
+            auto path_body = std::make_shared<messaging::OverlayMessage>(1, multicast_path.back(), payload);
+            path_body->is_encrypted = true;
+            path_bodies.emplace_back(path_body);
+        }
+        return std::make_shared<messaging::MulticastOverlayMessage>(1, 0, multicast_paths, path_bodies);
+    };
+
+    auto batch_of = [batch_size](const std::function<std::shared_ptr<messaging::OverlayMessage>()>& make_body) {
+        std::list<std::shared_ptr<messaging::OverlayTransportMessage>> batch;
+        for(int i = 0; i < batch_size; ++i) {
+            batch.emplace_back(std::make_shared<messaging::OverlayTransportMessage>(0, 2, false, make_body()));
+        }
+        return batch;
+    };
+    benchmark_message_type("Dummy overlay", batch_of([]() {
+        return std::make_shared<messaging::OverlayMessage>(1, 7, nullptr);
+    }), iterations);
+    benchmark_message_type("Onion", batch_of([&]() {
+        return std::make_shared<messaging::OverlayMessage>(1, path.front(), onion);
+    }), iterations);
+    benchmark_message_type("Path(ValueContribution)", batch_of([&]() {
+        return std::make_shared<messaging::PathOverlayMessage>(1, path, contribution);
+    }), iterations);
+    benchmark_message_type("Path(AgreementValue)", batch_of([&]() {
+        return std::make_shared<messaging::PathOverlayMessage>(1, path, agreement_value);
+    }), iterations);
+    benchmark_message_type("Multicast(ValueContribution)", batch_of([&]() {
+        return multicast_of(contribution);
+    }), iterations);
+    benchmark_message_type("Nested flood", batch_of([&]() {
+        return std::make_shared<messaging::OverlayMessage>(1, 7,
+                std::make_shared<messaging::OverlayMessage>(1, 8, contribution, true), true);
+    }), iterations);
+
+    //A frame like the ones exchanged during BFT agreement: onions carrying
+    //contributions to proxies, and signed values and agreements multicast among them
+    std::list<std::shared_ptr<messaging::OverlayTransportMessage>> bft_batch;
+    auto signed_value_body = std::make_shared<messaging::SignedValue>(signed_value);
+    for(int i = 0; i < bft_batch_size; ++i) {
+        std::shared_ptr<messaging::OverlayMessage> body;
+        switch(i % 4) {
+        case 0:
+            body = std::make_shared<messaging::OverlayMessage>(1, path.front(), onion);
+            break;
+        case 1:
+            body = multicast_of(signed_value_body);
+            break;
+        case 2:
+            body = multicast_of(agreement_value);
+            break;
+        default:
+            body = std::make_shared<messaging::PathOverlayMessage>(1, path, signed_value_body);
+            break;
+        }
+        bft_batch.emplace_back(std::make_shared<messaging::OverlayTransportMessage>(i % 64, 2, false, body));
+    }
+    benchmark_message_type("BFT batch", bft_batch, bft_iterations);
+
+    std::list<std::shared_ptr<messaging::AggregationMessage>> aggregation_batch = {
+            std::make_shared<messaging::AggregationMessage>(0, 1,
+                    std::make_shared<messaging::AggregationMessageValue>(24, FixedPoint_t(2.5)))};
+    benchmark_message_type("Aggregation", aggregation_batch, iterations);
+    std::list<std::shared_ptr<messaging::PingMessage>> ping_batch = {std::make_shared<messaging::PingMessage>(0, false)};
+    benchmark_message_type("Ping", ping_batch, iterations);
+    std::vector<std::uint64_t> digest_ids(64);
+    for(std::size_t i = 0; i < digest_ids.size(); ++i) {
+        digest_ids[i] = i * 2654435761u;
+    }
+    std::list<std::shared_ptr<messaging::FloodDigestMessage>> digest_batch = {
+            std::make_shared<messaging::FloodDigestMessage>(0, 1, 3, digest_ids)};
+    benchmark_message_type("FloodDigest", digest_batch, iterations);
+    return 0;
+}
@@ -2,11 +2,14 @@
 #include <algorithm>
 #include <queue>
 #include <cmath>
+#include <numeric>
+#include <vector>
 #include <spdlog/fmt/ostr.h>
 
 #include "UtilityClient.h"
 #include "messaging/StringBody.h"
 #include "util/OStreams.h"
+#include "util/Overlay.h"
 
 namespace pddm {
 
@@ -15,6 +18,10 @@ using namespace messaging;
 
 void UtilityClient::handle_message(const std::shared_ptr<messaging::AggregationMessage>& message) {
     logger->trace("Utility received an aggregation message: {}", *message);
+    //The first result of a query shows how long the query's rounds took
+    if(curr_query_results.empty() && !query_finished && rounds_for_query > 0) {
+        round_trip_estimator.add_sample((timer_library.current_time_us() - query_start_time) / (double) rounds_for_query);
+    }
     curr_query_results.insert(message);
     //Clear the timeout, since we got a message
     timer_library.cancel_timer(query_timeout_timer);
@@ -26,7 +33,7 @@ void UtilityClient::handle_message(const std::shared_ptr<messaging::AggregationM
     }
     //If the query isn't finished, set a new timeout for the next result message
     if(!query_finished) {
-        query_timeout_timer = timer_library.register_timer(query_timeout_time,
+        query_timeout_timer = timer_library.register_timer(compute_timeout_time(),
                 [this](){
                     logger->debug("Utility timed out waiting for query {} after receiving {} messages", query_num, curr_query_results.size());
                     end_query();
@@ -48,22 +55,26 @@ void UtilityClient::start_query(const std::shared_ptr<messaging::QueryRequest>&
     curr_query_results.clear();
     logger->info("Starting query {}", query_num);
     query_finished = false;
-    for(int meter_id = 0; meter_id < num_meters; ++meter_id) {
-        network.send(query, meter_id);
-    }
+    std::vector<int> meter_ids(num_meters);
+    std::iota(meter_ids.begin(), meter_ids.end(), 0);
+    network.send(query, meter_ids);
     int log2n = std::ceil(std::log2(num_meters));
-    int rounds_for_query = 0;
+    //Overlay path lengths depend on the gossip base, but aggregation trees are always binary
+    int logkn = util::log_gossip_base(num_meters)
+            + util::padding_failure_rounds(num_meters, ProtocolState_t::FAILURES_TOLERATED);
+    rounds_for_query = 0;
     if(query_protocol == QueryProtocol::BFT) {
-        rounds_for_query = 6 * ProtocolState_t::FAILURES_TOLERATED + 3 * log2n * log2n + 3
+        rounds_for_query = 6 * ProtocolState_t::FAILURES_TOLERATED + 3 * logkn * log2n + 3
                 + (int) std::ceil(std::log2(num_meters / (double)(2 * ProtocolState_t::FAILURES_TOLERATED + 1)));
     } else if(query_protocol == QueryProtocol::HFT) {
-        rounds_for_query = 2 * log2n + 2 * ProtocolState_t::FAILURES_TOLERATED
+        rounds_for_query = 2 * logkn + 2 * ProtocolState_t::FAILURES_TOLERATED
                 + (int) std::ceil(std::log2(num_meters / (double)(ProtocolState_t::FAILURES_TOLERATED + 1)));
     } else if(query_protocol == QueryProtocol::CT) {
-        rounds_for_query = 2 * ProtocolState_t::FAILURES_TOLERATED + 4 * log2n + 2
+        rounds_for_query = 2 * ProtocolState_t::FAILURES_TOLERATED + 4 * logkn + 2
                 + (int) std::ceil(std::log2(num_meters / (double)(ProtocolState_t::FAILURES_TOLERATED + 1)));
     }
-    query_timeout_timer = timer_library.register_timer(rounds_for_query * NETWORK_ROUNDTRIP_TIMEOUT, [this](){
+    query_start_time = timer_library.current_time_us();
+    query_timeout_timer = timer_library.register_timer(rounds_for_query * round_trip_estimator.timeout(), [this](){
         logger->debug("Utility timed out waiting for query {} after receiving no messages", query_num);
         end_query();
     });
@@ -160,14 +171,19 @@ bool UtilityClient::deregister_query_callback(const int callback_id) {
     return num_removed == 1;
 }
 
-int UtilityClient::compute_timeout_time(const int num_meters) {
+/**
+ * @return The time (ms) to wait for the next result of a query, based on the
+ * number of messages it takes to aggregate up to the utility and the measured
+ * time per round.
+ */
+int UtilityClient::compute_timeout_time() const {
     int messages_for_aggregation = 0;
     if(query_protocol == QueryProtocol::BFT) {
         messages_for_aggregation = (int) std::ceil(std::log2((double) num_meters / (double)(2 * ProtocolState_t::FAILURES_TOLERATED + 1)));
     } else {
         messages_for_aggregation = (int) std::ceil(std::log2((double) num_meters / (double)(ProtocolState_t::FAILURES_TOLERATED + 1)));
     }
-    return messages_for_aggregation * NETWORK_ROUNDTRIP_TIMEOUT;
+    return messages_for_aggregation * round_trip_estimator.timeout();
 }
 } /* namespace psm */
 
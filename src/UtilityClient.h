@@ -11,6 +11,7 @@
 #include "messaging/SignatureRequest.h"
 #include "messaging/QueryRequest.h"
 #include "util/PointerUtil.h"
+#include "util/TimeoutEstimator.h"
 #include "ConfigurationIncludes.h"
 
 namespace pddm {
@@ -36,8 +37,13 @@ class UtilityClient {
         UtilityNetworkClient_t network;
         CryptoLibrary_t crypto_library;
         TimerManager_t timer_library;
-        /** Number of milliseconds to wait for a query timeout interval */
-        const int query_timeout_time;
+        /** Measures how long one round of the protocol takes, based on how
+         * long queries take to produce their first result. */
+        util::TimeoutEstimator round_trip_estimator;
+        /** The time (according to timer_library, in microseconds) at which the current query started */
+        long long query_start_time;
+        /** The number of rounds the current query should take in the worst case */
+        int rounds_for_query;
         /** Handle referring to the timer that was set to time-out the current query*/
         int query_timeout_timer;
         int query_num;
@@ -54,7 +60,7 @@ class UtilityClient {
                 util::ptr_comparator<messaging::QueryRequest, messaging::QueryNumGreater>
         >;
         query_priority_queue pending_batch_queries;
-        static int compute_timeout_time(const int num_meters);
+        int compute_timeout_time() const;
     public:
         UtilityClient(const int num_meters, const std::function<UtilityNetworkClient_t (UtilityClient&)>& network_builder,
                 const std::function<CryptoLibrary_t (UtilityClient&)>& crypto_library_builder,
@@ -64,7 +70,10 @@ class UtilityClient {
                     network(network_builder(*this)),
                     crypto_library(crypto_library_builder(*this)),
                     timer_library(timer_library_builder(*this)),
-                    query_timeout_time(compute_timeout_time(num_meters)),
+                    round_trip_estimator(NETWORK_ROUNDTRIP_TIMEOUT, NETWORK_ROUNDTRIP_TIMEOUT * MIN_ADAPTIVE_TIMEOUT_PERCENT / 100,
+                            MAX_ADAPTIVE_TIMEOUT),
+                    query_start_time(0),
+                    rounds_for_query(0),
                     query_timeout_timer(0),
                     query_num(-1),
                     query_finished(false) {}
@@ -101,7 +110,11 @@ class UtilityClient {
          * Obviously, this must be called from a separate thread from listen_loop().  */
         void shut_down();
 
-        /** The maximum time (ms) the utility is willing to wait on a network round-trip */
+        /** Lets the timer manager's builder add its event source to the network client's loop. */
+        UtilityNetworkClient_t& get_network_client() { return network; }
+
+        /** The time (ms) the utility is willing to wait on a network round-trip,
+         * before it has measured how long round-trips actually take */
         static constexpr int NETWORK_ROUNDTRIP_TIMEOUT = 100;
     private:
         void end_query();
@@ -7,7 +7,9 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include "messaging/QueryRequest.h"
 #include "messaging/SignatureResponse.h"
@@ -27,12 +29,25 @@ class UtilityNetworkClient {
          * @param recipient_id The ID of the recipient
          */
         virtual void send(const std::shared_ptr<messaging::QueryRequest>& message, const int recipient_id) = 0;
+        /**
+         * Sends the same query request message to several meters.
+         * @param message The message to send
+         * @param recipient_ids The IDs of the recipients
+         */
+        virtual void send(const std::shared_ptr<messaging::QueryRequest>& message, const std::vector<int>& recipient_ids) = 0;
         /**
          * Sends a signature response (blindly signed value) back to a meter.
          * @param message The message to send
          * @param recipient_id The ID of the recipient
          */
         virtual void send(const std::shared_ptr<messaging::SignatureResponse>& message, const int recipient_id) = 0;
+        /**
+         * Has the loop that receives messages call a function whenever a file
+         * descriptor becomes readable, like NetworkClient::add_event_source().
+         * @param fd The file descriptor to watch
+         * @param on_readable The function to call, which should read from fd
+         */
+        virtual void add_event_source(const int fd, std::function<void(void)> on_readable) = 0;
 };
 
 inline UtilityNetworkClient::~UtilityNetworkClient() { }
@@ -0,0 +1,144 @@
+/**
+ * @file AckCertificate.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "AckCertificate.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutils-serialization/SerializationSupport.hpp>
+
+#include "OpaqueBody.h"
+
+namespace pddm {
+namespace messaging {
+
+const constexpr MessageBodyType AckCertificate::type;
+
+void AckCertificate::merge(const AckCertificate& other) {
+    for(std::size_t i = 0; i < messages_sent.size() && i < other.messages_sent.size(); ++i) {
+        messages_sent[i] = std::max(messages_sent[i], other.messages_sent[i]);
+        messages_received[i] = std::max(messages_received[i], other.messages_received[i]);
+    }
+}
+
+bool AckCertificate::is_complete() const {
+    long total_sent = 0, total_received = 0;
+    for(std::size_t i = 0; i < messages_sent.size(); ++i) {
+        if(messages_sent[i] < 0 || messages_received[i] < 0)
+            return false;
+        total_sent += messages_sent[i];
+        total_received += messages_received[i];
+    }
+    return total_sent == total_received;
+}
+
+bool AckCertificate::holds_certificate(const MessageBody* body) {
+    if(body_cast<AckCertificate>(body)) {
+        return true;
+    }
+    auto* opaque_body = body_cast<OpaqueBody>(body);
+    return opaque_body != nullptr && opaque_body->body_type() == type;
+}
+
+std::shared_ptr<const AckCertificate> AckCertificate::from_body(const std::shared_ptr<MessageBody>& body) {
+    if(auto certificate = body_pointer_cast<AckCertificate>(body)) {
+        return certificate;
+    }
+    auto* opaque_body = body_cast<OpaqueBody>(body.get());
+    if(opaque_body != nullptr && opaque_body->body_type() == type) {
+        return std::static_pointer_cast<const AckCertificate>(opaque_body->decode());
+    }
+    return nullptr;
+}
+
+std::vector<char> AckCertificate::known_bitmap() const {
+    std::vector<char> bitmap((messages_sent.size() + 7) / 8, 0);
+    for(std::size_t i = 0; i < messages_sent.size(); ++i) {
+        if(is_known(i)) {
+            bitmap[i / 8] |= static_cast<char>(1 << (i % 8));
+        }
+    }
+    return bitmap;
+}
+
+std::size_t AckCertificate::to_bytes(char* buffer) const {
+    std::size_t bytes_written = 0;
+    bytes_written += mutils::to_bytes(type, buffer);
+    bytes_written += mutils::to_bytes(phase, buffer + bytes_written);
+    const int num_meters = messages_sent.size();
+    bytes_written += mutils::to_bytes(num_meters, buffer + bytes_written);
+    std::vector<char> bitmap = known_bitmap();
+    std::memcpy(buffer + bytes_written, bitmap.data(), bitmap.size());
+    bytes_written += bitmap.size();
+    for(std::size_t i = 0; i < messages_sent.size(); ++i) {
+        if(is_known(i)) {
+            bytes_written += mutils::to_bytes(messages_sent[i], buffer + bytes_written);
+            bytes_written += mutils::to_bytes(messages_received[i], buffer + bytes_written);
+        }
+    }
+    return bytes_written;
+}
+
+void AckCertificate::post_object(const std::function<void(const char* const, std::size_t)>& consumer_function) const {
+    mutils::post_object(consumer_function, type);
+    mutils::post_object(consumer_function, phase);
+    const int num_meters = messages_sent.size();
+    mutils::post_object(consumer_function, num_meters);
+    std::vector<char> bitmap = known_bitmap();
+    consumer_function(bitmap.data(), bitmap.size());
+    for(std::size_t i = 0; i < messages_sent.size(); ++i) {
+        if(is_known(i)) {
+            mutils::post_object(consumer_function, messages_sent[i]);
+            mutils::post_object(consumer_function, messages_received[i]);
+        }
+    }
+}
+
+std::size_t AckCertificate::bytes_size() const {
+    std::size_t num_known = 0;
+    for(std::size_t i = 0; i < messages_sent.size(); ++i) {
+        if(is_known(i))
+            ++num_known;
+    }
+    return mutils::bytes_size(type) + mutils::bytes_size(phase) + sizeof(int)
+            + (messages_sent.size() + 7) / 8 + num_known * 2 * sizeof(int);
+}
+
+std::unique_ptr<AckCertificate> AckCertificate::from_bytes(mutils::DeserializationManager<>* m, const char* buffer) {
+    std::size_t bytes_read = sizeof(type);
+    int phase;
+    std::memcpy(&phase, buffer + bytes_read, sizeof(phase));
+    bytes_read += sizeof(phase);
+    int num_meters;
+    std::memcpy(&num_meters, buffer + bytes_read, sizeof(num_meters));
+    bytes_read += sizeof(num_meters);
+    const char* bitmap = buffer + bytes_read;
+    bytes_read += (num_meters + 7) / 8;
+    auto certificate = std::make_unique<AckCertificate>(phase, num_meters);
+    for(int i = 0; i < num_meters; ++i) {
+        if(bitmap[i / 8] & (1 << (i % 8))) {
+            std::memcpy(&certificate->messages_sent[i], buffer + bytes_read, sizeof(int));
+            bytes_read += sizeof(int);
+            std::memcpy(&certificate->messages_received[i], buffer + bytes_read, sizeof(int));
+            bytes_read += sizeof(int);
+        }
+    }
+    return certificate;
+}
+
+std::ostream& operator<<(std::ostream& stream, const AckCertificate& cert) {
+    int known = 0;
+    for(std::size_t i = 0; i < cert.messages_sent.size(); ++i) {
+        if(cert.messages_sent[i] >= 0 && cert.messages_received[i] >= 0)
+            ++known;
+    }
+    return stream << "{AckCertificate: phase=" << cert.phase << ", " << known << "/"
+            << cert.messages_sent.size() << " meters known}";
+}
+
+} /* namespace messaging */
+} /* namespace pddm */
@@ -0,0 +1,105 @@
+/**
+ * @file AckCertificate.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <mutils-serialization/SerializationSupport.hpp>
+
+#include "MessageBody.h"
+#include "MessageBodyType.h"
+
+namespace pddm {
+namespace messaging {
+
+/**
+ * A compact summary of how many messages each meter originated and received
+ * during one phase of the protocol, which meters piggyback on their overlay
+ * traffic. Once every meter's counts are known and the total received equals
+ * the total sent, every message of the phase has been delivered, so the phase
+ * can end without waiting for its worst-case number of rounds.
+ *
+ * The counts are kept for every meter, but only the meters whose counts are
+ * known are serialized: a certificate is sent as a bitmap of those meters,
+ * followed by their counts, so it stays small while few meters are known.
+ */
+struct AckCertificate : public MessageBody {
+        static const constexpr MessageBodyType type = MessageBodyType::ACK_CERTIFICATE;
+        /** The phase these counts describe, as an integer chosen by the protocol */
+        int phase;
+        /** For each meter ID, the number of messages that meter originated in
+         * this phase, or -1 if it is not yet known. */
+        std::vector<int> messages_sent;
+        /** For each meter ID, the number of this phase's messages that meter
+         * has received as their final destination, or -1 if not yet known. */
+        std::vector<int> messages_received;
+
+        AckCertificate(const int phase, const int num_meters) :
+            phase(phase), messages_sent(num_meters, -1), messages_received(num_meters, -1) {}
+        AckCertificate(const int phase, const std::vector<int>& messages_sent, const std::vector<int>& messages_received) :
+            phase(phase), messages_sent(messages_sent), messages_received(messages_received) {}
+        virtual ~AckCertificate() = default;
+
+        /**
+         * Combines the counts in another certificate for the same phase into
+         * this one. Both counts only ever grow, so the larger one is newer.
+         * @param other Another certificate for the same phase
+         */
+        void merge(const AckCertificate& other);
+
+        /**
+         * @return True if every meter's counts are known and all the messages
+         * sent in this phase have been received.
+         */
+        bool is_complete() const;
+
+        /** @return True if either of a meter's counts is known */
+        bool is_known(const std::size_t meter_id) const {
+            return messages_sent[meter_id] >= 0 || messages_received[meter_id] >= 0;
+        }
+
+        /** @return One bit for each meter, in order, that is set if the meter's counts are known */
+        std::vector<char> known_bitmap() const;
+
+        /**
+         * @param body A message body, which may be null
+         * @return True if body is an AckCertificate, or an OpaqueBody view of one
+         */
+        static bool holds_certificate(const MessageBody* body);
+
+        /**
+         * Reads a certificate out of a message body, which may be an
+         * AckCertificate or an OpaqueBody view of one; certificates are kept
+         * opaque when they are received, and only decoded if they are needed.
+         * @param body A message body
+         * @return The certificate it holds, or null if it isn't one
+         */
+        static std::shared_ptr<const AckCertificate> from_body(const std::shared_ptr<MessageBody>& body);
+
+        MessageBodyType get_type() const { return type; }
+
+        inline bool operator==(const MessageBody& _rhs) const {
+            if (auto* rhs = body_cast<AckCertificate>(&_rhs))
+                return this->phase == rhs->phase && this->messages_sent == rhs->messages_sent
+                        && this->messages_received == rhs->messages_received;
+            else return false;
+        }
+
+        //Serialization support
+        std::size_t to_bytes(char* buffer) const override;
+        void post_object(const std::function<void (char const * const,std::size_t)>& consumer_function) const override;
+        std::size_t bytes_size() const override;
+        static std::unique_ptr<AckCertificate> from_bytes(mutils::DeserializationManager<>* m, char const * buffer);
+};
+
+std::ostream& operator<<(std::ostream& stream, const AckCertificate& cert);
+
+} /* namespace messaging */
+} /* namespace pddm */
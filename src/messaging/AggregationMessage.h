@@ -66,9 +66,10 @@ class AggregationMessageValue : public MessageBody {
             data = other.data;
             return *this;
         }
+        MessageBodyType get_type() const { return type; }
         //This is the only method that differs from std::vector<FixedPoint_t>
         inline bool operator==(const MessageBody& _rhs) const {
-            if (auto* rhs = dynamic_cast<const AggregationMessageValue*>(&_rhs))
+            if (auto* rhs = body_cast<AggregationMessageValue>(&_rhs))
                 return this->data == rhs->data;
             else return false;
         }
@@ -124,6 +125,7 @@ class AggregationMessage: public Message {
 
         friend bool operator==(const AggregationMessage& lhs, const AggregationMessage& rhs);
         friend struct std::hash<AggregationMessage>;
+        friend class CompactEncoding;
     private:
         //All-member constructor used only be deserialization
         AggregationMessage(const int sender_id, const int query_num,
@@ -7,6 +7,8 @@
 
 #include "AgreementValue.h"
 
+#include <vector>
+
 namespace pddm {
 namespace messaging {
 
@@ -34,9 +36,9 @@ std::size_t AgreementValue::to_bytes(char* buffer) const {
 
 void AgreementValue::post_object(const std::function<void (char const * const,std::size_t)>& consumer) const {
     //This avoids needing to rewrite MessageBodyType after caling post_object(signed_value)
-    char buffer[bytes_size()];
-    to_bytes(buffer);
-    consumer(buffer, bytes_size());
+    std::vector<char> buffer(bytes_size());
+    to_bytes(buffer.data());
+    consumer(buffer.data(), buffer.size());
 }
 
 std::unique_ptr<AgreementValue> AgreementValue::from_bytes(mutils::DeserializationManager<>* p, const char* buffer) {
@@ -31,8 +31,9 @@ struct AgreementValue : public MessageBody {
         AgreementValue(const SignedValue& signed_value, const int accepter_id, const util::SignatureArray& signature) :
             signed_value(signed_value), accepter_id(accepter_id), accepter_signature(signature) {}
         virtual ~AgreementValue() = default;
+        MessageBodyType get_type() const { return type; }
         inline bool operator==(const MessageBody& _rhs) const {
-            if (auto* rhs = dynamic_cast<const AgreementValue*>(&_rhs))
+            if (auto* rhs = body_cast<AgreementValue>(&_rhs))
                 return this->signed_value == rhs->signed_value
                         && this->accepter_id == rhs->accepter_id
                         && this->accepter_signature == rhs->accepter_signature;
@@ -0,0 +1,660 @@
+/**
+ * @file CompactEncoding.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "CompactEncoding.h"
+
+#include <cassert>
+#include <cstring>
+#include <memory_resource>
+#include <string>
+#include <utility>
+#include <mutils-serialization/SerializationSupport.hpp>
+
+#include "AckCertificate.h"
+#include "AggregationMessage.h"
+#include "AgreementValue.h"
+#include "FloodDigestMessage.h"
+#include "MulticastOverlayMessage.h"
+#include "OnionPacket.h"
+#include "OverlayTransportMessage.h"
+#include "PathOverlayMessage.h"
+#include "PingMessage.h"
+#include "QueryRequest.h"
+#include "SignatureRequest.h"
+#include "SignatureResponse.h"
+#include "SignedValue.h"
+#include "StringBody.h"
+#include "ValueContribution.h"
+
+namespace pddm {
+namespace messaging {
+
+namespace {
+//Bits of the flags byte in each type of message
+constexpr std::uint8_t IS_FINAL_MESSAGE_FLAG = 1;
+constexpr std::uint8_t IS_RESPONSE_FLAG = 1;
+constexpr std::uint8_t IS_ENCRYPTED_FLAG = 1;
+constexpr std::uint8_t FLOOD_FLAG = 2;
+constexpr std::uint8_t HAS_BODY_FLAG = 4;
+
+/** The longest a varint of a 64-bit value can be */
+constexpr std::size_t MAX_VARINT_BYTES = 10;
+
+/** A size prefix that has been reserved in the buffer, but not yet squeezed down to its varint */
+struct ReservedPrefix {
+    std::size_t position;
+    std::uint64_t size;
+    std::size_t length;
+};
+
+/** The size prefixes reserved on this thread since the outermost one that is still unfinished */
+struct ReservedPrefixes {
+    /** In the order they were reserved, which is the order of their positions */
+    std::vector<ReservedPrefix> prefixes;
+    std::size_t num_unfinished = 0;
+    /** The unused bytes of the finished prefixes, which will be squeezed out */
+    std::size_t bytes_saved = 0;
+};
+
+thread_local ReservedPrefixes reserved_prefixes;
+
+std::size_t varint_length(std::uint64_t value) {
+    std::size_t length = 1;
+    while(value >= 0x80) {
+        value >>= 7;
+        ++length;
+    }
+    return length;
+}
+
+template<typename EnumType>
+void write_type(const EnumType type, std::vector<char>& out) {
+    out.push_back(static_cast<char>(type));
+}
+}
+
+void CompactEncoding::write_varint(std::uint64_t value, std::vector<char>& out) {
+    while(value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void CompactEncoding::write_signed_varint(std::int64_t value, std::vector<char>& out) {
+    //Zigzag-encode the value so that small negative numbers are also short
+    write_varint((static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63), out);
+}
+
+std::uint64_t CompactEncoding::read_varint(const char*& buffer, const char* end) {
+    std::uint64_t value = 0;
+    for(unsigned int shift = 0; shift < 64; shift += 7) {
+        if(buffer >= end) {
+            throw DecodeError("Varint runs past the end of the message");
+        }
+        std::uint8_t byte = static_cast<std::uint8_t>(*buffer++);
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if(!(byte & 0x80)) {
+            break;
+        }
+    }
+    return value;
+}
+
+std::int64_t CompactEncoding::read_signed_varint(const char*& buffer, const char* end) {
+    std::uint64_t zigzag = read_varint(buffer, end);
+    return static_cast<std::int64_t>((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+}
+
+void CompactEncoding::insert_size_prefix(std::vector<char>& out, const std::size_t position) {
+    std::uint64_t size = out.size() - position;
+    char prefix[10];
+    std::size_t prefix_length = 0;
+    while(size >= 0x80) {
+        prefix[prefix_length++] = static_cast<char>((size & 0x7f) | 0x80);
+        size >>= 7;
+    }
+    prefix[prefix_length++] = static_cast<char>(size);
+    out.insert(out.begin() + position, prefix, prefix + prefix_length);
+}
+
+CompactEncoding::SizePrefix::SizePrefix(std::vector<char>& out) :
+        out(out),
+        index(reserved_prefixes.prefixes.size()),
+        bytes_saved_before(reserved_prefixes.bytes_saved) {
+    reserved_prefixes.prefixes.push_back(ReservedPrefix{out.size(), 0, 0});
+    ++reserved_prefixes.num_unfinished;
+    out.resize(out.size() + MAX_VARINT_BYTES);
+}
+
+CompactEncoding::SizePrefix::~SizePrefix() {
+    ReservedPrefix& prefix = reserved_prefixes.prefixes[index];
+    //Every prefix nested in this one has been finished, and will shrink by the bytes it saved
+    prefix.size = out.size() - prefix.position - MAX_VARINT_BYTES - (reserved_prefixes.bytes_saved - bytes_saved_before);
+    prefix.length = varint_length(prefix.size);
+    reserved_prefixes.bytes_saved += MAX_VARINT_BYTES - prefix.length;
+    if(--reserved_prefixes.num_unfinished > 0) {
+        return;
+    }
+    //Squeeze out the unused bytes of every prefix, moving each byte after the first prefix down once
+    std::size_t write_position = reserved_prefixes.prefixes.front().position;
+    std::size_t read_position = write_position;
+    for(const ReservedPrefix& reserved : reserved_prefixes.prefixes) {
+        std::memmove(out.data() + write_position, out.data() + read_position, reserved.position - read_position);
+        write_position += reserved.position - read_position;
+        std::uint64_t size = reserved.size;
+        while(size >= 0x80) {
+            out[write_position++] = static_cast<char>((size & 0x7f) | 0x80);
+            size >>= 7;
+        }
+        out[write_position++] = static_cast<char>(size);
+        read_position = reserved.position + MAX_VARINT_BYTES;
+    }
+    std::memmove(out.data() + write_position, out.data() + read_position, out.size() - read_position);
+    out.resize(write_position + out.size() - read_position);
+    reserved_prefixes.prefixes.clear();
+    reserved_prefixes.bytes_saved = 0;
+}
+
+void CompactEncoding::require_bytes(const char* buffer, const char* end, const std::size_t num_bytes) {
+    if(buffer > end || static_cast<std::size_t>(end - buffer) < num_bytes) {
+        throw DecodeError("Message needs " + std::to_string(num_bytes) + " more bytes than it has");
+    }
+}
+
+std::size_t CompactEncoding::read_count(const char*& buffer, const char* end, const std::size_t min_element_size) {
+    std::uint64_t count = read_varint(buffer, end);
+    if(count > static_cast<std::uint64_t>(end - buffer) / min_element_size) {
+        throw DecodeError("Count of " + std::to_string(count) + " elements is larger than the rest of the message");
+    }
+    return count;
+}
+
+template<typename IntList>
+void CompactEncoding::write_path(const IntList& path, std::vector<char>& out) {
+    write_varint(path.size(), out);
+    int previous_id = 0;
+    for(const int id : path) {
+        write_signed_varint(static_cast<std::int64_t>(id) - previous_id, out);
+        previous_id = id;
+    }
+}
+
+template<typename IntList>
+void CompactEncoding::read_path(const char*& buffer, const char* end, IntList& path) {
+    std::size_t length = read_count(buffer, end, 1);
+    int previous_id = 0;
+    for(std::size_t i = 0; i < length; ++i) {
+        previous_id += static_cast<int>(read_signed_varint(buffer, end));
+        path.push_back(previous_id);
+    }
+}
+
+template<typename BodyType, typename... Args>
+std::shared_ptr<BodyType> CompactEncoding::make_decoded(const SharedBuffer& source_buffer, Args&&... args) {
+    if(source_buffer) {
+        return allocate_in_arena<BodyType>(source_buffer, std::forward<Args>(args)...);
+    }
+    //We can't use the protected constructors with make_shared
+    return std::shared_ptr<BodyType>(new BodyType(std::forward<Args>(args)...));
+}
+
+template<typename FixedPointRange>
+void CompactEncoding::write_fixed_points(const FixedPointRange& values, std::vector<char>& out) {
+    write_varint(values.size(), out);
+    for(const FixedPoint_t& value : values) {
+        write_signed_varint(value.raw_value(), out);
+    }
+}
+
+std::vector<FixedPoint_t> CompactEncoding::read_fixed_points(const char*& buffer, const char* end) {
+    std::size_t num_values = read_count(buffer, end, 1);
+    std::vector<FixedPoint_t> values;
+    values.reserve(num_values);
+    for(std::size_t i = 0; i < num_values; ++i) {
+        values.emplace_back(FixedPoint_t::from_raw_value(read_signed_varint(buffer, end)));
+    }
+    return values;
+}
+
+void CompactEncoding::write_signature(const util::SignatureArray& signature, std::vector<char>& out) {
+    const char* signature_bytes = reinterpret_cast<const char*>(signature.data());
+    out.insert(out.end(), signature_bytes, signature_bytes + signature.size());
+}
+
+util::SignatureArray CompactEncoding::read_signature(const char*& buffer, const char* end) {
+    util::SignatureArray signature;
+    require_bytes(buffer, end, signature.size());
+    std::memcpy(signature.data(), buffer, signature.size());
+    buffer += signature.size();
+    return signature;
+}
+
+void CompactEncoding::write_overlay_common(const OverlayMessage& message, std::vector<char>& out) {
+    std::uint8_t flags = (message.is_encrypted ? IS_ENCRYPTED_FLAG : 0)
+            | (message.flood ? FLOOD_FLAG : 0)
+            | (message.body != nullptr ? HAS_BODY_FLAG : 0);
+    out.push_back(static_cast<char>(flags));
+    write_signed_varint(message.query_num, out);
+    write_signed_varint(message.destination, out);
+    if(message.body != nullptr) {
+        //Prefix the body with its size so a relay can keep it as an OpaqueBody without decoding it
+        SizePrefix body_size(out);
+        to_bytes(*message.body, out);
+    }
+}
+
+void CompactEncoding::read_overlay_common(OverlayMessage& message, const char*& buffer, const char* end,
+        const SharedBuffer& source_buffer) {
+    require_bytes(buffer, end, 1);
+    std::uint8_t flags = static_cast<std::uint8_t>(*buffer++);
+    message.is_encrypted = flags & IS_ENCRYPTED_FLAG;
+    message.flood = flags & FLOOD_FLAG;
+    message.query_num = read_signed_varint(buffer, end);
+    message.destination = read_signed_varint(buffer, end);
+    if(flags & HAS_BODY_FLAG) {
+        std::size_t body_size = read_count(buffer, end, 1);
+        const char* body_start = buffer;
+        message.body = body_from_bytes(buffer, body_size, source_buffer);
+        buffer = body_start + body_size;
+    }
+}
+
+void CompactEncoding::write_value_contribution(const ValueContribution& value, std::vector<char>& out) {
+    write_signed_varint(value.value.query_num, out);
+    write_fixed_points(value.value.value, out);
+    write_varint(value.value.proxies.size(), out);
+    for(const int proxy : value.value.proxies) {
+        write_signed_varint(proxy, out);
+    }
+    write_signature(value.signature, out);
+}
+
+std::shared_ptr<ValueContribution> CompactEncoding::read_value_contribution(const char*& buffer, const char* end) {
+    int query_num = read_signed_varint(buffer, end);
+    std::vector<FixedPoint_t> values = read_fixed_points(buffer, end);
+    std::vector<int> proxies(read_count(buffer, end, 1));
+    for(auto& proxy : proxies) {
+        proxy = read_signed_varint(buffer, end);
+    }
+    util::SignatureArray signature = read_signature(buffer, end);
+    return std::make_shared<ValueContribution>(ValueTuple(query_num, values, proxies), signature);
+}
+
+void CompactEncoding::write_signed_value(const SignedValue& value, std::vector<char>& out) {
+    write_value_contribution(*value.value, out);
+    write_varint(value.signatures.size(), out);
+    //The map is sorted by meter ID, so the differences between IDs are small and positive
+    int previous_id = 0;
+    for(const auto& id_signature : value.signatures) {
+        write_signed_varint(static_cast<std::int64_t>(id_signature.first) - previous_id, out);
+        write_signature(id_signature.second, out);
+        previous_id = id_signature.first;
+    }
+}
+
+SignedValue CompactEncoding::read_signed_value(const char*& buffer, const char* end) {
+    std::shared_ptr<ValueContribution> value = read_value_contribution(buffer, end);
+    std::size_t num_signatures = read_count(buffer, end, 1 + sizeof(util::SignatureArray));
+    std::map<int, util::SignatureArray> signatures;
+    int previous_id = 0;
+    for(std::size_t i = 0; i < num_signatures; ++i) {
+        previous_id += static_cast<int>(read_signed_varint(buffer, end));
+        signatures.emplace_hint(signatures.end(), previous_id, read_signature(buffer, end));
+    }
+    return SignedValue(value, signatures);
+}
+
+template<typename MessageType>
+void CompactEncoding::write_mutils(const MessageType& message, std::vector<char>& out) {
+    write_type(MessageType::type, out);
+    std::size_t message_start = out.size();
+    out.resize(message_start + mutils::bytes_size(message));
+    mutils::to_bytes(message, out.data() + message_start);
+}
+
+void CompactEncoding::to_bytes(const OverlayTransportMessage& message, std::vector<char>& out) {
+    write_type(OverlayTransportMessage::type, out);
+    out.push_back(static_cast<char>(message.is_final_message ? IS_FINAL_MESSAGE_FLAG : 0));
+    write_signed_varint(message.sender_id, out);
+    write_signed_varint(message.sender_round, out);
+    to_bytes(*message.body, out);
+}
+
+void CompactEncoding::to_bytes(const PingMessage& message, std::vector<char>& out) {
+    write_type(PingMessage::type, out);
+    out.push_back(static_cast<char>(message.is_response ? IS_RESPONSE_FLAG : 0));
+    write_signed_varint(message.sender_id, out);
+}
+
+void CompactEncoding::to_bytes(const FloodDigestMessage& message, std::vector<char>& out) {
+    write_type(FloodDigestMessage::type, out);
+    write_signed_varint(message.sender_id, out);
+    write_signed_varint(message.query_num, out);
+    write_signed_varint(message.round, out);
+    //The filter's bits are random, so they are no shorter as varints
+    write_varint(message.filter.size(), out);
+    const char* filter_bytes = reinterpret_cast<const char*>(message.filter.data());
+    out.insert(out.end(), filter_bytes, filter_bytes + message.filter.size() * sizeof(std::uint64_t));
+}
+
+void CompactEncoding::to_bytes(const AggregationMessage& message, std::vector<char>& out) {
+    write_type(AggregationMessage::type, out);
+    write_signed_varint(message.sender_id, out);
+    write_signed_varint(message.query_num, out);
+    write_signed_varint(message.num_contributors, out);
+    write_fixed_points(*message.get_body(), out);
+}
+
+void CompactEncoding::to_bytes(const QueryRequest& message, std::vector<char>& out) {
+    write_mutils(message, out);
+}
+
+void CompactEncoding::to_bytes(const SignatureRequest& message, std::vector<char>& out) {
+    write_mutils(message, out);
+}
+
+void CompactEncoding::to_bytes(const SignatureResponse& message, std::vector<char>& out) {
+    write_mutils(message, out);
+}
+
+void CompactEncoding::to_bytes(const MessageBody& body, std::vector<char>& out) {
+    switch(body.get_type()) {
+    case MessageBodyType::OPAQUE: {
+        const auto& opaque_body = static_cast<const OpaqueBody&>(body);
+        if(opaque_body.wire_format() == WireFormat::COMPACT) {
+            out.insert(out.end(), opaque_body.data(), opaque_body.data() + opaque_body.size());
+        } else {
+            to_bytes(*opaque_body.decode(), out);
+        }
+        break;
+    }
+    case MessageBodyType::PATH_OVERLAY: {
+        const auto& pom_body = static_cast<const PathOverlayMessage&>(body);
+        write_type(PathOverlayMessage::type, out);
+        write_path(pom_body.remaining_path, out);
+        write_overlay_common(pom_body, out);
+        break;
+    }
+    case MessageBodyType::MULTICAST_OVERLAY: {
+        const auto& mom_body = static_cast<const MulticastOverlayMessage&>(body);
+        write_type(MulticastOverlayMessage::type, out);
+        write_varint(mom_body.remaining_paths.size(), out);
+        for(const auto& path : mom_body.remaining_paths) {
+            write_path(path, out);
+        }
+        //Each path's body is prefixed with its size, which is 0 if it has none, like an overlay message's body
+        for(const auto& path_body : mom_body.path_bodies) {
+            SizePrefix body_size(out);
+            if(path_body != nullptr) {
+                to_bytes(*path_body, out);
+            }
+        }
+        write_overlay_common(mom_body, out);
+        break;
+    }
+    case MessageBodyType::OVERLAY:
+        write_type(OverlayMessage::type, out);
+        write_overlay_common(static_cast<const OverlayMessage&>(body), out);
+        break;
+    case MessageBodyType::ONION_PACKET: {
+        //The header and payload must keep their exact bytes, since they are encrypted
+        const auto& onion_body = static_cast<const OnionPacket&>(body);
+        write_type(OnionPacket::type, out);
+        out.insert(out.end(), onion_body.header.begin(), onion_body.header.end());
+        write_varint(onion_body.payload.size(), out);
+        out.insert(out.end(), onion_body.payload.data(), onion_body.payload.data() + onion_body.payload.size());
+        break;
+    }
+    case MessageBodyType::VALUE_CONTRIBUTION:
+        write_type(ValueContribution::type, out);
+        write_value_contribution(static_cast<const ValueContribution&>(body), out);
+        break;
+    case MessageBodyType::SIGNED_VALUE:
+        write_type(SignedValue::type, out);
+        write_signed_value(static_cast<const SignedValue&>(body), out);
+        break;
+    case MessageBodyType::AGREEMENT_VALUE: {
+        const auto& av_body = static_cast<const AgreementValue&>(body);
+        write_type(AgreementValue::type, out);
+        write_signed_value(av_body.signed_value, out);
+        write_signed_varint(av_body.accepter_id, out);
+        write_signature(av_body.accepter_signature, out);
+        break;
+    }
+    case MessageBodyType::ACK_CERTIFICATE: {
+        const auto& cert_body = static_cast<const AckCertificate&>(body);
+        write_type(AckCertificate::type, out);
+        write_signed_varint(cert_body.phase, out);
+        //Only the meters whose counts are known are written, after a bitmap of which ones they are
+        write_varint(cert_body.messages_sent.size(), out);
+        std::vector<char> bitmap = cert_body.known_bitmap();
+        out.insert(out.end(), bitmap.begin(), bitmap.end());
+        for(std::size_t i = 0; i < cert_body.messages_sent.size(); ++i) {
+            if(cert_body.is_known(i)) {
+                write_signed_varint(cert_body.messages_sent[i], out);
+                write_signed_varint(cert_body.messages_received[i], out);
+            }
+        }
+        break;
+    }
+    case MessageBodyType::AGGREGATION_VALUE:
+        write_type(AggregationMessageValue::type, out);
+        write_fixed_points(static_cast<const AggregationMessageValue&>(body), out);
+        break;
+    case MessageBodyType::STRING: {
+        const auto& string_body = static_cast<const StringBody&>(body);
+        write_type(StringBody::type, out);
+        write_varint(string_body.size(), out);
+        out.insert(out.end(), string_body.c_str(), string_body.c_str() + string_body.size());
+        break;
+    }
+    default:
+        assert(false && "CompactEncoding can't encode a MessageBody of an unknown type!");
+        break;
+    }
+}
+
+std::shared_ptr<MessageBody> CompactEncoding::body_from_bytes(const char*& buffer, const std::size_t body_size,
+        const SharedBuffer& source_buffer) {
+    const char* end = buffer + body_size;
+    require_bytes(buffer, end, 1);
+    MessageBodyType type = static_cast<MessageBodyType>(static_cast<std::uint8_t>(*buffer));
+    //OPAQUE is never written, since an OpaqueBody is written as the body it contains
+    if(type >= MessageBodyType::OPAQUE) {
+        throw DecodeError("Compact MessageBody has an unknown type " + std::to_string(static_cast<int>(type)));
+    }
+    //Keep the same kinds of bodies as views as OpaqueBody::view does
+    if(source_buffer && type != MessageBodyType::OVERLAY && type != MessageBodyType::PATH_OVERLAY
+            && type != MessageBodyType::MULTICAST_OVERLAY && type != MessageBodyType::ONION_PACKET) {
+        auto view = allocate_in_arena<OpaqueBody>(source_buffer, source_buffer, buffer - source_buffer->data(), body_size,
+                WireFormat::COMPACT);
+        buffer += body_size;
+        return view;
+    }
+    buffer++;
+    switch(type) {
+    case MessageBodyType::OVERLAY: {
+        auto message = make_decoded<OverlayMessage>(source_buffer);
+        read_overlay_common(*message, buffer, end, source_buffer);
+        return message;
+    }
+    case MessageBodyType::PATH_OVERLAY: {
+        auto message = make_decoded<PathOverlayMessage>(source_buffer,
+                source_buffer ? source_buffer->resource() : std::pmr::get_default_resource());
+        read_path(buffer, end, message->remaining_path);
+        read_overlay_common(*message, buffer, end, source_buffer);
+        return message;
+    }
+    case MessageBodyType::MULTICAST_OVERLAY: {
+        auto message = make_decoded<MulticastOverlayMessage>(source_buffer,
+                source_buffer ? source_buffer->resource() : std::pmr::get_default_resource());
+        message->remaining_paths.resize(read_count(buffer, end, 1));
+        for(auto& path : message->remaining_paths) {
+            read_path(buffer, end, path);
+        }
+        message->path_bodies.resize(message->remaining_paths.size());
+        for(auto& path_body : message->path_bodies) {
+            std::size_t path_body_size = read_count(buffer, end, 1);
+            const char* path_body_start = buffer;
+            if(path_body_size > 0) {
+                path_body = body_from_bytes(buffer, path_body_size, source_buffer);
+            }
+            buffer = path_body_start + path_body_size;
+        }
+        read_overlay_common(*message, buffer, end, source_buffer);
+        return message;
+    }
+    case MessageBodyType::ONION_PACKET: {
+        const char* header_start = buffer;
+        require_bytes(buffer, end, OnionPacket::HEADER_SIZE);
+        buffer += OnionPacket::HEADER_SIZE;
+        std::size_t payload_size = read_count(buffer, end, 1);
+        const char* payload_start = buffer;
+        buffer += payload_size;
+        //The payload is encrypted, so it stays in the format it was built in rather than the wire format
+        if(source_buffer) {
+            return allocate_in_arena<OnionPacket>(source_buffer, header_start,
+                    OpaqueBody(source_buffer, payload_start - source_buffer->data(), payload_size));
+        }
+        return std::make_shared<OnionPacket>(header_start, OpaqueBody(std::vector<char>(payload_start, buffer)));
+    }
+    case MessageBodyType::VALUE_CONTRIBUTION:
+        return read_value_contribution(buffer, end);
+    case MessageBodyType::SIGNED_VALUE:
+        return std::make_shared<SignedValue>(read_signed_value(buffer, end));
+    case MessageBodyType::AGREEMENT_VALUE: {
+        SignedValue signed_value = read_signed_value(buffer, end);
+        int accepter_id = read_signed_varint(buffer, end);
+        return std::make_shared<AgreementValue>(signed_value, accepter_id, read_signature(buffer, end));
+    }
+    case MessageBodyType::ACK_CERTIFICATE: {
+        int phase = read_signed_varint(buffer, end);
+        std::uint64_t num_meters = read_varint(buffer, end);
+        //Each meter has a bit in the bitmap
+        if(num_meters > static_cast<std::uint64_t>(end - buffer) * 8) {
+            throw DecodeError("AckCertificate's bitmap is larger than the rest of the message");
+        }
+        const char* bitmap = buffer;
+        buffer += (num_meters + 7) / 8;
+        auto certificate = std::make_shared<AckCertificate>(phase, num_meters);
+        for(std::size_t i = 0; i < num_meters; ++i) {
+            if(bitmap[i / 8] & (1 << (i % 8))) {
+                certificate->messages_sent[i] = read_signed_varint(buffer, end);
+                certificate->messages_received[i] = read_signed_varint(buffer, end);
+            }
+        }
+        return certificate;
+    }
+    case MessageBodyType::AGGREGATION_VALUE:
+        return std::make_shared<AggregationMessageValue>(read_fixed_points(buffer, end));
+    case MessageBodyType::STRING: {
+        std::size_t length = read_count(buffer, end, 1);
+        std::string data(buffer, length);
+        buffer += length;
+        return std::make_shared<StringBody>(std::move(data));
+    }
+    default:
+        throw DecodeError("Compact MessageBody has a type that can't be decoded: " + std::to_string(static_cast<int>(type)));
+    }
+}
+
+void CompactEncoding::read_transport_fields(const char*& buffer, const char* end, bool& is_final_message,
+        int& sender_id, int& sender_round) {
+    require_bytes(buffer, end, 2);
+    const std::uint8_t flags = static_cast<std::uint8_t>(buffer[1]);
+    buffer += 2;
+    is_final_message = flags & IS_FINAL_MESSAGE_FLAG;
+    sender_id = read_signed_varint(buffer, end);
+    sender_round = read_signed_varint(buffer, end);
+    //An OverlayTransportMessage can only carry some kind of OverlayMessage
+    require_bytes(buffer, end, 1);
+    const MessageBodyType body_type = static_cast<MessageBodyType>(static_cast<std::uint8_t>(*buffer));
+    if(body_type != MessageBodyType::OVERLAY && body_type != MessageBodyType::PATH_OVERLAY
+            && body_type != MessageBodyType::MULTICAST_OVERLAY) {
+        throw DecodeError("OverlayTransportMessage has a body of type " + std::to_string(static_cast<int>(body_type)));
+    }
+}
+
+template<>
+std::unique_ptr<OverlayTransportMessage> CompactEncoding::from_bytes(const char* buffer, const std::size_t size) {
+    const char* cursor = buffer;
+    const char* end = buffer + size;
+    bool is_final_message;
+    int sender_id, sender_round;
+    read_transport_fields(cursor, end, is_final_message, sender_id, sender_round);
+    auto body = std::static_pointer_cast<OverlayMessage>(body_from_bytes(cursor, end - cursor));
+    return std::make_unique<OverlayTransportMessage>(sender_id, sender_round, is_final_message, body);
+}
+
+std::shared_ptr<OverlayTransportMessage> CompactEncoding::view_from_bytes(const char* buffer, const std::size_t size,
+        const SharedBuffer& source_buffer) {
+    const char* cursor = buffer;
+    const char* end = buffer + size;
+    bool is_final_message;
+    int sender_id, sender_round;
+    read_transport_fields(cursor, end, is_final_message, sender_id, sender_round);
+    auto body = std::static_pointer_cast<OverlayMessage>(body_from_bytes(cursor, end - cursor, source_buffer));
+    return allocate_in_arena<OverlayTransportMessage>(source_buffer, sender_id, sender_round, is_final_message, body);
+}
+
+template<>
+std::unique_ptr<PingMessage> CompactEncoding::from_bytes(const char* buffer, const std::size_t size) {
+    const char* end = buffer + size;
+    require_bytes(buffer, end, 2);
+    const char* cursor = buffer + 1;
+    std::uint8_t flags = static_cast<std::uint8_t>(*cursor++);
+    int sender_id = read_signed_varint(cursor, end);
+    return std::make_unique<PingMessage>(sender_id, flags & IS_RESPONSE_FLAG);
+}
+
+template<>
+std::unique_ptr<FloodDigestMessage> CompactEncoding::from_bytes(const char* buffer, const std::size_t size) {
+    const char* end = buffer + size;
+    require_bytes(buffer, end, 1);
+    const char* cursor = buffer + 1;
+    int sender_id = read_signed_varint(cursor, end);
+    int query_num = read_signed_varint(cursor, end);
+    int round = read_signed_varint(cursor, end);
+    std::vector<std::uint64_t> filter(read_count(cursor, end, sizeof(std::uint64_t)));
+    std::memcpy(filter.data(), cursor, filter.size() * sizeof(std::uint64_t));
+    return std::make_unique<FloodDigestMessage>(sender_id, query_num, round, std::move(filter));
+}
+
+template<>
+std::unique_ptr<AggregationMessage> CompactEncoding::from_bytes(const char* buffer, const std::size_t size) {
+    const char* end = buffer + size;
+    require_bytes(buffer, end, 1);
+    const char* cursor = buffer + 1;
+    int sender_id = read_signed_varint(cursor, end);
+    int query_num = read_signed_varint(cursor, end);
+    int num_contributors = read_signed_varint(cursor, end);
+    auto value = std::make_shared<AggregationMessageValue>(read_fixed_points(cursor, end));
+    //We can't use the private constructor with make_unique
+    return std::unique_ptr<AggregationMessage>(new AggregationMessage(sender_id, query_num, value, num_contributors));
+}
+
+template<>
+std::unique_ptr<QueryRequest> CompactEncoding::from_bytes(const char* buffer, const std::size_t size) {
+    require_bytes(buffer, buffer + size, 1);
+    return QueryRequest::from_bytes(nullptr, buffer + 1);
+}
+
+template<>
+std::unique_ptr<SignatureRequest> CompactEncoding::from_bytes(const char* buffer, const std::size_t size) {
+    require_bytes(buffer, buffer + size, 1);
+    return SignatureRequest::from_bytes(nullptr, buffer + 1);
+}
+
+template<>
+std::unique_ptr<SignatureResponse> CompactEncoding::from_bytes(const char* buffer, const std::size_t size) {
+    require_bytes(buffer, buffer + size, 1);
+    return SignatureResponse::from_bytes(nullptr, buffer + 1);
+}
+
+} /* namespace messaging */
+} /* namespace pddm */
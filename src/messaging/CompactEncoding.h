@@ -0,0 +1,203 @@
+/**
+ * @file CompactEncoding.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "../FixedPoint_t.h"
+#include "../util/CryptoLibrary.h"
+#include "MessageBody.h"
+#include "OpaqueBody.h"
+#include "WireFormat.h"
+
+namespace pddm {
+namespace messaging {
+
+class AggregationMessage;
+class FloodDigestMessage;
+class OverlayMessage;
+class OverlayTransportMessage;
+class PingMessage;
+class QueryRequest;
+class SignatureRequest;
+class SignatureResponse;
+class SignedValue;
+struct ValueContribution;
+
+/**
+ * Implements WireFormat::COMPACT, an alternative to the mutils serialization
+ * for messages sent over metered links. Integers that are usually small (IDs,
+ * counts, round and query numbers, and fixed-point values) are written as
+ * varints, zigzag-encoded if they may be negative; boolean fields are packed
+ * into a flags byte; paths are written as the first meter ID followed by the
+ * difference between each ID and the previous one; and message types take one
+ * byte instead of two. Signatures and onion contents are written unchanged.
+ *
+ * Unlike the mutils functions, which write into a buffer the caller has sized
+ * with bytes_size(), these functions append to a vector, so each message is
+ * only traversed once. Messages that are only exchanged with the utility once
+ * per query (QueryRequest, SignatureRequest and SignatureResponse) are written
+ * as their type followed by their mutils serialization.
+ *
+ * The decoding functions never read past the end of the bytes they are
+ * given: every count and length is checked against the bytes that remain,
+ * and a message that doesn't fit, or that has a type tag this build doesn't
+ * know, is rejected by throwing a DecodeError.
+ */
+class CompactEncoding {
+    public:
+        static void write_varint(std::uint64_t value, std::vector<char>& out);
+        static void write_signed_varint(std::int64_t value, std::vector<char>& out);
+        /**
+         * Reads a varint, advancing the buffer pointer past it.
+         * @param buffer A pointer to the varint, which will be advanced
+         * @param end The end of the bytes that can be read
+         * @return The value
+         * @throws DecodeError if the varint runs past end
+         */
+        static std::uint64_t read_varint(const char*& buffer, const char* end);
+        static std::int64_t read_signed_varint(const char*& buffer, const char* end);
+        /**
+         * Inserts the size of everything written to out since the given
+         * position as a varint at that position, so that a size prefix can be
+         * written after the data it describes.
+         * @param out The buffer being written
+         * @param position The position in out at which the sized data starts
+         */
+        static void insert_size_prefix(std::vector<char>& out, const std::size_t position);
+
+        static void to_bytes(const OverlayTransportMessage& message, std::vector<char>& out);
+        static void to_bytes(const PingMessage& message, std::vector<char>& out);
+        static void to_bytes(const FloodDigestMessage& message, std::vector<char>& out);
+        static void to_bytes(const AggregationMessage& message, std::vector<char>& out);
+        static void to_bytes(const QueryRequest& message, std::vector<char>& out);
+        static void to_bytes(const SignatureRequest& message, std::vector<char>& out);
+        static void to_bytes(const SignatureResponse& message, std::vector<char>& out);
+        /**
+         * Appends any MessageBody to a buffer, including its type.
+         * @param body The body to write
+         * @param out The buffer to append it to
+         */
+        static void to_bytes(const MessageBody& body, std::vector<char>& out);
+
+        /**
+         * Decodes a message of a known type from a buffer. This is specialized
+         * for each type of message that can be sent between meters.
+         * @param buffer The encoded message, starting with its type
+         * @param size The number of bytes in the encoded message
+         * @return The decoded message
+         * @throws DecodeError if the bytes are not a valid message
+         */
+        template<typename MessageType>
+        static std::unique_ptr<MessageType> from_bytes(const char* buffer, const std::size_t size);
+
+        /**
+         * Decodes an OverlayTransportMessage from a received frame, keeping
+         * the parts that a relay does not need to read as OpaqueBody views of
+         * the frame and allocating the rest in the frame's arena.
+         * @param buffer The encoded message, starting with its type
+         * @param size The number of bytes in the encoded message
+         * @param source_buffer The receive buffer that contains buffer
+         * @return The decoded message, which keeps source_buffer alive
+         * @throws DecodeError if the bytes are not a valid message
+         */
+        static std::shared_ptr<OverlayTransportMessage> view_from_bytes(const char* buffer, const std::size_t size,
+                const SharedBuffer& source_buffer);
+
+        /**
+         * Decodes any MessageBody, advancing the buffer pointer past it.
+         * @param buffer A pointer to the encoded body, which will be advanced
+         * to the end of the body
+         * @param body_size The number of bytes in the encoded body
+         * @param source_buffer The receive buffer that contains buffer, if
+         * any; if provided, the body is decoded as in OpaqueBody::view.
+         * @return The decoded body, or an OpaqueBody view of it
+         * @throws DecodeError if the bytes are not a valid body
+         */
+        static std::shared_ptr<MessageBody> body_from_bytes(const char*& buffer, const std::size_t body_size,
+                const SharedBuffer& source_buffer = nullptr);
+
+    private:
+        /**
+         * Writes the size of the bytes written to a buffer during its lifetime
+         * as a varint in front of them, for bodies that are nested inside
+         * other messages. Each prefix reserves the longest possible varint
+         * when it is created, and the size is filled in when it is destroyed;
+         * once the outermost prefix is finished, the unused bytes of every
+         * reserved prefix are squeezed out in a single pass over the buffer.
+         * So each byte of a deeply nested body is moved once, instead of once
+         * per level as it would be by insert_size_prefix.
+         */
+        class SizePrefix {
+            private:
+                std::vector<char>& out;
+                /** The index of this prefix among those reserved since the outermost one */
+                std::size_t index;
+                /** The bytes saved by the prefixes already finished when this one was reserved */
+                std::size_t bytes_saved_before;
+            public:
+                SizePrefix(std::vector<char>& out);
+                ~SizePrefix();
+                SizePrefix(const SizePrefix&) = delete;
+                SizePrefix& operator=(const SizePrefix&) = delete;
+        };
+        /** Throws a DecodeError unless at least num_bytes bytes remain before end */
+        static void require_bytes(const char* buffer, const char* end, const std::size_t num_bytes);
+        /**
+         * Reads the number of elements in a list, checking that that many
+         * elements of at least min_element_size bytes each could fit in the
+         * bytes that remain, so a corrupt count can't cause a huge allocation.
+         */
+        static std::size_t read_count(const char*& buffer, const char* end, const std::size_t min_element_size);
+        template<typename IntList>
+        static void write_path(const IntList& path, std::vector<char>& out);
+        template<typename IntList>
+        static void read_path(const char*& buffer, const char* end, IntList& path);
+        /** Constructs a decoded body in source_buffer's arena, or on the heap if there is no source_buffer */
+        template<typename BodyType, typename... Args>
+        static std::shared_ptr<BodyType> make_decoded(const SharedBuffer& source_buffer, Args&&... args);
+        template<typename FixedPointRange>
+        static void write_fixed_points(const FixedPointRange& values, std::vector<char>& out);
+        static std::vector<FixedPoint_t> read_fixed_points(const char*& buffer, const char* end);
+        static void write_signature(const util::SignatureArray& signature, std::vector<char>& out);
+        static util::SignatureArray read_signature(const char*& buffer, const char* end);
+        static void write_overlay_common(const OverlayMessage& message, std::vector<char>& out);
+        static void read_overlay_common(OverlayMessage& message, const char*& buffer, const char* end,
+                const SharedBuffer& source_buffer);
+        static void write_value_contribution(const ValueContribution& value, std::vector<char>& out);
+        static std::shared_ptr<ValueContribution> read_value_contribution(const char*& buffer, const char* end);
+        static void write_signed_value(const SignedValue& value, std::vector<char>& out);
+        static SignedValue read_signed_value(const char*& buffer, const char* end);
+        /** Reads the type and the fields that every OverlayTransportMessage has, up to its body */
+        static void read_transport_fields(const char*& buffer, const char* end, bool& is_final_message,
+                int& sender_id, int& sender_round);
+        template<typename MessageType>
+        static void write_mutils(const MessageType& message, std::vector<char>& out);
+};
+
+template<>
+std::unique_ptr<OverlayTransportMessage> CompactEncoding::from_bytes(const char* buffer, const std::size_t size);
+template<>
+std::unique_ptr<PingMessage> CompactEncoding::from_bytes(const char* buffer, const std::size_t size);
+template<>
+std::unique_ptr<FloodDigestMessage> CompactEncoding::from_bytes(const char* buffer, const std::size_t size);
+template<>
+std::unique_ptr<AggregationMessage> CompactEncoding::from_bytes(const char* buffer, const std::size_t size);
+template<>
+std::unique_ptr<QueryRequest> CompactEncoding::from_bytes(const char* buffer, const std::size_t size);
+template<>
+std::unique_ptr<SignatureRequest> CompactEncoding::from_bytes(const char* buffer, const std::size_t size);
+template<>
+std::unique_ptr<SignatureResponse> CompactEncoding::from_bytes(const char* buffer, const std::size_t size);
+
+} /* namespace messaging */
+} /* namespace pddm */
@@ -0,0 +1,89 @@
+/**
+ * @file FloodDigestMessage.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "FloodDigestMessage.h"
+
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+
+namespace pddm {
+namespace messaging {
+
+const constexpr MessageType FloodDigestMessage::type;
+const constexpr int FloodDigestMessage::FILTER_HASHES;
+
+bool FloodDigestMessage::might_hold(const std::uint64_t message_id) const {
+    if(filter.empty()) {
+        return false;
+    }
+    for(int i = 0; i < FILTER_HASHES; ++i) {
+        const std::size_t bit = filter_bit(message_id, i, filter.size());
+        if(!(filter[bit / 64] & (std::uint64_t(1) << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::size_t FloodDigestMessage::bytes_size() const {
+    return mutils::bytes_size(type) +
+            mutils::bytes_size(sender_id) +
+            mutils::bytes_size(query_num) +
+            mutils::bytes_size(round) +
+            mutils::bytes_size(filter);
+}
+
+//Like PingMessage, this completely overrides Message::to_bytes, since there is no body
+std::size_t FloodDigestMessage::to_bytes(char* buffer) const {
+    std::size_t bytes_written = 0;
+    std::memcpy(buffer+bytes_written, &type, sizeof(MessageType));
+    bytes_written += sizeof(MessageType);
+    std::memcpy(buffer+bytes_written, &sender_id, sizeof(sender_id));
+    bytes_written += sizeof(sender_id);
+    std::memcpy(buffer+bytes_written, &query_num, sizeof(query_num));
+    bytes_written += sizeof(query_num);
+    std::memcpy(buffer+bytes_written, &round, sizeof(round));
+    bytes_written += sizeof(round);
+    bytes_written += mutils::to_bytes(filter, buffer + bytes_written);
+    return bytes_written;
+}
+
+void FloodDigestMessage::post_object(const std::function<void(const char*, std::size_t)>& consumer) const {
+    mutils::post_object(consumer, type);
+    mutils::post_object(consumer, sender_id);
+    mutils::post_object(consumer, query_num);
+    mutils::post_object(consumer, round);
+    mutils::post_object(consumer, filter);
+}
+
+std::unique_ptr<FloodDigestMessage> FloodDigestMessage::from_bytes(mutils::DeserializationManager<>* m, const char* buffer) {
+    std::size_t bytes_read = 0;
+    MessageType message_type;
+    std::memcpy(&message_type, buffer + bytes_read, sizeof(MessageType));
+    bytes_read += sizeof(MessageType);
+    assert(message_type == MessageType::FLOOD_DIGEST);
+    int sender_id;
+    std::memcpy(&sender_id, buffer + bytes_read, sizeof(int));
+    bytes_read += sizeof(int);
+    int query_num;
+    std::memcpy(&query_num, buffer + bytes_read, sizeof(int));
+    bytes_read += sizeof(int);
+    int round;
+    std::memcpy(&round, buffer + bytes_read, sizeof(int));
+    bytes_read += sizeof(int);
+    std::unique_ptr<std::vector<std::uint64_t>> filter = mutils::from_bytes<std::vector<std::uint64_t>>(m, buffer + bytes_read);
+    return std::make_unique<FloodDigestMessage>(sender_id, query_num, round, std::move(*filter));
+}
+
+std::ostream& operator<< (std::ostream& out, const FloodDigestMessage& message) {
+    return out << "Flood digest from " << message.sender_id << " for query " << message.query_num
+            << ", round " << message.round << ": " << message.filter.size() * 64 << "-bit filter";
+}
+
+}
+}
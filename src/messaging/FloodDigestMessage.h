@@ -0,0 +1,107 @@
+/**
+ * @file FloodDigestMessage.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "../Configuration.h"
+#include "Message.h"
+#include "MessageType.h"
+
+namespace pddm {
+namespace messaging {
+
+/**
+ * A summary of the flood messages a meter already holds, which it sends ahead
+ * of time to the meters that will gossip to it in an upcoming round, so that
+ * they can skip sending it copies of those messages. The summary is a Bloom
+ * filter of the messages' IDs, with FLOOD_DIGEST_BITS_PER_ID bits per ID
+ * instead of the 64 the IDs themselves would take. A false positive only
+ * makes a sender skip one copy of a message, which the recipient can still
+ * get from its other predecessors or in a later round.
+ */
+class FloodDigestMessage: public Message {
+    public:
+        static const constexpr MessageType type = MessageType::FLOOD_DIGEST;
+        /** The query the summarized flood messages belong to */
+        int query_num;
+        /** The round in which the recipients will gossip to the sender */
+        int round;
+        /** The bits of the Bloom filter, FILTER_HASHES of which are set for
+         * each flood message ID the sender holds */
+        std::vector<std::uint64_t> filter;
+        /** The number of bits set in the filter for each message ID */
+        static constexpr int FILTER_HASHES = 7;
+        FloodDigestMessage(const int sender_id, const int query_num, const int round,
+                std::vector<std::uint64_t> filter) :
+            Message(sender_id, nullptr), query_num(query_num), round(round),
+            filter(std::move(filter)) {}
+        virtual ~FloodDigestMessage() = default;
+
+        /**
+         * Builds the Bloom filter for a set of message IDs.
+         * @param message_ids The IDs of the flood messages the sender holds
+         * @return The filter's bits, sized for that many IDs
+         */
+        template<typename IdSet>
+        static std::vector<std::uint64_t> build_filter(const IdSet& message_ids) {
+            std::vector<std::uint64_t> filter((message_ids.size() * FLOOD_DIGEST_BITS_PER_ID + 63) / 64 + 1, 0);
+            for(const std::uint64_t message_id : message_ids) {
+                for(int i = 0; i < FILTER_HASHES; ++i) {
+                    const std::size_t bit = filter_bit(message_id, i, filter.size());
+                    filter[bit / 64] |= std::uint64_t(1) << (bit % 64);
+                }
+            }
+            return filter;
+        }
+
+        /**
+         * @param message_id The ID of a flood message
+         * @return False if the sender definitely doesn't hold the message,
+         * true if it probably does
+         */
+        bool might_hold(const std::uint64_t message_id) const;
+
+        /**
+         * Computes the number of bytes it would take to serialize this message.
+         * @return The size of this FloodDigestMessage in bytes.
+         */
+        std::size_t bytes_size() const;
+        /**
+         * Copies a FloodDigestMessage into the byte buffer that {@code buffer}
+         * points to, blindly assuming that the buffer is large enough to
+         * contain the message. The caller must ensure that the buffer is at
+         * least as long as message.bytes_size() before calling this.
+         * @param buffer The byte buffer into which this object should be serialized.
+         */
+        std::size_t to_bytes(char* buffer) const;
+        void post_object(const std::function<void (char const * const,std::size_t)>& f) const;
+        /**
+         * Creates a new FloodDigestMessage by deserializing the contents of
+         * {@code buffer}, blindly assuming that the buffer contains a whole
+         * FloodDigestMessage.
+         * @param buffer A byte buffer containing the results of an earlier call to
+         * to_bytes(char*).
+         * @return A new FloodDigestMessage reconstructed from the serialized bytes.
+         */
+        static std::unique_ptr<FloodDigestMessage> from_bytes(mutils::DeserializationManager<>* m, const char* buffer);
+    private:
+        /** Picks the i'th bit for a message ID by double hashing; the IDs are already hashes, so their halves serve as the two hashes */
+        static std::size_t filter_bit(const std::uint64_t message_id, const int i, const std::size_t num_words) {
+            return ((message_id & 0xffffffff) + i * ((message_id >> 32) | 1)) % (num_words * 64);
+        }
+};
+
+std::ostream& operator<< (std::ostream& out, const FloodDigestMessage& message);
+
+} /* namespace messaging */
+} /* namespace pddm */
@@ -9,6 +9,7 @@
 #include "Message.h"
 
 #include "AggregationMessage.h"
+#include "FloodDigestMessage.h"
 #include "MessageType.h"
 #include "OverlayTransportMessage.h"
 #include "PingMessage.h"
@@ -53,6 +54,8 @@ std::unique_ptr<Message> Message::from_bytes(mutils::DeserializationManager<>* m
         return SignatureRequest::from_bytes(m, buffer);
     case SignatureResponse::type:
         return SignatureResponse::from_bytes(m, buffer);
+    case FloodDigestMessage::type:
+        return FloodDigestMessage::from_bytes(m, buffer);
     default:
         return nullptr;
     }
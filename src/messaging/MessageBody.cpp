@@ -8,14 +8,19 @@
 #include "MessageBody.h"
 
 #include <memory>
+#include <string>
 
+#include "AckCertificate.h"
 #include "AggregationMessage.h"
 #include "AgreementValue.h"
 #include "MessageBodyType.h"
+#include "MulticastOverlayMessage.h"
+#include "OnionPacket.h"
 #include "PathOverlayMessage.h"
 #include "SignedValue.h"
 #include "StringBody.h"
 #include "ValueContribution.h"
+#include "WireFormat.h"
 
 namespace pddm {
 namespace messaging {
@@ -29,6 +34,8 @@ std::unique_ptr<MessageBody> MessageBody::from_bytes(mutils::DeserializationMana
         return OverlayMessage::from_bytes(m, buffer);
     case PathOverlayMessage::type:
         return PathOverlayMessage::from_bytes(m, buffer);
+    case MulticastOverlayMessage::type:
+        return MulticastOverlayMessage::from_bytes(m, buffer);
     case AggregationMessageValue::type:
         return AggregationMessageValue::from_bytes(m, buffer);
     case ValueContribution::type:
@@ -39,9 +46,13 @@ std::unique_ptr<MessageBody> MessageBody::from_bytes(mutils::DeserializationMana
         return AgreementValue::from_bytes(m, buffer);
     case StringBody::type:
         return StringBody::from_bytes(m, buffer);
+    case AckCertificate::type:
+        return AckCertificate::from_bytes(m, buffer);
+    case OnionPacket::type:
+        return OnionPacket::from_bytes(m, buffer);
     default:
-        assert(false && "Serialized MessageBody contained an invalid MessageBodyType!");
-        return nullptr;
+        //Fail the same way as the compact format, so a malformed message from a peer is dropped instead of trusted
+        throw DecodeError("Serialized MessageBody has an unknown type " + std::to_string(static_cast<int>(body_type)));
     }
 }
 
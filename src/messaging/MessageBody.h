@@ -1,7 +1,10 @@
 #pragma once
 
+#include <memory>
 #include <mutils-serialization/SerializationSupport.hpp>
 
+#include "MessageBodyType.h"
+
 namespace pddm {
 
 namespace messaging {
@@ -16,7 +19,10 @@ class MessageBody : public mutils::ByteRepresentable {
     public:
         virtual ~MessageBody() = default;
         virtual bool operator==(const MessageBody&) const = 0;
+        /** @return The MessageBodyType tag of this body's class */
+        virtual MessageBodyType get_type() const = 0;
 
+        /** @throws DecodeError if the buffer doesn't start with a known MessageBodyType */
         static std::unique_ptr<MessageBody> from_bytes(mutils::DeserializationManager<>* m, char const * buffer);
 };
 
@@ -24,6 +30,45 @@ inline bool operator!=(const MessageBody& a, const MessageBody& b){
     return !(a == b);
 }
 
+/**
+ * Determines which MessageBodyType tags belong to a body class. A class
+ * matches only its own tag unless this is specialized for it, which classes
+ * with subclasses must do.
+ */
+template<typename BodyType>
+struct BodyTypeTraits {
+    static constexpr bool matches(const MessageBodyType tag) { return tag == BodyType::type; }
+};
+
+/**
+ * Casts a MessageBody to one of its subclasses by checking its type tag,
+ * rather than with dynamic_cast. Since the set of body types is closed, this
+ * is a single comparison instead of a walk through the RTTI.
+ * @param body A pointer to a MessageBody, which may be null
+ * @return body as a pointer to a BodyType, or null if it isn't one
+ */
+template<typename BodyType>
+BodyType* body_cast(MessageBody* body) {
+    return body != nullptr && BodyTypeTraits<BodyType>::matches(body->get_type()) ? static_cast<BodyType*>(body) : nullptr;
+}
+
+template<typename BodyType>
+const BodyType* body_cast(const MessageBody* body) {
+    return body != nullptr && BodyTypeTraits<BodyType>::matches(body->get_type()) ? static_cast<const BodyType*>(body) : nullptr;
+}
+
+/**
+ * The equivalent of std::dynamic_pointer_cast for message bodies, using the
+ * type tag. Prefer body_cast when the result doesn't need to be kept, since
+ * copying a shared_ptr costs an atomic increment and decrement.
+ * @param body A shared_ptr to a MessageBody, which may be null
+ * @return A shared_ptr to body as a BodyType, or null if it isn't one
+ */
+template<typename BodyType>
+std::shared_ptr<BodyType> body_pointer_cast(const std::shared_ptr<MessageBody>& body) {
+    return body_cast<BodyType>(body.get()) ? std::static_pointer_cast<BodyType>(body) : nullptr;
+}
+
 } /* namespace messaging */
 } /* namespace pddm */
 
@@ -19,7 +19,11 @@ enum class MessageBodyType : int16_t {
     SIGNED_VALUE,
     VALUE_CONTRIBUTION,
     AGGREGATION_VALUE,
-    STRING
+    STRING,
+    ACK_CERTIFICATE,
+    MULTICAST_OVERLAY,
+    ONION_PACKET,
+    OPAQUE /* The tag of an OpaqueBody. This is never serialized, since an OpaqueBody's bytes start with the type of the body they represent. */
 };
 
 }
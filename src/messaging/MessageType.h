@@ -8,6 +8,7 @@
 #pragma once
 
 #include <cstdint>
+#include <ostream>
 
 namespace pddm {
 namespace messaging {
@@ -18,7 +19,8 @@ enum class MessageType : int16_t {
     AGGREGATION,
     QUERY_REQUEST,
     SIGNATURE_REQUEST,
-    SIGNATURE_RESPONSE
+    SIGNATURE_RESPONSE,
+    FLOOD_DIGEST
 };
 
 inline std::ostream& operator<<(std::ostream& stream, const MessageType& value) {
@@ -35,6 +37,8 @@ inline std::ostream& operator<<(std::ostream& stream, const MessageType& value)
         return stream << "SIGNATURE_REQUEST";
     case MessageType::SIGNATURE_RESPONSE:
         return stream << "SIGNATURE_RESPONSE";
+    case MessageType::FLOOD_DIGEST:
+        return stream << "FLOOD_DIGEST";
     default:
         return stream << "UNKNOWN";
     }
@@ -0,0 +1,184 @@
+/**
+ * @file MulticastOverlayMessage.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "MulticastOverlayMessage.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <mutils-serialization/SerializationSupport.hpp>
+
+#include "OpaqueBody.h"
+#include "../util/OStreams.h"
+
+namespace pddm {
+namespace messaging {
+
+const constexpr MessageBodyType MulticastOverlayMessage::type;
+
+std::ostream& operator<< (std::ostream& out, const MulticastOverlayMessage& message) {
+    std::stringstream super_streamout;
+    super_streamout << static_cast<OverlayMessage>(message);
+    std::string output_string = super_streamout.str();
+    std::stringstream path_string_builder;
+    path_string_builder << "|RemainingPaths=[";
+    for(const auto& path : message.remaining_paths) {
+        path_string_builder << path;
+    }
+    path_string_builder << "]|PathBodies=" << message.path_bodies.size();
+    output_string.insert(output_string.find("|Body="), path_string_builder.str());
+    return out << output_string;
+}
+
+bool MulticastOverlayMessage::is_recipient() const {
+    return std::any_of(remaining_paths.begin(), remaining_paths.end(),
+            [](const std::pmr::list<int>& path) { return path.empty(); });
+}
+
+std::shared_ptr<MessageBody> MulticastOverlayMessage::recipient_body() const {
+    for(std::size_t i = 0; i < remaining_paths.size() && i < path_bodies.size(); ++i) {
+        if(remaining_paths[i].empty()) {
+            return path_bodies[i];
+        }
+    }
+    return nullptr;
+}
+
+template<typename PathVector, typename BodyVector>
+std::list<std::shared_ptr<MulticastOverlayMessage>> MulticastOverlayMessage::branch(const int query_num,
+        const PathVector& paths, const BodyVector& bodies) {
+    assert(paths.size() == bodies.size());
+    //Group the paths by their next hop, keeping the rest of each path and its body
+    std::map<int, std::pair<std::vector<std::list<int>>, std::vector<std::shared_ptr<MessageBody>>>> paths_by_next_hop;
+    for(std::size_t i = 0; i < paths.size(); ++i) {
+        if(paths[i].empty())
+            continue;
+        auto& hop_paths = paths_by_next_hop[paths[i].front()];
+        hop_paths.first.emplace_back(++paths[i].begin(), paths[i].end());
+        hop_paths.second.emplace_back(bodies[i]);
+    }
+    std::list<std::shared_ptr<MulticastOverlayMessage>> branches;
+    for(const auto& hop_paths : paths_by_next_hop) {
+        branches.emplace_back(std::make_shared<MulticastOverlayMessage>(query_num, hop_paths.first,
+                hop_paths.second.first, hop_paths.second.second));
+    }
+    return branches;
+}
+
+//Messages are branched both from new trees and from the paths in a received message
+template std::list<std::shared_ptr<MulticastOverlayMessage>> MulticastOverlayMessage::branch(const int,
+        const std::vector<std::list<int>>&, const std::vector<std::shared_ptr<MessageBody>>&);
+template std::list<std::shared_ptr<MulticastOverlayMessage>> MulticastOverlayMessage::branch(const int,
+        const std::pmr::vector<std::pmr::list<int>>&, const std::pmr::vector<std::shared_ptr<MessageBody>>&);
+
+std::vector<int> MulticastOverlayMessage::flatten_paths() const {
+    std::vector<int> flat_paths;
+    flat_paths.push_back(remaining_paths.size());
+    for(const auto& path : remaining_paths) {
+        flat_paths.push_back(path.size());
+        flat_paths.insert(flat_paths.end(), path.begin(), path.end());
+    }
+    return flat_paths;
+}
+
+std::size_t MulticastOverlayMessage::path_bodies_size() const {
+    std::size_t total_size = 0;
+    for(const auto& body : path_bodies) {
+        total_size += sizeof(std::size_t) + (body == nullptr ? 0 : mutils::bytes_size(*body));
+    }
+    return total_size;
+}
+
+std::size_t MulticastOverlayMessage::to_bytes(char* buffer) const {
+    std::size_t bytes_written = 0;
+    bytes_written += mutils::to_bytes(type, buffer);
+    bytes_written += mutils::to_bytes(flatten_paths(), buffer + bytes_written);
+    //Each path's body is prefixed with its size, like an OverlayMessage's body, so a relay can skip over it
+    for(const auto& body : path_bodies) {
+        char* body_size_position = buffer + bytes_written;
+        bytes_written += sizeof(std::size_t);
+        std::size_t body_size = (body == nullptr) ? 0 : mutils::to_bytes(*body, buffer + bytes_written);
+        std::memcpy(body_size_position, &body_size, sizeof(body_size));
+        bytes_written += body_size;
+    }
+    bytes_written += to_bytes_common(buffer + bytes_written);
+    return bytes_written;
+}
+
+void MulticastOverlayMessage::post_object(const std::function<void(const char* const, std::size_t)>& function) const {
+    mutils::post_object(function, type);
+    mutils::post_object(function, flatten_paths());
+    for(const auto& body : path_bodies) {
+        const std::size_t body_size = (body == nullptr) ? 0 : mutils::bytes_size(*body);
+        mutils::post_object(function, body_size);
+        if(body != nullptr) {
+            mutils::post_object(function, *body);
+        }
+    }
+    post_object_common(function);
+}
+
+std::size_t MulticastOverlayMessage::bytes_size() const {
+    //The superclass bytes_size already includes the size of a MessageBodyType
+    return OverlayMessage::bytes_size() + mutils::bytes_size(flatten_paths()) + path_bodies_size();
+}
+
+std::unique_ptr<MulticastOverlayMessage> MulticastOverlayMessage::from_bytes(mutils::DeserializationManager<>* m, char const * buffer) {
+    auto constructed_message = std::unique_ptr<MulticastOverlayMessage>(new MulticastOverlayMessage());
+    from_bytes_fields(*constructed_message, buffer, nullptr);
+    return constructed_message;
+}
+
+std::shared_ptr<MulticastOverlayMessage> MulticastOverlayMessage::view_from_bytes(char const * buffer,
+        const SharedBuffer& source_buffer) {
+    auto constructed_message = allocate_in_arena<MulticastOverlayMessage>(source_buffer, source_buffer->resource());
+    from_bytes_fields(*constructed_message, buffer, source_buffer);
+    return constructed_message;
+}
+
+std::size_t MulticastOverlayMessage::from_bytes_fields(MulticastOverlayMessage& partial_message, char const * buffer,
+        const SharedBuffer& source_buffer) {
+    std::size_t bytes_read = 0;
+    MessageBodyType type;
+    std::memcpy(&type, buffer + bytes_read, sizeof(type));
+    bytes_read += sizeof(type);
+    assert(type == MessageBodyType::MULTICAST_OVERLAY);
+
+    auto flat_paths = mutils::from_bytes<std::vector<int>>(nullptr, buffer + bytes_read);
+    bytes_read += mutils::bytes_size(*flat_paths);
+    auto flat_iter = flat_paths->begin();
+    const int num_paths = *flat_iter++;
+    partial_message.remaining_paths.resize(num_paths);
+    for(auto& path : partial_message.remaining_paths) {
+        const int path_length = *flat_iter++;
+        path.assign(flat_iter, flat_iter + path_length);
+        flat_iter += path_length;
+    }
+    partial_message.path_bodies.resize(num_paths);
+    for(auto& body : partial_message.path_bodies) {
+        std::size_t body_size;
+        std::memcpy(&body_size, buffer + bytes_read, sizeof(body_size));
+        bytes_read += sizeof(body_size);
+        if(body_size > 0) {
+            if(source_buffer) {
+                body = OpaqueBody::view(buffer + bytes_read, body_size, source_buffer);
+            } else {
+                body = mutils::from_bytes<MessageBody>(nullptr, buffer + bytes_read);
+            }
+            bytes_read += body_size;
+        }
+    }
+    bytes_read += OverlayMessage::from_bytes_common(partial_message, buffer + bytes_read, source_buffer);
+    return bytes_read;
+}
+
+}
+}
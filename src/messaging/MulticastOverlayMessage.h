@@ -0,0 +1,123 @@
+/**
+ * @file MulticastOverlayMessage.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+#include <mutils-serialization/SerializationSupport.hpp>
+#include <ostream>
+
+#include "OverlayMessage.h"
+
+namespace pddm {
+namespace messaging {
+
+/**
+ * Represents an OverlayMessage that must be delivered to several meters along
+ * a tree through the overlay, rather than along one path per meter. A single
+ * copy travels along the part of the tree that the paths share, and it is
+ * split into one copy per branch at the meters where the paths diverge. The
+ * destination field contains the ID of the next meter in the tree, and the
+ * remaining_paths field contains the rest of each path that passes through
+ * it; an empty path means that meter is itself one of the recipients. Each
+ * path carries its own copy of the body, encrypted for the recipient at its
+ * end, so the message itself has no body until a recipient decrypts its copy.
+ */
+class MulticastOverlayMessage : public OverlayMessage {
+    public:
+        static const constexpr MessageBodyType type = MessageBodyType::MULTICAST_OVERLAY;
+        /** The paths use the arena of the frame the message was received in,
+         * if it was deserialized with view_from_bytes. */
+        std::pmr::vector<std::pmr::list<int>> remaining_paths;
+        /** The body to deliver at the end of each path in remaining_paths,
+         * in the same order, encrypted for the meter at the end of the path.
+         * Relays keep these as views of the frame they were received in. */
+        std::pmr::vector<std::shared_ptr<MessageBody>> path_bodies;
+        /**
+         * Constructs a message for one branch of a multicast tree.
+         * @param query_num The query number
+         * @param destination The next meter in the tree
+         * @param remaining_paths The remainders of all the paths that pass
+         * through destination, not including destination itself
+         * @param path_bodies The body to deliver at the end of each path
+         */
+        MulticastOverlayMessage(const int query_num, const int destination,
+                const std::vector<std::list<int>>& remaining_paths,
+                const std::vector<std::shared_ptr<MessageBody>>& path_bodies) :
+            OverlayMessage(query_num, destination, nullptr),
+            path_bodies(path_bodies.begin(), path_bodies.end()) {
+            this->remaining_paths.reserve(remaining_paths.size());
+            for(const auto& path : remaining_paths) {
+                this->remaining_paths.emplace_back(path.begin(), path.end());
+            }
+        }
+        virtual ~MulticastOverlayMessage() = default;
+
+        MessageBodyType get_type() const { return type; }
+
+        /** @return True if the current destination is one of the recipients */
+        bool is_recipient() const;
+        /** @return The (still encrypted) body for the current destination,
+         * or null if it is not one of the recipients */
+        std::shared_ptr<MessageBody> recipient_body() const;
+
+        /**
+         * Splits a set of paths that start at the same meter into one
+         * message for each distinct next hop, each one carrying only the
+         * paths that pass through that hop, and their bodies. Empty paths
+         * are ignored.
+         * @param query_num The query number
+         * @param paths Paths to each recipient, not including the meter they start at
+         * @param bodies The body to deliver at the end of each path
+         * @return One message for each branch of the tree at this point
+         */
+        template<typename PathVector, typename BodyVector>
+        static std::list<std::shared_ptr<MulticastOverlayMessage>> branch(const int query_num,
+                const PathVector& paths, const BodyVector& bodies);
+
+        //Serialization support
+        std::size_t to_bytes(char* buffer) const;
+        void post_object(const std::function<void (char const * const,std::size_t)>& consumer_function) const;
+        std::size_t bytes_size() const;
+        static std::unique_ptr<MulticastOverlayMessage> from_bytes(mutils::DeserializationManager<>* m, char const * buffer);
+        /**
+         * Deserializes a MulticastOverlayMessage from a received frame into
+         * the frame's arena, as in OverlayMessage::view_from_bytes.
+         */
+        static std::shared_ptr<MulticastOverlayMessage> view_from_bytes(char const * buffer, const SharedBuffer& source_buffer);
+
+        friend class CompactEncoding;
+        template<typename T>
+        friend class ArenaAllocator;
+    protected:
+        /**
+         * Constructor used only by deserialization.
+         * @param paths_resource The memory resource for remaining_paths to use
+         */
+        explicit MulticastOverlayMessage(std::pmr::memory_resource* paths_resource = std::pmr::get_default_resource()) :
+            OverlayMessage(), remaining_paths(paths_resource), path_bodies(paths_resource) {}
+        /** Shared implementation of from_bytes and view_from_bytes */
+        static std::size_t from_bytes_fields(MulticastOverlayMessage& partial_message, char const * buffer,
+                const SharedBuffer& source_buffer);
+    private:
+        /** The paths flattened into a single vector, as the number of paths
+         * followed by each path's length and then its IDs */
+        std::vector<int> flatten_paths() const;
+        /** The number of bytes path_bodies takes up in mutils format, with a size before each body */
+        std::size_t path_bodies_size() const;
+};
+
+
+std::ostream& operator<< (std::ostream& out, const MulticastOverlayMessage& message);
+
+}
+}
@@ -7,11 +7,14 @@
 
 #include <memory>
 #include <list>
+#include <vector>
 
 #include "OnionBuilder.h"
 #include "../Configuration.h"
 #include "../ConfigurationIncludes.h"
 #include "MessageBody.h"
+#include "MulticastOverlayMessage.h"
+#include "OnionPacket.h"
 #include "OverlayMessage.h"
 
 namespace pddm {
@@ -20,19 +23,21 @@ namespace messaging {
 std::shared_ptr<OverlayMessage> build_encrypted_onion(const std::list<int>& path,
         const std::shared_ptr<MessageBody>& payload,
         const int query_num, CryptoLibrary_t& crypto_library) {
-    //Start with the last layer of the onion, which actually contains the payload
-    auto current_layer = crypto_library.rsa_encrypt(std::make_shared<OverlayMessage>(
-            query_num, path.back(), payload), path.back());
-    //Build the onion from the end of the list to the beginning
-    for(auto path_iter = path.rbegin(); path_iter != path.rend(); ++path_iter) {
-        if(path_iter == path.rbegin())
-            continue;
-        //Make the previous layer the payload of a new message, whose destination is the next hop
-        auto next_layer = crypto_library.rsa_encrypt(std::make_shared<OverlayMessage>(
-                query_num, *path_iter, current_layer), *path_iter);
-        current_layer = next_layer;
+    //The onion is a single fixed-size packet, rather than one nested OverlayMessage per hop,
+    //so it's the same size at every hop and each hop only needs to peel off one routing record
+    return std::make_shared<OverlayMessage>(query_num, path.front(),
+            crypto_library.build_onion(path, payload));
+}
+
+std::list<std::shared_ptr<MulticastOverlayMessage>> build_encrypted_multicast(const std::vector<std::list<int>>& tree,
+        const std::shared_ptr<MessageBody>& payload, const int query_num, CryptoLibrary_t& crypto_library) {
+    std::vector<std::shared_ptr<MessageBody>> path_bodies;
+    path_bodies.reserve(tree.size());
+    for(const auto& path : tree) {
+        path_bodies.emplace_back(crypto_library.rsa_encrypt(
+                std::make_shared<OverlayMessage>(query_num, path.back(), payload), path.back()));
     }
-    return current_layer;
+    return MulticastOverlayMessage::branch(query_num, tree, path_bodies);
 }
 
 } /* namespace messaging */
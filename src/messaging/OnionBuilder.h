@@ -9,16 +9,41 @@
 
 #include <memory>
 #include <list>
+#include <vector>
 
 #include "../Configuration.h"
+#include "MulticastOverlayMessage.h"
 #include "OverlayMessage.h"
 
 namespace pddm {
 namespace messaging {
 
+/**
+ * Builds an onion-routed message that will carry a payload along a path.
+ * @param path The meters the message should pass through, ending with its destination
+ * @param payload The body to deliver to the destination
+ * @param query_num The query number
+ * @param crypto_library The CryptoLibrary to use to build the onion
+ * @return An OverlayMessage, addressed to the first hop on the path, whose
+ * body is an OnionPacket
+ */
 std::shared_ptr<OverlayMessage> build_encrypted_onion(const std::list<int>& path, const std::shared_ptr<MessageBody>& payload,
         const int query_num, CryptoLibrary_t& crypto_library);
 
+/**
+ * Builds the messages that will carry a payload to several meters along a
+ * multicast tree. Each recipient's copy of the payload is encrypted with its
+ * public key (but not onion-encrypted), so the meters relaying it can't read
+ * the payload, just as with a PathOverlayMessage sent to each recipient.
+ * @param tree The paths to each recipient, as returned by util::find_multicast_tree
+ * @param payload The body to deliver to every recipient
+ * @param query_num The query number
+ * @param crypto_library The CryptoLibrary to use to encrypt each copy
+ * @return One MulticastOverlayMessage for each branch of the tree at its root
+ */
+std::list<std::shared_ptr<MulticastOverlayMessage>> build_encrypted_multicast(const std::vector<std::list<int>>& tree,
+        const std::shared_ptr<MessageBody>& payload, const int query_num, CryptoLibrary_t& crypto_library);
+
 } /* namespace messaging */
 } /* namespace pddm */
 
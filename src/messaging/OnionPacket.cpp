@@ -0,0 +1,114 @@
+/**
+ * @file OnionPacket.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "OnionPacket.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace pddm {
+namespace messaging {
+
+const constexpr MessageBodyType OnionPacket::type;
+constexpr std::size_t OnionPacket::RECORD_SIZE;
+constexpr std::size_t OnionPacket::HEADER_SIZE;
+constexpr int OnionPacket::FINAL_HOP;
+
+std::shared_ptr<OnionPacket> OnionPacket::assemble(const std::list<int>& path, const MessageBody& body) {
+    if(path.size() > static_cast<std::size_t>(ONION_MAX_HOPS)) {
+        throw std::length_error("Onion path of length " + std::to_string(path.size())
+                + " is longer than ONION_MAX_HOPS");
+    }
+    //Each hop's record names the hop after it, and the destination's record is FINAL_HOP.
+    //Records past the end of the path are left as filler.
+    std::array<char, HEADER_SIZE> header{};
+    std::size_t record_index = 0;
+    for(auto path_iter = path.begin(); path_iter != path.end(); ++path_iter, ++record_index) {
+        auto next_iter = std::next(path_iter);
+        const int next_hop = next_iter == path.end() ? FINAL_HOP : *next_iter;
+        std::memcpy(header.data() + record_index * RECORD_SIZE, &next_hop, sizeof(next_hop));
+    }
+    //Round the payload up to a whole number of ONION_PAYLOAD_SIZE blocks; the
+    //padding is ignored by MessageBody::from_bytes
+    const std::size_t body_size = body.bytes_size();
+    const std::size_t num_blocks = body_size / ONION_PAYLOAD_SIZE + (body_size % ONION_PAYLOAD_SIZE != 0);
+    std::vector<char> payload(std::max<std::size_t>(num_blocks, 1) * ONION_PAYLOAD_SIZE, 0);
+    body.to_bytes(payload.data());
+    return std::make_shared<OnionPacket>(header.data(), OpaqueBody(std::move(payload)));
+}
+
+int OnionPacket::next_hop() const {
+    int next_hop;
+    std::memcpy(&next_hop, header.data(), sizeof(next_hop));
+    return next_hop;
+}
+
+void OnionPacket::shift_header() {
+    std::memmove(header.data(), header.data() + RECORD_SIZE, HEADER_SIZE - RECORD_SIZE);
+    std::memset(header.data() + HEADER_SIZE - RECORD_SIZE, 0, RECORD_SIZE);
+}
+
+std::shared_ptr<MessageBody> OnionPacket::open_payload() const {
+    return payload.decode();
+}
+
+std::size_t OnionPacket::bytes_size() const {
+    //The header always has the same size, so it doesn't need a size prefix
+    return mutils::bytes_size(type) + HEADER_SIZE
+            + mutils::bytes_size(payload.size()) + payload.bytes_size();
+}
+
+std::size_t OnionPacket::to_bytes(char* buffer) const {
+    std::size_t bytes_written = mutils::to_bytes(type, buffer);
+    std::memcpy(buffer + bytes_written, header.data(), HEADER_SIZE);
+    bytes_written += HEADER_SIZE;
+    bytes_written += mutils::to_bytes(payload.size(), buffer + bytes_written);
+    bytes_written += payload.to_bytes(buffer + bytes_written);
+    return bytes_written;
+}
+
+void OnionPacket::post_object(const std::function<void(const char* const, std::size_t)>& function) const {
+    mutils::post_object(function, type);
+    function(header.data(), HEADER_SIZE);
+    mutils::post_object(function, payload.size());
+    payload.post_object(function);
+}
+
+std::unique_ptr<OnionPacket> OnionPacket::from_bytes(mutils::DeserializationManager<>* m, char const * buffer) {
+    std::size_t bytes_read = 0;
+    MessageBodyType type;
+    std::memcpy(&type, buffer + bytes_read, sizeof(type));
+    bytes_read += sizeof(type);
+    assert(type == MessageBodyType::ONION_PACKET);
+    const char* header_start = buffer + bytes_read;
+    bytes_read += HEADER_SIZE;
+    std::size_t payload_size;
+    std::memcpy(&payload_size, buffer + bytes_read, sizeof(payload_size));
+    bytes_read += sizeof(payload_size);
+    return std::make_unique<OnionPacket>(header_start,
+            OpaqueBody(std::vector<char>(buffer + bytes_read, buffer + bytes_read + payload_size)));
+}
+
+std::shared_ptr<OnionPacket> OnionPacket::view_from_bytes(char const * buffer, const SharedBuffer& source_buffer) {
+    const char* header_start = buffer + sizeof(MessageBodyType);
+    std::size_t payload_size;
+    std::memcpy(&payload_size, header_start + HEADER_SIZE, sizeof(payload_size));
+    const char* payload_start = header_start + HEADER_SIZE + sizeof(payload_size);
+    return allocate_in_arena<OnionPacket>(source_buffer, header_start,
+            OpaqueBody(source_buffer, payload_start - source_buffer->data(), payload_size));
+}
+
+std::ostream& operator<<(std::ostream& stream, const OnionPacket& packet) {
+    return stream << "{OnionPacket|NextHop=" << packet.next_hop() << "|PayloadSize=" << packet.payload.size() << "}";
+}
+
+} /* namespace messaging */
+} /* namespace pddm */
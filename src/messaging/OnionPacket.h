@@ -0,0 +1,117 @@
+/**
+ * @file OnionPacket.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <ostream>
+#include <vector>
+#include <mutils-serialization/SerializationSupport.hpp>
+
+#include "../Configuration.h"
+#include "MessageBody.h"
+#include "MessageBodyType.h"
+#include "OpaqueBody.h"
+
+namespace pddm {
+namespace messaging {
+
+/**
+ * An onion-routed packet in a fixed-size format, modeled on Sphinx. The header
+ * is a stack of ONION_MAX_HOPS routing records, one for each hop, each holding
+ * the ID of the next hop; unused records at the end are filler. Each hop removes the first record from the front of
+ * the header and appends a filler record at the back, so the header is the
+ * same size at every hop and doesn't reveal how far along the path the packet
+ * is. The payload is the serialized body being delivered, padded to a multiple
+ * of ONION_PAYLOAD_SIZE so that it doesn't reveal which kind of body it is.
+ *
+ * This class only lays out and rearranges the bytes; the encryption of each
+ * record and of the payload, and authenticating them, is up to the
+ * CryptoLibrary, whose build_onion and peel_onion operations use it.
+ */
+class OnionPacket : public MessageBody {
+    public:
+        static const constexpr MessageBodyType type = MessageBodyType::ONION_PACKET;
+        /** The size of each routing record in the header */
+        static constexpr std::size_t RECORD_SIZE = sizeof(int);
+        /** The size of the header, which is the same for every packet */
+        static constexpr std::size_t HEADER_SIZE = ONION_MAX_HOPS * RECORD_SIZE;
+        /** The next-hop ID in the record for the packet's destination */
+        static constexpr int FINAL_HOP = -2;
+
+        /** The header is stored inline, since its size never changes */
+        std::array<char, HEADER_SIZE> header;
+        /** The serialized body, which is never decoded by meters that only relay the packet */
+        OpaqueBody payload;
+
+        /**
+         * @param header_bytes A pointer to the HEADER_SIZE bytes of the header,
+         * which are copied into the packet
+         * @param payload The payload
+         */
+        OnionPacket(const char* header_bytes, OpaqueBody payload) :
+            payload(std::move(payload)) {
+            std::copy(header_bytes, header_bytes + HEADER_SIZE, header.begin());
+        }
+        virtual ~OnionPacket() = default;
+
+        /**
+         * Lays out the (unencrypted) header and payload for a packet that
+         * will travel along a path.
+         * @param path The meters the packet passes through, starting with the
+         * first hop and ending with the destination
+         * @param body The body to deliver to the destination
+         * @return A new packet with one routing record for each hop on the path
+         * @throws std::length_error if the path has more than ONION_MAX_HOPS hops,
+         * which util::find_paths won't return if it is given ONION_MAX_HOPS as
+         * its maximum path length
+         */
+        static std::shared_ptr<OnionPacket> assemble(const std::list<int>& path, const MessageBody& body);
+
+        /** @return The next-hop ID in the first routing record of the header */
+        int next_hop() const;
+
+        /**
+         * Strips the first routing record off the front of the header and
+         * appends a filler record at the back, keeping the header's size.
+         */
+        void shift_header();
+
+        /** @return The body carried in the payload, deserialized */
+        std::shared_ptr<MessageBody> open_payload() const;
+
+        MessageBodyType get_type() const { return type; }
+
+        inline bool operator==(const MessageBody& _rhs) const {
+            if (auto* rhs = body_cast<OnionPacket>(&_rhs))
+                return this->header == rhs->header && this->payload == rhs->payload;
+            else return false;
+        }
+
+        //Serialization support
+        std::size_t to_bytes(char* buffer) const;
+        void post_object(const std::function<void (char const * const,std::size_t)>& consumer_function) const;
+        std::size_t bytes_size() const;
+        static std::unique_ptr<OnionPacket> from_bytes(mutils::DeserializationManager<>* m, char const * buffer);
+        /**
+         * Deserializes an OnionPacket from a received frame into the frame's
+         * arena, keeping the payload as a view of the frame rather than
+         * copying it out.
+         * @param buffer The serialized OnionPacket
+         * @param source_buffer The receive buffer that contains buffer
+         */
+        static std::shared_ptr<OnionPacket> view_from_bytes(char const * buffer, const SharedBuffer& source_buffer);
+};
+
+std::ostream& operator<<(std::ostream& stream, const OnionPacket& packet);
+
+} /* namespace messaging */
+} /* namespace pddm */
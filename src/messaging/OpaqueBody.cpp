@@ -0,0 +1,93 @@
+/**
+ * @file OpaqueBody.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "OpaqueBody.h"
+
+#include <cstring>
+
+#include "CompactEncoding.h"
+#include "MulticastOverlayMessage.h"
+#include "OnionPacket.h"
+#include "OverlayMessage.h"
+#include "PathOverlayMessage.h"
+
+namespace pddm {
+namespace messaging {
+
+MessageBodyType OpaqueBody::body_type() const {
+    if(format == WireFormat::COMPACT) {
+        return static_cast<MessageBodyType>(static_cast<uint8_t>(data()[0]));
+    }
+    MessageBodyType type;
+    std::memcpy(&type, data(), sizeof(type));
+    return type;
+}
+
+std::shared_ptr<MessageBody> OpaqueBody::decode() const {
+    if(format == WireFormat::COMPACT) {
+        const char* buffer_start = data();
+        return CompactEncoding::body_from_bytes(buffer_start, length);
+    }
+    return MessageBody::from_bytes(nullptr, data());
+}
+
+std::shared_ptr<MessageBody> OpaqueBody::view(const char* buffer_start, const std::size_t body_size,
+        const SharedBuffer& source_buffer) {
+    MessageBodyType type;
+    std::memcpy(&type, buffer_start, sizeof(type));
+    switch(type) {
+    case MessageBodyType::OVERLAY:
+        return OverlayMessage::view_from_bytes(buffer_start, source_buffer);
+    case MessageBodyType::PATH_OVERLAY:
+        return PathOverlayMessage::view_from_bytes(buffer_start, source_buffer);
+    case MessageBodyType::MULTICAST_OVERLAY:
+        return MulticastOverlayMessage::view_from_bytes(buffer_start, source_buffer);
+    case MessageBodyType::ONION_PACKET:
+        return OnionPacket::view_from_bytes(buffer_start, source_buffer);
+    default:
+        return allocate_in_arena<OpaqueBody>(source_buffer, source_buffer, buffer_start - source_buffer->data(), body_size);
+    }
+}
+
+bool OpaqueBody::operator==(const MessageBody& _rhs) const {
+    if(auto* rhs = body_cast<OpaqueBody>(&_rhs)) {
+        if(this->format != rhs->format)
+            return *decode() == *rhs->decode();
+        return this->length == rhs->length && std::memcmp(this->data(), rhs->data(), length) == 0;
+    }
+    else return *decode() == _rhs;
+}
+
+std::size_t OpaqueBody::bytes_size() const {
+    if(format != WireFormat::MUTILS) {
+        return mutils::bytes_size(*decode());
+    }
+    return length;
+}
+
+std::size_t OpaqueBody::to_bytes(char* out_buffer) const {
+    if(format != WireFormat::MUTILS) {
+        return decode()->to_bytes(out_buffer);
+    }
+    std::memcpy(out_buffer, data(), length);
+    return length;
+}
+
+void OpaqueBody::post_object(const std::function<void(const char* const, std::size_t)>& consumer_function) const {
+    if(format != WireFormat::MUTILS) {
+        decode()->post_object(consumer_function);
+        return;
+    }
+    consumer_function(data(), length);
+}
+
+std::ostream& operator<<(std::ostream& stream, const OpaqueBody& body) {
+    return stream << "{Opaque|Type=" << static_cast<int16_t>(body.body_type()) << "|Size=" << body.size() << "}";
+}
+
+} /* namespace messaging */
+} /* namespace pddm */
@@ -0,0 +1,106 @@
+/**
+ * @file OpaqueBody.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <vector>
+#include <mutils-serialization/SerializationSupport.hpp>
+
+#include "MessageBody.h"
+#include "MessageBodyType.h"
+#include "ReceiveBuffer.h"
+#include "WireFormat.h"
+
+namespace pddm {
+namespace messaging {
+
+/**
+ * A MessageBody that has not been deserialized yet, represented by a view of
+ * its serialized bytes. When a meter receives a message that it will only
+ * relay, the parts of the message it doesn't need to read are kept as
+ * OpaqueBodys that point into the buffer the message was received in, so they
+ * are never decoded and are copied straight into the next hop's send buffer.
+ * The view keeps the receive buffer alive for as long as it is needed.
+ *
+ * The viewed bytes may be in either WireFormat, but the mutils serialization
+ * functions always produce the MUTILS format, decoding the body first if it
+ * was received in another format. This keeps the mutils serialization of a
+ * message the same no matter how it reached this meter, which
+ * HftProtocolState relies on to assign IDs to messages.
+ */
+class OpaqueBody : public MessageBody {
+    public:
+        static const constexpr MessageBodyType type = MessageBodyType::OPAQUE;
+    private:
+        SharedBuffer buffer;
+        std::size_t offset;
+        std::size_t length;
+        WireFormat format;
+    public:
+        /**
+         * Constructs a view of part of a shared buffer.
+         * @param buffer The buffer containing the serialized body
+         * @param offset The position in the buffer at which the body starts
+         * @param length The number of bytes in the serialized body
+         * @param format The format the body was serialized in
+         */
+        OpaqueBody(const SharedBuffer& buffer, const std::size_t offset, const std::size_t length,
+                const WireFormat format = WireFormat::MUTILS) :
+            buffer(buffer), offset(offset), length(length), format(format) {}
+        /**
+         * Constructs an OpaqueBody that owns its bytes, rather than viewing
+         * a buffer shared with other messages.
+         * @param bytes A body serialized with mutils, possibly followed by padding
+         */
+        explicit OpaqueBody(std::vector<char> bytes) :
+            buffer(std::make_shared<const ReceiveBuffer>(std::move(bytes))), offset(0), length(buffer->size()),
+            format(WireFormat::MUTILS) {}
+        virtual ~OpaqueBody() = default;
+
+        MessageBodyType get_type() const { return type; }
+
+        const char* data() const { return buffer->data() + offset; }
+        std::size_t size() const { return length; }
+        WireFormat wire_format() const { return format; }
+        /** @return The MessageBodyType at the start of the serialized body */
+        MessageBodyType body_type() const;
+        /**
+         * @return The body these bytes represent, deserialized into a new object
+         * @throws DecodeError if the bytes are COMPACT and not a valid body
+         */
+        std::shared_ptr<MessageBody> decode() const;
+
+        /**
+         * Creates a view of a serialized body in a shared buffer, except for
+         * the kinds of bodies that a relay needs to read (other layers of
+         * overlay messages and onion packets), which are
+         * deserialized, keeping their own contents as views where possible.
+         * Either way, the new objects are allocated in source_buffer's arena.
+         * @param buffer_start A pointer to the body within source_buffer
+         * @param body_size The number of bytes in the serialized body
+         * @param source_buffer The buffer containing the body
+         * @return Either a new OpaqueBody or a partially-deserialized MessageBody
+         */
+        static std::shared_ptr<MessageBody> view(const char* buffer_start, const std::size_t body_size,
+                const SharedBuffer& source_buffer);
+
+        bool operator==(const MessageBody& _rhs) const;
+
+        //Serialization support. There is no from_bytes, since the bytes are already a serialized MessageBody.
+        std::size_t bytes_size() const;
+        std::size_t to_bytes(char* out_buffer) const;
+        void post_object(const std::function<void (char const * const,std::size_t)>& consumer_function) const;
+};
+
+std::ostream& operator<<(std::ostream& stream, const OpaqueBody& body);
+
+} /* namespace messaging */
+} /* namespace pddm */
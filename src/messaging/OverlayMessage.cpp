@@ -12,12 +12,7 @@
 
 #include "OverlayMessage.h"
 
-#include "AgreementValue.h"
-#include "PathOverlayMessage.h"
-#include "QueryRequest.h"
-#include "SignedValue.h"
-#include "StringBody.h"
-#include "ValueContribution.h"
+#include "VisitBody.h"
 
 namespace pddm {
 namespace messaging {
@@ -26,23 +21,10 @@ const constexpr MessageBodyType OverlayMessage::type;
 
 std::ostream& operator<< (std::ostream& out, const OverlayMessage& message) {
     out << "{QueryNum=" << message.query_num << "|Destination=" << message.destination << "|Body=" ;
-    //Force C++ to use dynamic dispatch on operator<< even though it doesn't want to
     if(message.body == nullptr) {
         out << "null";
-    } else if(auto av_body = std::dynamic_pointer_cast<AgreementValue>(message.body)) {
-        out << *av_body;
-    } else if(auto pom_body = std::dynamic_pointer_cast<PathOverlayMessage>(message.body)) {
-        out << *pom_body;
-    } else if(auto om_body = std::dynamic_pointer_cast<OverlayMessage>(message.body)) {
-        out << *om_body;
-    } else if(auto sv_body = std::dynamic_pointer_cast<SignedValue>(message.body)) {
-        out << *sv_body;
-    } else if(auto string_body = std::dynamic_pointer_cast<StringBody>(message.body)) {
-        out << *string_body;
-    } else if(auto vc_body = std::dynamic_pointer_cast<ValueContribution>(message.body)) {
-        out << *vc_body;
     } else {
-        out << "UNKNOWN TYPE @ " << message.body;
+        visit_body(*message.body, [&out](const auto& body) { out << body; });
     }
     out << "}";
     return out;
@@ -52,16 +34,25 @@ std::size_t OverlayMessage::bytes_size() const {
     return mutils::bytes_size(type)
             + mutils::bytes_size(query_num) + mutils::bytes_size(destination)
             + mutils::bytes_size(is_encrypted) + mutils::bytes_size(flood)
-            + mutils::bytes_size(false) //Represents the "remaining_body" variable
+            + mutils::bytes_size(std::size_t{0}) //Represents the "body_size" variable
             + (body == nullptr ? 0 : mutils::bytes_size(*body));
 }
 
-//Is it OK to implement post_object this way?? Or do I have to recursively call post_object,
-//which would require another _common method for the superclass?
 void OverlayMessage::post_object(const std::function<void(const char* const, std::size_t)>& consumer_function) const {
-    char buffer[bytes_size()];
-    to_bytes(buffer);
-    consumer_function(buffer, bytes_size());
+    mutils::post_object(consumer_function, type);
+    post_object_common(consumer_function);
+}
+
+void OverlayMessage::post_object_common(const std::function<void(const char* const, std::size_t)>& consumer_function) const {
+    mutils::post_object(consumer_function, query_num);
+    mutils::post_object(consumer_function, destination);
+    mutils::post_object(consumer_function, is_encrypted);
+    mutils::post_object(consumer_function, flood);
+    const std::size_t body_size = (body == nullptr) ? 0 : mutils::bytes_size(*body);
+    mutils::post_object(consumer_function, body_size);
+    if(body != nullptr) {
+        mutils::post_object(consumer_function, *body);
+    }
 }
 
 std::size_t OverlayMessage::to_bytes_common(char* buffer) const {
@@ -72,11 +63,15 @@ std::size_t OverlayMessage::to_bytes_common(char* buffer) const {
     bytes_written += mutils::to_bytes(is_encrypted, buffer + bytes_written);
     bytes_written += mutils::to_bytes(flood, buffer + bytes_written);
 
-    bool remaining_body = (body != nullptr);
-    bytes_written += mutils::to_bytes(remaining_body, buffer + bytes_written);
-    if(remaining_body) {
-        bytes_written += mutils::to_bytes(*body, buffer + bytes_written);
-    }
+    //Prefix the body with its size, which is 0 if there is no body, so a relay can skip over it without
+    //decoding it. This replaced a has-body flag in WIRE_FORMAT_VERSION 1, so connections from older
+    //senders are refused before any of their messages reach from_bytes_common. Leave room for the size
+    //and fill it in after writing the body, to avoid computing it twice.
+    char* body_size_position = buffer + bytes_written;
+    bytes_written += sizeof(std::size_t);
+    std::size_t body_size = (body == nullptr) ? 0 : mutils::to_bytes(*body, buffer + bytes_written);
+    std::memcpy(body_size_position, &body_size, sizeof(body_size));
+    bytes_written += body_size;
     return bytes_written;
 }
 
@@ -99,7 +94,14 @@ std::unique_ptr<OverlayMessage> OverlayMessage::from_bytes(mutils::Deserializati
     return std::move(constructed_message);
 }
 
-std::size_t OverlayMessage::from_bytes_common(OverlayMessage& partial_overlay_message, char const * buffer) {
+std::shared_ptr<OverlayMessage> OverlayMessage::view_from_bytes(char const * buffer, const SharedBuffer& source_buffer) {
+    auto constructed_message = allocate_in_arena<OverlayMessage>(source_buffer);
+    from_bytes_common(*constructed_message, buffer + sizeof(MessageBodyType), source_buffer);
+    return constructed_message;
+}
+
+std::size_t OverlayMessage::from_bytes_common(OverlayMessage& partial_overlay_message, char const * buffer,
+        const SharedBuffer& source_buffer) {
     std::size_t bytes_read = 0;
     std::memcpy(&partial_overlay_message.query_num, buffer + bytes_read, sizeof(partial_overlay_message.query_num));
     bytes_read += sizeof(partial_overlay_message.query_num);
@@ -110,12 +112,16 @@ std::size_t OverlayMessage::from_bytes_common(OverlayMessage& partial_overlay_me
     std::memcpy(&partial_overlay_message.flood, buffer + bytes_read, sizeof(partial_overlay_message.flood));
     bytes_read += sizeof(partial_overlay_message.flood);
 
-    bool remaining_body;
-    std::memcpy(&remaining_body, buffer + bytes_read, sizeof(remaining_body));
-    bytes_read += sizeof(remaining_body);
-    if(remaining_body) {
-        partial_overlay_message.body = mutils::from_bytes<MessageBody>(nullptr, buffer+bytes_read);
-        bytes_read += mutils::bytes_size(*partial_overlay_message.body);
+    std::size_t body_size;
+    std::memcpy(&body_size, buffer + bytes_read, sizeof(body_size));
+    bytes_read += sizeof(body_size);
+    if(body_size > 0) {
+        if(source_buffer) {
+            partial_overlay_message.body = OpaqueBody::view(buffer + bytes_read, body_size, source_buffer);
+        } else {
+            partial_overlay_message.body = mutils::from_bytes<MessageBody>(nullptr, buffer + bytes_read);
+        }
+        bytes_read += body_size;
     }
 
     return bytes_read;
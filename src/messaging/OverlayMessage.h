@@ -12,11 +12,23 @@
 
 #include "MessageBody.h"
 #include "MessageBodyType.h"
+#include "OpaqueBody.h"
 #include "../util/Hash.h"
 
 namespace pddm {
 namespace messaging {
 
+class OverlayMessage;
+
+/** PathOverlayMessages and MulticastOverlayMessages are also OverlayMessages */
+template<>
+struct BodyTypeTraits<OverlayMessage> {
+    static constexpr bool matches(const MessageBodyType tag) {
+        return tag == MessageBodyType::OVERLAY || tag == MessageBodyType::PATH_OVERLAY
+                || tag == MessageBodyType::MULTICAST_OVERLAY;
+    }
+};
+
 /**
  * This is the payload of an OverlayTransportMessage, which may contain as its body
  * another OverlayMessage if the message is an encrypted onion. Each time an
@@ -35,9 +47,11 @@ class OverlayMessage: public MessageBody {
                 query_num(query_num), destination(dest_id), is_encrypted(false), flood(flood), body(body) {}
         virtual ~OverlayMessage() = default;
 
+        MessageBodyType get_type() const { return type; }
+
         inline bool operator==(const MessageBody& _rhs) const {
             auto lhs = this;
-            if (auto* rhs = dynamic_cast<const OverlayMessage*>(&_rhs))
+            if (auto* rhs = body_cast<OverlayMessage>(&_rhs))
                 return lhs->query_num == rhs->query_num
                         && lhs->destination == rhs->destination
                         && lhs->is_encrypted == rhs->is_encrypted
@@ -75,6 +89,19 @@ class OverlayMessage: public MessageBody {
          */
         static std::unique_ptr<OverlayMessage> from_bytes(mutils::DeserializationManager<>* p, const char * buffer);
 
+        /**
+         * Deserializes an OverlayMessage from a received frame into the
+         * frame's arena, keeping any part of the body that a relay does not
+         * need to read as an OpaqueBody view of the frame.
+         * @param buffer A pointer to the serialized OverlayMessage within source_buffer
+         * @param source_buffer The receive buffer that contains buffer
+         * @return A new OverlayMessage, which keeps source_buffer alive
+         */
+        static std::shared_ptr<OverlayMessage> view_from_bytes(const char * buffer, const SharedBuffer& source_buffer);
+
+        friend class CompactEncoding;
+        template<typename T>
+        friend class ArenaAllocator;
     protected:
         /** Default constructor, used only when reconstructing serialized messages */
         OverlayMessage() : query_num(0), destination(0), is_encrypted(false), flood(false), body(nullptr) {}
@@ -89,6 +116,15 @@ class OverlayMessage: public MessageBody {
          */
         std::size_t to_bytes_common(char* buffer) const;
 
+        /**
+         * Helper method for implementing post_object; posts the superclass
+         * fields (from OverlayMessage) to the consumer function, without a
+         * MessageBodyType. This is the post_object equivalent of
+         * to_bytes_common.
+         * @param consumer_function The function to post the fields' bytes to
+         */
+        void post_object_common(const std::function<void (char const * const,std::size_t)>& consumer_function) const;
+
         /**
          * Helper method for implementing from_bytes; deserializes the superclass
          * (OverlayMessage) fields from buffer into the corresponding fields of
@@ -100,9 +136,11 @@ class OverlayMessage: public MessageBody {
          * @param partial_overlay_message An OverlayMessage whose fields should
          * be updated to contain the values in the buffer
          * @param buffer The byte buffer containing serialized OverlayMessage fields
+         * @param source_buffer The shared receive buffer that contains buffer, if any
          * @return The number of bytes read from the buffer during deserialization.
          */
-        static std::size_t from_bytes_common(OverlayMessage& partial_overlay_message, const char * buffer);
+        static std::size_t from_bytes_common(OverlayMessage& partial_overlay_message, const char * buffer,
+                const SharedBuffer& source_buffer = nullptr);
 
 
 };
@@ -14,7 +14,9 @@
 
 #include "MessageType.h"
 #include "MessageBodyType.h"
+#include "MulticastOverlayMessage.h"
 #include "PathOverlayMessage.h"
+#include "VisitBody.h"
 
 namespace pddm {
 namespace messaging {
@@ -23,13 +25,10 @@ constexpr const MessageType OverlayTransportMessage::type;
 
 std::ostream& operator<< (std::ostream& out, const OverlayTransportMessage& message) {
     out << "{SenderRound=" << message.sender_round << "|Final=" << std::boolalpha << message.is_final_message << "|";
-    //Force C++ to use dynamic dispatch on operator<< even though it doesn't want to
-    if(auto pom_body = std::dynamic_pointer_cast<PathOverlayMessage>(message.body)) {
-        out << *pom_body;
-    } else if(auto om_body = std::dynamic_pointer_cast<OverlayMessage>(message.body)) {
-        out << *om_body;
+    if(message.body == nullptr) {
+        out << "null";
     } else {
-        out << "BODY UNKNOWN TYPE";
+        visit_body(*message.body, [&out](const auto& body) { out << body; });
     }
     out << "}";
     return out;
@@ -59,24 +58,33 @@ void OverlayTransportMessage::post_object(const std::function<void(const char* c
 }
 
 
-std::unique_ptr<OverlayTransportMessage> OverlayTransportMessage::from_bytes(mutils::DeserializationManager<>* m, const char* buffer) {
+/**
+ * Reads the fields of a serialized OverlayTransportMessage that come before
+ * its body.
+ * @return The number of bytes read, which is the offset of the body
+ */
+static std::size_t read_transport_fields(const char* buffer, int& sender_id, int& sender_round, bool& is_final_message) {
     std::size_t bytes_read = 0;
     MessageType message_type;
     std::memcpy(&message_type, buffer + bytes_read, sizeof(MessageType));
     bytes_read += sizeof(MessageType);
 
-    int sender_round;
     std::memcpy(&sender_round, buffer + bytes_read, sizeof(sender_round));
     bytes_read += sizeof(sender_round);
 
-    bool is_final_message;
     std::memcpy(&is_final_message, buffer + bytes_read, sizeof(is_final_message));
     bytes_read += sizeof(is_final_message);
 
     //Deserialize the fields written by Message's serialization (in the superclass call to to_bytes)
-    int sender_id;
     std::memcpy(&sender_id, buffer + bytes_read, sizeof(sender_id));
     bytes_read += sizeof(sender_id);
+    return bytes_read;
+}
+
+std::unique_ptr<OverlayTransportMessage> OverlayTransportMessage::from_bytes(mutils::DeserializationManager<>* m, const char* buffer) {
+    int sender_id, sender_round;
+    bool is_final_message;
+    std::size_t bytes_read = read_transport_fields(buffer, sender_id, sender_round, is_final_message);
     //Peek ahead at type, but don't advance bytes_read because MessageBody classes will expect to deserialize it
     MessageBodyType type;
     std::memcpy(&type, buffer + bytes_read, sizeof(type));
@@ -84,15 +92,20 @@ std::unique_ptr<OverlayTransportMessage> OverlayTransportMessage::from_bytes(mut
     std::shared_ptr<OverlayMessage> body_shared;
     switch(type) {
     case MessageBodyType::OVERLAY: {
-        std::unique_ptr<OverlayMessage> body = mutils::from_bytes<OverlayMessage>(m, buffer + bytes_read);
+        std::unique_ptr<OverlayMessage> body = OverlayMessage::from_bytes(m, buffer + bytes_read);
         body_shared = std::shared_ptr<OverlayMessage>(std::move(body));
         break;
     }
     case MessageBodyType::PATH_OVERLAY: {
-        std::unique_ptr<PathOverlayMessage> body = mutils::from_bytes<PathOverlayMessage>(m, buffer + bytes_read);
+        std::unique_ptr<PathOverlayMessage> body = PathOverlayMessage::from_bytes(m, buffer + bytes_read);
         body_shared = std::shared_ptr<PathOverlayMessage>(std::move(body));
         break;
     }
+    case MessageBodyType::MULTICAST_OVERLAY: {
+        std::unique_ptr<MulticastOverlayMessage> body = MulticastOverlayMessage::from_bytes(m, buffer + bytes_read);
+        body_shared = std::shared_ptr<MulticastOverlayMessage>(std::move(body));
+        break;
+    }
     default: {
         std::cerr << "OverlayTransportMessage contained something other than an OverlayMessage! type = " << static_cast<int16_t>(type) << std::endl;
         assert(false);
@@ -102,6 +115,32 @@ std::unique_ptr<OverlayTransportMessage> OverlayTransportMessage::from_bytes(mut
     return std::make_unique<OverlayTransportMessage>(sender_id, sender_round, is_final_message, body_shared);
 }
 
+std::shared_ptr<OverlayTransportMessage> OverlayTransportMessage::view_from_bytes(const char* buffer,
+        const SharedBuffer& source_buffer) {
+    int sender_id, sender_round;
+    bool is_final_message;
+    std::size_t bytes_read = read_transport_fields(buffer, sender_id, sender_round, is_final_message);
+    MessageBodyType type;
+    std::memcpy(&type, buffer + bytes_read, sizeof(type));
+    std::shared_ptr<OverlayMessage> body_shared;
+    switch(type) {
+    case MessageBodyType::OVERLAY:
+        body_shared = OverlayMessage::view_from_bytes(buffer + bytes_read, source_buffer);
+        break;
+    case MessageBodyType::PATH_OVERLAY:
+        body_shared = PathOverlayMessage::view_from_bytes(buffer + bytes_read, source_buffer);
+        break;
+    case MessageBodyType::MULTICAST_OVERLAY:
+        body_shared = MulticastOverlayMessage::view_from_bytes(buffer + bytes_read, source_buffer);
+        break;
+    default:
+        std::cerr << "OverlayTransportMessage contained something other than an OverlayMessage! type = " << static_cast<int16_t>(type) << std::endl;
+        assert(false);
+        break;
+    }
+    return allocate_in_arena<OverlayTransportMessage>(source_buffer, sender_id, sender_round, is_final_message, body_shared);
+}
+
 
 }  // namespace messaging
 }  // namespace pddm
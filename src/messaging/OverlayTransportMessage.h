@@ -42,6 +42,15 @@ class OverlayTransportMessage: public Message {
         std::size_t to_bytes(char* buffer) const;
         void post_object(const std::function<void (char const * const,std::size_t)>&) const;
         static std::unique_ptr<OverlayTransportMessage> from_bytes(mutils::DeserializationManager<>* m, char const * buffer);
+        /**
+         * Deserializes an OverlayTransportMessage from a received frame. The
+         * parts of the message that only need to be relayed are kept as
+         * OpaqueBody views of the frame, rather than decoded, and the message
+         * and its layers are allocated in the frame's arena.
+         * @param buffer The serialized message
+         * @param source_buffer The receive buffer that contains buffer
+         */
+        static std::shared_ptr<OverlayTransportMessage> view_from_bytes(char const * buffer, const SharedBuffer& source_buffer);
 };
 
 std::ostream& operator<< (std::ostream& out, const OverlayTransportMessage& message);
@@ -34,36 +34,47 @@ std::ostream& operator<< (std::ostream& out, const PathOverlayMessage& message)
 std::size_t PathOverlayMessage::to_bytes(char* buffer) const {
     std::size_t bytes_written = 0;
     bytes_written += mutils::to_bytes(type, buffer);
-    bytes_written += mutils::to_bytes(remaining_path, buffer + bytes_written);
+    bytes_written += mutils::to_bytes(mutils_path(), buffer + bytes_written);
     bytes_written += to_bytes_common(buffer + bytes_written);
     return bytes_written;
 }
 
-//Is it OK to implement post_object this way?? it seems much easier than recursive post_object calls
 void PathOverlayMessage::post_object(const std::function<void(const char* const, std::size_t)>& function) const {
-    char buffer[bytes_size()];
-    to_bytes(buffer);
-    function(buffer, bytes_size());
+    mutils::post_object(function, type);
+    mutils::post_object(function, mutils_path());
+    post_object_common(function);
 }
 
 std::size_t PathOverlayMessage::bytes_size() const {
     //The superclass bytes_size already includes the size of a MessageBodyType
-    return OverlayMessage::bytes_size() + mutils::bytes_size(remaining_path);
+    return OverlayMessage::bytes_size() + mutils::bytes_size(mutils_path());
 }
 
 std::unique_ptr<PathOverlayMessage> PathOverlayMessage::from_bytes(mutils::DeserializationManager<>* m, char const * buffer) {
+    auto constructed_message = std::unique_ptr<PathOverlayMessage>(new PathOverlayMessage());
+    from_bytes_fields(*constructed_message, buffer, nullptr);
+    return constructed_message;
+}
+
+std::shared_ptr<PathOverlayMessage> PathOverlayMessage::view_from_bytes(char const * buffer, const SharedBuffer& source_buffer) {
+    auto constructed_message = allocate_in_arena<PathOverlayMessage>(source_buffer, source_buffer->resource());
+    from_bytes_fields(*constructed_message, buffer, source_buffer);
+    return constructed_message;
+}
+
+std::size_t PathOverlayMessage::from_bytes_fields(PathOverlayMessage& partial_message, char const * buffer,
+        const SharedBuffer& source_buffer) {
     std::size_t bytes_read = 0;
     MessageBodyType type;
     std::memcpy(&type, buffer + bytes_read, sizeof(type));
     bytes_read += sizeof(type);
     assert(type == MessageBodyType::PATH_OVERLAY);
 
-    auto constructed_message = std::unique_ptr<PathOverlayMessage>(new PathOverlayMessage());
     auto deserialized_list = mutils::from_bytes<std::list<int>>(nullptr, buffer + bytes_read);
-    constructed_message->remaining_path = *deserialized_list;
-    bytes_read += mutils::bytes_size(constructed_message->remaining_path);
-    bytes_read += OverlayMessage::from_bytes_common(*constructed_message, buffer + bytes_read);
-    return constructed_message;
+    partial_message.remaining_path.assign(deserialized_list->begin(), deserialized_list->end());
+    bytes_read += mutils::bytes_size(*deserialized_list);
+    bytes_read += OverlayMessage::from_bytes_common(partial_message, buffer + bytes_read, source_buffer);
+    return bytes_read;
 }
 
 }
@@ -11,6 +11,7 @@
 #include <functional>
 #include <list>
 #include <memory>
+#include <memory_resource>
 #include <mutils-serialization/SerializationSupport.hpp>
 #include <ostream>
 
@@ -29,20 +30,41 @@ namespace messaging {
 class PathOverlayMessage : public OverlayMessage {
     public:
         static const constexpr MessageBodyType type = MessageBodyType::PATH_OVERLAY;
-        std::list<int> remaining_path;
+        /** The rest of the path. This uses the arena of the frame the message
+         * was received in, if it was deserialized with view_from_bytes. */
+        std::pmr::list<int> remaining_path;
         PathOverlayMessage(const int query_num, const std::list<int>& path, const std::shared_ptr<MessageBody>& body) :
             OverlayMessage(query_num, path.front(), body), remaining_path(++path.begin(), path.end()) { }
         virtual ~PathOverlayMessage() = default;
 
+        MessageBodyType get_type() const { return type; }
+
         //Serialization support
         std::size_t to_bytes(char* buffer) const;
         void post_object(const std::function<void (char const * const,std::size_t)>& consumer_function) const;
         std::size_t bytes_size() const;
         static std::unique_ptr<PathOverlayMessage> from_bytes(mutils::DeserializationManager<>* m, char const * buffer);
+        /**
+         * Deserializes a PathOverlayMessage from a received frame into the
+         * frame's arena, as in OverlayMessage::view_from_bytes.
+         */
+        static std::shared_ptr<PathOverlayMessage> view_from_bytes(char const * buffer, const SharedBuffer& source_buffer);
 
+        friend class CompactEncoding;
+        template<typename T>
+        friend class ArenaAllocator;
     protected:
-        /** Default constructor, used only by deserialization.*/
-        PathOverlayMessage() : OverlayMessage() {}
+        /**
+         * Constructor used only by deserialization.
+         * @param path_resource The memory resource for remaining_path to use
+         */
+        explicit PathOverlayMessage(std::pmr::memory_resource* path_resource = std::pmr::get_default_resource()) :
+            OverlayMessage(), remaining_path(path_resource) {}
+        /** @return remaining_path as the std::list that the mutils serialization expects */
+        std::list<int> mutils_path() const { return std::list<int>(remaining_path.begin(), remaining_path.end()); }
+        /** Shared implementation of from_bytes and view_from_bytes */
+        static std::size_t from_bytes_fields(PathOverlayMessage& partial_message, char const * buffer,
+                const SharedBuffer& source_buffer);
 };
 
 
@@ -0,0 +1,124 @@
+/**
+ * @file ReceiveBuffer.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace pddm {
+namespace messaging {
+
+/**
+ * The bytes of one received frame, together with an arena that the messages
+ * deserialized from the frame are allocated in. Deserializing a frame as views
+ * of its buffer creates a small graph of objects for every message in it (the
+ * transport message, each overlay layer, and the views of their bodies), and
+ * allocating all of them from a monotonic arena that is released along with
+ * the buffer turns hundreds of heap allocations per frame into a few. The
+ * arena is sized from the frame, so it usually needs only one block.
+ *
+ * Since every object in the arena keeps the buffer alive (see ArenaAllocator),
+ * the arena is released when the last message deserialized from the frame is
+ * destroyed. Objects that are kept for longer than the frame is relayed, such
+ * as the values stored at a message's destination, are decoded into new
+ * heap-allocated objects instead, so they don't pin the whole frame.
+ */
+class ReceiveBuffer {
+    private:
+        /** The smallest block the arena allocates, so that small frames don't use tiny blocks */
+        static constexpr std::size_t MIN_ARENA_BLOCK = 1024;
+        std::vector<char> bytes;
+        //Deallocation is a no-op, so the arena can be "modified" through a const buffer
+        mutable std::pmr::monotonic_buffer_resource arena;
+    public:
+        /**
+         * Constructs a buffer to receive a frame into.
+         * @param size The number of bytes in the frame
+         */
+        explicit ReceiveBuffer(const std::size_t size) :
+            bytes(size), arena(std::max(size, MIN_ARENA_BLOCK)) {}
+        /**
+         * Constructs a buffer that takes ownership of some bytes that were
+         * not received from the network.
+         * @param bytes The bytes the buffer should contain
+         */
+        explicit ReceiveBuffer(std::vector<char> bytes) :
+            bytes(std::move(bytes)), arena(std::pmr::new_delete_resource()) {}
+        ReceiveBuffer(const ReceiveBuffer&) = delete;
+        ReceiveBuffer& operator=(const ReceiveBuffer&) = delete;
+
+        char* data() { return bytes.data(); }
+        const char* data() const { return bytes.data(); }
+        std::size_t size() const { return bytes.size(); }
+        /** @return The arena that messages deserialized from this buffer are allocated in */
+        std::pmr::memory_resource* resource() const { return &arena; }
+};
+
+/** A received frame, shared by all the messages deserialized from it. */
+using SharedBuffer = std::shared_ptr<const ReceiveBuffer>;
+
+/**
+ * An allocator that allocates from a ReceiveBuffer's arena. Each copy of the
+ * allocator holds a reference to the buffer, so an object created with
+ * std::allocate_shared and this allocator keeps the frame it was received in
+ * (and the memory it is stored in) alive for as long as the object exists.
+ * Deallocating is a no-op, since the arena is released all at once.
+ *
+ * Message types whose constructors are protected can declare this class a
+ * friend to be allocated with allocate_in_arena.
+ */
+template<typename T>
+class ArenaAllocator {
+    private:
+        SharedBuffer buffer;
+        template<typename U>
+        friend class ArenaAllocator;
+    public:
+        using value_type = T;
+        explicit ArenaAllocator(const SharedBuffer& buffer) : buffer(buffer) {}
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) : buffer(other.buffer) {}
+
+        T* allocate(const std::size_t n) {
+            return static_cast<T*>(buffer->resource()->allocate(n * sizeof(T), alignof(T)));
+        }
+        void deallocate(T*, std::size_t) {}
+        //Defined here, rather than left to std::allocator_traits, so that friend declarations grant it access
+        template<typename U, typename... Args>
+        void construct(U* pointer, Args&&... args) {
+            ::new(static_cast<void*>(pointer)) U(std::forward<Args>(args)...);
+        }
+        template<typename U>
+        void destroy(U* pointer) {
+            pointer->~U();
+        }
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U>& other) const { return buffer == other.buffer; }
+        template<typename U>
+        bool operator!=(const ArenaAllocator<U>& other) const { return buffer != other.buffer; }
+};
+
+/**
+ * Creates an object in the arena of a received frame.
+ * @param buffer The frame the object was deserialized from
+ * @param args The arguments to the object's constructor
+ * @return A shared_ptr to the new object, which keeps the frame alive
+ */
+template<typename T, typename... Args>
+std::shared_ptr<T> allocate_in_arena(const SharedBuffer& buffer, Args&&... args) {
+    return std::allocate_shared<T>(ArenaAllocator<T>(buffer), std::forward<Args>(args)...);
+}
+
+} /* namespace messaging */
+} /* namespace pddm */
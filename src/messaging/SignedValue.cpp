@@ -8,6 +8,7 @@
 #include "SignedValue.h"
 
 #include <cstring>
+#include <vector>
 #include <mutils-serialization/SerializationSupport.hpp>
 
 namespace pddm {
@@ -25,7 +26,8 @@ std::size_t SignedValue::bytes_size(const std::map<int, util::SignatureArray>& s
 
 std::size_t SignedValue::to_bytes(const std::map<int, util::SignatureArray>& sig_map, char * buffer) {
     std::size_t bytes_written = 0;
-    bytes_written += mutils::to_bytes(sig_map.size(), buffer);
+    //The size is an int, to match bytes_size and from_bytes_map
+    bytes_written += mutils::to_bytes(static_cast<int>(sig_map.size()), buffer);
     for(const auto& entry : sig_map) {
         bytes_written += mutils::to_bytes(entry.first, buffer + bytes_written);
         std::memcpy(buffer + bytes_written, entry.second.data(), entry.second.size() * sizeof(util::SignatureArray::value_type));
@@ -68,9 +70,11 @@ std::size_t SignedValue::to_bytes(char* buffer) const {
 }
 
 void SignedValue::post_object(const std::function<void(const char* const, std::size_t)>& function) const {
-    char buffer[bytes_size()];
-    to_bytes(buffer);
-    function(buffer, bytes_size());
+    //The MessageBodyType rewriting in to_bytes makes this easier than recursive post_object calls.
+    //Use the heap, since the signatures can make this too big for the stack.
+    std::vector<char> buffer(bytes_size());
+    to_bytes(buffer.data());
+    function(buffer.data(), buffer.size());
 }
 
 std::unique_ptr<SignedValue> SignedValue::from_bytes(mutils::DeserializationManager<>* p, const char* buffer) {
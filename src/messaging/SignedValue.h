@@ -32,8 +32,10 @@ class SignedValue : public MessageBody {
                 const std::map<int, util::SignatureArray>& signatures) :
             value(value), signatures(signatures) {}
 
+        MessageBodyType get_type() const { return type; }
+
         inline bool operator==(const MessageBody& _rhs) const {
-            if (auto* rhs = dynamic_cast<const SignedValue*>(&_rhs))
+            if (auto* rhs = body_cast<SignedValue>(&_rhs))
                 return (rhs->value == nullptr ? value == rhs->value : *value == *(rhs->value))
                         && this->signatures == rhs->signatures;
             else return false;
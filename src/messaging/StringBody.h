@@ -50,9 +50,10 @@ class StringBody : public MessageBody {
         friend std::istream& operator>>(std::istream& stream, StringBody& item);
         template<typename A>
         std::string& operator+=(A&& arg) { return data.operator+=(std::forward<A>(arg)); }
+        MessageBodyType get_type() const { return type; }
         //This is the only method that differs from std::string
         inline bool operator==(const MessageBody& _rhs) const {
-            if (auto* rhs = dynamic_cast<const StringBody*>(&_rhs))
+            if (auto* rhs = body_cast<StringBody>(&_rhs))
                 return this->data == rhs->data;
             else return false;
         }
@@ -38,8 +38,10 @@ struct ValueContribution : public MessageBody {
             value(value), signature(signature) {}
         virtual ~ValueContribution() = default;
 
+        MessageBodyType get_type() const { return type; }
+
         inline bool operator==(const MessageBody& _rhs) const {
-            if (auto* rhs = dynamic_cast<const ValueContribution*>(&_rhs))
+            if (auto* rhs = body_cast<ValueContribution>(&_rhs))
                 return this->value == rhs->value && this->signature == rhs->signature;
             else return false;
         }
@@ -0,0 +1,70 @@
+/**
+ * @file VisitBody.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <cassert>
+
+#include "AckCertificate.h"
+#include "AggregationMessage.h"
+#include "AgreementValue.h"
+#include "MessageBody.h"
+#include "MessageBodyType.h"
+#include "MulticastOverlayMessage.h"
+#include "OnionPacket.h"
+#include "OpaqueBody.h"
+#include "OverlayMessage.h"
+#include "PathOverlayMessage.h"
+#include "SignedValue.h"
+#include "StringBody.h"
+#include "ValueContribution.h"
+
+namespace pddm {
+namespace messaging {
+
+/**
+ * Calls a visitor with a MessageBody cast to its actual class, which is chosen
+ * by switching on the body's type tag. This lets code that must do something
+ * different for each kind of body be written as one overloaded function
+ * object (or a generic lambda), rather than a chain of casts.
+ * @param body The body to visit
+ * @param visitor A function object that can be called with a const reference
+ * to each MessageBody class, and returns the same type for all of them
+ * @return The visitor's return value
+ */
+template<typename Visitor>
+decltype(auto) visit_body(const MessageBody& body, Visitor&& visitor) {
+    switch(body.get_type()) {
+    case MessageBodyType::OVERLAY:
+        return visitor(static_cast<const OverlayMessage&>(body));
+    case MessageBodyType::PATH_OVERLAY:
+        return visitor(static_cast<const PathOverlayMessage&>(body));
+    case MessageBodyType::MULTICAST_OVERLAY:
+        return visitor(static_cast<const MulticastOverlayMessage&>(body));
+    case MessageBodyType::AGREEMENT_VALUE:
+        return visitor(static_cast<const AgreementValue&>(body));
+    case MessageBodyType::SIGNED_VALUE:
+        return visitor(static_cast<const SignedValue&>(body));
+    case MessageBodyType::VALUE_CONTRIBUTION:
+        return visitor(static_cast<const ValueContribution&>(body));
+    case MessageBodyType::AGGREGATION_VALUE:
+        return visitor(static_cast<const AggregationMessageValue&>(body));
+    case MessageBodyType::STRING:
+        return visitor(static_cast<const StringBody&>(body));
+    case MessageBodyType::ACK_CERTIFICATE:
+        return visitor(static_cast<const AckCertificate&>(body));
+    case MessageBodyType::ONION_PACKET:
+        return visitor(static_cast<const OnionPacket&>(body));
+    default:
+        //Every MessageBody class reports its own tag, so the only one left is OpaqueBody
+        assert(body.get_type() == MessageBodyType::OPAQUE);
+        return visitor(static_cast<const OpaqueBody&>(body));
+    }
+}
+
+} /* namespace messaging */
+} /* namespace pddm */
@@ -0,0 +1,54 @@
+/**
+ * @file WireFormat.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+
+namespace pddm {
+namespace messaging {
+
+/**
+ * The encodings that messages can be sent over the network in. Each connection
+ * uses a single WireFormat, which its sender announces when it connects, so a
+ * receiver can decode messages from senders that use different formats.
+ */
+enum class WireFormat : uint8_t {
+    /** The mutils serialization implemented by each message's to_bytes, which
+     * uses fixed-width fields. */
+    MUTILS = 0,
+    /** The encoding implemented by CompactEncoding, which uses varints for
+     * IDs, counts and round numbers, packs flags into bits, and delta-encodes paths. */
+    COMPACT = 1
+};
+
+/**
+ * The version of the layout of messages in both WireFormats, which senders
+ * announce along with their format at the start of each connection, and
+ * receivers must match. It must change whenever a layout changes in a way
+ * that an older receiver can't parse.
+ *
+ * Version 0 was never announced. Version 1 prefixes an OverlayMessage's body
+ * with its size as a size_t, rather than a bool saying whether there is a
+ * body, so a relay can skip the body without decoding it, and prefixes each
+ * message in a frame with its size.
+ */
+constexpr std::uint8_t WIRE_FORMAT_VERSION = 1;
+
+/**
+ * Thrown when received bytes are not a valid encoding of a message in the
+ * wire format they were sent in, for example because a count or size in them
+ * runs past the end of the frame, or a type tag is not one this build knows.
+ */
+class DecodeError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+};
+
+} /* namespace messaging */
+} /* namespace pddm */
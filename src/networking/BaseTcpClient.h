@@ -8,10 +8,31 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
 #include <vector>
+#include <sys/epoll.h>
+#include <moodycamel/blockingconcurrentqueue.h>
 
+#include "ConnectionManager.h"
+#include "DatagramSocket.h"
+#include "FrameReader.h"
+#include "IoUring.h"
+#include "ReactorType.h"
+#include "SendQueue.h"
+#include "SharedMemoryRing.h"
 #include "TcpAddress.h"
+#include "../Configuration.h"
+#include "../messaging/MessageType.h"
+#include "../messaging/ReceiveBuffer.h"
+#include "../messaging/WireFormat.h"
 
 namespace pddm {
 namespace networking {
@@ -23,36 +44,411 @@ class Socket;
  * TcpUtilityClient, such as the epoll monitoring loop for receiving incoming
  * messages. This class should not be used polymorphically and uses the CRTP to
  * avoid virtual function dispatch when handing off to the subclass's
- * implementation of receive_message().
+ * implementations of decode_frame() and handle_messages().
+ *
+ * Receiving is split into those two steps so that, if TCP_RECEIVE_THREADS is
+ * more than 1, frames can be decoded on the threads that receive them while
+ * all of the messages are handled on one thread.
+ *
+ * The receive loop and the writing of batched sends can use either epoll or
+ * io_uring, as chosen by the ReactorType given to the constructor.
+ *
+ * A subclass can also open a DatagramSocket to send some of its frames over
+ * UDP. The first receive thread reads the frames that arrive on it and
+ * decodes them the same way as frames from a TCP connection.
+ *
+ * If SHARED_MEMORY_TRANSPORT is true, frames for clients on the same host are
+ * written to the recipient's SharedMemoryRing instead of a TCP connection,
+ * and the first receive thread reads this client's own ring along with its
+ * connections.
+ *
+ * Instead of dedicating a thread to monitor_incoming_messages(), a program
+ * that runs many clients can share a few threads between them by calling
+ * poll_incoming_messages() whenever get_poll_fd() becomes readable (see
+ * ReactorPool).
  */
 template<typename Impl>
 class BaseTcpClient {
+    protected:
+        /** Pair associating an untyped (void*) message pointer and its (enum value) actual type. */
+        using TypeMessagePair = std::pair<messaging::MessageType, std::shared_ptr<void>>;
     private:
         Impl* impl_this;
-        void require_receive_message(const std::vector<char>& message_bytes) { impl_this->receive_message(message_bytes); }
+        void require_decode_frame(const messaging::SharedBuffer& frame, const messaging::WireFormat format,
+                std::vector<TypeMessagePair>& messages) {
+            impl_this->decode_frame(frame, format, messages);
+        }
+        void require_handle_messages(const std::vector<TypeMessagePair>& messages) {
+            impl_this->handle_messages(messages);
+        }
     protected:
-        /** Maps Meter IDs to IP address/port pairs. */
+        /** Maps Meter IDs to IP address/port pairs. This may also contain the
+         * utility's address, at entry -1. */
         std::map<int, TcpAddress> id_to_ip_map;
         /** Cache of open sockets to meters, lazily initialized (the socket
-         * is created the first time a message is sent to that meter). This
-         * may also contain a socket for the utility, at entry -1. */
+         * is created the first time a message is sent to that meter, unless
+         * prewarm_connections() opened it in advance). This may also contain
+         * a socket for the utility, at entry -1. */
         std::map<int, Socket> sockets_by_id;
+        /** Opens the sockets in sockets_by_id, with timeouts and backoff */
+        ConnectionManager connections;
+        /** The frames waiting to be written to each socket in sockets_by_id, at the same index */
+        std::map<int, SendQueue> send_queues;
+        /** Buffers for building the frames sent on each socket in sockets_by_id,
+         * at the same index, which are reused so that sends don't allocate. */
+        std::map<int, std::vector<char>> send_buffers;
+        /** Scratch space for the sizes of the messages in a frame */
+        std::vector<std::size_t> message_sizes;
+        /** A UDP socket on the same port as the listening socket, if open_datagram_socket() was called */
+        std::unique_ptr<DatagramSocket> datagram_socket;
     private:
-        /** File descriptor for monitoring incoming connections */
-        int epoll_fd;
-        int server_socket_fd;
+        /** The size of the buffer that incoming connections are read into before their bytes are split into frames */
+        static constexpr std::size_t READ_BUFFER_SIZE = 64 * 1024;
+        /** The most bytes read from one connection before the others get a turn */
+        static constexpr std::size_t MAX_READ_PER_TURN = 4 * READ_BUFFER_SIZE;
+        /** The number of requests each io_uring can hold before they are submitted */
+        static constexpr unsigned IO_URING_ENTRIES = 1024;
+        /** The number and size of the buffers each io_uring receive thread gives the kernel to read into */
+        static constexpr unsigned short IO_URING_RECEIVE_BUFFERS = 128;
+        static constexpr std::size_t IO_URING_RECEIVE_BUFFER_SIZE = 8 * 1024;
+        /** True if this client uses io_uring instead of epoll */
+        const bool use_io_uring;
+        /** File descriptors for monitoring incoming connections, one for each receive thread */
+        std::vector<int> epoll_fds;
+        /** The listening socket of each receive thread, at the same index as its epoll_fd */
+        std::vector<int> server_socket_fds;
+        /** Batches of messages decoded by the receive threads, waiting to be handled,
+         * if there is more than one receive thread */
+        moodycamel::BlockingConcurrentQueue<std::vector<TypeMessagePair>> received_messages;
+        /** The event sources that have become readable, by FD, waiting for
+         * the thread that handles messages to run them, if there is more
+         * than one receive thread */
+        moodycamel::ConcurrentQueue<int> ready_event_sources;
         std::atomic<bool> shutdown;
+        /** The ID each socket in sockets_by_id is connected to, indexed by FD
+         * since that's all epoll reports when a socket becomes writable */
+        std::map<int, int> ids_by_socket_fd;
+        /** A socket in sockets_by_id whose connection has not opened yet */
+        struct PendingConnection {
+            std::chrono::steady_clock::time_point deadline;
+            /** False if the connection was opened in advance, so failing is not held against the meter */
+            bool record_failure;
+        };
+        /** The sockets whose connections are still opening, by ID */
+        std::map<int, PendingConnection> pending_connections;
+        /** The IDs of the meters whose connections failed to open since the
+         * last call to take_failed_connections() */
+        std::set<int> failed_connection_ids;
+        /** Set when a connection fails to open, so the receive loop can hand
+         * the failure to the message handler */
+        std::atomic<bool> connection_failed;
+        /** Guards sockets_by_id, send_queues, and ids_by_socket_fd, since
+         * queued frames are written by the receive thread while other
+         * threads send new ones */
+        std::mutex send_mutex;
+        /** Submits the writes of batched sends, if use_io_uring */
+        std::unique_ptr<IoUring> send_ring;
+        /** True between begin_send_batch() and end_send_batch() */
+        bool batching_sends;
+        /** The IDs of the sockets whose queues have frames appended since begin_send_batch() */
+        std::set<int> batched_send_ids;
+        /** The ring other clients on this host send to this client through, if SHARED_MEMORY_TRANSPORT */
+        std::unique_ptr<SharedMemoryRing> shared_memory_ring;
+        /** The rings of the clients on this host that have been sent frames, by ID.
+         * Guarded by send_mutex, like sockets_by_id. */
+        std::map<int, std::unique_ptr<SharedMemoryRing>> rings_by_id;
+        /** Functions to call when other file descriptors watched by the first receive thread
+         * become readable, such as a timer manager's timerfd, by FD */
+        std::map<int, std::function<void(void)>> event_sources;
+        /** Scratch space for the frames read from datagram_socket or shared_memory_ring */
+        std::vector<DatagramSocket::ReceivedFrame> received_frames;
+        /** The state of an epoll receive loop, which is kept between turns of the loop */
+        struct EpollReceiveState {
+            /** The read state of each connection, indexed by FD since that's all the information we get when a socket has data */
+            std::map<int, FrameReader> frame_readers;
+            /** Connections that still had bytes to read when their turn ended, which edge-triggered epoll won't report again */
+            std::set<int> unfinished_fds;
+            std::vector<int> fds_to_continue;
+            std::vector<epoll_event> events;
+            std::vector<messaging::SharedBuffer> complete_frames;
+            std::vector<TypeMessagePair> decoded_messages;
+            EpollReceiveState() : events(64) {}
+        };
+        /** The receive state of the first reactor when it is driven by poll_incoming_messages(),
+         * created by the first call */
+        std::unique_ptr<EpollReceiveState> polled_receive_state;
+        /**
+         * Closes the socket to a meter and drops any frames still queued for
+         * it. The caller must hold send_mutex.
+         * @param recipient_id The ID of the meter
+         */
+        void close_socket(const int recipient_id);
+        /**
+         * Starts connecting to a meter, and adds the connecting socket to
+         * sockets_by_id. Frames sent to it are queued until the connection
+         * opens. The caller must hold send_mutex.
+         * @param recipient_id The ID of the meter
+         * @param record_failure Whether failing to connect should start the
+         * meter's backoff delay and be reported as a send failure
+         * @return The connecting socket, or null if the connection could not
+         * even be started
+         */
+        Socket* start_connection(const int recipient_id, const bool record_failure);
+        /**
+         * Closes a socket whose connection failed to open, and reports the
+         * failure if the connection was started by a send. The caller must
+         * hold send_mutex.
+         * @param recipient_id The ID of the meter
+         */
+        void fail_connection(const int recipient_id);
+        /**
+         * Fails the connections that have been opening for longer than
+         * CONNECT_TIMEOUT. The caller must hold send_mutex.
+         */
+        void expire_pending_connections();
+        /**
+         * If a connection has failed to open since the last call, passes an
+         * empty batch of messages to deliver, so that the subclass's
+         * handle_messages() runs and can collect the failure with
+         * take_failed_connections(). This also expires connections that have
+         * taken too long to open.
+         * @param deliver The receive loop's function for delivering messages
+         * @param decoded_messages A vector to deliver, which is cleared first
+         */
+        template<typename DeliverFunc>
+        void deliver_connection_failures(DeliverFunc& deliver, std::vector<TypeMessagePair>& decoded_messages);
+        /**
+         * Handles an epoll event on an outgoing socket by writing its queued
+         * frames, or releasing the buffers of frames the kernel has finished
+         * sending with MSG_ZEROCOPY. The first event on a connecting socket
+         * says whether its connection opened. If the connection has failed,
+         * the socket is closed, so that the next send will try to reconnect.
+         * @param socket_fd The socket's file descriptor
+         * @param events The epoll events reported for it
+         */
+        void handle_send_event(const int socket_fd, const std::uint32_t events);
+        /**
+         * Reads the datagrams waiting on datagram_socket, and decodes the
+         * frames they complete.
+         * @param decoded_messages The vector to add the decoded messages to
+         */
+        void receive_datagrams(std::vector<TypeMessagePair>& decoded_messages);
+        /**
+         * Reads the frames waiting in shared_memory_ring, and decodes them.
+         * @param decoded_messages The vector to add the decoded messages to
+         */
+        void receive_shared_memory_frames(std::vector<TypeMessagePair>& decoded_messages);
+        /**
+         * Runs the function of an event source that has become readable. If
+         * there is more than one receive thread, this passes it to the thread
+         * that handles messages instead, which runs it with
+         * run_ready_event_sources().
+         * @param fd The event source's file descriptor
+         */
+        void handle_event_source(const int fd);
+        /** Runs the event sources passed to the thread that handles messages, and watches them again */
+        void run_ready_event_sources();
+        /**
+         * Accepts connections on one listening socket and reads frames from
+         * them until shut_down() is called, decoding each batch of frames
+         * that arrives together and passing the decoded messages to a function.
+         * @param reactor The index of the listening socket and epoll_fd to use
+         * @param deliver A function to call with each batch of decoded
+         * messages, which may leave the vector empty or unchanged
+         */
+        template<typename DeliverFunc>
+        void run_receive_loop(const std::size_t reactor, DeliverFunc&& deliver);
+        /** The implementation of run_receive_loop() that waits with epoll */
+        template<typename DeliverFunc>
+        void run_epoll_receive_loop(const std::size_t reactor, DeliverFunc&& deliver);
+        /**
+         * Runs one turn of the epoll receive loop: waits for events on one
+         * reactor's epoll_fd, handles them, and gives another turn to the
+         * connections that had more to read at the end of the last turn.
+         * @param reactor The index of the listening socket and epoll_fd to use
+         * @param state The loop's state, which persists between turns
+         * @param read_buffer The buffer to read connections into, of size
+         * READ_BUFFER_SIZE, which holds nothing between turns
+         * @param timeout_ms How long to wait for events if no connection has
+         * bytes left over from the last turn
+         * @param deliver A function to call with each batch of decoded messages
+         */
+        template<typename DeliverFunc>
+        void run_epoll_turn(const std::size_t reactor, EpollReceiveState& state, std::vector<char>& read_buffer,
+                const int timeout_ms, DeliverFunc& deliver);
+        /**
+         * Reads one incoming connection for at most MAX_READ_PER_TURN bytes,
+         * decodes the frames it completes, and closes it if the sender has.
+         * @param state The receive loop's state, which has the connection's FrameReader
+         * @param read_buffer The buffer to read the connection into
+         * @param socket_fd The connection's file descriptor
+         * @param deliver A function to call with the decoded messages
+         */
+        template<typename DeliverFunc>
+        void read_epoll_connection(EpollReceiveState& state, std::vector<char>& read_buffer, const int socket_fd,
+                DeliverFunc& deliver);
+        /** The implementation of run_receive_loop() that waits with io_uring */
+        template<typename DeliverFunc>
+        void run_io_uring_receive_loop(const std::size_t reactor, DeliverFunc&& deliver);
     protected:
-        BaseTcpClient(Impl* subclass_this, const TcpAddress& my_address, const std::map<int, TcpAddress>& meter_ips_by_id);
+        /**
+         * Starts listening for connections on a TCP address.
+         * @param subclass_this The subclass object, for the CRTP
+         * @param my_address The address to listen on
+         * @param meter_ips_by_id The addresses of the meters, by ID
+         * @param reactor_type The system calls to receive and send with. If
+         * this is IO_URING and the kernel doesn't support it, the client
+         * prints a warning and uses EPOLL instead.
+         */
+        BaseTcpClient(Impl* subclass_this, const TcpAddress& my_address, const std::map<int, TcpAddress>& meter_ips_by_id,
+                const ReactorType reactor_type = TCP_REACTOR);
         virtual ~BaseTcpClient();
+        /**
+         * Adds a newly connected socket to sockets_by_id, gives it a send
+         * queue, and announces the wire format on it. The socket is made
+         * nonblocking and monitored by the first receive thread's epoll_fd,
+         * which writes its queue whenever it becomes writable. The caller
+         * must hold send_mutex, unless no other thread can be using this
+         * client yet.
+         * @param recipient_id The ID of the meter the socket is connected to
+         * @param socket The socket
+         * @return A pointer to the socket in sockets_by_id
+         */
+        Socket* add_socket(const int recipient_id, Socket&& socket);
+        /**
+         * Opens datagram_socket on a port, and has the first receive thread
+         * monitor it. This must be called before monitor_incoming_messages().
+         * @param port The port to receive datagrams on, which is usually the
+         * port this client listens for TCP connections on
+         */
+        void open_datagram_socket(const int port);
+        /**
+         * Gets the socket connected to a meter, starting a connection to the
+         * meter if there is not already a socket for it in sockets_by_id.
+         * This never waits for the connection to open: frames are queued on
+         * it until it does, and if it fails or takes longer than
+         * CONNECT_TIMEOUT, the failure is reported by take_failed_connections().
+         * No connection is started if the meter could not be reached
+         * recently. The caller must hold send_mutex.
+         * @param recipient_id The ID of the meter
+         * @return The socket for that meter, or null if it could not be reached
+         */
+        Socket* get_socket(const int recipient_id);
+        /**
+         * Gets the shared memory ring of a meter on this host, opening it if
+         * this client hasn't sent to it yet. A meter that this client already
+         * has a TCP connection to keeps using it, so that its frames aren't
+         * reordered. The caller must hold send_mutex.
+         * @param recipient_id The ID of the meter
+         * @return The meter's ring, or null if SHARED_MEMORY_TRANSPORT is
+         * false or the meter has no ring that can be used
+         */
+        SharedMemoryRing* get_shared_memory_ring(const int recipient_id);
+        /**
+         * Sends a frame to a meter, connecting to the meter if necessary.
+         * This never waits for the meter to read the frame: whatever part of
+         * it the socket can't take right away is queued and written when the
+         * socket becomes writable. If the connection has failed, the socket
+         * is closed, so that the next send will try to reconnect (after a
+         * backoff delay).
+         * @param recipient_id The ID of the meter
+         * @param frame The bytes to send. If they have to be queued, the
+         * queue takes this vector's buffer and leaves it empty.
+         * @return True if the frame was sent or queued, false if the meter
+         * could not be reached or already has too much queued for it to
+         * take this frame (see MAX_QUEUED_SEND_BYTES). During a batch of sends, a connection that
+         * fails while the frame is written is reported by end_send_batch(),
+         * and a connection that fails to open is reported by
+         * take_failed_connections().
+         */
+        bool send_frame(const int recipient_id, std::vector<char>& frame);
+        /**
+         * Takes the IDs of the meters whose connections, started by sends,
+         * failed to open (or timed out) since the last call. The frames that
+         * were queued for them were dropped, so these should be treated as
+         * send failures. The receive loop calls the subclass's
+         * handle_messages() after such a failure, even if no messages arrived,
+         * so it can call this.
+         * @return The IDs of the meters
+         */
+        std::set<int> take_failed_connections();
+        /**
+         * Announces WIRE_FORMAT and the version of the frame layout on a
+         * newly connected socket, which receivers require before any frame.
+         * @param queue The send queue of a socket that has not been written to yet
+         */
+        static void announce_wire_format(SendQueue& queue);
+        /**
+         * Starts a batch of sends. Until end_send_batch() is called, frames
+         * passed to send_frame() are queued without being written, if this
+         * client uses io_uring, so that all of their writes can be submitted
+         * together. With epoll, sends are written immediately as usual.
+         */
+        void begin_send_batch();
+        /**
+         * Ends a batch of sends by submitting the writes of every socket
+         * that was sent a frame since begin_send_batch(), with a single
+         * system call if this client uses io_uring.
+         * @return The IDs of the meters whose connections failed while
+         * writing the batch, which were treated as send failures
+         */
+        std::set<int> end_send_batch();
     public:
+        /**
+         * Opens connections to a set of meters in advance, so that the first
+         * messages sent to them don't have to wait for a connection. The
+         * connections are started without waiting for them to open. Meters
+         * that can't be reached yet are left to be connected when they are
+         * first sent a message, and are not treated as failed.
+         * @param meter_ids The IDs of the meters to connect to
+         */
+        void prewarm_connections(const std::set<int>& meter_ids);
+        /**
+         * Has the thread that handles messages call a function whenever a
+         * file descriptor becomes readable, so that other sources of events
+         * can share its loop. The first receive thread watches the file
+         * descriptor; if TCP_RECEIVE_THREADS is more than 1, it hands the
+         * event to the thread that handles messages, and doesn't watch the
+         * file descriptor again until the function has run there. This must
+         * be called before monitor_incoming_messages() or
+         * poll_incoming_messages().
+         * @param fd The file descriptor to watch, which is level-triggered,
+         * so the function should read from it until it is no longer readable
+         * @param on_readable The function to call
+         */
+        void add_event_source(const int fd, std::function<void(void)> on_readable);
         /**
          * Loops forever, waiting for incoming connections and calling the subclass's
-         * receive_message() when a connected client sends a complete message.
+         * handle_messages() with the messages in the frames each connected
+         * client sends. Connections are read without blocking, a limited
+         * number of bytes at a time, so a client that sends slowly or sends a
+         * lot can't delay the messages from other clients. If
+         * TCP_RECEIVE_THREADS is more than 1, this starts that many threads to
+         * receive and decode messages, and only handles them on this thread.
          * Calls to this function will not return, so client applications must
          * dedicate a thread to it.
          */
         void monitor_incoming_messages();
+        /**
+         * Does the work that has arrived for this client, as one turn of the
+         * monitor_incoming_messages() loop, without waiting for more: accepts
+         * connections, reads frames and calls the subclass's handle_messages()
+         * with their messages, and writes queued sends. This lets a program
+         * drive many clients from a small number of its own threads instead
+         * of calling monitor_incoming_messages() for each of them. It must
+         * not be called concurrently for the same client, or by a client
+         * that uses io_uring, and it only reads from the first listening
+         * socket, so TCP_RECEIVE_THREADS should be 1.
+         * @return True if some connections still have bytes to read, so this
+         * should be called again even if get_poll_fd() doesn't become readable
+         */
+        bool poll_incoming_messages();
+        /**
+         * @return A file descriptor that becomes readable when there is work
+         * for poll_incoming_messages() to do, which can be monitored by
+         * another epoll instance
+         */
+        int get_poll_fd() const { return epoll_fds.front(); }
         /**
          * Shuts down the monitor_incoming_messages() loop. Can be called from a
          * different thread to allow the monitor_incoming_messages() thread to
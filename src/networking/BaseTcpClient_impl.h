@@ -5,7 +5,16 @@
  * @author edward
  */
 
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
 #include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <pthread.h>
 #include <sys/socket.h>
 #include <sys/epoll.h>
 #include <arpa/inet.h>
@@ -16,167 +25,753 @@
 #include <iostream>
 
 #include "BaseTcpClient.h"
+#include "FrameReader.h"
+#include "MessageFraming.h"
 #include "Socket.h"
+#include "../Configuration.h"
 
 namespace pddm {
 namespace networking {
 
 template<typename Impl>
 BaseTcpClient<Impl>::BaseTcpClient(Impl* subclass_this, const TcpAddress& my_address,
-        const std::map<int, TcpAddress>& meter_ips_by_id) :
+        const std::map<int, TcpAddress>& meter_ips_by_id, const ReactorType reactor_type) :
         impl_this(subclass_this),
         id_to_ip_map(meter_ips_by_id),
-        shutdown(false) {
-    //Create socket
-    server_socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if(server_socket_fd < 0) throw connection_failure("Could not create a socket to listen for incoming connections.");
-    int reuse_addr = 1;
-    setsockopt(server_socket_fd, SOL_SOCKET, SO_REUSEADDR, (char *)&reuse_addr, sizeof(reuse_addr));
-
-    //Bind socket to my port
-    sockaddr_in my_address_c;
-    memset(&my_address_c, 0, sizeof(my_address_c));
-    my_address_c.sin_family = AF_INET;
-    my_address_c.sin_addr.s_addr = INADDR_ANY;
-    my_address_c.sin_port = htons(my_address.port);
-    if(bind(server_socket_fd, (sockaddr*) &my_address_c, sizeof(my_address_c)) < 0) {
-        fprintf(stderr, "Error binding to socket on port %d: %s", my_address.port, strerror(errno));
-        throw connection_failure("Bind failure.");
-    }
-    //Make socket nonblocking
-    int flags;
-    flags = fcntl(server_socket_fd, F_GETFL, 0);
-    flags |= O_NONBLOCK;
-    if(fcntl(server_socket_fd, F_SETFL, flags) < 0) {
-        throw connection_failure("Failed to set listening socket to nonblocking!");
-    }
-
-    //Setup epoll to listen on socket
-    listen(server_socket_fd, SOMAXCONN);
-    epoll_fd = epoll_create1(0);
-    if(epoll_fd < 0) throw connection_failure("Could not create an epoll instance in TcpNetworkClient.");
-    struct epoll_event event;
-    memset(&event, 0, sizeof(event));
-    event.data.fd = server_socket_fd;
-    event.events = EPOLLIN;
-    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_socket_fd, &event);
+        use_io_uring(reactor_type == ReactorType::IO_URING && IoUring::is_supported()),
+        shutdown(false),
+        connection_failed(false),
+        batching_sends(false) {
+    if(reactor_type == ReactorType::IO_URING && !use_io_uring) {
+        fprintf(stderr, "WARNING: This kernel does not support io_uring, so TCP clients will use epoll instead\n");
+    }
+    if(use_io_uring) {
+        send_ring = std::make_unique<IoUring>(IO_URING_ENTRIES);
+    }
+    //Create the ring before listening, so any client on this host that can connect to this one can also find its ring
+    if(SHARED_MEMORY_TRANSPORT) {
+        shared_memory_ring = std::make_unique<SharedMemoryRing>(my_address.port, SharedMemoryRing::Role::RECEIVER);
+    }
+    //Each receive thread gets its own listening socket on the same port, which the kernel balances connections across
+    for(int reactor = 0; reactor < std::max(TCP_RECEIVE_THREADS, 1); ++reactor) {
+        //Create socket
+        int server_socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(server_socket_fd < 0) throw connection_failure("Could not create a socket to listen for incoming connections.");
+        int reuse_addr = 1;
+        setsockopt(server_socket_fd, SOL_SOCKET, SO_REUSEADDR, (char *)&reuse_addr, sizeof(reuse_addr));
+        if(TCP_RECEIVE_THREADS > 1) {
+            setsockopt(server_socket_fd, SOL_SOCKET, SO_REUSEPORT, (char *)&reuse_addr, sizeof(reuse_addr));
+        }
+
+        //Bind socket to my port
+        sockaddr_in my_address_c;
+        memset(&my_address_c, 0, sizeof(my_address_c));
+        my_address_c.sin_family = AF_INET;
+        my_address_c.sin_addr.s_addr = INADDR_ANY;
+        my_address_c.sin_port = htons(my_address.port);
+        if(bind(server_socket_fd, (sockaddr*) &my_address_c, sizeof(my_address_c)) < 0) {
+            fprintf(stderr, "Error binding to socket on port %d: %s", my_address.port, strerror(errno));
+            throw connection_failure("Bind failure.");
+        }
+        //Make socket nonblocking
+        int flags;
+        flags = fcntl(server_socket_fd, F_GETFL, 0);
+        flags |= O_NONBLOCK;
+        if(fcntl(server_socket_fd, F_SETFL, flags) < 0) {
+            throw connection_failure("Failed to set listening socket to nonblocking!");
+        }
+
+        //Setup epoll to listen on socket
+        listen(server_socket_fd, SOMAXCONN);
+        int epoll_fd = epoll_create1(0);
+        if(epoll_fd < 0) throw connection_failure("Could not create an epoll instance in TcpNetworkClient.");
+        //With io_uring, the ring accepts connections itself, and epoll only watches outgoing sockets
+        if(!use_io_uring) {
+            struct epoll_event event;
+            memset(&event, 0, sizeof(event));
+            event.data.fd = server_socket_fd;
+            event.events = EPOLLIN;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_socket_fd, &event);
+        }
+        server_socket_fds.push_back(server_socket_fd);
+        epoll_fds.push_back(epoll_fd);
+    }
+    if(shared_memory_ring) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.data.fd = shared_memory_ring->get_event_fd();
+        event.events = EPOLLIN;
+        epoll_ctl(epoll_fds.front(), EPOLL_CTL_ADD, shared_memory_ring->get_event_fd(), &event);
+    }
 }
 
 template<typename Impl>
 BaseTcpClient<Impl>::~BaseTcpClient() {
     shutdown = true;
-    close(server_socket_fd);
+    for(const int server_socket_fd : server_socket_fds) {
+        close(server_socket_fd);
+    }
+}
+
+template<typename Impl>
+Socket* BaseTcpClient<Impl>::add_socket(const int recipient_id, Socket&& socket) {
+    const int socket_fd = socket.get_fd();
+    //Writes go through the send queue, which must never block
+    fcntl(socket_fd, F_SETFL, fcntl(socket_fd, F_GETFL, 0) | O_NONBLOCK);
+    Socket* added_socket = &(sockets_by_id[recipient_id] = std::move(socket));
+    ids_by_socket_fd[socket_fd] = recipient_id;
+    SendQueue& queue = send_queues.emplace(recipient_id, SendQueue(socket_fd)).first->second;
+    announce_wire_format(queue);
+    //Edge-triggered, since a queue is written until it's empty or the socket is full
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.data.fd = socket_fd;
+    event.events = EPOLLOUT | EPOLLET;
+    if(epoll_ctl(epoll_fds.front(), EPOLL_CTL_ADD, socket_fd, &event) == -1) {
+        perror("Error in epoll_ctl");
+    }
+    return added_socket;
+}
+
+template<typename Impl>
+void BaseTcpClient<Impl>::open_datagram_socket(const int port) {
+    datagram_socket = std::make_unique<DatagramSocket>(port);
+    //Edge-triggered, since every waiting datagram is read each time
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.data.fd = datagram_socket->get_fd();
+    event.events = EPOLLIN | EPOLLET;
+    if(epoll_ctl(epoll_fds.front(), EPOLL_CTL_ADD, datagram_socket->get_fd(), &event) == -1) {
+        perror("Error in epoll_ctl");
+    }
+}
+
+template<typename Impl>
+void BaseTcpClient<Impl>::receive_datagrams(std::vector<TypeMessagePair>& decoded_messages) {
+    received_frames.clear();
+    datagram_socket->receive(received_frames);
+    for(const auto& frame_format : received_frames) {
+        impl_this->decode_frame(frame_format.first, frame_format.second, decoded_messages);
+    }
+}
+
+template<typename Impl>
+void BaseTcpClient<Impl>::receive_shared_memory_frames(std::vector<TypeMessagePair>& decoded_messages) {
+    received_frames.clear();
+    shared_memory_ring->read_all(received_frames);
+    for(const auto& frame_format : received_frames) {
+        impl_this->decode_frame(frame_format.first, frame_format.second, decoded_messages);
+    }
+}
+
+template<typename Impl>
+void BaseTcpClient<Impl>::close_socket(const int recipient_id) {
+    auto socket_map_find = sockets_by_id.find(recipient_id);
+    if(socket_map_find == sockets_by_id.end()) {
+        return;
+    }
+    ids_by_socket_fd.erase(socket_map_find->second.get_fd());
+    send_queues.erase(recipient_id);
+    pending_connections.erase(recipient_id);
+    //Closing the socket also removes it from the epoll set
+    sockets_by_id.erase(socket_map_find);
+}
+
+template<typename Impl>
+void BaseTcpClient<Impl>::add_event_source(const int fd, std::function<void(void)> on_readable) {
+    event_sources[fd] = std::move(on_readable);
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.data.fd = fd;
+    //With more than one receive thread, the FD is watched again only after the handler thread has run its function
+    event.events = TCP_RECEIVE_THREADS > 1 ? EPOLLIN | EPOLLONESHOT : EPOLLIN;
+    if(epoll_ctl(epoll_fds.front(), EPOLL_CTL_ADD, fd, &event) == -1) {
+        perror("Error in epoll_ctl");
+    }
+}
+
+template<typename Impl>
+void BaseTcpClient<Impl>::handle_event_source(const int fd) {
+    if(TCP_RECEIVE_THREADS <= 1) {
+        event_sources.at(fd)();
+        return;
+    }
+    ready_event_sources.enqueue(fd);
+    //Wake the handler thread, in case it is waiting for messages
+    received_messages.enqueue(std::vector<TypeMessagePair>());
+}
+
+template<typename Impl>
+void BaseTcpClient<Impl>::run_ready_event_sources() {
+    int fd;
+    while(ready_event_sources.try_dequeue(fd)) {
+        event_sources.at(fd)();
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.data.fd = fd;
+        event.events = EPOLLIN | EPOLLONESHOT;
+        epoll_ctl(epoll_fds.front(), EPOLL_CTL_MOD, fd, &event);
+    }
+}
+
+template<typename Impl>
+Socket* BaseTcpClient<Impl>::get_socket(const int recipient_id) {
+    auto socket_map_find = sockets_by_id.find(recipient_id);
+    if(socket_map_find != sockets_by_id.end()) {
+        return &socket_map_find->second;
+    }
+    //Try to connect to this node if there is not already a socket for it in the map
+    if(!connections.should_attempt(recipient_id)) {
+        return nullptr;
+    }
+    return start_connection(recipient_id, true);
+}
+
+template<typename Impl>
+Socket* BaseTcpClient<Impl>::start_connection(const int recipient_id, const bool record_failure) {
+    Socket socket = connections.start_connect(id_to_ip_map.at(recipient_id));
+    if(socket.is_empty()) {
+        if(record_failure) {
+            connections.record_failure(recipient_id);
+        }
+        return nullptr;
+    }
+    Socket* added_socket = add_socket(recipient_id, std::move(socket));
+    //The socket becomes writable when the connection opens, which is reported to handle_send_event()
+    send_queues.at(recipient_id).wait_until_writable();
+    pending_connections[recipient_id] = {std::chrono::steady_clock::now() + std::chrono::milliseconds(CONNECT_TIMEOUT),
+            record_failure};
+    return added_socket;
+}
+
+template<typename Impl>
+void BaseTcpClient<Impl>::fail_connection(const int recipient_id) {
+    auto pending_find = pending_connections.find(recipient_id);
+    const bool record_failure = pending_find == pending_connections.end() || pending_find->second.record_failure;
+    close_socket(recipient_id);
+    if(record_failure) {
+        connections.record_failure(recipient_id);
+        failed_connection_ids.insert(recipient_id);
+        connection_failed = true;
+    }
+}
+
+template<typename Impl>
+void BaseTcpClient<Impl>::expire_pending_connections() {
+    const auto now = std::chrono::steady_clock::now();
+    for(auto pending_iter = pending_connections.begin(); pending_iter != pending_connections.end(); ) {
+        const int recipient_id = pending_iter->first;
+        ++pending_iter;
+        if(pending_connections.at(recipient_id).deadline <= now) {
+            fail_connection(recipient_id);
+        }
+    }
+}
+
+template<typename Impl>
+std::set<int> BaseTcpClient<Impl>::take_failed_connections() {
+    std::lock_guard<std::mutex> lock(send_mutex);
+    std::set<int> failed_ids;
+    failed_ids.swap(failed_connection_ids);
+    return failed_ids;
+}
+
+template<typename Impl>
+template<typename DeliverFunc>
+void BaseTcpClient<Impl>::deliver_connection_failures(DeliverFunc& deliver, std::vector<TypeMessagePair>& decoded_messages) {
+    {
+        std::lock_guard<std::mutex> lock(send_mutex);
+        if(!pending_connections.empty()) {
+            expire_pending_connections();
+        }
+    }
+    if(connection_failed.exchange(false)) {
+        decoded_messages.clear();
+        deliver(decoded_messages);
+    }
+}
+
+template<typename Impl>
+SharedMemoryRing* BaseTcpClient<Impl>::get_shared_memory_ring(const int recipient_id) {
+    if(!SHARED_MEMORY_TRANSPORT) {
+        return nullptr;
+    }
+    auto ring_find = rings_by_id.find(recipient_id);
+    if(ring_find != rings_by_id.end()) {
+        return ring_find->second.get();
+    }
+    if(sockets_by_id.find(recipient_id) != sockets_by_id.end() || !connections.should_attempt(recipient_id)
+            || !connections.is_local(id_to_ip_map.at(recipient_id))) {
+        return nullptr;
+    }
+    try {
+        auto ring = std::make_unique<SharedMemoryRing>(id_to_ip_map.at(recipient_id).port, SharedMemoryRing::Role::SENDER);
+        return rings_by_id.emplace(recipient_id, std::move(ring)).first->second.get();
+    } catch(const connection_failure&) {
+        //The recipient isn't running, or doesn't use shared memory, so try TCP
+        return nullptr;
+    }
+}
+
+template<typename Impl>
+bool BaseTcpClient<Impl>::send_frame(const int recipient_id, std::vector<char>& frame) {
+    std::lock_guard<std::mutex> lock(send_mutex);
+    SharedMemoryRing* ring = get_shared_memory_ring(recipient_id);
+    //A frame too large for the ring goes over TCP, which may deliver it out of order
+    if(ring != nullptr && frame.size() <= ring->max_frame_size()) {
+        if(ring->write(frame, WIRE_FORMAT)) {
+            return true;
+        }
+        //The recipient is gone or stuck; treat it like one that couldn't be connected to
+        rings_by_id.erase(recipient_id);
+        connections.record_failure(recipient_id);
+        return false;
+    }
+    if(!pending_connections.empty()) {
+        expire_pending_connections();
+    }
+    if(get_socket(recipient_id) == nullptr) {
+        return false;
+    }
+    //A peer that has fallen this far behind is treated as failed rather than buffered for
+    if(!send_queues.at(recipient_id).has_room_for(frame.size())) {
+        return false;
+    }
+    if(batching_sends) {
+        send_queues.at(recipient_id).append(frame);
+        batched_send_ids.insert(recipient_id);
+        return true;
+    }
+    if(send_queues.at(recipient_id).enqueue(frame) == SendQueue::Status::FAILED) {
+        //The connection is broken; treat the recipient like one that couldn't be connected to
+        close_socket(recipient_id);
+        connections.record_failure(recipient_id);
+        return false;
+    }
+    return true;
+}
+
+template<typename Impl>
+void BaseTcpClient<Impl>::handle_send_event(const int socket_fd, const std::uint32_t events) {
+    std::lock_guard<std::mutex> lock(send_mutex);
+    auto id_find = ids_by_socket_fd.find(socket_fd);
+    if(id_find == ids_by_socket_fd.end()) {
+        return;
+    }
+    const int recipient_id = id_find->second;
+    auto pending_find = pending_connections.find(recipient_id);
+    if(pending_find != pending_connections.end()) {
+        //This is the end of a nonblocking connect, which either opened the connection or failed
+        if((events & (EPOLLERR | EPOLLHUP)) || !ConnectionManager::finish_connect(socket_fd)) {
+            fail_connection(recipient_id);
+            return;
+        }
+        pending_connections.erase(pending_find);
+        connections.record_success(recipient_id);
+    }
+    SendQueue& queue = send_queues.at(recipient_id);
+    //MSG_ZEROCOPY completions are reported on the socket's error queue
+    if(events & EPOLLERR) {
+        queue.reap_zerocopy_completions();
+    }
+    if(queue.flush() == SendQueue::Status::FAILED || (events & EPOLLHUP)) {
+        close_socket(recipient_id);
+        connections.record_failure(recipient_id);
+    }
+}
+
+template<typename Impl>
+void BaseTcpClient<Impl>::prewarm_connections(const std::set<int>& meter_ids) {
+    std::lock_guard<std::mutex> lock(send_mutex);
+    for(const int meter_id : meter_ids) {
+        //Meters on this host are reached through their rings, which are opened here too
+        if(sockets_by_id.find(meter_id) == sockets_by_id.end() && get_shared_memory_ring(meter_id) == nullptr) {
+            start_connection(meter_id, false);
+        }
+    }
+}
+
+template<typename Impl>
+void BaseTcpClient<Impl>::announce_wire_format(SendQueue& queue) {
+    std::uint64_t announcement = wire_format_announcement(WIRE_FORMAT);
+    std::vector<char> announcement_bytes((char*) &announcement, (char*) &announcement + sizeof(announcement));
+    queue.enqueue(announcement_bytes);
+}
+
+template<typename Impl>
+void BaseTcpClient<Impl>::begin_send_batch() {
+    std::lock_guard<std::mutex> lock(send_mutex);
+    //Deferring writes only helps if they can all be submitted at once
+    batching_sends = use_io_uring;
+}
+
+template<typename Impl>
+std::set<int> BaseTcpClient<Impl>::end_send_batch() {
+    std::lock_guard<std::mutex> lock(send_mutex);
+    batching_sends = false;
+    std::set<int> failed_ids;
+    unsigned num_writes = 0;
+    for(const int recipient_id : batched_send_ids) {
+        auto queue_find = send_queues.find(recipient_id);
+        const msghdr* message = queue_find == send_queues.end() ? nullptr : queue_find->second.prepare_write();
+        if(message == nullptr) {
+            continue;
+        }
+        io_uring_sqe* sqe = send_ring->get_sqe();
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = sockets_by_id.at(recipient_id).get_fd();
+        sqe->addr = reinterpret_cast<std::uint64_t>(message);
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+        sqe->user_data = static_cast<std::uint32_t>(recipient_id);
+        ++num_writes;
+    }
+    batched_send_ids.clear();
+    unsigned num_finished = 0;
+    while(num_finished < num_writes) {
+        //The sockets are nonblocking, so every write finishes without waiting for its recipient
+        send_ring->submit_and_wait(num_writes - num_finished);
+        num_finished += send_ring->for_each_completion([&](const io_uring_cqe& completion) {
+            const int recipient_id = static_cast<std::int32_t>(completion.user_data);
+            if(send_queues.at(recipient_id).finish_write(completion.res) == SendQueue::Status::FAILED) {
+                failed_ids.insert(recipient_id);
+            }
+        });
+    }
+    //Close the failed sockets only after every write has finished, since their queues were being written
+    for(const int recipient_id : failed_ids) {
+        close_socket(recipient_id);
+        connections.record_failure(recipient_id);
+    }
+    return failed_ids;
 }
 
 template<typename Impl>
 void BaseTcpClient<Impl>::shut_down() {
     shutdown = true;
-    //Open and close a connection to myself to make epoll_wait wake up and do nothing
+    //Open and close a connection to myself to make epoll_wait wake up and do nothing (other receive threads time out)
     sockaddr_in my_address;
     socklen_t size_of_sockaddr = sizeof(my_address);
     memset(&my_address, 0, sizeof(my_address));
-    getsockname(server_socket_fd, (struct sockaddr*) &my_address, &size_of_sockaddr);
-    Socket dummy{"127.0.0.1", my_address.sin_port};
+    getsockname(server_socket_fds.front(), (struct sockaddr*) &my_address, &size_of_sockaddr);
+    Socket dummy{"127.0.0.1", ntohs(my_address.sin_port)};
     dummy.write("", 0);
 }
 
 template<typename Impl>
 void BaseTcpClient<Impl>::monitor_incoming_messages() {
-    const int EVENTS_LENGTH = 64;
-    struct epoll_event* events = (struct epoll_event*) calloc(EVENTS_LENGTH, sizeof(struct epoll_event));
-    //Indexed by FD, since that's all the information we get when a socket has data
-    std::map<int, std::vector<char>> sender_buffers;
+    if(TCP_RECEIVE_THREADS <= 1) {
+        run_receive_loop(0, [this](std::vector<TypeMessagePair>& messages) {
+            impl_this->handle_messages(messages);
+        });
+        return;
+    }
+    std::vector<std::thread> receive_threads;
+    for(std::size_t reactor = 0; reactor < epoll_fds.size(); ++reactor) {
+        receive_threads.emplace_back([this, reactor]() {
+            pthread_setname_np(pthread_self(), "tcp_receive_thread");
+            //Batches from one producer token are dequeued in order, so each connection's messages stay in order
+            moodycamel::ProducerToken receive_thread_token(received_messages);
+            run_receive_loop(reactor, [this, &receive_thread_token](std::vector<TypeMessagePair>& messages) {
+                received_messages.enqueue(receive_thread_token, std::move(messages));
+                messages.clear();
+            });
+        });
+    }
+    moodycamel::ConsumerToken handler_thread_token(received_messages);
+    std::vector<TypeMessagePair> messages;
     while(!shutdown) {
-        int num_events = epoll_wait(epoll_fd, events, EVENTS_LENGTH, 100);
-        for(int i = 0; i < num_events; ++i) {
-
-            if ((events[i].events & EPOLLERR) || (events[i].events & EPOLLHUP) ||
-                    (!(events[i].events & EPOLLIN))) {
-                /* An error has occured on this fd, or the socket is not
-                 ready for reading (why were we notified then?) */
-                fprintf (stderr, "epoll error\n");
-                close (events[i].data.fd);
-                continue;
+        //Wake up periodically to check for shutdown
+        if(received_messages.wait_dequeue_timed(handler_thread_token, messages, std::chrono::milliseconds(100))) {
+            impl_this->handle_messages(messages);
+        }
+        //Timer callbacks and other event sources run here too, so they never run alongside a message handler
+        run_ready_event_sources();
+    }
+    for(auto& receive_thread : receive_threads) {
+        receive_thread.join();
+    }
+}
+
+template<typename Impl>
+template<typename DeliverFunc>
+void BaseTcpClient<Impl>::run_receive_loop(const std::size_t reactor, DeliverFunc&& deliver) {
+    if(use_io_uring) {
+        run_io_uring_receive_loop(reactor, std::forward<DeliverFunc>(deliver));
+    } else {
+        run_epoll_receive_loop(reactor, std::forward<DeliverFunc>(deliver));
+    }
+}
+
+template<typename Impl>
+template<typename DeliverFunc>
+void BaseTcpClient<Impl>::run_io_uring_receive_loop(const std::size_t reactor, DeliverFunc&& deliver) {
+    //What a request is for, stored in the top half of its user_data above the FD it's for
+    enum RequestType : std::uint64_t { ACCEPT, RECEIVE, SEND_READY };
+    auto user_data = [](const RequestType type, const int fd) {
+        return (static_cast<std::uint64_t>(type) << 32) | static_cast<std::uint32_t>(fd);
+    };
+    const int epoll_fd = epoll_fds[reactor];
+    const int server_socket_fd = server_socket_fds[reactor];
+    const unsigned short buffer_group = 0;
+    IoUring ring(IO_URING_ENTRIES);
+    ring.register_buffers(buffer_group, IO_URING_RECEIVE_BUFFERS, IO_URING_RECEIVE_BUFFER_SIZE);
+    //Multishot requests keep completing, once for each connection or each read, until the kernel ends them
+    auto submit_accept = [&]() {
+        io_uring_sqe* sqe = ring.get_sqe();
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = server_socket_fd;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->user_data = user_data(ACCEPT, server_socket_fd);
+    };
+    auto submit_receive = [&](const int socket_fd) {
+        io_uring_sqe* sqe = ring.get_sqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = socket_fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = buffer_group;
+        sqe->user_data = user_data(RECEIVE, socket_fd);
+    };
+    //Outgoing sockets (and the datagram socket and shared memory ring) are still registered with epoll, so the ring only has to watch the epoll FD
+    auto submit_send_ready = [&]() {
+        io_uring_sqe* sqe = ring.get_sqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = epoll_fd;
+        sqe->poll32_events = POLLIN;
+        sqe->len = IORING_POLL_ADD_MULTI;
+        sqe->user_data = user_data(SEND_READY, epoll_fd);
+    };
+    submit_accept();
+    submit_send_ready();
+    const int EVENTS_LENGTH = 64;
+    struct epoll_event send_events[EVENTS_LENGTH];
+    //The read state of each connection, indexed by FD
+    std::map<int, FrameReader> frame_readers;
+    std::vector<messaging::SharedBuffer> complete_frames;
+    std::vector<TypeMessagePair> decoded_messages;
+    auto handle_completion = [&](const io_uring_cqe& completion) {
+        const RequestType type = static_cast<RequestType>(completion.user_data >> 32);
+        const int fd = static_cast<int>(completion.user_data & 0xffffffff);
+        const bool request_continues = completion.flags & IORING_CQE_F_MORE;
+        if(type == ACCEPT) {
+            if(completion.res >= 0) {
+                //The sender must announce its format first; its reader closes the connection if it doesn't
+                frame_readers.emplace(completion.res, FrameReader());
+                submit_receive(completion.res);
             }
-            else if(events[i].data.fd == server_socket_fd) {
-                //There are new incoming connections to add to the epoll set
-                while (true) {
-                    //Grab the next incoming connection from the server socket
-                    struct sockaddr in_addr;
-                    socklen_t in_len = sizeof in_addr;
-                    int incoming_fd = accept(server_socket_fd, &in_addr, &in_len);
-                    if (incoming_fd == -1) {
-                        if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
-                            /* We have processed all incoming connections. */
-                            break;
-                        } else {
-                            perror("Error in accept");
-                            break;
-                        }
+            if(!request_continues) {
+                submit_accept();
+            }
+        } else if(type == RECEIVE) {
+            auto reader_find = frame_readers.find(fd);
+            if(completion.flags & IORING_CQE_F_BUFFER) {
+                const unsigned short buffer_id = completion.flags >> IORING_CQE_BUFFER_SHIFT;
+                if(completion.res > 0 && reader_find != frame_readers.end()) {
+                    complete_frames.clear();
+                    if(!reader_find->second.consume(ring.get_buffer(buffer_id), completion.res, complete_frames)) {
+                        //Ending the connection ends its multishot receive, whose last completion closes it
+                        ::shutdown(fd, SHUT_RDWR);
                     }
-
-                    //For debugging only
-//                    char host_buf[NI_MAXHOST], port_buf[NI_MAXSERV];
-//                    int s = getnameinfo(&in_addr, in_len, host_buf, sizeof host_buf, port_buf, sizeof port_buf,
-//                            NI_NUMERICHOST | NI_NUMERICSERV);
-//                    if (s == 0) {
-//                        printf("Accepted connection on descriptor %d "
-//                                "(host=%s, port=%s)\n", incoming_fd, host_buf, port_buf);
-//                    }
-                    //Allocate a fresh buffer for the data sent by this sender
-                    sender_buffers.emplace(incoming_fd, std::vector<char>{});
-
-                    //Make the incoming socket non-blocking and add it to the list of fds to monitor.,
-                    int flags;
-                    flags = fcntl(incoming_fd, F_GETFL, 0);
-                    flags |= O_NONBLOCK;
-                    if (fcntl(incoming_fd, F_SETFL, flags) < 0) {
-                        throw connection_failure("Failed to set an incoming connection's socket to nonblocking!");
+                    for(const auto& frame : complete_frames) {
+                        impl_this->decode_frame(frame, reader_find->second.get_format(), decoded_messages);
                     }
+                }
+                //The reader copied the bytes, so the kernel can have the buffer back right away
+                ring.recycle_buffer(buffer_id);
+            }
+            if(request_continues) {
+                return;
+            }
+            if(completion.res > 0 || completion.res == -ENOBUFS) {
+                //The kernel ends a multishot receive when it runs out of buffers, which have been recycled since
+                submit_receive(fd);
+            } else if(reader_find != frame_readers.end()) {
+                //The client closed the connection, or it failed; a partially received frame is dropped with its reader
+                close(fd);
+                frame_readers.erase(reader_find);
+            }
+        } else if(type == SEND_READY) {
+            int num_events = epoll_wait(epoll_fd, send_events, EVENTS_LENGTH, 0);
+            for(int i = 0; i < num_events; ++i) {
+                if(datagram_socket && send_events[i].data.fd == datagram_socket->get_fd()) {
+                    receive_datagrams(decoded_messages);
+                } else if(shared_memory_ring && send_events[i].data.fd == shared_memory_ring->get_event_fd()) {
+                    receive_shared_memory_frames(decoded_messages);
+                } else if(event_sources.find(send_events[i].data.fd) != event_sources.end()) {
+                    handle_event_source(send_events[i].data.fd);
+                } else {
+                    handle_send_event(send_events[i].data.fd, send_events[i].events);
+                }
+            }
+            if(!request_continues) {
+                submit_send_ready();
+            }
+        }
+    };
+    while(!shutdown) {
+        //Wake up periodically to check for shutdown
+        ring.submit_and_wait(1, 100);
+        decoded_messages.clear();
+        ring.for_each_completion(handle_completion);
+        //Every connection's messages are decoded in the order they arrived, so they can all be delivered together
+        if(!decoded_messages.empty()) {
+            deliver(decoded_messages);
+        }
+        deliver_connection_failures(deliver, decoded_messages);
+    }
+}
 
-                    struct epoll_event event;
-                    memset(&event, 0, sizeof(event));
-                    event.data.fd = incoming_fd;
-                    event.events = EPOLLIN;
-                    int success = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, incoming_fd, &event);
-                    if (success == -1) {
-                        perror("Error in epoll_ctl");
-                        throw connection_failure("Failed to add a socket to the epoll set!");
-                    }
+template<typename Impl>
+template<typename DeliverFunc>
+void BaseTcpClient<Impl>::run_epoll_receive_loop(const std::size_t reactor, DeliverFunc&& deliver) {
+    EpollReceiveState state;
+    std::vector<char> read_buffer(READ_BUFFER_SIZE);
+    while(!shutdown) {
+        run_epoll_turn(reactor, state, read_buffer, 100, deliver);
+    }
+}
+
+template<typename Impl>
+bool BaseTcpClient<Impl>::poll_incoming_messages() {
+    //With io_uring, connections are accepted by a ring that only run_io_uring_receive_loop() has
+    assert(!use_io_uring);
+    if(!polled_receive_state) {
+        polled_receive_state = std::make_unique<EpollReceiveState>();
+    }
+    auto handle = [this](std::vector<TypeMessagePair>& messages) {
+        impl_this->handle_messages(messages);
+    };
+    //Clients polled by the same thread never read at the same time, so they can share one buffer
+    static thread_local std::vector<char> read_buffer(READ_BUFFER_SIZE);
+    run_epoll_turn(0, *polled_receive_state, read_buffer, 0, handle);
+    return !polled_receive_state->unfinished_fds.empty();
+}
+
+template<typename Impl>
+template<typename DeliverFunc>
+void BaseTcpClient<Impl>::read_epoll_connection(EpollReceiveState& state, std::vector<char>& read_buffer,
+        const int socket_fd, DeliverFunc& deliver) {
+    auto reader_find = state.frame_readers.find(socket_fd);
+    if(reader_find == state.frame_readers.end()) {
+        return;
+    }
+    state.complete_frames.clear();
+    FrameReader::Status status = reader_find->second.read_from(socket_fd, read_buffer, MAX_READ_PER_TURN, state.complete_frames);
+    //Handle the frames before closing the connection, since a client may close it right after sending
+    if(!state.complete_frames.empty()) {
+        state.decoded_messages.clear();
+        for(const auto& frame : state.complete_frames) {
+            impl_this->decode_frame(frame, reader_find->second.get_format(), state.decoded_messages);
+        }
+        deliver(state.decoded_messages);
+    }
+    if(status == FrameReader::Status::MORE_AVAILABLE) {
+        state.unfinished_fds.insert(socket_fd);
+    } else {
+        state.unfinished_fds.erase(socket_fd);
+    }
+    if(status == FrameReader::Status::CLOSED) {
+        //A frame that was only partially received is dropped along with its reader
+        close(socket_fd);
+        state.frame_readers.erase(reader_find);
+    }
+}
+
+template<typename Impl>
+template<typename DeliverFunc>
+void BaseTcpClient<Impl>::run_epoll_turn(const std::size_t reactor, EpollReceiveState& state, std::vector<char>& read_buffer,
+        const int timeout_ms, DeliverFunc& deliver) {
+    const int epoll_fd = epoll_fds[reactor];
+    const int server_socket_fd = server_socket_fds[reactor];
+    std::vector<TypeMessagePair>& decoded_messages = state.decoded_messages;
+    epoll_event* events = state.events.data();
+    state.fds_to_continue.assign(state.unfinished_fds.begin(), state.unfinished_fds.end());
+    //Don't wait for new events if some connections are already known to have bytes waiting
+    int num_events = epoll_wait(epoll_fd, events, state.events.size(), state.fds_to_continue.empty() ? timeout_ms : 0);
+    for(int i = 0; i < num_events; ++i) {
+        if(events[i].data.fd != server_socket_fd) {
+            if(state.frame_readers.find(events[i].data.fd) != state.frame_readers.end()) {
+                //Errors and hangups on a connection are discovered by reading from it
+                read_epoll_connection(state, read_buffer, events[i].data.fd, deliver);
+            } else if(datagram_socket && events[i].data.fd == datagram_socket->get_fd()) {
+                decoded_messages.clear();
+                receive_datagrams(decoded_messages);
+                if(!decoded_messages.empty()) {
+                    deliver(decoded_messages);
                 }
+            } else if(shared_memory_ring && events[i].data.fd == shared_memory_ring->get_event_fd()) {
+                decoded_messages.clear();
+                receive_shared_memory_frames(decoded_messages);
+                if(!decoded_messages.empty()) {
+                    deliver(decoded_messages);
+                }
+            } else if(event_sources.find(events[i].data.fd) != event_sources.end()) {
+                handle_event_source(events[i].data.fd);
+            } else {
+                //Not an incoming connection, so it must be one of this client's outgoing sockets
+                handle_send_event(events[i].data.fd, events[i].events);
             }
-            else {
-                //We have data on a socket FD waiting to be read, so read it off
-                /* In all PDDM messaging protocols, the first 4 bytes are a size_t
-                 * containing the size of the rest of the message */
-                std::size_t message_size;
-                ssize_t int_bytes_read = recv(events[i].data.fd, (char*)&message_size, sizeof(message_size), MSG_WAITALL);
-                if(int_bytes_read == 0) {
-                    //If the very first read is zero, the client has closed the connection
-                    close(events[i].data.fd);
-                    continue;
-                } else if(int_bytes_read != sizeof(message_size)) {
-                    perror("Failed to read the first 4 bytes of an incoming message!");
-                    continue;
+        } else if ((events[i].events & EPOLLERR) || (events[i].events & EPOLLHUP) ||
+                (!(events[i].events & EPOLLIN))) {
+            /* An error has occured on this fd, or the socket is not
+             ready for reading (why were we notified then?) */
+            fprintf (stderr, "epoll error\n");
+            close (events[i].data.fd);
+            continue;
+        } else {
+            //There are new incoming connections to add to the epoll set
+            while (true) {
+                //Grab the next incoming connection from the server socket
+                struct sockaddr in_addr;
+                socklen_t in_len = sizeof in_addr;
+                int incoming_fd = accept(server_socket_fd, &in_addr, &in_len);
+                if (incoming_fd == -1) {
+                    if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                        /* We have processed all incoming connections. */
+                        break;
+                    } else {
+                        perror("Error in accept");
+                        break;
+                    }
                 }
-                sender_buffers[events[i].data.fd].resize(message_size);
-                /* Block until the entire message has been read - the sender should have
-                 * packed it into one send, so this won't block for very long. */
-                ssize_t msg_bytes_read = recv(events[i].data.fd, sender_buffers[events[i].data.fd].data(), message_size, MSG_WAITALL);
-                if(msg_bytes_read != message_size) {
-                    //Client must have failed or disconnected
-                    perror("Failure while reading a message from a client");
-                    sender_buffers.erase(events[i].data.fd);
-                    continue;
+
+                //For debugging only
+//                char host_buf[NI_MAXHOST], port_buf[NI_MAXSERV];
+//                int s = getnameinfo(&in_addr, in_len, host_buf, sizeof host_buf, port_buf, sizeof port_buf,
+//                        NI_NUMERICHOST | NI_NUMERICSERV);
+//                if (s == 0) {
+//                    printf("Accepted connection on descriptor %d "
+//                            "(host=%s, port=%s)\n", incoming_fd, host_buf, port_buf);
+//                }
+                //The sender must announce its format first; its reader closes the connection if it doesn't
+                state.frame_readers.emplace(incoming_fd, FrameReader());
+
+                //Make the incoming socket non-blocking and add it to the list of fds to monitor.,
+                int flags;
+                flags = fcntl(incoming_fd, F_GETFL, 0);
+                flags |= O_NONBLOCK;
+                if (fcntl(incoming_fd, F_SETFL, flags) < 0) {
+                    throw connection_failure("Failed to set an incoming connection's socket to nonblocking!");
+                }
+
+                struct epoll_event event;
+                memset(&event, 0, sizeof(event));
+                event.data.fd = incoming_fd;
+                //Edge-triggered, since each connection is read until it has nothing left or its turn ends
+                event.events = EPOLLIN | EPOLLET;
+                int success = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, incoming_fd, &event);
+                if (success == -1) {
+                    perror("Error in epoll_ctl");
+                    throw connection_failure("Failed to add a socket to the epoll set!");
                 }
-                //Handle the message
-                impl_this->receive_message(sender_buffers.at(events[i].data.fd));
-                sender_buffers.erase(events[i].data.fd);
             }
         }
     }
-
-    free(events);
+    //Give another turn to the connections that had more to read at the start of this turn
+    for(const int socket_fd : state.fds_to_continue) {
+        read_epoll_connection(state, read_buffer, socket_fd, deliver);
+    }
+    deliver_connection_failures(deliver, decoded_messages);
 }
 
 } /* namespace networking */
@@ -0,0 +1,109 @@
+/**
+ * @file ConnectionManager.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "ConnectionManager.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Socket.h"
+#include "../Configuration.h"
+
+namespace pddm {
+namespace networking {
+
+bool ConnectionManager::resolve(const TcpAddress& address, sockaddr_in& resolved) {
+    auto cache_find = resolved_addresses.find(address);
+    if(cache_find != resolved_addresses.end()) {
+        resolved = cache_find->second;
+        return true;
+    }
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* results;
+    if(getaddrinfo(address.ip_addr.c_str(), nullptr, &hints, &results) != 0) {
+        return false;
+    }
+    memcpy(&resolved, results->ai_addr, sizeof(resolved));
+    freeaddrinfo(results);
+    resolved.sin_port = htons(address.port);
+    resolved_addresses.emplace(address, resolved);
+    return true;
+}
+
+bool ConnectionManager::is_local(const TcpAddress& address) {
+    sockaddr_in resolved;
+    if(!resolve(address, resolved)) {
+        return false;
+    }
+    if((ntohl(resolved.sin_addr.s_addr) >> 24) == IN_LOOPBACKNET) {
+        return true;
+    }
+    if(local_addresses.empty()) {
+        ifaddrs* interfaces;
+        if(getifaddrs(&interfaces) != 0) {
+            return false;
+        }
+        for(ifaddrs* interface = interfaces; interface != nullptr; interface = interface->ifa_next) {
+            if(interface->ifa_addr != nullptr && interface->ifa_addr->sa_family == AF_INET) {
+                local_addresses.insert(reinterpret_cast<sockaddr_in*>(interface->ifa_addr)->sin_addr.s_addr);
+            }
+        }
+        freeifaddrs(interfaces);
+    }
+    return local_addresses.count(resolved.sin_addr.s_addr) > 0;
+}
+
+bool ConnectionManager::should_attempt(const int meter_id) const {
+    auto backoff_find = backoff_by_id.find(meter_id);
+    return backoff_find == backoff_by_id.end() || clock::now() >= backoff_find->second.next_attempt;
+}
+
+void ConnectionManager::record_failure(const int meter_id) {
+    auto backoff_find = backoff_by_id.find(meter_id);
+    int delay_ms = backoff_find == backoff_by_id.end() ? MIN_RECONNECT_BACKOFF
+            : std::min(2 * backoff_find->second.delay_ms, MAX_RECONNECT_BACKOFF);
+    backoff_by_id[meter_id] = {delay_ms, clock::now() + std::chrono::milliseconds(delay_ms)};
+}
+
+void ConnectionManager::record_success(const int meter_id) {
+    backoff_by_id.erase(meter_id);
+}
+
+Socket ConnectionManager::start_connect(const TcpAddress& address) {
+    sockaddr_in server_address;
+    if(!resolve(address, server_address)) {
+        return Socket();
+    }
+    int sock = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if(sock < 0) {
+        return Socket();
+    }
+    if(::connect(sock, (sockaddr*) &server_address, sizeof(server_address)) < 0 && errno != EINPROGRESS) {
+        close(sock);
+        return Socket();
+    }
+    //Leave the socket nonblocking, since BaseTcpClient writes to it through a SendQueue
+    return Socket(sock, address.ip_addr);
+}
+
+bool ConnectionManager::finish_connect(const int socket_fd) {
+    int error = 0;
+    socklen_t error_size = sizeof(error);
+    return getsockopt(socket_fd, SOL_SOCKET, SO_ERROR, &error, &error_size) == 0 && error == 0;
+}
+
+} /* namespace networking */
+} /* namespace pddm */
@@ -0,0 +1,100 @@
+/**
+ * @file ConnectionManager.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <set>
+#include <netinet/in.h>
+
+#include "TcpAddress.h"
+
+namespace pddm {
+namespace networking {
+
+class Socket;
+
+/**
+ * Opens outgoing TCP connections for BaseTcpClient without blocking.
+ * Connections are started with nonblocking connect() calls, and the client
+ * watches the sockets with its reactor to find out when they open or fail,
+ * so a send never waits for a connection. Host names are resolved once and
+ * cached, and meters that could not be reached are not tried again until a
+ * backoff delay has passed, so that sends to a failed meter fail immediately
+ * instead of waiting for another timeout.
+ */
+class ConnectionManager {
+    private:
+        using clock = std::chrono::steady_clock;
+        struct Backoff {
+            int delay_ms;
+            clock::time_point next_attempt;
+        };
+        /** Resolved socket addresses, cached so each host is only looked up once */
+        std::map<TcpAddress, sockaddr_in> resolved_addresses;
+        /** The reconnection delay for each meter that could not be reached, by ID */
+        std::map<int, Backoff> backoff_by_id;
+        /** The IPv4 addresses of this host's network interfaces, once they have been looked up */
+        std::set<in_addr_t> local_addresses;
+    public:
+        /**
+         * Looks up the socket address for a TCP address, using the cache if
+         * the address has been resolved before.
+         * @param address The address to resolve
+         * @param resolved Set to the socket address
+         * @return True if the address could be resolved
+         */
+        bool resolve(const TcpAddress& address, sockaddr_in& resolved);
+        /**
+         * Checks whether an address belongs to this host, either as a
+         * loopback address or as the address of one of its interfaces.
+         * @param address The address to check
+         * @return True if the address is this host's, false if it isn't or
+         * can't be resolved
+         */
+        bool is_local(const TcpAddress& address);
+        /**
+         * Checks whether a connection to a meter should be attempted, which is
+         * true unless the last attempt failed less than the meter's backoff
+         * delay ago.
+         * @param meter_id The ID of the meter
+         * @return True if the meter is not waiting out a backoff delay
+         */
+        bool should_attempt(const int meter_id) const;
+        /**
+         * Records that a meter could not be reached, or that its connection
+         * broke, which starts (or doubles) its backoff delay.
+         * @param meter_id The ID of the meter
+         */
+        void record_failure(const int meter_id);
+        /**
+         * Records that a connection to a meter opened, which resets its backoff delay.
+         * @param meter_id The ID of the meter
+         */
+        void record_success(const int meter_id);
+        /**
+         * Starts connecting to an address without waiting for the connection
+         * to open. The socket becomes writable once the connection opens, and
+         * reports an error if it fails, which finish_connect() tells apart.
+         * This does not check or update backoff delays.
+         * @param address The address to connect to
+         * @return A nonblocking socket that is connecting or connected, or an
+         * empty socket if the address can't be resolved or connected to at all
+         */
+        Socket start_connect(const TcpAddress& address);
+        /**
+         * Checks whether a connection started by start_connect() opened,
+         * once its socket has become writable or reported an error.
+         * @param socket_fd The connection's socket
+         * @return True if the connection is open
+         */
+        static bool finish_connect(const int socket_fd);
+};
+
+} /* namespace networking */
+} /* namespace pddm */
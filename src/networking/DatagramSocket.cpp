@@ -0,0 +1,206 @@
+/**
+ * @file DatagramSocket.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "DatagramSocket.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+#include "MessageFraming.h"
+#include "Socket.h"
+#include "../Configuration.h"
+
+namespace pddm {
+namespace networking {
+
+DatagramSocket::DatagramSocket(const int port) :
+        next_frame_id(0),
+        receive_buffers(RECEIVE_BATCH_SIZE * UDP_MAX_DATAGRAM_SIZE),
+        receive_iovecs(RECEIVE_BATCH_SIZE),
+        receive_addresses(RECEIVE_BATCH_SIZE),
+        receive_headers(RECEIVE_BATCH_SIZE) {
+    socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(socket_fd < 0) throw connection_failure("Could not create a UDP socket.");
+    int reuse_addr = 1;
+    setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &reuse_addr, sizeof(reuse_addr));
+    //The kernel caps these at its rmem_max and wmem_max, which is fine
+    int buffer_size = SOCKET_BUFFER_SIZE;
+    setsockopt(socket_fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    setsockopt(socket_fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+    sockaddr_in my_address;
+    std::memset(&my_address, 0, sizeof(my_address));
+    my_address.sin_family = AF_INET;
+    my_address.sin_addr.s_addr = INADDR_ANY;
+    my_address.sin_port = htons(port);
+    if(bind(socket_fd, (sockaddr*) &my_address, sizeof(my_address)) < 0) {
+        close(socket_fd);
+        throw connection_failure("Could not bind a UDP socket to port " + std::to_string(port) + ": " + strerror(errno));
+    }
+    //The socket stays blocking so that sends wait for buffer space instead of dropping datagrams; receives don't wait
+    for(unsigned i = 0; i < RECEIVE_BATCH_SIZE; ++i) {
+        receive_iovecs[i].iov_base = receive_buffers.data() + i * UDP_MAX_DATAGRAM_SIZE;
+        receive_iovecs[i].iov_len = UDP_MAX_DATAGRAM_SIZE;
+    }
+}
+
+DatagramSocket::~DatagramSocket() {
+    close(socket_fd);
+}
+
+void DatagramSocket::queue_frame(const int recipient_id, const sockaddr_in& address, const std::vector<char>& frame,
+        const messaging::WireFormat format) {
+    //The size prefix is only needed to find the end of a frame in a stream; the header carries it instead
+    const char* frame_body = frame.data();
+    const std::size_t frame_size = read_size_prefix(frame_body, frame.data() + frame.size(), format);
+    const std::size_t max_payload = UDP_MAX_DATAGRAM_SIZE - sizeof(FragmentHeader);
+    FragmentHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.frame_id = next_frame_id++;
+    header.frame_size = frame_size;
+    header.fragment_count = std::max<std::size_t>((frame_size + max_payload - 1) / max_payload, 1);
+    header.format = static_cast<std::uint8_t>(format);
+    header.version = messaging::WIRE_FORMAT_VERSION;
+    for(header.fragment_index = 0; header.fragment_index < header.fragment_count; ++header.fragment_index) {
+        header.fragment_offset = header.fragment_index * max_payload;
+        const std::size_t payload_size = std::min(max_payload, frame_size - header.fragment_offset);
+        const std::size_t datagram_offset = outgoing_bytes.size();
+        outgoing_bytes.resize(datagram_offset + sizeof(header) + payload_size);
+        std::memcpy(outgoing_bytes.data() + datagram_offset, &header, sizeof(header));
+        std::memcpy(outgoing_bytes.data() + datagram_offset + sizeof(header), frame_body + header.fragment_offset, payload_size);
+        queued_datagrams.push_back({recipient_id, address, datagram_offset, sizeof(header) + payload_size});
+    }
+}
+
+std::set<int> DatagramSocket::send_queued() {
+    std::set<int> failed_ids;
+    //outgoing_bytes is done growing, so it's now safe to point into it
+    send_iovecs.resize(queued_datagrams.size());
+    send_headers.resize(queued_datagrams.size());
+    for(std::size_t i = 0; i < queued_datagrams.size(); ++i) {
+        send_iovecs[i].iov_base = outgoing_bytes.data() + queued_datagrams[i].offset;
+        send_iovecs[i].iov_len = queued_datagrams[i].size;
+        std::memset(&send_headers[i], 0, sizeof(mmsghdr));
+        send_headers[i].msg_hdr.msg_name = &queued_datagrams[i].address;
+        send_headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        send_headers[i].msg_hdr.msg_iov = &send_iovecs[i];
+        send_headers[i].msg_hdr.msg_iovlen = 1;
+    }
+    std::size_t num_sent = 0;
+    while(num_sent < send_headers.size()) {
+        //sendmmsg() stops at the first datagram that fails, and only reports the error if it was the first one
+        int result = sendmmsg(socket_fd, send_headers.data() + num_sent, std::min<std::size_t>(send_headers.size() - num_sent, UIO_MAXIOV), 0);
+        if(result > 0) {
+            num_sent += result;
+        } else if(errno != EINTR) {
+            failed_ids.insert(queued_datagrams[num_sent].recipient_id);
+            ++num_sent;
+        }
+    }
+    queued_datagrams.clear();
+    outgoing_bytes.clear();
+    return failed_ids;
+}
+
+void DatagramSocket::receive(std::vector<ReceivedFrame>& complete_frames) {
+    while(true) {
+        for(unsigned i = 0; i < RECEIVE_BATCH_SIZE; ++i) {
+            std::memset(&receive_headers[i], 0, sizeof(mmsghdr));
+            receive_headers[i].msg_hdr.msg_name = &receive_addresses[i];
+            receive_headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            receive_headers[i].msg_hdr.msg_iov = &receive_iovecs[i];
+            receive_headers[i].msg_hdr.msg_iovlen = 1;
+        }
+        int num_received = recvmmsg(socket_fd, receive_headers.data(), RECEIVE_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+        if(num_received < 0 && errno == EINTR) {
+            continue;
+        }
+        for(int i = 0; i < num_received; ++i) {
+            //A datagram larger than this meter's buffers must come from a sender with a different UDP_MAX_DATAGRAM_SIZE
+            if(receive_headers[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                continue;
+            }
+            handle_datagram(receive_addresses[i], static_cast<const char*>(receive_iovecs[i].iov_base),
+                    receive_headers[i].msg_len, complete_frames);
+        }
+        //Fewer datagrams than asked for means the socket has been emptied
+        if(num_received < static_cast<int>(RECEIVE_BATCH_SIZE)) {
+            break;
+        }
+    }
+    expire_partial_frames();
+}
+
+void DatagramSocket::handle_datagram(const sockaddr_in& sender, const char* bytes, const std::size_t size,
+        std::vector<ReceivedFrame>& complete_frames) {
+    FragmentHeader header;
+    if(size < sizeof(header)) {
+        return;
+    }
+    std::memcpy(&header, bytes, sizeof(header));
+    const char* payload = bytes + sizeof(header);
+    const std::size_t payload_size = size - sizeof(header);
+    if(header.frame_size == 0 || header.fragment_index >= header.fragment_count
+            || header.fragment_offset + payload_size > header.frame_size) {
+        return;
+    }
+    //A sender with a different layout version can't be understood, just like one that announces it over TCP
+    if(header.version != messaging::WIRE_FORMAT_VERSION
+            || header.format > static_cast<std::uint8_t>(messaging::WireFormat::COMPACT)) {
+        return;
+    }
+    const messaging::WireFormat format = static_cast<messaging::WireFormat>(header.format);
+    //Most frames fit in one datagram and don't need to wait for anything else
+    if(header.fragment_count == 1) {
+        if(payload_size != header.frame_size) {
+            return;
+        }
+        auto frame = std::make_shared<messaging::ReceiveBuffer>(header.frame_size);
+        std::memcpy(frame->data(), payload, payload_size);
+        complete_frames.emplace_back(std::move(frame), format);
+        return;
+    }
+    const FrameKey key(sender.sin_addr.s_addr, sender.sin_port, header.frame_id);
+    auto partial_find = partial_frames.find(key);
+    if(partial_find != partial_frames.end() && (partial_find->second.frame->size() != header.frame_size
+            || partial_find->second.fragments_received.size() != header.fragment_count)) {
+        //The sender must have restarted and reused the frame ID, so the old fragments will never be completed
+        partial_frames.erase(partial_find);
+        partial_find = partial_frames.end();
+    }
+    if(partial_find == partial_frames.end()) {
+        partial_find = partial_frames.emplace(key, PartialFrame{std::make_shared<messaging::ReceiveBuffer>(header.frame_size),
+                std::vector<bool>(header.fragment_count, false), header.fragment_count, std::chrono::steady_clock::now()}).first;
+    }
+    PartialFrame& partial_frame = partial_find->second;
+    //The network may duplicate a datagram
+    if(partial_frame.fragments_received[header.fragment_index]) {
+        return;
+    }
+    partial_frame.fragments_received[header.fragment_index] = true;
+    std::memcpy(partial_frame.frame->data() + header.fragment_offset, payload, payload_size);
+    if(--partial_frame.fragments_remaining == 0) {
+        complete_frames.emplace_back(std::move(partial_frame.frame), format);
+        partial_frames.erase(partial_find);
+    }
+}
+
+void DatagramSocket::expire_partial_frames() {
+    const auto expiry_time = std::chrono::steady_clock::now() - std::chrono::milliseconds(UDP_REASSEMBLY_TIMEOUT);
+    for(auto partial_iter = partial_frames.begin(); partial_iter != partial_frames.end(); ) {
+        if(partial_iter->second.first_received < expiry_time) {
+            partial_iter = partial_frames.erase(partial_iter);
+        } else {
+            ++partial_iter;
+        }
+    }
+}
+
+} /* namespace networking */
+} /* namespace pddm */
@@ -0,0 +1,144 @@
+/**
+ * @file DatagramSocket.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "../messaging/ReceiveBuffer.h"
+#include "../messaging/WireFormat.h"
+
+namespace pddm {
+namespace networking {
+
+/**
+ * A UDP socket that sends and receives the same frames TCP clients send over
+ * their connections, one frame per datagram if it fits in
+ * UDP_MAX_DATAGRAM_SIZE, or split into several fragments that the receiver
+ * reassembles if it doesn't. Each datagram starts with a header that says
+ * which frame it belongs to and which part of that frame it carries, along
+ * with the frame's wire format and messaging::WIRE_FORMAT_VERSION, since
+ * there is no connection to announce them on; datagrams of another version
+ * are dropped. A frame with a lost fragment is dropped once UDP_REASSEMBLY_TIMEOUT has
+ * passed, exactly as if it had been sent in one datagram that was lost.
+ *
+ * Frames are queued and then sent all at once with sendmmsg(), and received
+ * in batches with recvmmsg(), so a round's worth of datagrams costs a few
+ * system calls rather than one per datagram. Sending and receiving use
+ * separate state, so one thread can receive while another sends, but each of
+ * them must only be done by one thread at a time.
+ */
+class DatagramSocket {
+    public:
+        /** A reassembled frame, and the format it was sent in */
+        using ReceivedFrame = std::pair<messaging::SharedBuffer, messaging::WireFormat>;
+    private:
+        /** The header at the start of every datagram */
+        struct FragmentHeader {
+            /** Identifies the frame among the frames from the same sender */
+            std::uint32_t frame_id;
+            /** The size of the whole frame, not including its size prefix */
+            std::uint32_t frame_size;
+            /** The position in the frame of the bytes in this datagram */
+            std::uint32_t fragment_offset;
+            std::uint16_t fragment_index;
+            std::uint16_t fragment_count;
+            std::uint8_t format;
+            /** The sender's messaging::WIRE_FORMAT_VERSION */
+            std::uint8_t version;
+        };
+        /** A datagram that has been queued, whose bytes are in outgoing_bytes */
+        struct QueuedDatagram {
+            int recipient_id;
+            sockaddr_in address;
+            std::size_t offset;
+            std::size_t size;
+        };
+        /** The fragments received so far of a frame that was split */
+        struct PartialFrame {
+            std::shared_ptr<messaging::ReceiveBuffer> frame;
+            std::vector<bool> fragments_received;
+            std::uint16_t fragments_remaining;
+            std::chrono::steady_clock::time_point first_received;
+        };
+        /** Identifies a frame by its sender's address, port, and frame ID */
+        using FrameKey = std::tuple<std::uint32_t, std::uint16_t, std::uint32_t>;
+        /** The most datagrams read by one recvmmsg() call */
+        static constexpr unsigned RECEIVE_BATCH_SIZE = 64;
+        /** The socket buffer size requested from the kernel, so that a round's
+         * burst of datagrams isn't dropped before it can be read */
+        static constexpr int SOCKET_BUFFER_SIZE = 4 * 1024 * 1024;
+        int socket_fd;
+        std::uint32_t next_frame_id;
+        std::vector<char> outgoing_bytes;
+        std::vector<QueuedDatagram> queued_datagrams;
+        std::vector<iovec> send_iovecs;
+        std::vector<mmsghdr> send_headers;
+        std::vector<char> receive_buffers;
+        std::vector<iovec> receive_iovecs;
+        std::vector<sockaddr_in> receive_addresses;
+        std::vector<mmsghdr> receive_headers;
+        std::map<FrameKey, PartialFrame> partial_frames;
+        /**
+         * Adds the bytes of one received datagram to the frame they belong
+         * to, and adds that frame to complete_frames if they complete it.
+         */
+        void handle_datagram(const sockaddr_in& sender, const char* bytes, const std::size_t size,
+                std::vector<ReceivedFrame>& complete_frames);
+        /** Drops the partial frames that have waited longer than UDP_REASSEMBLY_TIMEOUT */
+        void expire_partial_frames();
+    public:
+        /**
+         * Creates a UDP socket bound to a port on every local interface.
+         * @param port The port to receive datagrams on
+         * @throws connection_failure if the socket can't be created or bound
+         */
+        explicit DatagramSocket(const int port);
+        ~DatagramSocket();
+        DatagramSocket(const DatagramSocket&) = delete;
+        DatagramSocket& operator=(const DatagramSocket&) = delete;
+        int get_fd() const { return socket_fd; }
+        /**
+         * Queues a frame to be sent by the next call to send_queued(),
+         * splitting it into fragments if it doesn't fit in one datagram.
+         * @param recipient_id The ID to report if the frame can't be sent
+         * @param address The address to send the frame to
+         * @param frame A frame built by frame_messages(), starting with its size
+         * @param format The format the frame was built in
+         */
+        void queue_frame(const int recipient_id, const sockaddr_in& address, const std::vector<char>& frame,
+                const messaging::WireFormat format);
+        /**
+         * Sends every queued datagram, with as few sendmmsg() calls as
+         * possible. This only waits for the local socket buffer to have room,
+         * never for a recipient.
+         * @return The IDs of the recipients that had a datagram the kernel
+         * refused to send, such as one to an unreachable network
+         */
+        std::set<int> send_queued();
+        /**
+         * Reads every datagram waiting on the socket, without blocking, and
+         * reassembles them into frames.
+         * @param complete_frames Each frame completed by these datagrams is
+         * added to this vector, with its format
+         */
+        void receive(std::vector<ReceivedFrame>& complete_frames);
+};
+
+} /* namespace networking */
+} /* namespace pddm */
@@ -0,0 +1,130 @@
+/**
+ * @file FrameReader.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "FrameReader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+
+#include "MessageFraming.h"
+#include "../Configuration.h"
+
+namespace pddm {
+namespace networking {
+
+FrameReader::FrameReader() :
+        format(messaging::WireFormat::MUTILS),
+        announced(false),
+        rejected(false),
+        size_bytes_read(0),
+        frame_bytes_read(0) {}
+
+void FrameReader::consume_size_byte(const std::uint8_t byte) {
+    size_bytes[size_bytes_read++] = byte;
+    std::size_t frame_size = 0;
+    if(format == messaging::WireFormat::MUTILS) {
+        if(size_bytes_read < sizeof(frame_size)) {
+            return;
+        }
+        std::memcpy(&frame_size, size_bytes, sizeof(frame_size));
+        if(!announced) {
+            //This is not a frame, but an announcement of the format the rest of them will use
+            size_bytes_read = 0;
+            const std::uint64_t format_byte = frame_size & 0xff;
+            if((frame_size & WIRE_FORMAT_ANNOUNCEMENT) != WIRE_FORMAT_ANNOUNCEMENT
+                    || ((frame_size >> 8) & 0xff) != messaging::WIRE_FORMAT_VERSION
+                    || format_byte > static_cast<std::uint64_t>(messaging::WireFormat::COMPACT)) {
+                //The sender uses a layout this reader can't parse
+                rejected = true;
+                return;
+            }
+            format = static_cast<messaging::WireFormat>(format_byte);
+            announced = true;
+            return;
+        }
+    } else {
+        //A varint ends at the first byte without its high bit set
+        if((byte & 0x80) && size_bytes_read < sizeof(size_bytes)) {
+            return;
+        }
+        for(std::size_t i = 0; i < size_bytes_read; ++i) {
+            frame_size |= static_cast<std::size_t>(size_bytes[i] & 0x7f) << (7 * i);
+        }
+    }
+    size_bytes_read = 0;
+    if(frame_size > MAX_RECEIVED_FRAME_SIZE) {
+        //Don't let the sender make this reader allocate whatever it likes
+        rejected = true;
+        return;
+    }
+    //An empty frame has no messages in it, so there is nothing to read
+    if(frame_size > 0) {
+        //Received messages may keep views of the buffer, and are allocated in its arena, so each frame needs a new one
+        frame = std::make_shared<messaging::ReceiveBuffer>(frame_size);
+        frame_bytes_read = 0;
+    }
+}
+
+bool FrameReader::consume(const char* bytes, std::size_t size, std::vector<messaging::SharedBuffer>& complete_frames) {
+    while(size > 0 && !rejected) {
+        if(!frame) {
+            consume_size_byte(static_cast<std::uint8_t>(*bytes));
+            ++bytes;
+            --size;
+            continue;
+        }
+        std::size_t bytes_to_copy = std::min(size, frame->size() - frame_bytes_read);
+        std::memcpy(frame->data() + frame_bytes_read, bytes, bytes_to_copy);
+        frame_bytes_read += bytes_to_copy;
+        bytes += bytes_to_copy;
+        size -= bytes_to_copy;
+        if(frame_bytes_read == frame->size()) {
+            complete_frames.emplace_back(std::move(frame));
+            frame = nullptr;
+        }
+    }
+    return !rejected;
+}
+
+FrameReader::Status FrameReader::read_from(const int socket_fd, std::vector<char>& scratch, const std::size_t max_bytes,
+        std::vector<messaging::SharedBuffer>& complete_frames) {
+    std::size_t total_bytes_read = 0;
+    while(total_bytes_read < max_bytes) {
+        ssize_t bytes_read;
+        if(frame && frame->size() - frame_bytes_read >= scratch.size()) {
+            //The rest of a large frame can be read straight into its buffer, skipping a copy
+            bytes_read = recv(socket_fd, frame->data() + frame_bytes_read, frame->size() - frame_bytes_read, 0);
+            if(bytes_read > 0) {
+                frame_bytes_read += bytes_read;
+                if(frame_bytes_read == frame->size()) {
+                    complete_frames.emplace_back(std::move(frame));
+                    frame = nullptr;
+                }
+            }
+        } else {
+            bytes_read = recv(socket_fd, scratch.data(), scratch.size(), 0);
+            if(bytes_read > 0 && !consume(scratch.data(), bytes_read, complete_frames)) {
+                return Status::CLOSED;
+            }
+        }
+        if(bytes_read > 0) {
+            total_bytes_read += bytes_read;
+        } else if(bytes_read == 0) {
+            return Status::CLOSED;
+        } else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            return Status::WOULD_BLOCK;
+        } else if(errno != EINTR) {
+            return Status::CLOSED;
+        }
+    }
+    return Status::MORE_AVAILABLE;
+}
+
+} /* namespace networking */
+} /* namespace pddm */
@@ -0,0 +1,93 @@
+/**
+ * @file FrameReader.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../messaging/ReceiveBuffer.h"
+#include "../messaging/WireFormat.h"
+
+namespace pddm {
+namespace networking {
+
+/**
+ * The read state of one incoming connection, which assembles the frames sent
+ * on it from nonblocking reads of whatever bytes have arrived. A frame's size
+ * and contents can each be split across any number of reads, and one read
+ * can contain the end of one frame and several more, so a sender that stalls
+ * partway through a frame never blocks the thread reading from it.
+ */
+class FrameReader {
+    public:
+        /** The outcome of reading from a connection */
+        enum class Status {
+            /** Everything the sender has sent so far has been read */
+            WOULD_BLOCK,
+            /** The read limit was reached before the socket ran out of bytes */
+            MORE_AVAILABLE,
+            /** The sender closed the connection, or the connection failed */
+            CLOSED
+        };
+    private:
+        messaging::WireFormat format;
+        /** True once the sender has announced a format and version this reader understands */
+        bool announced;
+        /** True if the sender started with something other than such an
+         * announcement, or sent a frame larger than MAX_RECEIVED_FRAME_SIZE,
+         * in which case nothing more is read from it */
+        bool rejected;
+        /** The bytes of the current frame's size that have been read so far */
+        std::uint8_t size_bytes[sizeof(std::uint64_t) + 2];
+        std::size_t size_bytes_read;
+        /** The frame being read, once its size is known, or null while reading the size */
+        std::shared_ptr<messaging::ReceiveBuffer> frame;
+        std::size_t frame_bytes_read;
+        /**
+         * Adds one byte to the size of the next frame. Once the size is
+         * complete, this starts a new frame of that size, unless it is the
+         * first one, which must be a wire format announcement of the current
+         * version; if it isn't, or the frame is larger than
+         * MAX_RECEIVED_FRAME_SIZE, the connection is rejected.
+         */
+        void consume_size_byte(const std::uint8_t byte);
+    public:
+        FrameReader();
+        /**
+         * Parses bytes that have been read from the connection by the
+         * caller, adding each frame they complete to complete_frames.
+         * @param bytes The bytes, which are copied and can be reused afterwards
+         * @param size The number of bytes
+         * @param complete_frames Each frame that these bytes completed is
+         * added to this vector, in the order they were sent
+         * @return False if the connection has been rejected, and should be closed
+         */
+        bool consume(const char* bytes, std::size_t size, std::vector<messaging::SharedBuffer>& complete_frames);
+        /** @return The format the sender announced */
+        messaging::WireFormat get_format() const { return format; }
+        /**
+         * Reads as many bytes as are available from a nonblocking socket, up
+         * to a limit, and assembles them into frames.
+         * @param socket_fd The socket to read from
+         * @param scratch A buffer to read into before the bytes are split
+         * into frames, which can be shared by every FrameReader on a thread
+         * @param max_bytes The most bytes to read before returning, so that
+         * one sender can't keep the reading thread busy indefinitely
+         * @param complete_frames Each frame that was completed by this read is
+         * added to this vector, in the order they were sent
+         * @return Whether the socket has more bytes to read, none, or has
+         * closed; a connection that is rejected is reported as closed
+         */
+        Status read_from(const int socket_fd, std::vector<char>& scratch, const std::size_t max_bytes,
+                std::vector<messaging::SharedBuffer>& complete_frames);
+};
+
+} /* namespace networking */
+} /* namespace pddm */
@@ -0,0 +1,206 @@
+/**
+ * @file IoUring.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "IoUring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Socket.h"
+
+namespace pddm {
+namespace networking {
+
+namespace {
+//glibc has no wrappers for the io_uring system calls
+int io_uring_setup(unsigned entries, io_uring_params* params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags, const void* arg, std::size_t arg_size) {
+    return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size);
+}
+int io_uring_register(int ring_fd, unsigned opcode, const void* arg, unsigned num_args) {
+    return syscall(__NR_io_uring_register, ring_fd, opcode, arg, num_args);
+}
+}
+
+IoUring::IoUring(const unsigned entries) :
+        rings(MAP_FAILED),
+        rings_size(0),
+        sqes(static_cast<io_uring_sqe*>(MAP_FAILED)),
+        sqes_size(0),
+        sqe_tail(0),
+        buffer_ring(nullptr),
+        buffer_ring_tail_ptr(nullptr),
+        buffer_ring_size(0),
+        buffer_ring_tail(0),
+        buffer_ring_mask(0),
+        buffer_size(0) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = 4 * entries;
+    ring_fd = io_uring_setup(entries, &params);
+    if(ring_fd < 0) {
+        throw connection_failure(std::string("Could not create an io_uring instance: ") + strerror(errno));
+    }
+    //Every kernel with the features BaseTcpClient needs maps both rings at once
+    if(!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        close(ring_fd);
+        throw connection_failure("This kernel's io_uring is too old.");
+    }
+    rings_size = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+            params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    rings = mmap(nullptr, rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            ring_fd, IORING_OFF_SQES));
+    if(rings == MAP_FAILED || sqes == MAP_FAILED) {
+        if(rings != MAP_FAILED) munmap(rings, rings_size);
+        if(sqes != MAP_FAILED) munmap(sqes, sqes_size);
+        close(ring_fd);
+        throw connection_failure("Could not map the io_uring rings.");
+    }
+    char* ring_bytes = static_cast<char*>(rings);
+    sq_head = reinterpret_cast<unsigned*>(ring_bytes + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(ring_bytes + params.sq_off.tail);
+    sq_array = reinterpret_cast<unsigned*>(ring_bytes + params.sq_off.array);
+    sq_mask = *reinterpret_cast<unsigned*>(ring_bytes + params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    sqe_tail = *sq_tail;
+    cq_head = reinterpret_cast<unsigned*>(ring_bytes + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(ring_bytes + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned*>(ring_bytes + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(ring_bytes + params.cq_off.cqes);
+}
+
+IoUring::~IoUring() {
+    //Closing the ring cancels any requests still in flight
+    close(ring_fd);
+    munmap(sqes, sqes_size);
+    munmap(rings, rings_size);
+    if(buffer_ring != nullptr) {
+        munmap(buffer_ring, buffer_ring_size);
+    }
+}
+
+bool IoUring::is_supported() {
+    try {
+        //Provided buffer rings need kernel 5.19
+        IoUring test_ring(2);
+        test_ring.register_buffers(0, 1, 1);
+        //Multishot receives need kernel 6.0, and older kernels reject them with -EINVAL,
+        //so try one on a socket pair that has a byte waiting to be read
+        int socket_fds[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, socket_fds) < 0) {
+            return false;
+        }
+        const char probe_byte = 0;
+        bool supported = false;
+        if(write(socket_fds[1], &probe_byte, 1) == 1) {
+            io_uring_sqe* sqe = test_ring.get_sqe();
+            sqe->opcode = IORING_OP_RECV;
+            sqe->fd = socket_fds[0];
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = 0;
+            if(test_ring.submit_and_wait(1, 1000) >= 0) {
+                test_ring.for_each_completion([&](const io_uring_cqe& completion) {
+                    //A multishot receive that read the byte and is still armed
+                    supported = completion.res == 1 && (completion.flags & IORING_CQE_F_MORE);
+                });
+            }
+        }
+        //The receive still in flight is cancelled when the test ring is closed
+        close(socket_fds[0]);
+        close(socket_fds[1]);
+        return supported;
+    } catch(const connection_failure&) {
+        return false;
+    }
+}
+
+unsigned IoUring::publish_submissions() {
+    const unsigned num_unpublished = sqe_tail - *sq_tail;
+    __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+    return num_unpublished;
+}
+
+io_uring_sqe* IoUring::get_sqe() {
+    if(sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+        submit_and_wait(0);
+    }
+    const unsigned index = sqe_tail & sq_mask;
+    sq_array[index] = index;
+    ++sqe_tail;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int IoUring::submit_and_wait(const unsigned wait_for, const int timeout_ms) {
+    const unsigned to_submit = publish_submissions();
+    __kernel_timespec timeout;
+    io_uring_getevents_arg wait_arg;
+    std::memset(&wait_arg, 0, sizeof(wait_arg));
+    wait_arg.sigmask_sz = _NSIG / 8;
+    if(timeout_ms >= 0) {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+        wait_arg.ts = reinterpret_cast<std::uint64_t>(&timeout);
+    }
+    const unsigned flags = wait_for > 0 ? IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG : IORING_ENTER_EXT_ARG;
+    int result;
+    do {
+        result = io_uring_enter(ring_fd, to_submit, wait_for, flags, &wait_arg, sizeof(wait_arg));
+    } while(result < 0 && errno == EINTR);
+    return result < 0 ? -errno : result;
+}
+
+void IoUring::register_buffers(const unsigned short group_id, const unsigned short count, const std::size_t size) {
+    buffer_ring_size = count * sizeof(io_uring_buf);
+    void* ring_memory = mmap(nullptr, buffer_ring_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if(ring_memory == MAP_FAILED) {
+        throw connection_failure("Could not allocate an io_uring buffer ring.");
+    }
+    io_uring_buf_reg registration;
+    std::memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = reinterpret_cast<std::uint64_t>(ring_memory);
+    registration.ring_entries = count;
+    registration.bgid = group_id;
+    if(io_uring_register(ring_fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+        munmap(ring_memory, buffer_ring_size);
+        throw connection_failure(std::string("Could not register io_uring buffers: ") + strerror(errno));
+    }
+    buffer_ring = static_cast<io_uring_buf*>(ring_memory);
+    buffer_ring_tail_ptr = &static_cast<io_uring_buf_ring*>(ring_memory)->tail;
+    buffer_ring_mask = count - 1;
+    buffer_memory.resize(count * size);
+    buffer_size = size;
+    for(unsigned short buffer_id = 0; buffer_id < count; ++buffer_id) {
+        recycle_buffer(buffer_id);
+    }
+}
+
+void IoUring::recycle_buffer(const unsigned short buffer_id) {
+    io_uring_buf& entry = buffer_ring[buffer_ring_tail & buffer_ring_mask];
+    entry.addr = reinterpret_cast<std::uint64_t>(get_buffer(buffer_id));
+    entry.len = buffer_size;
+    entry.bid = buffer_id;
+    ++buffer_ring_tail;
+    __atomic_store_n(buffer_ring_tail_ptr, buffer_ring_tail, __ATOMIC_RELEASE);
+}
+
+} /* namespace networking */
+} /* namespace pddm */
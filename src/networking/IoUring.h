@@ -0,0 +1,130 @@
+/**
+ * @file IoUring.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <linux/io_uring.h>
+
+namespace pddm {
+namespace networking {
+
+/**
+ * A minimal wrapper around an io_uring instance, using the kernel's interface
+ * directly so that it needs no library beyond the kernel headers. It provides
+ * only what BaseTcpClient needs: filling in and submitting requests, reading
+ * completions, and one group of provided buffers for multishot receives to
+ * read into. An IoUring is not thread-safe; each thread that uses one should
+ * have its own, or callers must lock around it.
+ */
+class IoUring {
+    private:
+        int ring_fd;
+        /** The submission and completion rings, which share one mapping */
+        void* rings;
+        std::size_t rings_size;
+        io_uring_sqe* sqes;
+        std::size_t sqes_size;
+        unsigned* sq_head;
+        unsigned* sq_tail;
+        unsigned* sq_array;
+        unsigned sq_mask;
+        unsigned sq_entries;
+        /** The tail of the submission ring, including requests that haven't been published to the kernel yet */
+        unsigned sqe_tail;
+        unsigned* cq_head;
+        unsigned* cq_tail;
+        unsigned cq_mask;
+        io_uring_cqe* cqes;
+        /** The ring of provided buffers, if register_buffers() was called.
+         * This isn't accessed through io_uring_buf_ring::bufs, because in C++
+         * the empty struct the header puts in front of that array takes up
+         * space, which moves the array away from the start of the ring. */
+        io_uring_buf* buffer_ring;
+        /** The ring's tail, which overlaps the unused end of its first entry */
+        unsigned short* buffer_ring_tail_ptr;
+        std::size_t buffer_ring_size;
+        unsigned short buffer_ring_tail;
+        unsigned short buffer_ring_mask;
+        std::vector<char> buffer_memory;
+        std::size_t buffer_size;
+        /** Makes every filled-in request visible to the kernel */
+        unsigned publish_submissions();
+    public:
+        /**
+         * Creates an io_uring instance.
+         * @param entries The number of requests that can be waiting to be
+         * submitted at once. The completion ring is 4 times larger, since
+         * multishot requests can complete many times each.
+         * @throws connection_failure if the kernel doesn't support io_uring
+         */
+        explicit IoUring(const unsigned entries);
+        ~IoUring();
+        IoUring(const IoUring&) = delete;
+        IoUring& operator=(const IoUring&) = delete;
+        /**
+         * @return True if this kernel supports every io_uring feature
+         * BaseTcpClient uses, which includes provided buffer rings (5.19)
+         * and multishot receives (6.0). If it doesn't, BaseTcpClient falls
+         * back to epoll.
+         */
+        static bool is_supported();
+        /**
+         * Gets an empty request to fill in, which will be sent to the kernel
+         * on the next call to submit_and_wait(). If the submission ring is
+         * full, this submits the requests in it first.
+         */
+        io_uring_sqe* get_sqe();
+        /**
+         * Submits every request filled in since the last call, and waits
+         * until a number of requests have completed.
+         * @param wait_for The number of completions to wait for, or 0 to
+         * return as soon as the requests are submitted
+         * @param timeout_ms The longest time to wait, or -1 to wait indefinitely
+         * @return The number of requests submitted, or -errno on failure
+         * (-ETIME if the timeout expired)
+         */
+        int submit_and_wait(const unsigned wait_for, const int timeout_ms = -1);
+        /**
+         * Calls a function with each completion that is ready, in the order
+         * they completed, and removes them from the completion ring.
+         * @param handle_completion A function that takes a const io_uring_cqe&
+         * @return The number of completions handled
+         */
+        template<typename CompletionFunc>
+        unsigned for_each_completion(CompletionFunc&& handle_completion) {
+            unsigned head = *cq_head;
+            const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+            unsigned handled = 0;
+            for(; head != tail; ++head, ++handled) {
+                handle_completion(cqes[head & cq_mask]);
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+            return handled;
+        }
+        /**
+         * Gives the kernel a group of buffers for receives with
+         * IOSQE_BUFFER_SELECT to read into, each of which is returned to the
+         * group with recycle_buffer() once its bytes have been used.
+         * @param group_id The ID receives will use to pick this group
+         * @param count The number of buffers, which must be a power of 2
+         * @param size The size of each buffer
+         * @throws connection_failure if the kernel rejects the buffers
+         */
+        void register_buffers(const unsigned short group_id, const unsigned short count, const std::size_t size);
+        /** @return The buffer with the given ID, from the group given to register_buffers() */
+        char* get_buffer(const unsigned short buffer_id) {
+            return buffer_memory.data() + buffer_id * buffer_size;
+        }
+        /** Returns a buffer to the group given to register_buffers(), so the kernel can read into it again */
+        void recycle_buffer(const unsigned short buffer_id);
+};
+
+} /* namespace networking */
+} /* namespace pddm */
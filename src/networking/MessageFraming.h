@@ -0,0 +1,221 @@
+/**
+ * @file MessageFraming.h
+ * Functions that lay out the frames TCP clients send to each other, which
+ * serialize each message in a single pass into a caller-provided buffer that
+ * can be reused from one send to the next.
+ *
+ * A frame starts with the size of the rest of the frame. A frame sent to a
+ * meter then contains the number of messages in it, followed by each message
+ * preceded by its size (since messaging::WIRE_FORMAT_VERSION 1), so the
+ * receiver can step from one message to the next without computing any
+ * message's size. A frame sent to the utility
+ * contains exactly one message, with no count or size prefix. In
+ * WireFormat::MUTILS these sizes and counts are size_ts, and in
+ * WireFormat::COMPACT they are varints.
+ *
+ * Every connection starts with an announcement of the format and
+ * messaging::WIRE_FORMAT_VERSION its frames use (see
+ * WIRE_FORMAT_ANNOUNCEMENT), and receivers drop connections that don't start
+ * with one they understand. Peers using the unannounced layout that came
+ * before version 1 are disconnected rather than misparsed.
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutils-serialization/SerializationSupport.hpp>
+
+#include "../messaging/CompactEncoding.h"
+#include "../messaging/MessageType.h"
+#include "../messaging/OverlayTransportMessage.h"
+#include "../messaging/WireFormat.h"
+
+namespace pddm {
+namespace networking {
+
+/** A sender announces the WireFormat and layout version a connection will
+ * use by sending this value, with the format in its lowest byte and the
+ * version in the byte above it, in place of the size of its first frame. No
+ * frame is large enough to be mistaken for it, so a receiver can tell a
+ * sender that doesn't announce anything, which uses the older unannounced
+ * layout, and close its connection. */
+constexpr std::uint64_t WIRE_FORMAT_ANNOUNCEMENT = 0xffffffffffff0000ull;
+/**
+ * @param format The format a connection will use
+ * @return The announcement to send, as a MUTILS frame size, at the start of the connection
+ */
+inline std::uint64_t wire_format_announcement(const messaging::WireFormat format) {
+    return WIRE_FORMAT_ANNOUNCEMENT | (static_cast<std::uint64_t>(messaging::WIRE_FORMAT_VERSION) << 8)
+            | static_cast<std::uint64_t>(format);
+}
+
+/**
+ * Serializes a sequence of messages into a frame for a meter, replacing the
+ * previous contents of the buffer. The buffer only grows, so reusing it for
+ * every send to the same connection avoids allocating after the first few.
+ * @param begin An iterator to the first pointer to a message
+ * @param end An iterator past the last pointer to a message
+ * @param format The format to serialize the frame in
+ * @param frame The buffer to write the frame into
+ * @param message_sizes Scratch space for the message sizes, which is reused
+ * for the same reason as frame
+ */
+template<typename MessagePtrIter>
+void frame_messages(MessagePtrIter begin, MessagePtrIter end, const messaging::WireFormat format,
+        std::vector<char>& frame, std::vector<std::size_t>& message_sizes) {
+    if(format == messaging::WireFormat::COMPACT) {
+        //The encoding appends to the buffer, so write each size after its message and insert it in front
+        frame.clear();
+        messaging::CompactEncoding::write_varint(std::distance(begin, end), frame);
+        for(auto message_iter = begin; message_iter != end; ++message_iter) {
+            std::size_t message_start = frame.size();
+            messaging::CompactEncoding::to_bytes(**message_iter, frame);
+            messaging::CompactEncoding::insert_size_prefix(frame, message_start);
+        }
+        messaging::CompactEncoding::insert_size_prefix(frame, 0);
+        return;
+    }
+    //Compute each message's size exactly once
+    message_sizes.clear();
+    std::size_t frame_size = sizeof(std::size_t);
+    for(auto message_iter = begin; message_iter != end; ++message_iter) {
+        message_sizes.push_back(mutils::bytes_size(**message_iter));
+        frame_size += sizeof(std::size_t) + message_sizes.back();
+    }
+    frame.resize(sizeof(frame_size) + frame_size);
+    char* buffer = frame.data();
+    std::size_t bytes_written = mutils::to_bytes(frame_size, buffer);
+    bytes_written += mutils::to_bytes(message_sizes.size(), buffer + bytes_written);
+    auto size_iter = message_sizes.begin();
+    for(auto message_iter = begin; message_iter != end; ++message_iter, ++size_iter) {
+        bytes_written += mutils::to_bytes(*size_iter, buffer + bytes_written);
+        std::size_t message_bytes = mutils::to_bytes(**message_iter, buffer + bytes_written);
+        assert(message_bytes == *size_iter);
+        bytes_written += message_bytes;
+    }
+}
+
+/**
+ * Serializes a single message into a frame for the utility, replacing the
+ * previous contents of the buffer.
+ * @param message The message to send
+ * @param format The format to serialize the frame in
+ * @param frame The buffer to write the frame into
+ */
+template<typename MessageType>
+void frame_utility_message(const MessageType& message, const messaging::WireFormat format, std::vector<char>& frame) {
+    if(format == messaging::WireFormat::COMPACT) {
+        frame.clear();
+        messaging::CompactEncoding::to_bytes(message, frame);
+        messaging::CompactEncoding::insert_size_prefix(frame, 0);
+        return;
+    }
+    const std::size_t frame_size = mutils::bytes_size(message);
+    frame.resize(sizeof(frame_size) + frame_size);
+    std::size_t bytes_written = mutils::to_bytes(frame_size, frame.data());
+    mutils::to_bytes(message, frame.data() + bytes_written);
+}
+
+/**
+ * Reads a message count or message size from a received frame, and advances
+ * the buffer pointer past it.
+ * @param buffer A pointer into a received frame
+ * @param end The end of the frame
+ * @param format The format of the frame
+ * @return The count or size
+ * @throws messaging::DecodeError if the prefix runs past the end of the frame
+ */
+inline std::size_t read_size_prefix(const char*& buffer, const char* end, const messaging::WireFormat format) {
+    if(format == messaging::WireFormat::COMPACT) {
+        return messaging::CompactEncoding::read_varint(buffer, end);
+    }
+    if(end - buffer < static_cast<std::ptrdiff_t>(sizeof(std::size_t))) {
+        throw messaging::DecodeError("Size prefix runs past the end of the frame");
+    }
+    std::size_t size;
+    std::memcpy(&size, buffer, sizeof(size));
+    buffer += sizeof(size);
+    return size;
+}
+
+/**
+ * Reads the size of the next message in a received frame, and checks that
+ * the message fits in the rest of the frame and is large enough to have a type.
+ * @param buffer A pointer to the message's size prefix, which will be
+ * advanced to the start of the message
+ * @param end The end of the frame
+ * @param format The format of the frame
+ * @return The size of the message
+ * @throws messaging::DecodeError if the message doesn't fit in the frame
+ */
+inline std::size_t read_message_size(const char*& buffer, const char* end, const messaging::WireFormat format) {
+    const std::size_t message_size = read_size_prefix(buffer, end, format);
+    const std::size_t type_size = format == messaging::WireFormat::COMPACT ? 1 : sizeof(messaging::MessageType);
+    if(message_size > static_cast<std::size_t>(end - buffer) || message_size < type_size) {
+        throw messaging::DecodeError("Message of size " + std::to_string(message_size)
+                + " doesn't fit in the " + std::to_string(end - buffer) + " bytes left in its frame");
+    }
+    return message_size;
+}
+
+/**
+ * @param buffer A pointer to a serialized message
+ * @param format The format the message was serialized in
+ * @return The type of the message
+ */
+inline messaging::MessageType peek_message_type(const char* buffer, const messaging::WireFormat format) {
+    if(format == messaging::WireFormat::COMPACT) {
+        return static_cast<messaging::MessageType>(static_cast<std::uint8_t>(buffer[0]));
+    }
+    messaging::MessageType message_type;
+    std::memcpy(&message_type, buffer, sizeof(message_type));
+    return message_type;
+}
+
+/**
+ * Deserializes a message of a known type from a received frame.
+ * @param buffer A pointer to the serialized message
+ * @param size The size of the serialized message
+ * @param format The format the message was serialized in
+ * @return The message
+ * @throws messaging::DecodeError if the message is not valid COMPACT bytes
+ */
+template<typename MessageType>
+std::unique_ptr<MessageType> decode_message(const char* buffer, const std::size_t size, const messaging::WireFormat format) {
+    if(format == messaging::WireFormat::COMPACT) {
+        return messaging::CompactEncoding::from_bytes<MessageType>(buffer, size);
+    }
+    return MessageType::from_bytes(nullptr, buffer);
+}
+
+/**
+ * Deserializes an OverlayTransportMessage from a received frame, keeping the
+ * parts of it that a relay doesn't need to read as views of the frame, and
+ * allocating everything else in the frame's arena.
+ * @param buffer A pointer to the serialized message
+ * @param size The size of the serialized message
+ * @param format The format the message was serialized in
+ * @param source_buffer The receive buffer containing the message
+ * @return The message
+ * @throws messaging::DecodeError if the message is not valid COMPACT bytes
+ */
+inline std::shared_ptr<messaging::OverlayTransportMessage> view_transport_message(const char* buffer, const std::size_t size,
+        const messaging::WireFormat format, const messaging::SharedBuffer& source_buffer) {
+    if(format == messaging::WireFormat::COMPACT) {
+        return messaging::CompactEncoding::view_from_bytes(buffer, size, source_buffer);
+    }
+    return messaging::OverlayTransportMessage::view_from_bytes(buffer, source_buffer);
+}
+
+} /* namespace networking */
+} /* namespace pddm */
@@ -0,0 +1,109 @@
+/**
+ * @file ReactorPool.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "ReactorPool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "Socket.h"
+
+namespace pddm {
+namespace networking {
+
+ReactorPool::ReactorPool(const std::size_t num_threads, const bool pin_threads) :
+        pin_threads(pin_threads),
+        reactors(num_threads > 0 ? num_threads : 1),
+        shutdown(false) {
+    for(auto& reactor : reactors) {
+        reactor.epoll_fd = epoll_create1(0);
+        if(reactor.epoll_fd < 0) throw connection_failure("Could not create an epoll instance in ReactorPool.");
+    }
+}
+
+ReactorPool::~ReactorPool() {
+    shut_down();
+    for(auto& reactor : reactors) {
+        close(reactor.epoll_fd);
+    }
+}
+
+void ReactorPool::add(const std::size_t shard, const int fd, PollFunction poll) {
+    Reactor& reactor = reactors[reactor_for(shard)];
+    reactor.sources.push_back(Source{fd, std::move(poll)});
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.data.ptr = &reactor.sources.back();
+    //Level-triggered, so a client that leaves work for its next turn is reported again
+    event.events = EPOLLIN;
+    if(epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        perror("Error in epoll_ctl");
+        throw connection_failure("Failed to add a client to a ReactorPool!");
+    }
+}
+
+void ReactorPool::start() {
+    for(std::size_t reactor_index = 0; reactor_index < reactors.size(); ++reactor_index) {
+        reactors[reactor_index].thread = std::thread([this, reactor_index]() {
+            run_reactor(reactor_index);
+        });
+    }
+}
+
+void ReactorPool::shut_down() {
+    shutdown = true;
+    for(auto& reactor : reactors) {
+        if(reactor.thread.joinable()) {
+            reactor.thread.join();
+        }
+    }
+}
+
+void ReactorPool::run_reactor(const std::size_t reactor_index) {
+    pthread_setname_np(pthread_self(), ("reactor_" + std::to_string(reactor_index)).c_str());
+    if(pin_threads) {
+        const unsigned int num_cores = std::thread::hardware_concurrency();
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(reactor_index % (num_cores > 0 ? num_cores : 1), &cpu_set);
+        if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0) {
+            fprintf(stderr, "WARNING: Could not pin reactor thread %zu to a core\n", reactor_index);
+        }
+    }
+    Reactor& reactor = reactors[reactor_index];
+    const int EVENTS_LENGTH = 256;
+    std::vector<epoll_event> events(EVENTS_LENGTH);
+    //Sources that had work left at the end of their turn, and the ones that get a turn now
+    std::vector<Source*> unfinished_sources;
+    std::vector<Source*> ready_sources;
+    while(!shutdown) {
+        ready_sources.swap(unfinished_sources);
+        unfinished_sources.clear();
+        //Don't wait for new events if some clients are already known to have work waiting
+        int num_events = epoll_wait(reactor.epoll_fd, events.data(), EVENTS_LENGTH, ready_sources.empty() ? 100 : 0);
+        for(int i = 0; i < num_events; ++i) {
+            Source* source = static_cast<Source*>(events[i].data.ptr);
+            if(std::find(ready_sources.begin(), ready_sources.end(), source) == ready_sources.end()) {
+                ready_sources.push_back(source);
+            }
+        }
+        for(Source* source : ready_sources) {
+            if(source->poll()) {
+                unfinished_sources.push_back(source);
+            }
+        }
+    }
+}
+
+} /* namespace networking */
+} /* namespace pddm */
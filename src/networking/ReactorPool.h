@@ -0,0 +1,86 @@
+/**
+ * @file ReactorPool.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <thread>
+#include <vector>
+
+namespace pddm {
+namespace networking {
+
+/**
+ * A fixed set of threads, each pinned to its own core, that drive the receive
+ * loops of many clients in one process, so that thousands of clients don't
+ * need a thread each. Each client is registered as a file descriptor that
+ * becomes readable when it has work to do and a function that does that work
+ * without blocking (for a TCP client, its get_poll_fd() and
+ * poll_incoming_messages()), and is assigned to one thread by its shard
+ * number. Each thread waits on an epoll instance that watches the descriptors
+ * of its clients, so a client's work is always done by the same thread, and
+ * clients on different threads never wait for each other.
+ */
+class ReactorPool {
+    public:
+        /**
+         * Does the work that is waiting for a client, without blocking.
+         * @return True if the client still has work left that its file
+         * descriptor won't report, so the function should be called again
+         * on the next turn of its thread
+         */
+        using PollFunction = std::function<bool()>;
+    private:
+        struct Source {
+            int fd;
+            PollFunction poll;
+        };
+        struct Reactor {
+            int epoll_fd;
+            /** A list, so that epoll can hold pointers to the sources */
+            std::list<Source> sources;
+            std::thread thread;
+        };
+        const bool pin_threads;
+        std::vector<Reactor> reactors;
+        std::atomic<bool> shutdown;
+        void run_reactor(const std::size_t reactor_index);
+    public:
+        /**
+         * Creates the pool's epoll instances, without starting its threads.
+         * @param num_threads The number of threads to run clients on
+         * @param pin_threads True if each thread should be pinned to a
+         * different core (wrapping around if there are more threads than cores)
+         */
+        ReactorPool(const std::size_t num_threads, const bool pin_threads = true);
+        ~ReactorPool();
+        ReactorPool(const ReactorPool&) = delete;
+        ReactorPool& operator=(const ReactorPool&) = delete;
+        /**
+         * Registers a client with the pool. This must be called before start().
+         * @param shard A number identifying the client, such as its meter ID;
+         * the client runs on thread (shard % num_threads)
+         * @param fd A file descriptor that becomes readable (and stays
+         * readable until poll is called) when the client has work to do
+         * @param poll The function that does the client's work
+         */
+        void add(const std::size_t shard, const int fd, PollFunction poll);
+        /** @return The index of the thread that runs the clients with a shard number */
+        std::size_t reactor_for(const std::size_t shard) const { return shard % reactors.size(); }
+        /** @return The number of threads in the pool */
+        std::size_t size() const { return reactors.size(); }
+        /** Starts the pool's threads, which run until shut_down() is called. */
+        void start();
+        /** Stops the pool's threads and waits for them to finish their current turn. */
+        void shut_down();
+};
+
+} /* namespace networking */
+} /* namespace pddm */
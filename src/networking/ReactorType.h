@@ -0,0 +1,29 @@
+/**
+ * @file ReactorType.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+namespace pddm {
+namespace networking {
+
+/**
+ * The system call interfaces that a TCP client can use to wait for incoming
+ * connections and messages, and to write the frames it sends.
+ */
+enum class ReactorType {
+    /** Waits with epoll, and reads and writes with one system call per
+     * connection. Works on every Linux kernel. */
+    EPOLL,
+    /** Accepts and receives with multishot io_uring requests, which keep
+     * delivering completions without being resubmitted, and submits the
+     * writes of a batch of sends with one system call. Needs Linux 6.0 or
+     * later; clients fall back to EPOLL on older kernels. */
+    IO_URING
+};
+
+} /* namespace networking */
+} /* namespace pddm */
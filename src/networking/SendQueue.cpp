@@ -0,0 +1,211 @@
+/**
+ * @file SendQueue.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "SendQueue.h"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/errqueue.h>
+
+#include "../Configuration.h"
+
+namespace pddm {
+namespace networking {
+
+SendQueue::SendQueue(const int socket_fd) :
+        socket_fd(socket_fd),
+        first_frame_offset(0),
+        queued_bytes(0),
+        blocked(false),
+        zerocopy_enabled(false),
+        next_zerocopy_id(0),
+        first_frame_zerocopied(false),
+        first_frame_zerocopy_id(0) {
+#ifdef SO_ZEROCOPY
+    if(ZEROCOPY_SEND_THRESHOLD > 0) {
+        int enable = 1;
+        zerocopy_enabled = setsockopt(socket_fd, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) == 0;
+    }
+#endif
+}
+
+void SendQueue::recycle(std::vector<char>&& buffer) {
+    if(spare_buffers.size() < MAX_SPARE_BUFFERS) {
+        buffer.clear();
+        spare_buffers.emplace_back(std::move(buffer));
+    }
+}
+
+SendQueue::Status SendQueue::enqueue(std::vector<char>& frame) {
+    if(frame.empty()) {
+        return frames.empty() ? Status::EMPTY : Status::PENDING;
+    }
+    append(frame);
+    //If the socket was full the last time, it won't take more until epoll says it's writable
+    if(blocked) {
+        return Status::PENDING;
+    }
+    return write_queued();
+}
+
+bool SendQueue::has_room_for(const std::size_t frame_size) const {
+    return queued_bytes == 0 || queued_bytes + frame_size <= MAX_QUEUED_SEND_BYTES;
+}
+
+void SendQueue::append(std::vector<char>& frame) {
+    if(frame.empty()) {
+        return;
+    }
+    queued_bytes += frame.size();
+    //Take the frame's buffer rather than copying it, and give the caller a spare one to build the next frame in
+    frames.emplace_back();
+    frames.back().swap(frame);
+    if(!spare_buffers.empty()) {
+        frame.swap(spare_buffers.back());
+        spare_buffers.pop_back();
+    }
+}
+
+SendQueue::Status SendQueue::flush() {
+    blocked = false;
+    return write_queued();
+}
+
+std::size_t SendQueue::gather_segments() {
+    std::size_t num_segments = 0;
+    std::size_t bytes_to_write = 0;
+    for(auto frame = frames.begin(); frame != frames.end() && num_segments < MAX_FRAMES_PER_WRITE; ++frame) {
+        std::size_t offset = num_segments == 0 ? first_frame_offset : 0;
+        segments[num_segments].iov_base = frame->data() + offset;
+        segments[num_segments].iov_len = frame->size() - offset;
+        bytes_to_write += segments[num_segments].iov_len;
+        ++num_segments;
+    }
+    std::memset(&write_message, 0, sizeof(write_message));
+    write_message.msg_iov = segments;
+    write_message.msg_iovlen = num_segments;
+    return bytes_to_write;
+}
+
+void SendQueue::advance(std::size_t bytes_written, const bool zerocopy) {
+    //Each MSG_ZEROCOPY send that succeeds gets the next sequence number
+    const std::uint32_t zerocopy_id = zerocopy ? next_zerocopy_id++ : 0;
+    queued_bytes -= bytes_written;
+    while(bytes_written > 0 && bytes_written >= frames.front().size() - first_frame_offset) {
+        bytes_written -= frames.front().size() - first_frame_offset;
+        //A frame the kernel may still be reading from must be kept until it says it's done
+        if(zerocopy) {
+            zerocopy_frames.emplace_back(zerocopy_id, std::move(frames.front()));
+        } else if(first_frame_zerocopied) {
+            zerocopy_frames.emplace_back(first_frame_zerocopy_id, std::move(frames.front()));
+        } else {
+            recycle(std::move(frames.front()));
+        }
+        frames.pop_front();
+        first_frame_offset = 0;
+        first_frame_zerocopied = false;
+    }
+    first_frame_offset += bytes_written;
+    if(zerocopy && first_frame_offset > 0) {
+        first_frame_zerocopied = true;
+        first_frame_zerocopy_id = zerocopy_id;
+    }
+}
+
+SendQueue::Status SendQueue::write_queued() {
+    bool zerocopy_allowed = zerocopy_enabled;
+    while(!frames.empty()) {
+        //Gather the queued frames into one write, starting where the last write stopped
+        const std::size_t bytes_to_write = gather_segments();
+        int flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+        const bool zerocopy = zerocopy_allowed && bytes_to_write >= ZEROCOPY_SEND_THRESHOLD;
+#ifdef MSG_ZEROCOPY
+        if(zerocopy) {
+            flags |= MSG_ZEROCOPY;
+        }
+#endif
+        ssize_t bytes_written = sendmsg(socket_fd, &write_message, flags);
+        if(bytes_written < 0) {
+            if(errno == EINTR) {
+                continue;
+            } else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                blocked = true;
+                return Status::PENDING;
+            } else if(errno == ENOBUFS && zerocopy) {
+                //The kernel ran out of memory to pin pages with; copying still works
+                zerocopy_allowed = false;
+                continue;
+            }
+            return Status::FAILED;
+        }
+        advance(bytes_written, zerocopy);
+    }
+    return Status::EMPTY;
+}
+
+const msghdr* SendQueue::prepare_write() {
+    if(frames.empty() || blocked) {
+        return nullptr;
+    }
+    gather_segments();
+    return &write_message;
+}
+
+SendQueue::Status SendQueue::finish_write(const int result) {
+    if(result == -EAGAIN || result == -EWOULDBLOCK) {
+        blocked = true;
+        return Status::PENDING;
+    } else if(result < 0 && result != -EINTR) {
+        return Status::FAILED;
+    } else if(result > 0) {
+        advance(result, false);
+    }
+    return write_queued();
+}
+
+void SendQueue::reap_zerocopy_completions() {
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+    char control[128];
+    while(!zerocopy_frames.empty()) {
+        msghdr message;
+        std::memset(&message, 0, sizeof(message));
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        if(recvmsg(socket_fd, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            return;
+        }
+        for(cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if(cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR) {
+                continue;
+            }
+            sock_extended_err error;
+            std::memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+            if(error.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            //Each notification covers an inclusive range of sequence numbers, which may wrap around
+            const std::uint32_t range_start = error.ee_info;
+            const std::uint32_t range_length = error.ee_data - error.ee_info;
+            for(auto frame = zerocopy_frames.begin(); frame != zerocopy_frames.end();) {
+                if(frame->first - range_start <= range_length) {
+                    recycle(std::move(frame->second));
+                    frame = zerocopy_frames.erase(frame);
+                } else {
+                    ++frame;
+                }
+            }
+        }
+    }
+#endif
+}
+
+} /* namespace networking */
+} /* namespace pddm */
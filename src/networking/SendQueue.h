@@ -0,0 +1,164 @@
+/**
+ * @file SendQueue.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace pddm {
+namespace networking {
+
+/**
+ * The frames waiting to be written to one nonblocking outgoing socket. A
+ * frame is written immediately if nothing is queued ahead of it and the
+ * socket accepts it; otherwise, whatever part of it the socket didn't accept
+ * is queued, and the queue is written when the socket becomes writable again.
+ * Each write sends as many queued frames as possible in one sendmsg() call,
+ * so a slow peer never blocks the sender, and a peer that falls behind gets
+ * its backlog in a few large writes rather than one write per frame. The
+ * backlog is limited to MAX_QUEUED_SEND_BYTES, so a peer that stops reading
+ * can't make the sender buffer frames without bound.
+ *
+ * If ZEROCOPY_SEND_THRESHOLD is nonzero, writes of at least that many bytes
+ * are sent with MSG_ZEROCOPY. The kernel then reads the frames directly from
+ * their buffers after sendmsg() returns, so those buffers are kept until the
+ * kernel reports that it is done with them.
+ */
+class SendQueue {
+    public:
+        /** The state of a queue after trying to write to its socket */
+        enum class Status {
+            /** Every frame has been written */
+            EMPTY,
+            /** Some frames are waiting for the socket to become writable */
+            PENDING,
+            /** The connection is broken */
+            FAILED
+        };
+    private:
+        int socket_fd;
+        /** Frames waiting to be written, in order. The first may have been partly written. */
+        std::deque<std::vector<char>> frames;
+        /** The number of bytes of the first frame that have been written */
+        std::size_t first_frame_offset;
+        /** The number of bytes in the queue that haven't been written yet */
+        std::size_t queued_bytes;
+        /** True if the last write stopped because the socket's buffer was full */
+        bool blocked;
+        /** True if the socket accepted SO_ZEROCOPY */
+        bool zerocopy_enabled;
+        /** The sequence number the kernel will give the next MSG_ZEROCOPY send */
+        std::uint32_t next_zerocopy_id;
+        /** True if part of the first frame was written with MSG_ZEROCOPY, so
+         * its buffer can't be reused as soon as the rest of it is written */
+        bool first_frame_zerocopied;
+        /** The sequence number of the last MSG_ZEROCOPY send that read from the first frame */
+        std::uint32_t first_frame_zerocopy_id;
+        /** Frames that were written with MSG_ZEROCOPY, each with the sequence
+         * number of the last send that read from it, in order */
+        std::deque<std::pair<std::uint32_t, std::vector<char>>> zerocopy_frames;
+        /** Buffers of frames that have been completely written, which can be reused */
+        std::vector<std::vector<char>> spare_buffers;
+        /** The most frames one sendmsg() call will write */
+        static constexpr std::size_t MAX_FRAMES_PER_WRITE = 64;
+        /** The most buffers to keep for reuse */
+        static constexpr std::size_t MAX_SPARE_BUFFERS = 4;
+        /** The segments of the write in progress, which must stay valid
+         * until an asynchronous write started by prepare_write() finishes */
+        iovec segments[MAX_FRAMES_PER_WRITE];
+        msghdr write_message;
+        /**
+         * Points write_message at the first MAX_FRAMES_PER_WRITE queued
+         * frames, starting where the last write stopped.
+         * @return The number of bytes in the write
+         */
+        std::size_t gather_segments();
+        /**
+         * Removes bytes that have been written from the front of the queue,
+         * and recycles the buffers of frames that have been completely written.
+         * @param bytes_written The number of bytes written
+         * @param zerocopy True if the write used MSG_ZEROCOPY
+         */
+        void advance(std::size_t bytes_written, const bool zerocopy);
+        /** Writes as many queued frames as the socket accepts */
+        Status write_queued();
+        /** Takes a buffer that is done being sent, to reuse it for a later frame */
+        void recycle(std::vector<char>&& buffer);
+    public:
+        /**
+         * Creates an empty queue for a socket, which must be nonblocking.
+         * The queue does not own the socket.
+         */
+        explicit SendQueue(const int socket_fd);
+        /**
+         * Sends a frame after any frames that are already queued, writing as
+         * much of it as the socket will accept right away. If part of the
+         * frame has to be queued, the queue takes the frame's buffer and
+         * gives the caller an empty buffer (with the same or more capacity,
+         * if one is available) to build its next frame in.
+         * @param frame The frame to send
+         * @return The state of the queue
+         */
+        Status enqueue(std::vector<char>& frame);
+        /**
+         * @param frame_size The size of a frame
+         * @return True if the frame can be queued without the unwritten bytes
+         * exceeding MAX_QUEUED_SEND_BYTES. A frame can always be queued if
+         * nothing is waiting to be written, however large it is.
+         */
+        bool has_room_for(const std::size_t frame_size) const;
+        /**
+         * Adds a frame to the end of the queue without trying to write it,
+         * taking its buffer in the same way as enqueue().
+         * @param frame The frame to send
+         */
+        void append(std::vector<char>& frame);
+        /**
+         * Prepares a sendmsg() of the queued frames for the caller to submit
+         * asynchronously (with io_uring), without MSG_ZEROCOPY. No other
+         * method may be called until the write has been passed to finish_write().
+         * @return The message to write, or null if there is nothing to write
+         * or the socket is known to be full
+         */
+        const msghdr* prepare_write();
+        /**
+         * Finishes a write started by prepare_write(), and then writes any
+         * frames it left queued, as flush() would.
+         * @param result The sendmsg() result: the number of bytes written,
+         * or -errno if it failed
+         * @return The state of the queue
+         */
+        Status finish_write(const int result);
+        /**
+         * Writes as much of the queue as the socket accepts. This should be
+         * called whenever the socket becomes writable.
+         * @return The state of the queue
+         */
+        Status flush();
+        /**
+         * Reads the kernel's notifications that MSG_ZEROCOPY sends have
+         * finished, and releases the buffers of those frames. This should be
+         * called when epoll reports EPOLLERR on the socket.
+         */
+        void reap_zerocopy_completions();
+        /**
+         * Queues frames without writing them until the next flush(), for a
+         * socket whose connection is still opening. The socket becomes
+         * writable once the connection opens, so flush() is called then.
+         */
+        void wait_until_writable() { blocked = true; }
+        bool empty() const { return frames.empty(); }
+};
+
+} /* namespace networking */
+} /* namespace pddm */
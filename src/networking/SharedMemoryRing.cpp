@@ -0,0 +1,306 @@
+/**
+ * @file SharedMemoryRing.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "SharedMemoryRing.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <thread>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MessageFraming.h"
+#include "Socket.h"
+#include "../Configuration.h"
+
+namespace pddm {
+namespace networking {
+
+static_assert((SHARED_MEMORY_RING_SIZE & (SHARED_MEMORY_RING_SIZE - 1)) == 0, "SHARED_MEMORY_RING_SIZE must be a power of 2");
+
+namespace {
+/** @return True if no process with this ID exists */
+bool process_gone(const pid_t pid) {
+    return kill(pid, 0) != 0 && errno == ESRCH;
+}
+/** @return A socket to ring doorbells with, which every sender in this process shares */
+int doorbell_sender_fd() {
+    static const int socket_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    return socket_fd;
+}
+/** @return The space a frame of this size takes up in the ring, including its header */
+std::uint64_t record_size(const std::uint64_t frame_size) {
+    return sizeof(std::uint64_t) + ((frame_size + 7) & ~std::uint64_t(7));
+}
+}
+
+std::mutex SharedMemoryRing::local_queues_mutex;
+std::map<int, std::weak_ptr<SharedMemoryRing::LocalQueue>> SharedMemoryRing::local_queues;
+
+SharedMemoryRing::SharedMemoryRing(const int port, const Role role) :
+        role(role),
+        port(port),
+        name("/pddm-ring-" + std::to_string(port)),
+        segment_size(0),
+        control(nullptr),
+        frames(nullptr),
+        mask(0),
+        doorbell_fd(-1) {
+    //The doorbell is in the abstract namespace (its name starts with a 0 byte), so it disappears with its socket
+    std::memset(&doorbell_address, 0, sizeof(doorbell_address));
+    doorbell_address.sun_family = AF_UNIX;
+    std::memcpy(doorbell_address.sun_path + 1, name.data() + 1, name.size() - 1);
+    doorbell_address_length = offsetof(sockaddr_un, sun_path) + name.size();
+    if(role == Role::SENDER) {
+        std::lock_guard<std::mutex> lock(local_queues_mutex);
+        auto queue_find = local_queues.find(port);
+        if(queue_find != local_queues.end()) {
+            local_queue = queue_find->second.lock();
+        }
+        //The receiver is in this process, so its frames don't need to go through shared memory
+        if(local_queue && local_queue->owner_pid == getpid()) {
+            return;
+        }
+        local_queue.reset();
+    }
+    int shm_fd;
+    if(role == Role::RECEIVER) {
+        //A ring left behind by a receiver that crashed may have frames that were never completed
+        shm_unlink(name.c_str());
+        shm_fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        segment_size = sizeof(RingControl) + SHARED_MEMORY_RING_SIZE;
+        if(shm_fd < 0 || ftruncate(shm_fd, segment_size) < 0) {
+            if(shm_fd >= 0) close(shm_fd);
+            throw connection_failure("Could not create shared memory ring " + name + ": " + strerror(errno));
+        }
+    } else {
+        shm_fd = shm_open(name.c_str(), O_RDWR, 0);
+        struct stat segment_stat;
+        if(shm_fd < 0 || fstat(shm_fd, &segment_stat) < 0 || segment_stat.st_size < (off_t) sizeof(RingControl)) {
+            if(shm_fd >= 0) close(shm_fd);
+            throw connection_failure("No shared memory ring for port " + std::to_string(port));
+        }
+        segment_size = segment_stat.st_size;
+    }
+    void* segment = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    close(shm_fd);
+    if(segment == MAP_FAILED) {
+        throw connection_failure("Could not map shared memory ring " + name);
+    }
+    control = static_cast<RingControl*>(segment);
+    frames = static_cast<char*>(segment) + sizeof(RingControl);
+    const std::uint32_t version = messaging::WIRE_FORMAT_VERSION | (RING_LAYOUT_VERSION << 16);
+    if(role == Role::RECEIVER) {
+        doorbell_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(doorbell_fd < 0 || bind(doorbell_fd, (const sockaddr*) &doorbell_address, doorbell_address_length) < 0) {
+            const std::string error = strerror(errno);
+            if(doorbell_fd >= 0) close(doorbell_fd);
+            munmap(segment, segment_size);
+            shm_unlink(name.c_str());
+            throw connection_failure("Could not create the doorbell for shared memory ring " + name + ": " + error);
+        }
+        control->receiver_pid = getpid();
+        control->version = version;
+        //Nothing has been read yet, so the first frame should ring the doorbell
+        control->receiver_waiting = 1;
+        //Senders treat the ring as ready once they see its capacity
+        __atomic_store_n(&control->capacity, SHARED_MEMORY_RING_SIZE, __ATOMIC_RELEASE);
+        mask = SHARED_MEMORY_RING_SIZE - 1;
+        local_queue = std::make_shared<LocalQueue>(getpid());
+        std::lock_guard<std::mutex> lock(local_queues_mutex);
+        local_queues[port] = local_queue;
+        return;
+    }
+    const std::uint64_t capacity = __atomic_load_n(&control->capacity, __ATOMIC_ACQUIRE);
+    if(capacity == 0 || sizeof(RingControl) + capacity != segment_size || receiver_gone()) {
+        munmap(segment, segment_size);
+        throw connection_failure("The shared memory ring for port " + std::to_string(port) + " is not in use");
+    }
+    if(control->version != version) {
+        munmap(segment, segment_size);
+        throw connection_failure("The shared memory ring for port " + std::to_string(port)
+                + " uses wire format version " + std::to_string(control->version & 0xffff)
+                + " and ring layout version " + std::to_string(control->version >> 16));
+    }
+    if(doorbell_sender_fd() < 0) {
+        munmap(segment, segment_size);
+        throw connection_failure("Could not create a socket to ring shared memory ring " + name);
+    }
+    mask = capacity - 1;
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+    if(role == Role::RECEIVER) {
+        {
+            std::lock_guard<std::mutex> lock(local_queues_mutex);
+            auto queue_find = local_queues.find(port);
+            if(queue_find != local_queues.end() && queue_find->second.lock() == local_queue) {
+                local_queues.erase(queue_find);
+            }
+        }
+        std::lock_guard<std::mutex> lock(local_queue->mutex);
+        local_queue->closed = true;
+        local_queue->frames.clear();
+    }
+    if(control == nullptr) {
+        return;
+    }
+    if(role == Role::RECEIVER) {
+        __atomic_store_n(&control->closed, 1, __ATOMIC_RELEASE);
+        shm_unlink(name.c_str());
+        close(doorbell_fd);
+    }
+    munmap(control, segment_size);
+}
+
+void SharedMemoryRing::ring_doorbell() {
+    const char ring = 1;
+    sendto(doorbell_sender_fd(), &ring, sizeof(ring), MSG_DONTWAIT, (const sockaddr*) &doorbell_address, doorbell_address_length);
+}
+
+bool SharedMemoryRing::write_local(const char* frame_body, const std::size_t frame_size, const messaging::WireFormat format) {
+    auto frame = std::make_shared<messaging::ReceiveBuffer>(frame_size);
+    std::memcpy(frame->data(), frame_body, frame_size);
+    bool receiver_waiting;
+    {
+        std::lock_guard<std::mutex> lock(local_queue->mutex);
+        //A receiver that has fallen this far behind would have filled its ring, so treat it the same way
+        if(local_queue->closed || local_queue->queued_bytes + frame_size > SHARED_MEMORY_RING_SIZE) {
+            return false;
+        }
+        local_queue->frames.emplace_back(std::move(frame), format);
+        local_queue->queued_bytes += frame_size;
+        receiver_waiting = local_queue->receiver_waiting;
+        local_queue->receiver_waiting = false;
+    }
+    if(receiver_waiting) {
+        ring_doorbell();
+    }
+    return true;
+}
+
+bool SharedMemoryRing::receiver_gone() const {
+    return __atomic_load_n(&control->closed, __ATOMIC_ACQUIRE) || process_gone(control->receiver_pid);
+}
+
+bool SharedMemoryRing::write(const std::vector<char>& frame, const messaging::WireFormat format) {
+    //The size prefix is only needed to find the end of a frame in a stream; the frame's header carries it instead
+    const char* frame_body = frame.data();
+    const std::uint64_t frame_size = read_size_prefix(frame_body, frame.data() + frame.size(), format);
+    if(control == nullptr) {
+        return write_local(frame_body, frame_size, format);
+    }
+    const std::uint64_t capacity = mask + 1;
+    const std::uint64_t frame_record_size = record_size(frame_size);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(CONNECT_TIMEOUT);
+    std::uint64_t position;
+    std::uint64_t space_to_end;
+    std::uint64_t reserved_size;
+    while(true) {
+        position = __atomic_load_n(&control->reserve_position, __ATOMIC_RELAXED);
+        space_to_end = capacity - (position & mask);
+        //A frame is never split across the end of the ring; if it doesn't fit, the space before the end is skipped
+        reserved_size = frame_record_size <= space_to_end ? frame_record_size : space_to_end + frame_record_size;
+        if(position + reserved_size - __atomic_load_n(&control->consume_position, __ATOMIC_ACQUIRE) <= capacity) {
+            if(__atomic_compare_exchange_n(&control->reserve_position, &position, position + reserved_size,
+                    false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                break;
+            }
+            continue;
+        }
+        //The ring is full, so the receiver has fallen behind, or isn't running any more
+        if(receiver_gone() || std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    //Mark the space as this process's right away, so the receiver can skip it if this process dies before completing it
+    __atomic_store_n(header_at(position), reserved_size | FRAME_RESERVED
+            | (static_cast<std::uint64_t>(getpid()) << FRAME_OWNER_SHIFT), __ATOMIC_RELEASE);
+    const std::uint64_t frame_position = reserved_size != frame_record_size ? position + space_to_end : position;
+    std::memcpy(frames + (frame_position & mask) + sizeof(std::uint64_t), frame_body, frame_size);
+    __atomic_store_n(header_at(frame_position), frame_size | (static_cast<std::uint64_t>(format) << FRAME_FORMAT_SHIFT) | FRAME_COMPLETE,
+            __ATOMIC_RELEASE);
+    //The padding replaces the reservation's header, so it must be completed last
+    if(frame_position != position) {
+        __atomic_store_n(header_at(position), (space_to_end - sizeof(std::uint64_t)) | FRAME_PADDING | FRAME_COMPLETE,
+                __ATOMIC_RELEASE);
+    }
+    //Only make the system call if the receiver is waiting, and only once for all the senders that complete frames meanwhile
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&control->receiver_waiting, __ATOMIC_RELAXED)
+            && __atomic_exchange_n(&control->receiver_waiting, 0, __ATOMIC_SEQ_CST)) {
+        ring_doorbell();
+    }
+    return true;
+}
+
+bool SharedMemoryRing::read_complete_frames(std::vector<ReceivedFrame>& complete_frames) {
+    std::uint64_t position = control->consume_position;
+    const std::uint64_t start_position = position;
+    while(true) {
+        const std::uint64_t header = __atomic_load_n(header_at(position), __ATOMIC_ACQUIRE);
+        //Frames are read in the order they were reserved, so an incomplete frame holds up the ones after it
+        if(!(header & FRAME_COMPLETE)) {
+            //...unless its sender has died, in which case it will never be completed
+            if(!(header & FRAME_RESERVED) || !process_gone(header >> FRAME_OWNER_SHIFT)) {
+                break;
+            }
+            //The reservation may include padding at the end of the ring, and wrap around to its start
+            const std::uint64_t reserved_size = header & 0xffffffff;
+            const std::uint64_t size_to_end = std::min(reserved_size, mask + 1 - (position & mask));
+            std::memset(frames + (position & mask), 0, size_to_end);
+            std::memset(frames, 0, reserved_size - size_to_end);
+            position += reserved_size;
+            __atomic_store_n(&control->consume_position, position, __ATOMIC_RELEASE);
+            continue;
+        }
+        const std::uint64_t frame_size = header & 0xffffffff;
+        const std::uint64_t frame_record_size = record_size(frame_size);
+        if(!(header & FRAME_PADDING) && frame_size > 0) {
+            auto frame = std::make_shared<messaging::ReceiveBuffer>(frame_size);
+            std::memcpy(frame->data(), frames + (position & mask) + sizeof(std::uint64_t), frame_size);
+            complete_frames.emplace_back(std::move(frame),
+                    static_cast<messaging::WireFormat>((header >> FRAME_FORMAT_SHIFT) & 0xff));
+        }
+        //Clear the space before releasing it, so a stale header is never mistaken for a complete frame
+        std::memset(frames + (position & mask), 0, frame_record_size);
+        position += frame_record_size;
+        __atomic_store_n(&control->consume_position, position, __ATOMIC_RELEASE);
+    }
+    return position != start_position;
+}
+
+void SharedMemoryRing::read_all(std::vector<ReceivedFrame>& complete_frames) {
+    //Empty the doorbell first, so a sender that rings it while the ring is being read wakes the reactor again
+    char rings[64];
+    while(recv(doorbell_fd, rings, sizeof(rings), 0) > 0) {}
+    bool read_more;
+    do {
+        read_complete_frames(complete_frames);
+        //Ask for the doorbell before looking for frames one last time, so a frame completed in between rings it
+        __atomic_store_n(&control->receiver_waiting, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        read_more = __atomic_load_n(header_at(control->consume_position), __ATOMIC_ACQUIRE) & FRAME_COMPLETE;
+    } while(read_more);
+    std::lock_guard<std::mutex> lock(local_queue->mutex);
+    std::move(local_queue->frames.begin(), local_queue->frames.end(), std::back_inserter(complete_frames));
+    local_queue->frames.clear();
+    local_queue->queued_bytes = 0;
+    local_queue->receiver_waiting = true;
+}
+
+} /* namespace networking */
+} /* namespace pddm */
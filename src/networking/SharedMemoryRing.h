@@ -0,0 +1,192 @@
+/**
+ * @file SharedMemoryRing.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+#include "../messaging/ReceiveBuffer.h"
+#include "../messaging/WireFormat.h"
+
+namespace pddm {
+namespace networking {
+
+/**
+ * A ring of frames in a POSIX shared memory segment, which lets TCP clients on
+ * the same host send each other frames without going through the kernel's TCP
+ * stack. Each client that receives over shared memory creates one ring, named
+ * after the port it listens on, and every process on the host that sends to
+ * it writes into that ring; so there are many senders but only one receiver.
+ * The frames are the same ones sent over TCP, without their size prefix,
+ * tagged with the format they were built in. The receiver records its
+ * messaging::WIRE_FORMAT_VERSION and RING_LAYOUT_VERSION in the ring, and
+ * senders of another version refuse to open it.
+ *
+ * Senders reserve space by advancing a shared position with compare-and-swap,
+ * mark the space with their process ID, copy the frame in, and then mark it
+ * complete, so they never wait for each other except to reserve. The receiver
+ * reads complete frames in the order they were reserved. If the process that
+ * reserved the next frame no longer exists, the receiver skips that frame
+ * instead of waiting for it forever; only a sender killed in the few
+ * instructions between reserving space and marking it can still hold up the
+ * ring.
+ *
+ * To wait for frames without polling, the receiver's reactor watches a
+ * doorbell: a Unix datagram socket in the abstract namespace, named after
+ * the ring, which works like an eventfd that other processes can signal.
+ * A sender rings it after completing a frame only if the receiver has said
+ * it is waiting, so a busy receiver costs senders no system calls.
+ *
+ * A sender in the same process as the receiver, such as another of the
+ * meters MultiMeterHostMain runs, doesn't use the ring at all: it hands its
+ * frames straight to the receiver's in-process queue. So a process whose
+ * meters only talk to each other never touches the pages of their rings.
+ */
+class SharedMemoryRing {
+    public:
+        /** Which end of the ring this object is */
+        enum class Role { RECEIVER, SENDER };
+        /** A frame read from the ring, and the format it was sent in */
+        using ReceivedFrame = std::pair<messaging::SharedBuffer, messaging::WireFormat>;
+    private:
+        /** The state at the start of the segment, which every process maps */
+        struct RingControl {
+            /** The size of the frame area, which is 0 until the receiver has set up the ring */
+            std::uint64_t capacity;
+            std::int32_t receiver_pid;
+            /** Set when the receiver shuts down, so senders stop writing to it */
+            std::uint32_t closed;
+            /** The receiver's messaging::WIRE_FORMAT_VERSION in the low 16 bits, and its
+             * RING_LAYOUT_VERSION above them. This is 0 in rings from before it was recorded. */
+            std::uint32_t version;
+            /** The position after the last reserved byte, advanced by senders */
+            alignas(64) std::uint64_t reserve_position;
+            /** The position of the first unread byte, advanced by the receiver */
+            alignas(64) std::uint64_t consume_position;
+            /** Nonzero while the receiver has read every complete frame and
+             * is waiting for the doorbell; the sender that clears it rings it */
+            alignas(64) std::uint32_t receiver_waiting;
+        };
+        /** The frames sent to a receiver by senders in its own process */
+        struct LocalQueue {
+            /** The receiver's process, since a child forked from it inherits a copy of its queue */
+            const pid_t owner_pid;
+            std::mutex mutex;
+            std::vector<ReceivedFrame> frames;
+            /** The number of bytes in frames, which is limited to the ring's size */
+            std::size_t queued_bytes = 0;
+            /** True while the receiver has taken every frame and is waiting for the doorbell */
+            bool receiver_waiting = true;
+            /** Set when the receiver shuts down */
+            bool closed = false;
+            explicit LocalQueue(const pid_t owner_pid) : owner_pid(owner_pid) {}
+        };
+        /** Incremented whenever RingControl or the frame headers change */
+        static constexpr std::uint32_t RING_LAYOUT_VERSION = 1;
+        /** Each frame is preceded by an 8-byte header with its size and these flags */
+        static constexpr std::uint64_t FRAME_COMPLETE = 1ull << 32;
+        static constexpr std::uint64_t FRAME_PADDING = 1ull << 33;
+        /** Marks space that a sender has reserved but not completed. The
+         * header then holds the size of the whole reservation, including any
+         * padding skipped at the end of the ring, and the sender's process ID. */
+        static constexpr std::uint64_t FRAME_RESERVED = 1ull << 34;
+        static constexpr int FRAME_FORMAT_SHIFT = 40;
+        /** A reservation's header has its owner where a complete frame's has its format */
+        static constexpr int FRAME_OWNER_SHIFT = 40;
+        /** The local queues of the receivers in this process, by port */
+        static std::mutex local_queues_mutex;
+        static std::map<int, std::weak_ptr<LocalQueue>> local_queues;
+        const Role role;
+        const int port;
+        const std::string name;
+        std::size_t segment_size;
+        RingControl* control;
+        char* frames;
+        std::uint64_t mask;
+        /** The receiver's local queue, which a sender in the same process
+         * writes to instead of the ring; null for other senders */
+        std::shared_ptr<LocalQueue> local_queue;
+        /** The doorbell socket, bound to doorbell_address; receiver only.
+         * Senders ring it with one socket shared by the whole process. */
+        int doorbell_fd;
+        sockaddr_un doorbell_address;
+        socklen_t doorbell_address_length;
+        void ring_doorbell();
+        /** Adds a frame to local_queue; a sender in the receiver's process uses this instead of the ring */
+        bool write_local(const char* frame_body, const std::size_t frame_size, const messaging::WireFormat format);
+        /** @return True if the receiver has shut down or its process no longer exists */
+        bool receiver_gone() const;
+        /**
+         * Reads the frames at the consume position up to the first one that
+         * hasn't been completed, skipping frames whose sender has died.
+         * @return True if any frames were read or skipped
+         */
+        bool read_complete_frames(std::vector<ReceivedFrame>& complete_frames);
+        std::uint64_t* header_at(const std::uint64_t position) {
+            return reinterpret_cast<std::uint64_t*>(frames + (position & mask));
+        }
+    public:
+        /**
+         * Creates the ring for a receiver, replacing any ring left behind by
+         * an earlier receiver on the same port, or opens an existing ring
+         * for a sender.
+         * @param port The port the receiver listens on, which names the ring
+         * @param role Whether this process will read from the ring or write to it
+         * @throws connection_failure if the ring can't be created, or for a
+         * sender, if there is no ring for that port or its receiver is gone
+         */
+        SharedMemoryRing(const int port, const Role role);
+        ~SharedMemoryRing();
+        SharedMemoryRing(const SharedMemoryRing&) = delete;
+        SharedMemoryRing& operator=(const SharedMemoryRing&) = delete;
+        /** @return The largest frame that can be written, which is half the
+         * ring, or unlimited for a sender in the receiver's process */
+        std::size_t max_frame_size() const {
+            return local_queue && role == Role::SENDER ? std::numeric_limits<std::size_t>::max()
+                    : control->capacity / 2 - sizeof(std::uint64_t);
+        }
+        /**
+         * Writes a frame into the ring. If the ring is full, this waits for
+         * the receiver to make room, for at most CONNECT_TIMEOUT. A sender in
+         * the receiver's process never waits, but fails if the receiver has
+         * fallen a ring's worth of frames behind.
+         * @param frame A frame built by frame_messages() or
+         * frame_utility_message(), starting with its size, which must be no
+         * larger than max_frame_size()
+         * @param format The format the frame was built in
+         * @return False if the receiver has gone away or didn't make room in time
+         */
+        bool write(const std::vector<char>& frame, const messaging::WireFormat format);
+        /**
+         * Reads every complete frame in the ring, in order, and then tells
+         * senders to ring the doorbell for the next one; receiver only. This
+         * also clears the doorbell, so it should be called whenever the
+         * doorbell becomes readable.
+         * @param complete_frames The frames are added to this vector
+         */
+        void read_all(std::vector<ReceivedFrame>& complete_frames);
+        /**
+         * @return The doorbell, which becomes readable when frames have been
+         * written to the ring; the receiver's reactor should watch it for
+         * EPOLLIN and call read_all() when it does. Receiver only.
+         */
+        int get_event_fd() const { return doorbell_fd; }
+};
+
+} /* namespace networking */
+} /* namespace pddm */
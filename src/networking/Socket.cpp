@@ -11,33 +11,47 @@
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 #include <netdb.h>
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <thread>
 #include <unistd.h>
 
+#include "../Configuration.h"
+
 namespace pddm {
 namespace networking {
 
 Socket::Socket(std::string servername, int port) {
-    sock = socket(AF_INET, SOCK_STREAM, 0);
-    if(sock < 0) throw connection_failure("Failed to create socket!");
-
-    hostent* server;
-    server = gethostbyname(servername.c_str());
-    if(server == nullptr) throw connection_failure(std::string("Error: Could not find host ") + servername);
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* server;
+    if(getaddrinfo(servername.c_str(), nullptr, &hints, &server) != 0) {
+        throw connection_failure(std::string("Error: Could not find host ") + servername);
+    }
+    sockaddr_in serv_addr;
+    memcpy(&serv_addr, server->ai_addr, sizeof(serv_addr));
+    freeaddrinfo(server);
+    serv_addr.sin_port = htons(port);
 
     char server_ip_cstr[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, server->h_addr, server_ip_cstr, sizeof(server_ip_cstr));
+    inet_ntop(AF_INET, &serv_addr.sin_addr, server_ip_cstr, sizeof(server_ip_cstr));
     remote_ip = std::string(server_ip_cstr);
 
-    sockaddr_in serv_addr;
-    memset(&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(port);
-    memcpy((char*)&serv_addr.sin_addr.s_addr, (char*)server->h_addr, server->h_length);
-
-    while(connect(sock, (sockaddr*) &serv_addr, sizeof(serv_addr)) < 0)
-        /* do nothing*/;
-    
+    //A socket whose connect() failed can't be reused, so each attempt needs a new one
+    int retry_delay_ms = MIN_RECONNECT_BACKOFF;
+    while(true) {
+        sock = socket(AF_INET, SOCK_STREAM, 0);
+        if(sock < 0) throw connection_failure("Failed to create socket!");
+        if(connect(sock, (sockaddr*) &serv_addr, sizeof(serv_addr)) == 0) {
+            break;
+        }
+        close(sock);
+        std::this_thread::sleep_for(std::chrono::milliseconds(retry_delay_ms));
+        retry_delay_ms = std::min(2 * retry_delay_ms, MAX_RECONNECT_BACKOFF);
+    }
 }
 
 Socket::Socket(Socket &&s) : sock(s.sock), remote_ip(s.remote_ip) {
@@ -90,7 +104,8 @@ bool Socket::write(const char *buffer, size_t size) {
 
     size_t total_bytes = 0;
     while(total_bytes < size) {
-        ssize_t bytes_written = ::write(sock, buffer + total_bytes, size - total_bytes);
+        //Report a closed connection as a failed write, rather than raising SIGPIPE
+        ssize_t bytes_written = ::send(sock, buffer + total_bytes, size - total_bytes, MSG_NOSIGNAL);
         if(bytes_written >= 0) {
             total_bytes += bytes_written;
         } else if(bytes_written == -1 && errno != EINTR) {
@@ -36,7 +36,13 @@ class Socket {
         std::string remote_ip;
 
         Socket() : sock(-1), remote_ip() {}
-        /** Constructs a socket connected to the given hostname and port. */
+        /**
+         * Constructs a socket connected to the given hostname and port. If
+         * the server is not accepting connections yet, this waits for it,
+         * retrying with a delay that grows from MIN_RECONNECT_BACKOFF to
+         * MAX_RECONNECT_BACKOFF; sockets that should give up on an unreachable
+         * server are opened with a ConnectionManager instead.
+         */
         Socket(std::string servername, int port);
         Socket(Socket&& s);
 
@@ -46,6 +52,8 @@ class Socket {
         ~Socket();
 
         bool is_empty();
+        /** @return The socket's file descriptor, or -1 if it is empty */
+        int get_fd() const { return sock; }
 
         /** Reads size bytes from the socket into buffer */
         bool read(char* buffer, size_t size);
@@ -54,6 +62,7 @@ class Socket {
         bool write(char const* buffer, size_t size);
 
         friend class ConnectionListener;
+        friend class ConnectionManager;
 
 };
 
@@ -15,6 +15,7 @@
 #include <mutils-serialization/SerializationSupport.hpp>
 
 #include "TcpNetworkClient.h"
+#include "MessageFraming.h"
 #include "Socket.h"
 #include "../MeterClient.h"
 #include "../messaging/QueryRequest.h"
@@ -27,137 +28,211 @@ TcpNetworkClient::TcpNetworkClient(MeterClient& owning_meter_client, const TcpAd
                 BaseTcpClient(this, my_address, meter_ips_by_id),
                 logger(spdlog::get("global_logger")),
                 meter_client(owning_meter_client),
+                holding_overlay_sends(false),
                 num_messages_sent(0) {
-    sockets_by_id.emplace(UTILITY_NODE_ID, Socket(utility_address.ip_addr, utility_address.port));
+    //Wait for the utility to be reachable, and keep its address in case the connection needs to be reopened
+    id_to_ip_map.emplace(UTILITY_NODE_ID, utility_address);
+    if(get_shared_memory_ring(UTILITY_NODE_ID) == nullptr) {
+        add_socket(UTILITY_NODE_ID, Socket(utility_address.ip_addr, utility_address.port));
+    }
 }
 
 bool TcpNetworkClient::send(const std::list<std::shared_ptr<messaging::OverlayTransportMessage> >& messages, const int recipient_id) {
-    //Construct a new socket for this node if there is not one already in the map
-    auto socket_map_find = sockets_by_id.lower_bound(recipient_id);
-    if(socket_map_find == sockets_by_id.end() || socket_map_find->first != recipient_id) {
-        sockets_by_id.emplace_hint(socket_map_find, recipient_id,
-                Socket(id_to_ip_map.at(recipient_id).ip_addr, id_to_ip_map.at(recipient_id).port));
+    if(holding_overlay_sends) {
+        held_overlay_sends.emplace_back(recipient_id, messages);
+        return true;
     }
-    std::size_t send_size = mutils::bytes_size(messages.size());
-    for(const auto& message : messages) {
-        send_size += mutils::bytes_size(*message);
+    return send_overlay_batch(messages, recipient_id);
+}
+
+void TcpNetworkClient::add_event_source(const int fd, std::function<void(void)> on_readable) {
+    BaseTcpClient::add_event_source(fd, [this, on_readable]() {
+        hold_overlay_sends();
+        on_readable();
+        meter_client.flush_held_sends();
+    });
+}
+
+void TcpNetworkClient::hold_overlay_sends() {
+    holding_overlay_sends = true;
+}
+
+TcpNetworkClient::HostSendsMap TcpNetworkClient::take_held_sends_by_host() {
+    holding_overlay_sends = false;
+    HostSendsMap sends_by_host;
+    for(auto& held_send : held_overlay_sends) {
+        auto& host_sends = sends_by_host[id_to_ip_map.at(held_send.first)];
+        host_sends.first.push_back(held_send.first);
+        host_sends.second.splice(host_sends.second.end(), held_send.second);
     }
-    char buffer[send_size + sizeof(send_size)];
-    std::memcpy(buffer, (char*)&send_size, sizeof(send_size));
-    std::size_t bytes_written = sizeof(send_size);
-    bytes_written += mutils::to_bytes(messages.size(), buffer + bytes_written);
-    for(const auto& message : messages) {
-        bytes_written += mutils::to_bytes(*message, buffer + bytes_written);
-        num_messages_sent++;
+    held_overlay_sends.clear();
+    return sends_by_host;
+}
+
+std::set<int> TcpNetworkClient::flush_overlay_sends() {
+    HostSendsMap sends_by_host = take_held_sends_by_host();
+    std::set<int> failed_ids;
+    begin_send_batch();
+    for(const auto& host_sends : sends_by_host) {
+        //Any of the recipients' sockets will reach the host; the receiver dispatches each message by its sender
+        bool success = send_overlay_batch(host_sends.second.second, host_sends.second.first.front());
+        if(!success) {
+            failed_ids.insert(host_sends.second.first.begin(), host_sends.second.first.end());
+        }
     }
-    bool success = sockets_by_id.at(recipient_id).write(buffer, send_size + sizeof(send_size));
+    std::set<int> failed_sockets = end_send_batch();
+    for(const auto& host_sends : sends_by_host) {
+        if(failed_sockets.find(host_sends.second.first.front()) != failed_sockets.end()) {
+            failed_ids.insert(host_sends.second.first.begin(), host_sends.second.first.end());
+        }
+    }
+    add_failed_connections(failed_ids);
+    return failed_ids;
+}
+
+void TcpNetworkClient::add_failed_connections(std::set<int>& failed_ids) {
+    for(const int failed_id : take_failed_connections()) {
+        //The protocol only tracks failures of meters
+        if(failed_id != UTILITY_NODE_ID) {
+            failed_ids.insert(failed_id);
+        }
+    }
+}
+
+bool TcpNetworkClient::send_overlay_batch(const std::list<std::shared_ptr<messaging::OverlayTransportMessage> >& messages, const int recipient_id) {
+    auto& frame = send_buffers[recipient_id];
+    frame_messages(messages.begin(), messages.end(), WIRE_FORMAT, frame, message_sizes);
+    num_messages_sent += messages.size();
+    bool success = send_frame(recipient_id, frame);
     return success;
 }
 
 bool TcpNetworkClient::send(const std::shared_ptr<messaging::AggregationMessage>& message, const int recipient_id) {
-    //Construct a new socket for this node if there is not one already in the map
-    auto socket_map_find = sockets_by_id.lower_bound(recipient_id);
-    if(socket_map_find == sockets_by_id.end() || socket_map_find->first != recipient_id) {
-        sockets_by_id.emplace_hint(socket_map_find, recipient_id,
-                Socket(id_to_ip_map.at(recipient_id).ip_addr, id_to_ip_map.at(recipient_id).port));
-    }
-    const std::size_t num_messages = 1;
-    std::size_t send_size = mutils::bytes_size(*message);
+    auto& frame = send_buffers[recipient_id];
     //The utility doesn't need a "number of messages" header because it only accepts one message
-    if(recipient_id != UTILITY_NODE_ID) {
-        send_size += mutils::bytes_size(num_messages);
+    if(recipient_id == UTILITY_NODE_ID) {
+        frame_utility_message(*message, WIRE_FORMAT, frame);
+    } else {
+        frame_messages(&message, &message + 1, WIRE_FORMAT, frame, message_sizes);
     }
-    char buffer[send_size + sizeof(send_size)];
-    std::memcpy(buffer, (char*)&send_size, sizeof(send_size));
-    std::size_t bytes_written = sizeof(send_size);
-    if(recipient_id != UTILITY_NODE_ID) {
-        bytes_written += mutils::to_bytes(num_messages, buffer + bytes_written);
-    }
-    bytes_written += mutils::to_bytes(*message, buffer + bytes_written);
-    bool success = sockets_by_id.at(recipient_id).write(buffer, send_size + sizeof(send_size));
+    bool success = send_frame(recipient_id, frame);
     num_messages_sent++;
     return success;
 }
 
 bool TcpNetworkClient::send(const std::shared_ptr<messaging::PingMessage>& message, const int recipient_id) {
-    auto socket_map_find = sockets_by_id.lower_bound(recipient_id);
-    if(socket_map_find == sockets_by_id.end() || socket_map_find->first != recipient_id) {
-        sockets_by_id.emplace_hint(socket_map_find, recipient_id,
-                Socket(id_to_ip_map.at(recipient_id).ip_addr, id_to_ip_map.at(recipient_id).port));
-    }    const std::size_t num_messages = 1;
-    std::size_t send_size = mutils::bytes_size(num_messages) + mutils::bytes_size(*message);
-    char buffer[send_size + sizeof(send_size)];
-    std::memcpy(buffer, (char*)&send_size, sizeof(send_size));
-    std::size_t bytes_written = sizeof(send_size);
-    bytes_written += mutils::to_bytes(num_messages, buffer + bytes_written);
-    bytes_written += mutils::to_bytes(*message, buffer + bytes_written);
-    bool success = sockets_by_id.at(recipient_id).write(buffer, send_size + sizeof(send_size));
+    auto& frame = send_buffers[recipient_id];
+    frame_messages(&message, &message + 1, WIRE_FORMAT, frame, message_sizes);
+    bool success = send_frame(recipient_id, frame);
+    num_messages_sent++;
+    return success;
+}
+
+bool TcpNetworkClient::send(const std::shared_ptr<messaging::FloodDigestMessage>& message, const int recipient_id) {
+    auto& frame = send_buffers[recipient_id];
+    frame_messages(&message, &message + 1, WIRE_FORMAT, frame, message_sizes);
+    bool success = send_frame(recipient_id, frame);
     num_messages_sent++;
     return success;
 }
 
 bool TcpNetworkClient::send(const std::shared_ptr<messaging::SignatureRequest>& message) {
     //No "number of messages" header for the utility
-    std::size_t send_size = mutils::bytes_size(*message);
-    char buffer[send_size + sizeof(send_size)];
-    std::memcpy(buffer, (char*)&send_size, sizeof(send_size));
-    mutils::to_bytes(*message, buffer + sizeof(send_size));
-    bool success = sockets_by_id.at(UTILITY_NODE_ID).write(buffer, send_size + sizeof(send_size));
+    auto& frame = send_buffers[UTILITY_NODE_ID];
+    frame_utility_message(*message, WIRE_FORMAT, frame);
+    bool success = send_frame(UTILITY_NODE_ID, frame);
     num_messages_sent++;
     return success;
 }
 
-void TcpNetworkClient::receive_message(const std::vector<char>& message_bytes) {
+void TcpNetworkClient::decode_frame(const messaging::SharedBuffer& frame, const messaging::WireFormat format,
+        std::vector<TypeMessagePair>& messages) {
     using namespace messaging;
-    //First, read the number of messages in the list
-    std::size_t num_messages = ((std::size_t*) message_bytes.data())[0];
-    const char* buffer = message_bytes.data() + sizeof(num_messages);
-    //Deserialize that number of messages, moving the buffer pointer each time one is deserialized
-    for(auto i = 0u; i < num_messages; ++i) {
-        /* This is the exact same logic used in Message::from_bytes. We could just do
-         * auto message = mutils::from_bytes<messaging::Message>(nullptr, message_bytes.data());
-         * but then we would have to use dynamic_pointer_cast to figure out which subclass
-         * was deserialized and call the right meter_client.handle_message() overload.
-         */
-        MessageType message_type = ((MessageType*)(buffer))[0];
-        //Deserialize the correct message subclass based on the type, and call the correct handler
-        switch(message_type) {
-        case OverlayTransportMessage::type: {
-            std::shared_ptr<OverlayTransportMessage> message(mutils::from_bytes<OverlayTransportMessage>(nullptr, buffer));
-            buffer += mutils::bytes_size(*message);
-            meter_client.handle_message(message);
-            break;
+    const char* buffer = frame->data();
+    const char* frame_end = buffer + frame->size();
+    try {
+        //First, read the number of messages in the list
+        std::size_t num_messages = read_size_prefix(buffer, frame_end, format);
+        //Deserialize that number of messages, using the size before each one to move the buffer pointer past it
+        for(auto i = 0u; i < num_messages; ++i) {
+            std::size_t message_size = read_message_size(buffer, frame_end, format);
+            /* This is the exact same logic used in Message::from_bytes. We could just do
+             * auto message = mutils::from_bytes<messaging::Message>(nullptr, message_bytes.data());
+             * but then we would have to use dynamic_pointer_cast to figure out which subclass
+             * was deserialized and call the right meter_client.handle_message() overload.
+             */
+            MessageType message_type = peek_message_type(buffer, format);
+            //Deserialize the correct message subclass based on the type, and tag it with the type for handle_messages
+            switch(message_type) {
+            case OverlayTransportMessage::type:
+                //Keep the parts of the message this meter will only relay as views of the receive buffer, in its arena
+                messages.emplace_back(message_type, view_transport_message(buffer, message_size, format, frame));
+                break;
+            case PingMessage::type:
+                messages.emplace_back(message_type, std::shared_ptr<PingMessage>(
+                        decode_message<PingMessage>(buffer, message_size, format)));
+                break;
+            case FloodDigestMessage::type:
+                messages.emplace_back(message_type, std::shared_ptr<FloodDigestMessage>(
+                        decode_message<FloodDigestMessage>(buffer, message_size, format)));
+                break;
+            case AggregationMessage::type:
+                messages.emplace_back(message_type, std::shared_ptr<AggregationMessage>(
+                        decode_message<AggregationMessage>(buffer, message_size, format)));
+                break;
+            case QueryRequest::type:
+                messages.emplace_back(message_type, std::shared_ptr<QueryRequest>(
+                        decode_message<QueryRequest>(buffer, message_size, format)));
+                break;
+            case SignatureResponse::type:
+                messages.emplace_back(message_type, std::shared_ptr<SignatureResponse>(
+                        decode_message<SignatureResponse>(buffer, message_size, format)));
+                break;
+            default:
+                logger->warn("Meter {} dropped a message it didn't know how to handle.", meter_client.meter_id);
+                break;
+            }
+            buffer += message_size;
         }
-        case PingMessage::type: {
-            std::shared_ptr<PingMessage> message(mutils::from_bytes<PingMessage>(nullptr, buffer));
-            buffer += mutils::bytes_size(*message);
-            meter_client.handle_message(message);
+    } catch(const DecodeError& e) {
+        //The sizes in the rest of the frame can't be trusted either, so the messages decoded so far are all that's kept
+        logger->warn("Meter {} dropped the rest of a frame it couldn't decode: {}", meter_client.meter_id, e.what());
+    }
+}
+
+void TcpNetworkClient::handle_messages(const std::vector<TypeMessagePair>& messages) {
+    using namespace messaging;
+    //Coalesce the overlay messages sent in response to all of these messages
+    hold_overlay_sends();
+    for(const auto& type_message_pair : messages) {
+        //Call the correct handler based on the type
+        switch(type_message_pair.first) {
+        case OverlayTransportMessage::type:
+            meter_client.handle_message(std::static_pointer_cast<OverlayTransportMessage>(type_message_pair.second));
             break;
-        }
-        case AggregationMessage::type: {
-            std::shared_ptr<AggregationMessage> message(mutils::from_bytes<AggregationMessage>(nullptr, buffer));
-            buffer += mutils::bytes_size(*message);
-            meter_client.handle_message(message);
+        case PingMessage::type:
+            meter_client.handle_message(std::static_pointer_cast<PingMessage>(type_message_pair.second));
+            break;
+        case FloodDigestMessage::type:
+            meter_client.handle_message(std::static_pointer_cast<FloodDigestMessage>(type_message_pair.second));
+            break;
+        case AggregationMessage::type:
+            meter_client.handle_message(std::static_pointer_cast<AggregationMessage>(type_message_pair.second));
             break;
-        }
         case QueryRequest::type: {
-            std::shared_ptr<QueryRequest> message(mutils::from_bytes<QueryRequest>(nullptr, buffer));
-            buffer += mutils::bytes_size(*message);
+            auto message = std::static_pointer_cast<QueryRequest>(type_message_pair.second);
             std::cout << "Received a QueryRequest: " << *message << std::endl;
             meter_client.handle_message(message);
             break;
         }
-        case SignatureResponse::type: {
-            std::shared_ptr<SignatureResponse> message(mutils::from_bytes<SignatureResponse>(nullptr, buffer));
-            buffer += mutils::bytes_size(*message);
-            meter_client.handle_message(message);
+        case SignatureResponse::type:
+            meter_client.handle_message(std::static_pointer_cast<SignatureResponse>(type_message_pair.second));
             break;
-        }
         default:
-            logger->warn("Meter {} dropped a message it didn't know how to handle.", meter_client.meter_id);
             break;
         }
     }
+    meter_client.flush_held_sends();
 }
 
 std::function<TcpNetworkClient(MeterClient&)> network_client_builder(const TcpAddress& my_address,
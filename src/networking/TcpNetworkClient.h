@@ -7,8 +7,13 @@
 
 #pragma once
 
+#include <functional>
+#include <list>
 #include <map>
 #include <memory>
+#include <set>
+#include <utility>
+#include <vector>
 #include <spdlog/spdlog.h>
 
 #include "../NetworkClient.h"
@@ -27,10 +32,29 @@ class TcpNetworkClient : public BaseTcpClient<TcpNetworkClient>, public NetworkC
         std::shared_ptr<spdlog::logger> logger;
         /** The MeterClient that owns this TCPNetworkClient */
         MeterClient& meter_client;
+        /** True if overlay sends are being held to be coalesced */
+        bool holding_overlay_sends;
+        /** Overlay messages held since hold_overlay_sends(), paired with their recipient IDs */
+        std::list<std::pair<int, std::list<std::shared_ptr<messaging::OverlayTransportMessage>>>> held_overlay_sends;
+    protected:
+        /** The overlay messages held for each host, with the IDs of their recipients at that host */
+        using HostSendsMap = std::map<TcpAddress, std::pair<std::list<int>, std::list<std::shared_ptr<messaging::OverlayTransportMessage>>>>;
         /** Message count tracker for experiment graphs. */
         int num_messages_sent;
-    protected:
-        void receive_message(const std::vector<char>& message_bytes);
+        /**
+         * Stops holding overlay sends, and takes the messages held since
+         * hold_overlay_sends(), combined by the address of their recipient and
+         * kept in the order they were sent.
+         */
+        HostSendsMap take_held_sends_by_host();
+        /** Adds the meters whose connections failed to open since the last
+         * flush, and so lost the frames queued for them, to a set of failed IDs */
+        void add_failed_connections(std::set<int>& failed_ids);
+        /** Sends a list of overlay messages to a meter as one frame, without holding it */
+        virtual bool send_overlay_batch(const std::list<std::shared_ptr<messaging::OverlayTransportMessage>>& messages, const int recipient_id);
+        void decode_frame(const messaging::SharedBuffer& frame, const messaging::WireFormat format,
+                std::vector<TypeMessagePair>& messages);
+        void handle_messages(const std::vector<TypeMessagePair>& messages);
     public:
         /**
          * Constructs a NetworkClient for sending over TCP networks using Linux
@@ -53,12 +77,23 @@ class TcpNetworkClient : public BaseTcpClient<TcpNetworkClient>, public NetworkC
         bool send(const std::list<std::shared_ptr<messaging::OverlayTransportMessage>>& messages, const int recipient_id);
         bool send(const std::shared_ptr<messaging::AggregationMessage>& message, const int recipient_id);
         bool send(const std::shared_ptr<messaging::PingMessage>& message, const int recipient_id);
+        bool send(const std::shared_ptr<messaging::FloodDigestMessage>& message, const int recipient_id);
         bool send(const std::shared_ptr<messaging::SignatureRequest>& message);
+        void hold_overlay_sends();
+        std::set<int> flush_overlay_sends();
         /* Stupid indirection just to get the compiler to believe that BaseTcpClient provides
          * an implementation of monitor_incoming_messages to satisfy NetworkClient's interface */
         inline void monitor_incoming_messages() {
             BaseTcpClient::monitor_incoming_messages();
         }
+        //Same for prewarm_connections
+        inline void prewarm_connections(const std::set<int>& meter_ids) {
+            BaseTcpClient::prewarm_connections(meter_ids);
+        }
+        /** Watches an event source like BaseTcpClient::add_event_source, but
+         * coalesces the overlay messages sent while handling its events (such
+         * as round timeouts) like those sent while handling messages. */
+        void add_event_source(const int fd, std::function<void(void)> on_readable);
 
         int get_total_messages_sent() const { return num_messages_sent; }
 
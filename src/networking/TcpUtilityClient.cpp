@@ -9,6 +9,7 @@
 
 #include <mutils-serialization/SerializationSupport.hpp>
 
+#include "MessageFraming.h"
 #include "Socket.h"
 #include "../messaging/AggregationMessage.h"
 #include "../messaging/SignatureRequest.h"
@@ -27,64 +28,80 @@ TcpUtilityClient::TcpUtilityClient(UtilityClient& owning_utility_client, const T
 
 
 void TcpUtilityClient::send(const std::shared_ptr<messaging::QueryRequest>& message, const int recipient_id) {
-    //Construct a new socket for this node if there is not one already in the map
-    auto socket_map_find = sockets_by_id.lower_bound(recipient_id);
-    if(socket_map_find == sockets_by_id.end() || socket_map_find->first != recipient_id) {
-        sockets_by_id.emplace_hint(socket_map_find, recipient_id,
-                Socket(id_to_ip_map.at(recipient_id).ip_addr, id_to_ip_map.at(recipient_id).port));
-    }
     //Meter clients expect a "number of messages" first
-    const std::size_t num_messages = 1;
-    std::size_t send_size = mutils::bytes_size(num_messages) + mutils::bytes_size(*message);
-    char buffer[send_size + sizeof(send_size)];
-    std::memcpy(buffer, (char*)&send_size, sizeof(send_size));
-    std::size_t bytes_written = sizeof(send_size);
-    bytes_written += mutils::to_bytes(num_messages, buffer + bytes_written);
-    bytes_written += mutils::to_bytes(*message, buffer + bytes_written);
-    sockets_by_id.at(recipient_id).write(buffer, send_size + sizeof(send_size));
+    auto& frame = send_buffers[recipient_id];
+    frame_messages(&message, &message + 1, WIRE_FORMAT, frame, message_sizes);
+    send_frame(recipient_id, frame);
+}
+
+void TcpUtilityClient::send(const std::shared_ptr<messaging::QueryRequest>& message, const std::vector<int>& recipient_ids) {
+    //Every meter gets the same bytes, so frame the message once and copy the frame
+    frame_messages(&message, &message + 1, WIRE_FORMAT, broadcast_frame, message_sizes);
+    begin_send_batch();
+    for(const int recipient_id : recipient_ids) {
+        auto& frame = send_buffers[recipient_id];
+        frame.assign(broadcast_frame.begin(), broadcast_frame.end());
+        send_frame(recipient_id, frame);
+    }
+    end_send_batch();
 }
 
 void TcpUtilityClient::send(const std::shared_ptr<messaging::SignatureResponse>& message, const int recipient_id) {
     //Exactly the same as the other send(), but must be re-implemented becuase the message is a different type
-    auto socket_map_find = sockets_by_id.lower_bound(recipient_id);
-    if(socket_map_find == sockets_by_id.end() || socket_map_find->first != recipient_id) {
-        sockets_by_id.emplace_hint(socket_map_find, recipient_id,
-                Socket(id_to_ip_map.at(recipient_id).ip_addr, id_to_ip_map.at(recipient_id).port));
-    }
-    const std::size_t num_messages = 1;
-    std::size_t send_size = mutils::bytes_size(num_messages) + mutils::bytes_size(*message);
-    char buffer[send_size + sizeof(send_size)];
-    std::memcpy(buffer, (char*)&send_size, sizeof(send_size));
-    std::size_t bytes_written = sizeof(send_size);
-    bytes_written += mutils::to_bytes(num_messages, buffer + bytes_written);
-    bytes_written += mutils::to_bytes(*message, buffer + bytes_written);
-    sockets_by_id.at(recipient_id).write(buffer, send_size + sizeof(send_size));
+    auto& frame = send_buffers[recipient_id];
+    frame_messages(&message, &message + 1, WIRE_FORMAT, frame, message_sizes);
+    send_frame(recipient_id, frame);
 }
 
-void TcpUtilityClient::receive_message(const std::vector<char>& message_bytes) {
+void TcpUtilityClient::decode_frame(const messaging::SharedBuffer& frame, const messaging::WireFormat format,
+        std::vector<TypeMessagePair>& messages) {
     using namespace messaging;
-    const char* buffer = message_bytes.data();
+    const char* buffer = frame->data();
+    const std::size_t type_size = format == WireFormat::COMPACT ? 1 : sizeof(MessageType);
+    if(frame->size() < type_size) {
+        logger->warn("Utility dropped a frame too short to contain a message");
+        return;
+    }
     /* This is the exact same logic used in Message::from_bytes. We could just do
      * auto message = mutils::from_bytes<messaging::Message>(nullptr, message_bytes.data());
      * but then we would have to use dynamic_pointer_cast to figure out which subclass
      * was deserialized and call the right utility_client.handle_message() overload.
      */
-    MessageType message_type = *((MessageType*)(buffer));
-    //Deserialize the correct message subclass based on the type, and call the correct handler
-    switch(message_type) {
-    case AggregationMessage::type: {
-        std::shared_ptr<AggregationMessage> message{mutils::from_bytes<AggregationMessage>(nullptr, buffer)};
-        utility_client.handle_message(message);
-        break;
-    }
-    case SignatureRequest::type: {
-        std::shared_ptr<SignatureRequest> message(mutils::from_bytes<SignatureRequest>(nullptr, buffer));
-        utility_client.handle_message(message);
-        break;
+    MessageType message_type = peek_message_type(buffer, format);
+    //Deserialize the correct message subclass based on the type, and tag it with the type for handle_messages
+    try {
+        switch(message_type) {
+        case AggregationMessage::type:
+            messages.emplace_back(message_type, std::shared_ptr<AggregationMessage>(
+                    decode_message<AggregationMessage>(buffer, frame->size(), format)));
+            break;
+        case SignatureRequest::type:
+            messages.emplace_back(message_type, std::shared_ptr<SignatureRequest>(
+                    decode_message<SignatureRequest>(buffer, frame->size(), format)));
+            break;
+        default:
+            logger->warn("Utility dropped a message it didn't know how to handle!");
+            break;
+        }
+    } catch(const DecodeError& e) {
+        logger->warn("Utility dropped a message it couldn't decode: {}", e.what());
     }
-    default:
-        logger->warn("Utility dropped a message it didn't know how to handle!");
-        break;
+}
+
+void TcpUtilityClient::handle_messages(const std::vector<TypeMessagePair>& messages) {
+    using namespace messaging;
+    for(const auto& type_message_pair : messages) {
+        //Call the correct handler based on the type
+        switch(type_message_pair.first) {
+        case AggregationMessage::type:
+            utility_client.handle_message(std::static_pointer_cast<AggregationMessage>(type_message_pair.second));
+            break;
+        case SignatureRequest::type:
+            utility_client.handle_message(std::static_pointer_cast<SignatureRequest>(type_message_pair.second));
+            break;
+        default:
+            break;
+        }
     }
 }
 
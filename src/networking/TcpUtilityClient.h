@@ -7,8 +7,10 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
 #include <memory>
+#include <vector>
 #include <spdlog/spdlog.h>
 
 #include "BaseTcpClient.h"
@@ -29,15 +31,23 @@ class TcpUtilityClient: public BaseTcpClient<TcpUtilityClient>, public UtilityNe
         std::shared_ptr<spdlog::logger> logger;
         /** The UtilityClient that owns this TcpUtilityClient. */
         UtilityClient& utility_client;
+        /** A buffer for framing messages that are sent to several meters */
+        std::vector<char> broadcast_frame;
     protected:
-        void receive_message(const std::vector<char>& message_bytes);
+        void decode_frame(const messaging::SharedBuffer& frame, const messaging::WireFormat format,
+                std::vector<TypeMessagePair>& messages);
+        void handle_messages(const std::vector<TypeMessagePair>& messages);
     public:
         TcpUtilityClient(UtilityClient& owning_utility_client, const TcpAddress& my_address,
                 const std::map<int, TcpAddress>& meter_ips_by_id);
         virtual ~TcpUtilityClient() = default;
         //Inherited from UtilityNetworkClient
         void send(const std::shared_ptr<messaging::QueryRequest>& message, const int recipient_id);
+        void send(const std::shared_ptr<messaging::QueryRequest>& message, const std::vector<int>& recipient_ids);
         void send(const std::shared_ptr<messaging::SignatureResponse>& message, const int recipient_id);
+        inline void add_event_source(const int fd, std::function<void(void)> on_readable) {
+            BaseTcpClient::add_event_source(fd, std::move(on_readable));
+        }
 
         using BaseTcpClient::monitor_incoming_messages;
 };
@@ -0,0 +1,92 @@
+/**
+ * @file UdpNetworkClient.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "UdpNetworkClient.h"
+
+#include <iterator>
+
+#include "MessageFraming.h"
+#include "../Configuration.h"
+
+namespace pddm {
+namespace networking {
+
+UdpNetworkClient::UdpNetworkClient(MeterClient& owning_meter_client, const TcpAddress& my_address,
+        const TcpAddress& utility_address, const std::map<int, TcpAddress>& meter_ips_by_id) :
+                TcpNetworkClient(owning_meter_client, my_address, utility_address, meter_ips_by_id) {
+    open_datagram_socket(my_address.port);
+    for(const auto& id_address : meter_ips_by_id) {
+        sockaddr_in resolved;
+        //A meter whose address can't be resolved is left out, so sends to it fail
+        if(connections.resolve(id_address.second, resolved)) {
+            datagram_addresses.emplace(id_address.first, resolved);
+        }
+    }
+}
+
+template<typename MessagePtrIter>
+bool UdpNetworkClient::queue_datagram_frame(MessagePtrIter begin, MessagePtrIter end, const int recipient_id) {
+    auto address_find = datagram_addresses.find(recipient_id);
+    if(address_find == datagram_addresses.end()) {
+        return false;
+    }
+    //The socket copies the frame into its datagrams, so one buffer serves every recipient
+    frame_messages(begin, end, WIRE_FORMAT, datagram_frame, datagram_message_sizes);
+    datagram_socket->queue_frame(recipient_id, address_find->second, datagram_frame, WIRE_FORMAT);
+    num_messages_sent += std::distance(begin, end);
+    return true;
+}
+
+bool UdpNetworkClient::send_overlay_batch(const std::list<std::shared_ptr<messaging::OverlayTransportMessage>>& messages,
+        const int recipient_id) {
+    std::lock_guard<std::mutex> lock(datagram_mutex);
+    if(!queue_datagram_frame(messages.begin(), messages.end(), recipient_id)) {
+        return false;
+    }
+    return datagram_socket->send_queued().empty();
+}
+
+bool UdpNetworkClient::send(const std::shared_ptr<messaging::PingMessage>& message, const int recipient_id) {
+    std::lock_guard<std::mutex> lock(datagram_mutex);
+    if(!queue_datagram_frame(&message, &message + 1, recipient_id)) {
+        return false;
+    }
+    return datagram_socket->send_queued().empty();
+}
+
+std::set<int> UdpNetworkClient::flush_overlay_sends() {
+    HostSendsMap sends_by_host = take_held_sends_by_host();
+    std::set<int> failed_ids;
+    std::lock_guard<std::mutex> lock(datagram_mutex);
+    for(const auto& host_sends : sends_by_host) {
+        //Any of the recipients' addresses reaches the host; the receiver dispatches each message by its sender
+        if(!queue_datagram_frame(host_sends.second.second.begin(), host_sends.second.second.end(),
+                host_sends.second.first.front())) {
+            failed_ids.insert(host_sends.second.first.begin(), host_sends.second.first.end());
+        }
+    }
+    //Every host's datagrams go out together
+    std::set<int> failed_sends = datagram_socket->send_queued();
+    for(const auto& host_sends : sends_by_host) {
+        if(failed_sends.find(host_sends.second.first.front()) != failed_sends.end()) {
+            failed_ids.insert(host_sends.second.first.begin(), host_sends.second.first.end());
+        }
+    }
+    //Messages that don't fit in datagrams still go over TCP
+    add_failed_connections(failed_ids);
+    return failed_ids;
+}
+
+std::function<UdpNetworkClient(MeterClient&)> udp_network_client_builder(const TcpAddress& my_address,
+        const TcpAddress& utility_address, const std::map<int, TcpAddress>& meter_ips_by_id) {
+    return [utility_address, my_address, meter_ips_by_id](MeterClient& meter_client) {
+        return UdpNetworkClient(meter_client, my_address, utility_address, meter_ips_by_id);
+    };
+}
+
+} /* namespace networking */
+} /* namespace pddm */
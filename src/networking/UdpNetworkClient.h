@@ -0,0 +1,78 @@
+/**
+ * @file UdpNetworkClient.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+#include <netinet/in.h>
+
+#include "TcpNetworkClient.h"
+
+namespace pddm {
+namespace networking {
+
+/**
+ * A NetworkClient that sends overlay messages and pings to other meters as
+ * UDP datagrams, and everything else (aggregation messages, flood digests, and
+ * messages to the utility) over TCP like TcpNetworkClient. Overlay batches are
+ * small, go to a predictable peer once per round, and are already protected by
+ * the protocol's round timeouts and pings, so they don't need TCP's
+ * connections or retransmissions, and a datagram that is lost or late doesn't
+ * hold up the ones sent after it.
+ *
+ * All of the overlay batches flushed together are sent with one sendmmsg()
+ * call, and a batch too large for one datagram is split into fragments (see
+ * DatagramSocket). Datagrams are received on the UDP port with the same
+ * number as this meter's TCP port. Since a datagram can't fail to reach a
+ * meter that has failed, a send only fails if the recipient's address can't
+ * be resolved or the kernel refuses the datagram; failed meters are detected
+ * by pings and timeouts instead.
+ */
+class UdpNetworkClient : public TcpNetworkClient {
+    private:
+        /** The socket address of each meter, resolved once since every datagram needs it */
+        std::map<int, sockaddr_in> datagram_addresses;
+        /** Guards the datagram socket's send state and the buffers below,
+         * since pings may be sent by timer threads */
+        std::mutex datagram_mutex;
+        std::vector<char> datagram_frame;
+        std::vector<std::size_t> datagram_message_sizes;
+        /**
+         * Builds a frame from a sequence of messages and queues it on the
+         * datagram socket. The caller must hold datagram_mutex.
+         * @return False if the recipient's address is unknown
+         */
+        template<typename MessagePtrIter>
+        bool queue_datagram_frame(MessagePtrIter begin, MessagePtrIter end, const int recipient_id);
+    protected:
+        bool send_overlay_batch(const std::list<std::shared_ptr<messaging::OverlayTransportMessage>>& messages, const int recipient_id);
+    public:
+        /**
+         * Constructs a NetworkClient that sends overlay messages and pings
+         * over UDP. The arguments are the same as TcpNetworkClient's.
+         * @throws connection_failure if this meter's UDP port can't be bound
+         */
+        UdpNetworkClient(MeterClient& owning_meter_client, const TcpAddress& my_address,
+                const TcpAddress& utility_address, const std::map<int, TcpAddress>& meter_ips_by_id);
+        virtual ~UdpNetworkClient() = default;
+        using TcpNetworkClient::send;
+        bool send(const std::shared_ptr<messaging::PingMessage>& message, const int recipient_id);
+        std::set<int> flush_overlay_sends();
+};
+
+std::function<UdpNetworkClient (MeterClient&)> udp_network_client_builder(const TcpAddress& my_address,
+        const TcpAddress& utility_address, const std::map<int, TcpAddress>& meter_ips_by_id);
+
+} /* namespace networking */
+} /* namespace pddm */
@@ -12,6 +12,7 @@
 #include <memory>
 #include <string>
 
+#include "../messaging/OnionPacket.h"
 #include "../messaging/OverlayMessage.h"
 #include "../messaging/ValueTuple.h"
 #include "../messaging/ValueContribution.h"
@@ -54,6 +55,21 @@ std::shared_ptr<messaging::OverlayMessage> SimCrypto::rsa_decrypt(const int call
     return message;
 }
 
+std::shared_ptr<messaging::OnionPacket> SimCrypto::build_onion(const int caller_id,
+        const std::list<int>& path, const std::shared_ptr<messaging::MessageBody>& payload) {
+    //Building an onion takes one encryption per hop, like the nested layers did
+    if(caller_id > -1) meter_network_clients.at(caller_id).get().delay_client(RSA_ENCRYPT_TIME_MICROS * static_cast<int>(path.size()));
+    return messaging::OnionPacket::assemble(path, *payload);
+}
+
+int SimCrypto::peel_onion(const int caller_id, messaging::OnionPacket& packet) {
+    //Peeling is one decryption no matter how deep the onion is
+    if(caller_id > -1) meter_network_clients.at(caller_id).get().delay_client(RSA_DECRYPT_TIME_MICROS);
+    const int next_hop = packet.next_hop();
+    packet.shift_header();
+    return next_hop;
+}
+
 void SimCrypto::rsa_sign(const int caller_id, const messaging::ValueContribution& value,
         util::SignatureArray& signature) {
     if(caller_id > -1) meter_network_clients.at(caller_id).get().delay_client(RSA_SIGN_TIME_MICROS);
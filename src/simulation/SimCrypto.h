@@ -8,6 +8,7 @@
 #pragma once
 
 #include <functional>
+#include <list>
 #include <memory>
 #include <vector>
 #include <string>
@@ -46,6 +47,9 @@ class SimCrypto {
                 const std::shared_ptr<messaging::OverlayMessage>& message, const int target_meter_id);
         std::shared_ptr<messaging::OverlayMessage> rsa_decrypt(const int caller_id,
                 const std::shared_ptr<messaging::OverlayMessage>& message);
+        std::shared_ptr<messaging::OnionPacket> build_onion(const int caller_id,
+                const std::list<int>& path, const std::shared_ptr<messaging::MessageBody>& payload);
+        int peel_onion(const int caller_id, messaging::OnionPacket& packet);
         std::shared_ptr<messaging::StringBody> rsa_encrypt(const int caller_id,
                 const std::shared_ptr<messaging::ValueTuple>& value, const int target_meter_id);
 //        std::shared_ptr<messaging::ValueTuple> rsa_decrypt(const int caller_id,
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <functional>
+#include <list>
 #include <memory>
 #include <string>
 
@@ -48,6 +49,13 @@ class SimCryptoWrapper: public util::CryptoLibrary {
                 const std::shared_ptr<messaging::OverlayMessage>& message) override {
             return inner_sim_crypto.rsa_decrypt(calling_meter_id, message);
         }
+        std::shared_ptr<messaging::OnionPacket> build_onion(
+                const std::list<int>& path, const std::shared_ptr<messaging::MessageBody>& payload) override {
+            return inner_sim_crypto.build_onion(calling_meter_id, path, payload);
+        }
+        int peel_onion(messaging::OnionPacket& packet) override {
+            return inner_sim_crypto.peel_onion(calling_meter_id, packet);
+        }
         std::shared_ptr<messaging::StringBody> rsa_encrypt(
                 const std::shared_ptr<messaging::ValueTuple>& value, const int target_meter_id) override {
             return inner_sim_crypto.rsa_encrypt(calling_meter_id, value, target_meter_id);
@@ -8,6 +8,9 @@
 #include <functional>
 #include <memory>
 #include <list>
+#include <map>
+#include <set>
+#include <utility>
 #include <cassert>
 #include "SimNetworkClient.h"
 
@@ -73,6 +76,7 @@ void SimNetworkClient::receive_message(const messaging::MessageType& message_typ
         //We finished a whole number of milliseconds of delay and received the next message,
         //so discard any extra microseconds - they shouldn't affect the next send
         accumulated_delay_micros = 0;
+        hold_overlay_sends();
         switch(message_type) {
         case messaging::OverlayTransportMessage::type:
             logger->trace("At time {}, meter {} received an overlay message: {}",
@@ -87,6 +91,9 @@ void SimNetworkClient::receive_message(const messaging::MessageType& message_typ
         case messaging::PingMessage::type:
             meter_client.handle_message(static_pointer_cast<messaging::PingMessage>(message));
             break;
+        case messaging::FloodDigestMessage::type:
+            meter_client.handle_message(static_pointer_cast<messaging::FloodDigestMessage>(message));
+            break;
         case messaging::QueryRequest::type:
             meter_client.handle_message(static_pointer_cast<messaging::QueryRequest>(message));
             break;
@@ -97,6 +104,7 @@ void SimNetworkClient::receive_message(const messaging::MessageType& message_typ
             logger->warn("Meter {} dropped a message it didn't know how to handle.", meter_client.meter_id);
             break;
         }
+        meter_client.flush_held_sends();
     } else {
         incoming_message_queue.emplace(message_type, message);
     }
@@ -109,9 +117,41 @@ bool SimNetworkClient::send(const std::list<std::shared_ptr<messaging::OverlayTr
     for(auto& message : messages) {
         raw_message_list->emplace_back(messaging::MessageType::OVERLAY, static_pointer_cast<void>(message));
     }
+    if(holding_overlay_sends) {
+        held_overlay_sends.emplace_back(recipient_id, std::move(raw_message_list));
+        return true;
+    }
     return send(std::move(raw_message_list), recipient_id);
 }
 
+void SimNetworkClient::hold_overlay_sends() {
+    holding_overlay_sends = true;
+}
+
+std::set<int> SimNetworkClient::flush_overlay_sends() {
+    holding_overlay_sends = false;
+    //Combine held messages by the client that will receive them, keeping them in the order they were sent
+    std::map<SimNetworkClient*, std::pair<std::list<int>, shared_ptr<list<TypeMessagePair>>>> sends_by_host;
+    for(auto& held_send : held_overlay_sends) {
+        auto& host_sends = sends_by_host[&network->meter_clients.at(held_send.first).get()];
+        host_sends.first.push_back(held_send.first);
+        if(!host_sends.second) {
+            host_sends.second = std::move(held_send.second);
+        } else {
+            host_sends.second->splice(host_sends.second->end(), *held_send.second);
+        }
+    }
+    held_overlay_sends.clear();
+    std::set<int> failed_ids;
+    for(auto& host_sends : sends_by_host) {
+        bool success = send(std::move(host_sends.second.second), host_sends.second.first.front());
+        if(!success) {
+            failed_ids.insert(host_sends.second.first.begin(), host_sends.second.first.end());
+        }
+    }
+    return failed_ids;
+}
+
 bool SimNetworkClient::send(const std::shared_ptr<messaging::AggregationMessage>& message, const int recipient_id) {
     num_messages_sent++;
     shared_ptr<list<TypeMessagePair>> raw_message_list = make_shared<list<TypeMessagePair>>();
@@ -126,6 +166,13 @@ bool SimNetworkClient::send(const std::shared_ptr<messaging::PingMessage>& messa
     return send(std::move(raw_message_list), recipient_id);
 }
 
+bool SimNetworkClient::send(const std::shared_ptr<messaging::FloodDigestMessage>& message, const int recipient_id) {
+    num_messages_sent++;
+    shared_ptr<list<TypeMessagePair>> raw_message_list = make_shared<list<TypeMessagePair>>();
+    raw_message_list->emplace_back(messaging::MessageType::FLOOD_DIGEST, static_pointer_cast<void>(message));
+    return send(std::move(raw_message_list), recipient_id);
+}
+
 bool SimNetworkClient::send(const std::shared_ptr<messaging::SignatureRequest>& message) {
     num_messages_sent++;
     shared_ptr<list<TypeMessagePair>> raw_message_list = make_shared<list<TypeMessagePair>>();
@@ -165,6 +212,7 @@ void SimNetworkClient::resume_from_busy() {
         return;
     }
     client_is_busy = false;
+    hold_overlay_sends();
     //Receive each incoming message in order
     //If handling a message causes the client to become busy, stop processing -
     //another resume_from_busy has been created that will handle the next one
@@ -182,6 +230,9 @@ void SimNetworkClient::resume_from_busy() {
         case MessageType::PING:
             meter_client.handle_message(static_pointer_cast<PingMessage>(message));
             break;
+        case MessageType::FLOOD_DIGEST:
+            meter_client.handle_message(static_pointer_cast<FloodDigestMessage>(message));
+            break;
         case MessageType::QUERY_REQUEST:
             meter_client.handle_message(static_pointer_cast<QueryRequest>(message));
             break;
@@ -194,6 +245,7 @@ void SimNetworkClient::resume_from_busy() {
         }
         incoming_message_queue.pop();
     }
+    meter_client.flush_held_sends();
 }
 
 std::function<SimNetworkClient (MeterClient&)> network_client_builder(const std::shared_ptr<Network>& network) {
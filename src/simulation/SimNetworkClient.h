@@ -9,7 +9,10 @@
 //This is not an include guard, but it signals to other files that this header has been included
 #define SIM_NETWORK
 
+#include <list>
 #include <memory>
+#include <set>
+#include <utility>
 #include <vector>
 #include <queue>
 #include <spdlog/spdlog.h>
@@ -54,6 +57,10 @@ class SimNetworkClient : public NetworkClient {
         std::queue<TypeMessagePair> incoming_message_queue;
         /** Message count tracker for simulation graphs. */
         int num_messages_sent;
+        /** True if overlay sends are being held to be coalesced */
+        bool holding_overlay_sends;
+        /** Overlay messages held since hold_overlay_sends(), paired with their recipient IDs */
+        std::list<std::pair<int, std::shared_ptr<std::list<TypeMessagePair>>>> held_overlay_sends;
 
         bool send(std::shared_ptr<std::list<TypeMessagePair>> untyped_messages, const int recipient_id);
 
@@ -68,15 +75,23 @@ class SimNetworkClient : public NetworkClient {
             accumulated_delay_micros(0),
             client_is_busy(false),
             busy_until_time(0),
-            num_messages_sent(0) {};
+            num_messages_sent(0),
+            holding_overlay_sends(false) {};
         virtual ~SimNetworkClient() = default;
         //Inherited from NetworkClient
         bool send(const std::list<std::shared_ptr<messaging::OverlayTransportMessage>>& messages, const int recipient_id);
         bool send(const std::shared_ptr<messaging::AggregationMessage>& message, const int recipient_id);
         bool send(const std::shared_ptr<messaging::PingMessage>& message, const int recipient_id);
+        bool send(const std::shared_ptr<messaging::FloodDigestMessage>& message, const int recipient_id);
         bool send(const std::shared_ptr<messaging::SignatureRequest>& message);
+        void hold_overlay_sends();
+        std::set<int> flush_overlay_sends();
+        //The simulated network has no connections to open
+        void prewarm_connections(const std::set<int>& meter_ids) {}
         //In the simulation there is no "polling" loop, so this function does nothing
         void monitor_incoming_messages() {}
+        //There are no file descriptors in the simulation either, and timers are simulation events
+        void add_event_source(const int fd, std::function<void(void)> on_readable) {}
 
         /** Called by the simulated Network when the meter should receive a message. */
         void receive_message(const messaging::MessageType& message_type, const std::shared_ptr<void>& message);
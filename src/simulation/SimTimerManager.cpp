@@ -18,6 +18,9 @@ namespace simulation {
 using util::timer_id_t;
 
 timer_id_t SimTimerManager::register_timer(const int delay_ms, std::function<void(void)> callback) {
+    if(run_callback) {
+        callback = [this, callback]() { run_callback(callback); };
+    }
     std::weak_ptr<Event> event_ptr = event_manager.submit(callback, event_manager.get_current_time() + delay_ms, "Timer delayed by " + std::to_string(delay_ms) + " ms", true);
     timer_events[next_id] = event_ptr;
     return next_id++; //Return current value, then increment it for next time
@@ -33,7 +36,12 @@ void SimTimerManager::cancel_timer(const timer_id_t timer_id) {
 
 std::function<SimTimerManager (MeterClient&)> timer_manager_builder(EventManager& event_manager) {
     return [&event_manager](MeterClient& client) {
-        return SimTimerManager(event_manager);
+        //Coalesce the overlay messages sent by timeouts, like those sent while handling messages
+        return SimTimerManager(event_manager, [&client](const std::function<void(void)>& callback) {
+            client.get_network_client().hold_overlay_sends();
+            callback();
+            client.flush_held_sends();
+        });
     };
 }
 
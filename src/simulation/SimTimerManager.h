@@ -24,16 +24,24 @@ namespace pddm {
 namespace simulation {
 
 class SimTimerManager: public util::TimerManager {
+    public:
+        /** A function that runs a timer's callback, so that the client can do something around it */
+        using RunCallbackFunction = std::function<void(const std::function<void(void)>& callback)>;
     private:
         util::timer_id_t next_id;
         std::map<util::timer_id_t, std::weak_ptr<Event>> timer_events;
         EventManager& event_manager;
+        RunCallbackFunction run_callback;
 
     public:
-        SimTimerManager(EventManager& event_manager) : next_id(0), timer_events(), event_manager(event_manager) {}
+        SimTimerManager(EventManager& event_manager, RunCallbackFunction run_callback = nullptr) :
+            next_id(0), timer_events(), event_manager(event_manager), run_callback(std::move(run_callback)) {}
         virtual ~SimTimerManager() = default;
         util::timer_id_t register_timer(const int delay_ms, std::function<void(void)> callback) override;
         void cancel_timer(const util::timer_id_t timer_id) override;
+        long long current_time_ms() const override { return event_manager.get_current_time(); }
+        //Simulated time only advances in whole milliseconds
+        long long current_time_us() const override { return event_manager.get_current_time() * 1000; }
 };
 
 
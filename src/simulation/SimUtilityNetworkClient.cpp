@@ -30,6 +30,12 @@ void SimUtilityNetworkClient::send(const std::shared_ptr<messaging::QueryRequest
     send(make_pair(messaging::MessageType::QUERY_REQUEST, message), recipient_id);
 }
 
+void SimUtilityNetworkClient::send(const std::shared_ptr<messaging::QueryRequest>& message, const std::vector<int>& recipient_ids) {
+    for(const int recipient_id : recipient_ids) {
+        send(message, recipient_id);
+    }
+}
+
 void SimUtilityNetworkClient::send(const std::shared_ptr<messaging::SignatureResponse>& message, const int recipient_id) {
     send(make_pair(messaging::MessageType::SIGNATURE_RESPONSE, message), recipient_id);
 }
@@ -10,6 +10,7 @@
 #include <functional>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "../messaging/MessageType.h"
 #include "../UtilityNetworkClient.h"
@@ -38,7 +39,10 @@ class SimUtilityNetworkClient: public UtilityNetworkClient {
         virtual ~SimUtilityNetworkClient() = default;
         //Inherited from UtilityNetworkClient
         void send(const std::shared_ptr<messaging::QueryRequest>& message, const int recipient_id);
+        void send(const std::shared_ptr<messaging::QueryRequest>& message, const std::vector<int>& recipient_ids);
         void send(const std::shared_ptr<messaging::SignatureResponse>& message, const int recipient_id);
+        //In the simulation there is no "polling" loop, and timers are simulation events
+        void add_event_source(const int fd, std::function<void(void)> on_readable) {}
 
         /** Called by the simulated Network when the client should receive a message. */
         void receive_message(const messaging::MessageType& message_type, const std::shared_ptr<void>& message);
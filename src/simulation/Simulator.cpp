@@ -31,7 +31,6 @@
 #include "../messaging/QueryRequest.h"
 #include "../messaging/AggregationMessage.h"
 #include "../util/Money.h"
-#include "../util/Overlay.h"
 #include "../util/Random.h"
 #include "../UtilityClient.h"
 #include "Event.h"
@@ -61,7 +60,8 @@ void Simulator::setup_simulation(int num_homes, const string& device_power_data_
 
     util::debug_state().event_manager = &event_manager;
 
-    modulus = util::get_valid_prime_modulus(num_homes);
+    //The overlay pads itself out to a valid prime internally, so every ID is a real meter
+    modulus = num_homes;
     ProtocolState_t::init_failures_tolerated(modulus);
     //Initialize the SimCrypto instance
     sim_crypto = std::make_unique<SimCrypto>(modulus);
@@ -88,14 +88,6 @@ void Simulator::setup_simulation(int num_homes, const string& device_power_data_
         meter_clients.emplace_back(std::make_unique<MeterClient>(next_id, modulus, new_meter, network_client_builder(sim_network),
                 crypto_library_builder(*sim_crypto), timer_manager_builder(event_manager)));
     }
-    //Assign secondary IDs to some meters
-    int current_id = meter_clients.size();
-    for(std::size_t double_id_pointer = 0; double_id_pointer < modulus - meter_clients.size(); ++double_id_pointer) {
-        meter_clients[double_id_pointer]->set_second_id(current_id);
-        virtual_meter_clients.emplace(current_id, std::ref(*meter_clients[double_id_pointer]));
-        sim_network->connect_meter(meter_clients[double_id_pointer]->network_client, current_id);
-        current_id++;
-    }
 
     sim_network->finish_setup();
     sim_crypto->finish_setup();
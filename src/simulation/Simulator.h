@@ -43,9 +43,6 @@ class Simulator {
         int modulus;
         /** All of the meter clients in the simulation; the simulator owns them. */
         std::vector<std::unique_ptr<MeterClient>> meter_clients;
-        /** Index of meter clients that have secondary IDs.
-         * Maps the secondary ID to a reference to an object in meter_clients. */
-        std::map<int, std::reference_wrapper<MeterClient>> virtual_meter_clients;
         /** Pointers to the simulated Meters owned by the MeterClients,
          * kept here so that the simulation can make them generate measurements */
         std::vector<std::shared_ptr<Meter>> meters;
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <cstdint>
+#include <list>
 #include <memory>
 #include <string>
 #include <array>
@@ -17,6 +18,7 @@ namespace messaging {
 class MessageBody;
 class StringBody;
 class OverlayMessage;
+class OnionPacket;
 struct ValueTuple;
 struct ValueContribution;
 struct SignedValue;
@@ -58,6 +60,33 @@ class CryptoLibrary {
         virtual std::shared_ptr<messaging::OverlayMessage> rsa_decrypt(
                 const std::shared_ptr<messaging::OverlayMessage>& message) = 0;
 
+        /**
+         * Builds an onion that will carry a message body along a path through
+         * the overlay. Each hop's routing record is encrypted under that
+         * hop's public key, and the payload is encrypted under the
+         * destination's public key.
+         * @param path The meters the onion should pass through, starting with
+         * the first hop and ending with the destination
+         * @param payload The message body to deliver to the destination
+         * @return An OnionPacket whose first routing record can be read by the
+         * first meter on the path
+         */
+        virtual std::shared_ptr<messaging::OnionPacket> build_onion(
+                const std::list<int>& path, const std::shared_ptr<messaging::MessageBody>& payload) = 0;
+
+        /**
+         * Removes the current client's layer from an onion, using the current
+         * client's private key, leaving the packet ready to send to the next
+         * hop. This does the same amount of work at every hop, no matter how
+         * far the onion is from its destination.
+         * @param packet An OnionPacket whose first routing record is encrypted
+         * under the current client's public key; it is modified in place.
+         * @return The ID of the meter the onion should be sent to next, or
+         * OnionPacket::FINAL_HOP if the current client is the destination and
+         * the payload is now readable.
+         */
+        virtual int peel_onion(messaging::OnionPacket& packet) = 0;
+
         /**
          * Signs a ciphertext with the current client's private key.
          * @param encrypted_message The ciphertext to sign, which we expect to
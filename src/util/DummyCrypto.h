@@ -11,6 +11,7 @@
 
 #include "CryptoLibrary.h"
 
+#include "../messaging/OnionPacket.h"
 #include "../messaging/OverlayMessage.h"
 #include "../messaging/ValueTuple.h"
 #include "../messaging/ValueContribution.h"
@@ -43,6 +44,17 @@ class DummyCrypto : public CryptoLibrary {
             return message;
         }
 
+        std::shared_ptr<messaging::OnionPacket> build_onion(
+                const std::list<int>& path, const std::shared_ptr<messaging::MessageBody>& payload) override {
+            return messaging::OnionPacket::assemble(path, *payload);
+        }
+
+        int peel_onion(messaging::OnionPacket& packet) override {
+            const int next_hop = packet.next_hop();
+            packet.shift_header();
+            return next_hop;
+        }
+
         std::shared_ptr<messaging::StringBody> rsa_encrypt(
                 const std::shared_ptr<messaging::ValueTuple>& value, const int target_meter_id) override {
             std::stringstream stringifier;
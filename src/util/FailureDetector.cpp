@@ -0,0 +1,47 @@
+/**
+ * @file FailureDetector.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "FailureDetector.h"
+
+#include <algorithm>
+
+namespace pddm {
+namespace util {
+
+constexpr int FailureDetector::MAX_SUSPICION;
+constexpr int FailureDetector::SUSPICION_EXPIRY_QUERIES;
+
+void FailureDetector::report_failure(const int meter_id, const int query_num) {
+    auto suspicion_find = suspicions.find(meter_id);
+    if(suspicion_find == suspicions.end()) {
+        suspicions.emplace(meter_id, Suspicion{1, query_num});
+    } else if(suspicion_find->second.last_failure_query != query_num) {
+        suspicion_find->second.level = std::min(suspicion_find->second.level + 1, MAX_SUSPICION);
+        suspicion_find->second.last_failure_query = query_num;
+    }
+}
+
+void FailureDetector::report_alive(const int meter_id) {
+    suspicions.erase(meter_id);
+}
+
+std::set<int> FailureDetector::suspected_meters(const int query_num) {
+    std::set<int> suspected;
+    for(auto suspicion_iter = suspicions.begin(); suspicion_iter != suspicions.end(); ) {
+        const Suspicion& suspicion = suspicion_iter->second;
+        if(query_num - suspicion.last_failure_query > suspicion.level * SUSPICION_EXPIRY_QUERIES) {
+            suspicion_iter = suspicions.erase(suspicion_iter);
+        } else {
+            suspected.insert(suspicion_iter->first);
+            ++suspicion_iter;
+        }
+    }
+    return suspected;
+}
+
+} /* namespace util */
+} /* namespace pddm */
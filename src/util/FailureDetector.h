@@ -0,0 +1,59 @@
+/**
+ * @file FailureDetector.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <map>
+#include <set>
+
+namespace pddm {
+namespace util {
+
+/**
+ * Remembers which meters have been detected as failed in recent queries, so
+ * that a meter doesn't have to rediscover the same failures (by timing out on
+ * them) in every query. Each meter's suspicion level goes up each query in
+ * which it is detected as failed, and a suspicion expires once the meter has
+ * gone SUSPICION_EXPIRY_QUERIES queries per level of suspicion without being
+ * detected as failed again. Hearing from a suspected meter clears it.
+ */
+class FailureDetector {
+    private:
+        struct Suspicion {
+            int level;
+            int last_failure_query;
+        };
+        std::map<int, Suspicion> suspicions;
+    public:
+        /** The highest suspicion level a meter can reach */
+        static constexpr int MAX_SUSPICION = 5;
+        /** The number of queries each level of suspicion lasts */
+        static constexpr int SUSPICION_EXPIRY_QUERIES = 2;
+
+        /**
+         * Records that a meter was detected as failed during a query. Repeated
+         * reports in the same query only count once.
+         * @param meter_id The ID of the meter that failed
+         * @param query_num The query during which it failed
+         */
+        void report_failure(const int meter_id, const int query_num);
+        /**
+         * Records that a meter has been heard from, so it has not failed.
+         * @param meter_id The ID of the meter
+         */
+        void report_alive(const int meter_id);
+        /**
+         * Expires old suspicions and returns the meters that are still
+         * suspected of having failed.
+         * @param query_num The query that is about to start
+         * @return The IDs of the meters that are suspected of having failed
+         */
+        std::set<int> suspected_meters(const int query_num);
+};
+
+} /* namespace util */
+} /* namespace pddm */
@@ -43,6 +43,9 @@ class FixedPoint : public mutils::ByteRepresentable {
         FixedPoint& operator/=(int x) { m /= x; return *this; }
         FixedPoint operator-() const { return FixedPoint(-m); }
         double toDouble() const { return double(m) / factor; }
+        /** @return The integer that represents this number, for encodings that store it directly */
+        Base raw_value() const { return m; }
+        static FixedPoint from_raw_value(const Base raw_value) { return FixedPoint(raw_value); }
         operator double() const { return toDouble(); }
 
         // comparison operators
@@ -7,134 +7,146 @@
 
 #include "LinuxTimerManager.h"
 
+#include <algorithm>
 #include <cassert>
-#include <csignal>
 #include <ctime>
-#include <cstring>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "../MeterClient.h"
+#include "../UtilityClient.h"
 
 namespace pddm {
 namespace util {
 
-//Ugly hack. There better only be once instance of LinuxTimerManager, otherwise the signal handler won't work.
-LinuxTimerManager* tm_instance;
-
-LinuxTimerManager::LinuxTimerManager() :
-        timer_signal_num(SIGRTMIN),
-        next_id(0),
-        fired_timers(1000), /* Initialize with plenty of space to avoid memory allocation */
-        thread_shutdown(false) {
-    tm_instance = this;
-    int sem_success = sem_init(&timers_fired_semaphore, 0, 0);
-    assert(sem_success == 0);
-    //Register timer_signal_handler as the signal handler for timers
-    struct sigaction sa = {0};
-    sa.sa_flags = SA_SIGINFO;
-    sa.sa_sigaction = timer_signal_handler;
-    sigemptyset(&sa.sa_mask);
-    int sig_success = sigaction(timer_signal_num, &sa, NULL);
-    assert(sig_success == 0);
-    callback_thread = std::thread(&LinuxTimerManager::callback_thread_main, this);
-}
-
-LinuxTimerManager::~LinuxTimerManager() {
-    thread_shutdown = true;
-    sem_post(&timers_fired_semaphore);
-    callback_thread.join();
-    sem_destroy(&timers_fired_semaphore);
-}
-
-/* This function needs to tell the LinuxTimerManager the ID of the timer
- * that fired, but it must be a bare function and can't get any additional
- * arguments (such as a LinuxTimerManager reference). The only solution I can
- * see is to use a global pointer to one instance of LinuxTimerManager. */
-void timer_signal_handler(int signum, siginfo_t* info, void* ucontext) {
-    timer_id_t timer_id = info->si_value.sival_int;
-    tm_instance->fired_timers.enqueue(timer_id);
-    sem_post(&tm_instance->timers_fired_semaphore);
+namespace {
+/** Reads the clock that timer_fd measures, which is the same one std::chrono::steady_clock reads */
+std::uint64_t monotonic_time_ms() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<std::uint64_t>(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
 }
 
-timer_id_t LinuxTimerManager::register_timer(const int delay_ms, std::function<void(void)> callback) {
-    //Create a timer that will signal with a sigev_value containing its ID
-    struct sigevent timer_event = {0};
-    timer_event.sigev_notify = SIGEV_SIGNAL;
-    timer_event.sigev_signo = timer_signal_num;
-    timer_event.sigev_value.sival_int = next_id;
+TimerfdWheel::TimerfdWheel() :
+        wheel(monotonic_time_ms()),
+        timer_fd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+        armed_deadline(0) {
+    assert(timer_fd >= 0);
+}
 
-    timer_t timer_handle;
-    int success_flag = timer_create(CLOCK_REALTIME, &timer_event, &timer_handle);
-    assert(success_flag == 0);
-    timer_handles[next_id] = timer_handle;
-    timer_callbacks[next_id] = callback;
+TimerfdWheel::~TimerfdWheel() {
+    close(timer_fd);
+}
 
-    //Arm the timer to fire once after delay_ms milliseconds
-    struct itimerspec timer_spec = {0};
-    timer_spec.it_interval.tv_sec = 0;
-    timer_spec.it_interval.tv_nsec = 0;
-    timer_spec.it_value.tv_sec = 0;
-    timer_spec.it_value.tv_nsec = delay_ms * 1000000;
-    timer_settime(timer_handle, 0, &timer_spec, NULL);
+void TimerfdWheel::arm(const std::uint64_t deadline) {
+    if(deadline == armed_deadline) {
+        return;
+    }
+    //An absolute deadline, so the time spent getting here doesn't delay the timer; a zero it_value disarms it
+    struct itimerspec timer_spec = {};
+    timer_spec.it_value.tv_sec = deadline / 1000;
+    timer_spec.it_value.tv_nsec = (deadline % 1000) * 1000000;
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &timer_spec, NULL);
+    armed_deadline = deadline;
+}
 
-    return next_id++; //Return current value, then increment it for next time
+timer_id_t TimerfdWheel::add(const int delay_ms, std::function<void(void)> callback) {
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    const std::uint64_t now = monotonic_time_ms();
+    const std::uint64_t expiration = now + std::max(delay_ms, 0);
+    timer_id_t timer_id = wheel.add(now, expiration, std::move(callback));
+    //The timerfd only needs to change if this timer is due before everything else in the wheel
+    if(armed_deadline == 0 || expiration < armed_deadline) {
+        arm(expiration);
+    }
+    return timer_id;
+}
 
+void TimerfdWheel::cancel(const timer_id_t timer_id) {
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    //timer_fd is left armed; if nothing is due when it fires, it is just rearmed
+    wheel.cancel(timer_id);
 }
 
-/*
- * Mark the timer as cancelled rather than attempt to delete it, which might
- * create a race condition with the timer handler firing.
- */
-void LinuxTimerManager::cancel_timer(const timer_id_t timer_id) {
-    std::lock_guard<std::mutex> lock(cancelled_timers_mutex);
-    if(timer_handles.find(timer_id) != timer_handles.end()) {
-        cancelled_timers.emplace(timer_id);
+void TimerfdWheel::handle_timer_event() {
+    //Clear the timerfd's readiness; this fails harmlessly if it was rearmed since epoll saw it
+    std::uint64_t expirations;
+    ssize_t bytes_read = read(timer_fd, &expirations, sizeof(expirations));
+    (void) bytes_read;
+    std::unique_lock<std::mutex> lock(wheel_mutex);
+    //The timerfd isn't armed any more once it has fired
+    armed_deadline = 0;
+    std::function<void(void)> callback;
+    while(wheel.pop_expired(monotonic_time_ms(), callback)) {
+        //The callback may register or cancel timers itself
+        lock.unlock();
+        callback();
+        lock.lock();
     }
+    arm(wheel.next_deadline());
+}
+
+LinuxTimerManager::LinuxTimerManager(const WatchFdFunction& watch_fd) :
+        wheel(std::make_shared<TimerfdWheel>()) {
+    watch_fd(wheel->get_fd(), [wheel = wheel]() { wheel->handle_timer_event(); });
 }
 
-void LinuxTimerManager::callback_thread_main() {
-    pthread_setname_np(pthread_self(), "timer_callback_thread");
-    /* Block the receipt of timer signals in this thread,
-     * since ConcurrentQueue is non-reentrant */
-    sigset_t signal_set;
-    sigemptyset(&signal_set);
-    sigaddset(&signal_set, timer_signal_num);
-    pthread_sigmask(SIG_BLOCK, &signal_set, NULL);
-    moodycamel::ConsumerToken callback_thread_token(fired_timers);
-    while(!thread_shutdown) {
-        sem_wait(&timers_fired_semaphore);
-        //Dequeue may fail if this thread was awoken by the destructor
-        timer_id_t timer_id;
-        if(!fired_timers.try_dequeue(callback_thread_token, timer_id)) {
-            continue;
-        }
-        std::unique_lock<std::mutex> cancelled_timers_lock(cancelled_timers_mutex);
-        //Only fire the trigger if the timer is not in the cancelled set
-        auto cancelled_location = cancelled_timers.find(timer_id);
-        if(cancelled_location == cancelled_timers.end()) {
-            //The callback may take a while, allow other cancellations while it is running
-            cancelled_timers_lock.unlock();
-            timer_callbacks.at(timer_id)();
-            cancelled_timers_lock.lock();
-        } else {
-            cancelled_timers.erase(cancelled_location);
-        }
-        timer_callbacks.erase(timer_id);
-        timer_delete(tm_instance->timer_handles.at(timer_id));
-        timer_handles.erase(timer_id);
+LinuxTimerManager::LinuxTimerManager(const std::shared_ptr<TimerfdWheel>& shared_wheel, RunCallbackFunction run_callback) :
+        wheel(shared_wheel),
+        run_callback(std::move(run_callback)) {}
+
+timer_id_t LinuxTimerManager::register_timer(const int delay_ms, std::function<void(void)> callback) {
+    if(!run_callback) {
+        return wheel->add(delay_ms, std::move(callback));
     }
+    //Copy elision means a LinuxTimerManager is never moved, so the callback can refer to this one
+    return wheel->add(delay_ms, [this, callback = std::move(callback)]() {
+        run_callback(callback);
+    });
+}
+
+void LinuxTimerManager::cancel_timer(const timer_id_t timer_id) {
+    wheel->cancel(timer_id);
+}
 
+long long LinuxTimerManager::current_time_ms() const {
+    return monotonic_time_ms();
+}
+
+long long LinuxTimerManager::current_time_us() const {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<long long>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
 }
 
 std::function<LinuxTimerManager(MeterClient&)> timer_manager_builder() {
     return [](MeterClient& client) {
-        return LinuxTimerManager();
+        NetworkClient_t& network_client = client.get_network_client();
+        return LinuxTimerManager([&network_client](const int fd, std::function<void(void)> on_readable) {
+            network_client.add_event_source(fd, std::move(on_readable));
+        });
+    };
+}
+
+std::function<LinuxTimerManager(MeterClient&)> timer_manager_builder(const std::shared_ptr<TimerfdWheel>& shared_wheel) {
+    return [shared_wheel](MeterClient& client) {
+        return LinuxTimerManager(shared_wheel, [&client](const std::function<void(void)>& callback) {
+            client.get_network_client().hold_overlay_sends();
+            callback();
+            client.flush_held_sends();
+        });
     };
 }
 
 std::function<LinuxTimerManager(UtilityClient&)> timer_manager_builder_utility() {
     return [](UtilityClient& client) {
-        return LinuxTimerManager();
+        UtilityNetworkClient_t& network_client = client.get_network_client();
+        return LinuxTimerManager([&network_client](const int fd, std::function<void(void)> on_readable) {
+            network_client.add_event_source(fd, std::move(on_readable));
+        });
     };
 }
 
 } /* namespace util */
 } /* namespace pddm */
-
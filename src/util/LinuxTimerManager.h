@@ -7,17 +7,13 @@
 
 #pragma once
 
-#include <ctime>
-#include <csignal>
+#include <cstdint>
 #include <functional>
-#include <map>
-#include <set>
-#include <thread>
+#include <memory>
 #include <mutex>
-#include <semaphore.h>
-#include <moodycamel/concurrentqueue.h>
 
 #include "TimerManager.h"
+#include "TimerWheel.h"
 
 namespace pddm {
 class UtilityClient;
@@ -27,48 +23,101 @@ class MeterClient;
 namespace pddm {
 namespace util {
 
+/**
+ * A TimerWheel whose earliest deadline arms a timerfd, so that an event loop
+ * can find out when its timers expire. One of these can be shared by all the
+ * LinuxTimerManagers whose callbacks run on the same event loop, so that a
+ * process running many clients on a few threads needs only one wheel and one
+ * timerfd per thread.
+ */
+class TimerfdWheel {
+    private:
+        TimerWheel wheel;
+        /** The timerfd, which is readable once the wheel's earliest deadline has passed */
+        int timer_fd;
+        /** The absolute time timer_fd is armed for, or 0 if it is disarmed */
+        std::uint64_t armed_deadline;
+        /** Guards the wheel and timer_fd's deadline, since a client may start
+         * timers from other threads (the utility starts queries from one).
+         * Callbacks are run without holding it. */
+        std::mutex wheel_mutex;
+        /** Arms timer_fd to expire at a time, or disarms it if the time is 0.
+         * The caller must hold wheel_mutex. */
+        void arm(const std::uint64_t deadline);
+    public:
+        TimerfdWheel();
+        ~TimerfdWheel();
+        TimerfdWheel(const TimerfdWheel&) = delete;
+        TimerfdWheel& operator=(const TimerfdWheel&) = delete;
+        /** @return The timerfd, which the event loop should watch for readability */
+        int get_fd() const { return timer_fd; }
+        timer_id_t add(const int delay_ms, std::function<void(void)> callback);
+        void cancel(const timer_id_t timer_id);
+        /** Runs the callbacks of the timers that have expired, and rearms the
+         * timerfd for the next ones. The event loop calls this when the
+         * timerfd is readable. */
+        void handle_timer_event();
+};
+
+/**
+ * A TimerManager for programs running on Linux, which keeps its timers in a
+ * TimerfdWheel, watched by the event loop of the client's network client.
+ * That runs timer callbacks on the thread that handles messages (handing them
+ * to it from a receive thread if TCP_RECEIVE_THREADS is more than 1), so they
+ * never run concurrently with message handlers. Clients that share an event
+ * loop, such as the meters on one thread of a ReactorPool, can share a wheel
+ * instead of each having its own. Registering or cancelling a timer usually
+ * makes no system calls at all.
+ */
 class LinuxTimerManager: public TimerManager {
+    public:
+        /** A function that has an event loop call a handler whenever a file descriptor becomes readable */
+        using WatchFdFunction = std::function<void(const int fd, std::function<void(void)> on_readable)>;
+        /** A function that runs a timer callback from a shared wheel on behalf of one client */
+        using RunCallbackFunction = std::function<void(const std::function<void(void)>& callback)>;
     private:
-        const int timer_signal_num;
-        /** The next ID that will be returned on a call to register_timer */
-        timer_id_t next_id;
-        /** Maps each timer ID to its Linux-generated "handle" struct. */
-        std::map<timer_id_t, timer_t> timer_handles;
-        /** Maps each timer ID to the user-provided callback function it should execute. */
-        std::map<timer_id_t, std::function<void(void)>> timer_callbacks;
-        /** A set of timer IDs that are cancelled. */
-        std::set<timer_id_t> cancelled_timers;
-        /** A list of timer IDs that have fired and need to have their callbacks
-         * executed, in order of when they fired. Written by the timer signal
-         * handler, read by the callback-executing thread. */
-        moodycamel::ConcurrentQueue<timer_id_t> fired_timers;
-        /** Semaphore used by the timer signal handler to safely tell the
-         * callback-executing thread that a timer has fired. */
-        sem_t timers_fired_semaphore;
-        /** Synchronizes access to cancelled_timers between the callback-executing
-         * thread and cancel_timer(). */
-        std::mutex cancelled_timers_mutex;
-        /** Shuts down the callback-executing thread when true. */
-        std::atomic<bool> thread_shutdown;
-        /** The thread that actually runs timer callbacks once the timers fire.
-         * This must be a separate thread because Linux timer events are delivered
-         * to an interrupt handler, which must be nonblocking. */
-        std::thread callback_thread;
-        void callback_thread_main();
-        friend void timer_signal_handler(int signum, siginfo_t* info, void* ucontext);
+        std::shared_ptr<TimerfdWheel> wheel;
+        /** Wraps this client's callbacks if its wheel is shared, or is empty if it isn't */
+        RunCallbackFunction run_callback;
     public:
-        LinuxTimerManager();
-        virtual ~LinuxTimerManager();
+        /**
+         * Creates a timer manager with its own wheel, and adds the wheel's
+         * timerfd to an event loop.
+         * @param watch_fd A function that registers a file descriptor with
+         * the event loop that timer callbacks should run on
+         */
+        LinuxTimerManager(const WatchFdFunction& watch_fd);
+        /**
+         * Creates a timer manager that keeps its timers in a wheel shared with
+         * other clients, whose timerfd is already watched by their event loop.
+         * @param shared_wheel The wheel to share
+         * @param run_callback A function that runs each of this client's
+         * callbacks, doing whatever the client's event loop would do around
+         * a handler of its own
+         */
+        LinuxTimerManager(const std::shared_ptr<TimerfdWheel>& shared_wheel, RunCallbackFunction run_callback);
+        virtual ~LinuxTimerManager() = default;
+        LinuxTimerManager(const LinuxTimerManager&) = delete;
+        LinuxTimerManager& operator=(const LinuxTimerManager&) = delete;
         timer_id_t register_timer(const int delay_ms, std::function<void(void)> callback) override;
         void cancel_timer(const timer_id_t timer_id) override;
+        long long current_time_ms() const override;
+        long long current_time_us() const override;
 };
 
-void timer_signal_handler(int signum, siginfo_t* info, void* ucontext);
-
+/** @return A builder for a MeterClient's LinuxTimerManager, which runs on its network client's event loop */
 std::function<LinuxTimerManager (MeterClient&)> timer_manager_builder();
+/**
+ * @param shared_wheel A wheel whose timerfd is watched by the event loop that
+ * runs the meter's network client, shared with the other meters it runs
+ * @return A builder for a MeterClient's LinuxTimerManager, which keeps its
+ * timers in the shared wheel and coalesces the overlay messages its callbacks
+ * send, as the network client does for its own event sources
+ */
+std::function<LinuxTimerManager (MeterClient&)> timer_manager_builder(const std::shared_ptr<TimerfdWheel>& shared_wheel);
+/** @return A builder for a UtilityClient's LinuxTimerManager, which runs on its network client's event loop */
 std::function<LinuxTimerManager (UtilityClient&)> timer_manager_builder_utility();
 
 
 } /* namespace util */
 } /* namespace pddm */
-
@@ -27,8 +27,8 @@ namespace std {
 //  return out;
 //}
 
-template <typename T>
-std::ostream& operator<< (std::ostream& out, const std::list<T>& v) {
+template <typename T, typename Alloc>
+std::ostream& operator<< (std::ostream& out, const std::list<T, Alloc>& v) {
   if ( !v.empty() ) {
     out << '[';
     std::copy (v.begin(), v.end(), std::ostream_iterator<T>(out, ", "));
@@ -5,7 +5,9 @@
  *      Author: edward
  */
 
+#include <algorithm>
 #include <map>
+#include <mutex>
 #include <tuple>
 #include <vector>
 #include <cstdint>
@@ -18,7 +20,8 @@
 namespace pddm {
 namespace util {
 
-static std::mt19937 random_engine;
+//Each thread that picks proxies gets its own engine, since meters may run on several reactor threads
+static thread_local std::mt19937 random_engine;
 
 /**
  * Efficient modpow implementation found on StackOverflow
@@ -29,50 +32,113 @@ static std::mt19937 random_engine;
  */
 uint32_t mod_pow(uint32_t num, uint32_t pow, uint32_t mod) {
     uint64_t result = 1;
+    uint64_t base = num % mod;
     while (pow > 0) {
         if (pow & 1)
-            result = (result * num) % mod;
-        num = (num * num) % mod;
+            result = (result * base) % mod;
+        base = (base * base) % mod;
         pow >>= 1;
     }
     return result;
 }
 
-int gossip_target(const int source_id, const int round, const int group_size) {
-    //Memo table ordering is (N, t, i) -> i + 2^t mod N
-    //This is copied from the Java version, and it may be possible to reorder the tuple
-    static std::map<std::tuple<int, int, int>, int> memo_table;
-    auto memo_value = memo_table.find(std::make_tuple(group_size, round, source_id));
+/**
+ * Gets the modulus of the circulant graph that the overlay for a given
+ * number of nodes is embedded in, which is the smallest valid prime modulus
+ * that is at least the number of nodes. IDs between the number of nodes and
+ * this modulus are "padding" that doesn't correspond to any real node.
+ * @param group_size The total number of nodes in the system
+ * @return The padded modulus for the overlay
+ */
+int padded_modulus(const int group_size) {
+    static std::map<int, int> memo_table;
+    static std::mutex memo_mutex;
+    std::lock_guard<std::mutex> lock(memo_mutex);
+    auto memo_value = memo_table.find(group_size);
     if(memo_value != memo_table.end()) {
         return memo_value->second;
     }
-    int target = (source_id + mod_pow(2, round, group_size)) % group_size;
-    memo_table.emplace(std::make_tuple(group_size, round, source_id), target);
-    return target;
+    int modulus = get_valid_prime_modulus(group_size);
+    memo_table.emplace(group_size, modulus);
+    return modulus;
 }
 
 /**
- * "Safe" modular subtraction, which correctly wraps around negative values of
- * x-y (unlike the built-in % operator). Copied from StackOverflow.
- * @param x
- * @param y
- * @param m
- * @return (x - y) % m, correctly accounting for (x - y) < 0
+ * Adds the IDs reached by following each of a round's gossip edges forwards
+ * (or backwards) from a node and every padding ID it hosts to a list, mapping
+ * padding IDs to their hosts. The padding ID p is hosted by the real node
+ * p mod N, which sends and receives on its behalf, so the real nodes are
+ * connected exactly as well as the IDs of the prime-sized circulant graph.
+ * @param node_id The ID of the real node
+ * @param base_power k^t mod P for the round t
+ * @param backwards True to follow edges backwards, to find predecessors
+ * @param group_size The total number of real nodes
+ * @param neighbors The list to add neighbors to, which gets no duplicates and not node_id
  */
-inline int mod_subtract(const int x, const int y, const int m) {
-    return ((x - y) % m) + ((x >= y) ? 0 : m);
+void add_overlay_neighbors(const int node_id, const uint64_t base_power, const bool backwards,
+        const int group_size, std::vector<int>& neighbors) {
+    const int modulus = padded_modulus(group_size);
+    for(int hosted_id = node_id; hosted_id < modulus; hosted_id += group_size) {
+        for(int j = 1; j < GOSSIP_BASE; ++j) {
+            const int offset = (j * base_power) % modulus;
+            const int neighbor = ((backwards ? hosted_id + modulus - offset : hosted_id + offset) % modulus) % group_size;
+            //A host may be connected to itself, or to the same node through two of its IDs
+            if(neighbor != node_id && std::find(neighbors.begin(), neighbors.end(), neighbor) == neighbors.end()) {
+                neighbors.push_back(neighbor);
+            }
+        }
+    }
+}
+
+const std::vector<int>& gossip_targets(const int source_id, const int round, const int group_size) {
+    //Memo table ordering is (N, t, i) -> {i + j*k^t mod P}, where P is the padded modulus
+    //This is copied from the Java version, and it may be possible to reorder the tuple
+    //Entries are never removed, so references to them stay valid after the lock is released
+    static std::map<std::tuple<int, int, int>, std::vector<int>> memo_table;
+    static std::mutex memo_mutex;
+    std::lock_guard<std::mutex> lock(memo_mutex);
+    auto memo_value = memo_table.find(std::make_tuple(group_size, round, source_id));
+    if(memo_value != memo_table.end()) {
+        return memo_value->second;
+    }
+    const int modulus = padded_modulus(group_size);
+    std::vector<int> targets;
+    add_overlay_neighbors(source_id, mod_pow(GOSSIP_BASE, round, modulus), false, group_size, targets);
+    return memo_table.emplace(std::make_tuple(group_size, round, source_id), std::move(targets)).first->second;
 }
 
-int gossip_predecessor(const int target_id, const int round, const int group_size) {
-    //Memo table ordering is (N, t, j) -> j - 2^t mod N
-    static std::map<std::tuple<int, int, int>, int> memo_table;
+const std::vector<int>& gossip_predecessors(const int target_id, const int round, const int group_size) {
+    //Memo table ordering is (N, t, i) -> {i - j*k^t mod P}, where P is the padded modulus
+    static std::map<std::tuple<int, int, int>, std::vector<int>> memo_table;
+    static std::mutex memo_mutex;
+    std::lock_guard<std::mutex> lock(memo_mutex);
     auto memo_value = memo_table.find(std::make_tuple(group_size, round, target_id));
     if(memo_value != memo_table.end()) {
         return memo_value->second;
     }
-    int source = mod_subtract(target_id, mod_pow(2, round, group_size), group_size);
-    memo_table.emplace(std::make_tuple(group_size, round, target_id), source);
-    return source;
+    const int modulus = padded_modulus(group_size);
+    std::vector<int> sources;
+    add_overlay_neighbors(target_id, mod_pow(GOSSIP_BASE, round, modulus), true, group_size, sources);
+    return memo_table.emplace(std::make_tuple(group_size, round, target_id), std::move(sources)).first->second;
+}
+
+bool is_gossip_target(const int source_id, const int round, const int group_size, const int target_id) {
+    const auto& targets = gossip_targets(source_id, round, group_size);
+    return std::find(targets.begin(), targets.end(), target_id) != targets.end();
+}
+
+int log_gossip_base(const int num_nodes) {
+    //Hosts connect the real nodes like the whole padded graph, so use its size
+    const int modulus = padded_modulus(num_nodes);
+    int rounds = 0;
+    for(long reach = 1; reach < modulus; reach *= GOSSIP_BASE) {
+        ++rounds;
+    }
+    return rounds;
+}
+
+int padding_failure_rounds(const int num_nodes, const int failures_tolerated) {
+    return std::min(failures_tolerated, padded_modulus(num_nodes) - num_nodes);
 }
 
 inline constexpr int standard_group_size(const int num_groups, const int num_meters) {
@@ -195,9 +261,60 @@ std::pair<int, int> aggregation_tree_children(const int node_id, const int num_g
 
 }
 
+/**
+ * Determines whether a number is prime by trial division. This is only used
+ * while setting up the system, so it doesn't need to be fast.
+ * @param num
+ * @return True if num is prime
+ */
+bool is_prime(const int num) {
+    if(num < 2)
+        return false;
+    for(int divisor = 2; divisor * divisor <= num; ++divisor) {
+        if(num % divisor == 0)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Determines whether {@code root} is a primitive root modulo the prime
+ * {@code prime}, by checking that root^((p-1)/q) != 1 for every prime
+ * factor q of p-1.
+ * @param root The candidate primitive root
+ * @param prime A prime modulus
+ * @return True if root generates the multiplicative group of integers mod prime
+ */
+bool is_primitive_root(const int root, const int prime) {
+    if(root % prime == 0)
+        return false;
+    int remaining = prime - 1;
+    for(int factor = 2; factor <= remaining; ++factor) {
+        if(remaining % factor != 0)
+            continue;
+        if(mod_pow(root, (prime - 1) / factor, prime) == 1)
+            return false;
+        while(remaining % factor == 0) {
+            remaining /= factor;
+        }
+    }
+    return true;
+}
+
 int get_valid_prime_modulus(const int lower_bound) {
-    auto result = std::lower_bound(valid_prime_moduli.begin(), valid_prime_moduli.end(), lower_bound);
-    return *result;
+    if(GOSSIP_BASE == 2) {
+        auto result = std::lower_bound(valid_prime_moduli.begin(), valid_prime_moduli.end(), lower_bound);
+        if(result != valid_prime_moduli.end()) {
+            return *result;
+        }
+    }
+    //The pre-computed list only covers base 2, up to its last entry, so otherwise
+    //search for a prime that has the gossip base as a primitive root
+    for(int candidate = std::max(lower_bound, GOSSIP_BASE + 1); ; ++candidate) {
+        if(is_prime(candidate) && is_primitive_root(GOSSIP_BASE, candidate)) {
+            return candidate;
+        }
+    }
 }
 
 }
@@ -10,30 +10,76 @@
 #include <vector>
 #include <utility>
 
+#include "../Configuration.h"
+
 namespace pddm {
 namespace util {
 
 /**
- * Calculates the gossip target for a node in the given round by evaluating
- * g(i,t) = i + 2^t mod N, where N is the number of nodes in the system.
+ * Calculates the gossip targets for a node in the given round by evaluating
+ * g_j(i,t) = i + j*k^t mod P for each j in [1, k-1], where k is the gossip
+ * base (GOSSIP_BASE). P is the smallest prime with primitive root k that is
+ * at least N, the number of nodes in the system. If N is not itself such a
+ * prime, IDs in [N, P) are padding, and each padding ID p is hosted by the
+ * real node p mod N: the host also sends to p's targets, and receives what is
+ * sent to p, so any N works and the real nodes are connected exactly as they
+ * would be on P nodes. With the default base of 2 and a valid prime N, this
+ * is the single target i + 2^t mod N.
  *
  * @param source_id The ID of the source node.
  * @param round The current round number (time)
  * @param group_size The total number of nodes in the system.
- * @return The ID of the node's gossip target in the current round.
+ * @return The IDs of the node's gossip targets in the current round, ordered by
+ *         j (first for the node's own ID, then for each padding ID it hosts),
+ *         without duplicates
  */
-int gossip_target(const int source_id, const int round, const int group_size);
+const std::vector<int>& gossip_targets(const int source_id, const int round, const int group_size);
 
 /**
- * Calculates the predecessor of a node in the overlay graph by evaluating
- * g^-1(j,t) = j - 2^t mod N, where N is the number of nodes in the system.
+ * Calculates the predecessors of a node in the overlay graph by evaluating
+ * g_j^-1(i,t) = i - j*k^t mod P for each j in [1, k-1], for the node and each
+ * padding ID it hosts, in the same way as gossip_targets.
  *
  * @param target_id The ID of the target node
  * @param round The current round number (time)
  * @param group_size The total number of nodes in the system
- * @return The ID of the node's gossip predecessor in the current round
+ * @return The IDs of the node's gossip predecessors in the current round, ordered
+ *         by j, without duplicates
+ */
+const std::vector<int>& gossip_predecessors(const int target_id, const int round, const int group_size);
+
+/**
+ * Determines whether one node is among another node's gossip targets in
+ * the given round.
+ * @param source_id The ID of the sending node
+ * @param round The round number in which the source is sending
+ * @param group_size The total number of nodes in the system
+ * @param target_id The ID of the possible target node
+ * @return True if {@code target_id} is one of the gossip targets of
+ * {@code source_id} in round {@code round}
+ */
+bool is_gossip_target(const int source_id, const int round, const int group_size, const int target_id);
+
+/**
+ * Computes ceil(log_k(P)), where k is the gossip base and P is the padded
+ * modulus of the overlay for num_nodes nodes. This is the number of rounds it
+ * takes the overlay to connect any node to any other node, so protocol phase
+ * lengths should be derived from it.
+ * @param num_nodes The total number of nodes in the system
+ * @return The logarithm, base GOSSIP_BASE, of the overlay's modulus, rounded up
+ */
+int log_gossip_base(const int num_nodes);
+
+/**
+ * Computes the number of rounds a phase that tolerates some number of failed
+ * nodes must add to its length to make up for the overlay's padding. A node
+ * that hosts a padding ID takes two of the overlay's IDs down with it when it
+ * fails, so up to P - N of the failures can cost an extra round each.
+ * @param num_nodes The total number of nodes in the system
+ * @param failures_tolerated The number of failed nodes the phase tolerates
+ * @return The number of extra rounds, which is 0 if num_nodes is a valid prime
  */
-int gossip_predecessor(const int target_id, const int round, const int group_size);
+int padding_failure_rounds(const int num_nodes, const int failures_tolerated);
 
 /**
  * Picks a set of proxies for a node with the given ID by randomly picking
@@ -84,8 +130,10 @@ std::pair<int, int> aggregation_tree_children(const int node_id, const int num_g
 
 /**
  * Finds the smallest prime modulus larger than <code>lowerBound</code> that will
- * create a field over the integers with primitive root 2. Uses a pre-computed list
- * of valid prime moduli, from http://oeis.org/A001122.
+ * create a field over the integers with primitive root GOSSIP_BASE. For base 2,
+ * uses a pre-computed list of valid prime moduli, from http://oeis.org/A001122;
+ * for other bases, searches upwards from lower_bound for a prime with the right
+ * primitive root.
  * @param lower_bound The value to find a prime modulus near
  * @return The smallest valid prime modulus that is not less than {@code lower_bound}
  */
@@ -64,13 +64,83 @@ struct hash<pddm::util::InfectedNode> {
 namespace pddm {
 namespace util {
 
-std::vector<std::list<int>> find_paths(const int source_id, const std::vector<int>& target_ids, const int num_nodes, const int start_round) {
+std::vector<std::list<int>> find_paths(const int source_id, const std::vector<int>& target_ids, const int num_nodes,
+        const int start_round, const std::set<int>& avoid_nodes, const int max_path_length) {
     set<int> used_nodes(target_ids.begin(), target_ids.end());
+    //Nodes to avoid are treated as if an earlier path had already used them
+    for(const int avoid_node : avoid_nodes) {
+        if(avoid_node != source_id) {
+            used_nodes.insert(avoid_node);
+        }
+    }
+    std::vector<list<int>> paths(target_ids.size());
+    int rounds_limit = log_gossip_base(num_nodes) * target_ids.size() + MIN_PATH_LENGTH;
+    //A path gains at most one hop per round, so limiting its rounds limits its length
+    if(max_path_length > 0) {
+        rounds_limit = std::min(rounds_limit, max_path_length);
+    }
+    try {
+        for(size_t i = 0; i < target_ids.size(); ++i) {
+            paths[i] = find_another(source_id, target_ids[i], num_nodes, start_round, start_round + rounds_limit, used_nodes);
+            paths[i].pop_front();
+        }
+    } catch(std::runtime_error& e) {
+        //Avoiding those nodes left no way through, so fall back to ignoring them
+        if(avoid_nodes.empty())
+            throw;
+        return find_paths(source_id, target_ids, num_nodes, start_round, std::set<int>(), max_path_length);
+    }
+    return paths;
+}
+
+std::vector<std::list<int>> find_multicast_tree(const int source_id, const std::vector<int>& target_ids,
+        const int num_nodes, const int start_round, const std::set<int>& avoid_nodes) {
+    //Targets only receive the message, and avoided nodes can't relay it either
+    set<int> non_relay_nodes(target_ids.begin(), target_ids.end());
+    for(const int avoid_node : avoid_nodes) {
+        if(avoid_node != source_id) {
+            non_relay_nodes.insert(avoid_node);
+        }
+    }
+    set<int> unreached_targets(target_ids.begin(), target_ids.end());
+    //The node that first infected each infected node; the source has no parent
+    std::map<int, int> parents{{source_id, -1}};
+    std::vector<int> relay_nodes{source_id};
+    int rounds_limit = log_gossip_base(num_nodes) * target_ids.size() + MIN_PATH_LENGTH;
+    for(int time = start_round; time < start_round + rounds_limit && !unreached_targets.empty(); ++time) {
+        std::vector<int> new_relay_nodes;
+        for(const int relay_node : relay_nodes) {
+            for(const int gossip_target : gossip_targets(relay_node, time, num_nodes)) {
+                if(parents.find(gossip_target) != parents.end())
+                    continue;
+                if(unreached_targets.find(gossip_target) != unreached_targets.end()) {
+                    //Like find_path, don't reach a target in less than the minimum time
+                    if(time - start_round < MIN_PATH_LENGTH)
+                        continue;
+                    parents[gossip_target] = relay_node;
+                    unreached_targets.erase(gossip_target);
+                } else if(non_relay_nodes.find(gossip_target) == non_relay_nodes.end()) {
+                    parents[gossip_target] = relay_node;
+                    new_relay_nodes.push_back(gossip_target);
+                }
+            }
+        }
+        //Nodes infected in this round can't relay until the next round
+        relay_nodes.insert(relay_nodes.end(), new_relay_nodes.begin(), new_relay_nodes.end());
+    }
+    if(!unreached_targets.empty()) {
+        //Avoiding those nodes left no way through, so fall back to ignoring them
+        if(!avoid_nodes.empty())
+            return find_multicast_tree(source_id, target_ids, num_nodes, start_round);
+        throw std::runtime_error(std::string("Failed to find a multicast tree from ") + std::to_string(source_id)
+                + std::string(" reaching ") + std::to_string(*unreached_targets.begin()));
+    }
     std::vector<list<int>> paths(target_ids.size());
-    int rounds_limit = static_cast<int>(ceil(log2(num_nodes))) * target_ids.size() + MIN_PATH_LENGTH;
     for(size_t i = 0; i < target_ids.size(); ++i) {
-        paths[i] = find_another(source_id, target_ids[i], num_nodes, start_round, start_round + rounds_limit, used_nodes);
-        paths[i].pop_front();
+        //Construct each path backwards by following the parents up to the source
+        for(int hop = target_ids[i]; hop != source_id; hop = parents.at(hop)) {
+            paths[i].push_front(hop);
+        }
     }
     return paths;
 }
@@ -127,27 +197,29 @@ list<int> find_path(const int source, const int target, const int n, const int s
     for (int time = starting_round; time < max_round; time++) {
         std::unordered_set<InfectedNode> newInfectedNodes;
         for(const auto& infectedNode : infected) {
-            InfectedNode endPtNode{gossip_target(infectedNode.id, time, n), time+1, const_cast<InfectedNode*>(&infectedNode)};
-            //If the endpoint was already used, skip infecting it (note that target nodes are also on the used list)
-            if (exclude_nodes.find(endPtNode.id) != exclude_nodes.end() && endPtNode.id != target)
-                continue;
-            //If we're reaching the target in less than the minimum time, skip infecting it
-            if(endPtNode.id == target && (time - starting_round) < MIN_PATH_LENGTH)
-                continue;
-            //If we reached the target at the right time, return the path to it
-            if(endPtNode.id == target) {
-                list<int> path;
-                path.push_back(endPtNode.id);
-                //Construct the path backwards by following the parent pointers
-                InfectedNode* parent = endPtNode.parent;
-                while(parent != nullptr) {
-                    path.push_front(parent->id);
-                    parent = parent->parent;
+            for(const int gossip_target : gossip_targets(infectedNode.id, time, n)) {
+                InfectedNode endPtNode{gossip_target, time+1, const_cast<InfectedNode*>(&infectedNode)};
+                //If the endpoint was already used, skip infecting it (note that target nodes are also on the used list)
+                if (exclude_nodes.find(endPtNode.id) != exclude_nodes.end() && endPtNode.id != target)
+                    continue;
+                //If we're reaching the target in less than the minimum time, skip infecting it
+                if(endPtNode.id == target && (time - starting_round) < MIN_PATH_LENGTH)
+                    continue;
+                //If we reached the target at the right time, return the path to it
+                if(endPtNode.id == target) {
+                    list<int> path;
+                    path.push_back(endPtNode.id);
+                    //Construct the path backwards by following the parent pointers
+                    InfectedNode* parent = endPtNode.parent;
+                    while(parent != nullptr) {
+                        path.push_front(parent->id);
+                        parent = parent->parent;
+                    }
+                    return path;
                 }
-                return path;
+                //Otherwise, add the new infected node and continue
+                newInfectedNodes.insert(std::move(endPtNode));
             }
-            //Otherwise, add the new infected node and continue
-            newInfectedNodes.insert(std::move(endPtNode));
         }
         //Since InfectedNode's operator== is based only on id, this will not add nodes that were re-infected
         infected.insert(newInfectedNodes.begin(), newInfectedNodes.end());
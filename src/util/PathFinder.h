@@ -9,6 +9,7 @@
 
 #include <vector>
 #include <list>
+#include <set>
 
 namespace pddm {
 namespace util {
@@ -25,12 +26,45 @@ namespace util {
  * @param num_nodes The number of nodes in the graph (i.e. the modulus size)
  * @param start_round The round number on which the source node wants to start
  *        sending messages
+ * @param avoid_nodes Nodes that should not be used as intermediate hops,
+ *        such as nodes that are believed to have failed. If the paths can't be
+ *        found without them, they will be used anyway.
+ * @param max_path_length The most hops any path may have, or 0 for no limit.
+ *        A path that would be longer is passed over for another route to the
+ *        same target, such as for onions, which have a fixed number of hops.
  * @return A vector of paths, in the same order as the list of target IDs,
  *         where each path is a list of node IDs in time order.
  *         This list does not include the source, but does include the target.
  */
 std::vector<std::list<int>> find_paths(const int source_id, const std::vector<int>& target_ids,
-        const int num_nodes, const int start_round);
+        const int num_nodes, const int start_round, const std::set<int>& avoid_nodes = std::set<int>(),
+        const int max_path_length = 0);
+
+/**
+ * Finds a multicast tree from the source node to the target nodes in an
+ * instance of Bobby's gossip graph, by propagating a single infection from
+ * the source and keeping the first way each node was reached. Paths to
+ * different targets share hops wherever the infection reached both targets
+ * through the same node, so a message sent along the tree only needs one
+ * copy on each shared hop. As with find_paths, no target is used as an
+ * intermediate hop on the way to another target, so a failed target can't
+ * cut off any of the others, and each path is at least as long as a path
+ * from find_paths would be allowed to be.
+ *
+ * @param source_id The ID of the source node
+ * @param target_ids The IDs of the target nodes
+ * @param num_nodes The number of nodes in the graph (i.e. the modulus size)
+ * @param start_round The round number on which the source node wants to start
+ *        sending messages
+ * @param avoid_nodes Nodes that should not be used as intermediate hops,
+ *        such as nodes that are believed to have failed. If the tree can't be
+ *        found without them, they will be used anyway.
+ * @return A vector of paths, in the same order as the list of target IDs,
+ *         where each path is a list of node IDs in time order, not including
+ *         the source. Paths may share any number of leading hops.
+ */
+std::vector<std::list<int>> find_multicast_tree(const int source_id, const std::vector<int>& target_ids,
+        const int num_nodes, const int start_round, const std::set<int>& avoid_nodes = std::set<int>());
 
 }
 }
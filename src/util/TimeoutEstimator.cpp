@@ -0,0 +1,39 @@
+/**
+ * @file TimeoutEstimator.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "TimeoutEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace pddm {
+namespace util {
+
+//Weights of a new sample in the average and the deviation, the same ones TCP uses
+static constexpr double AVERAGE_GAIN = 0.125;
+static constexpr double DEVIATION_GAIN = 0.25;
+
+void TimeoutEstimator::add_sample(const double sample_us) {
+    if(!has_sample) {
+        smoothed_time_us = sample_us;
+        time_deviation_us = sample_us / 2;
+        has_sample = true;
+    } else {
+        time_deviation_us = (1 - DEVIATION_GAIN) * time_deviation_us + DEVIATION_GAIN * std::fabs(smoothed_time_us - sample_us);
+        smoothed_time_us = (1 - AVERAGE_GAIN) * smoothed_time_us + AVERAGE_GAIN * sample_us;
+    }
+}
+
+int TimeoutEstimator::timeout() const {
+    if(!has_sample)
+        return std::min(std::max(initial_timeout, min_timeout), max_timeout);
+    int computed_timeout = (int) std::ceil((smoothed_time_us + 4 * time_deviation_us) / 1000);
+    return std::min(std::max(computed_timeout, min_timeout), max_timeout);
+}
+
+} /* namespace util */
+} /* namespace pddm */
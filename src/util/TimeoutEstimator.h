@@ -0,0 +1,56 @@
+/**
+ * @file TimeoutEstimator.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+namespace pddm {
+namespace util {
+
+/**
+ * Keeps a running estimate of how long some network operation (an overlay
+ * round, a ping round-trip) takes, and derives a timeout for it. This uses the
+ * same smoothing as TCP's retransmission timer: an exponentially-weighted
+ * moving average of the samples, plus four times their average deviation, so
+ * that the timeout sits just above the slow tail of recent samples rather
+ * than at their mean. Samples are kept in microseconds, since a round or a
+ * ping on a fast network takes well under a millisecond, but timeouts are
+ * rounded up to whole milliseconds for TimerManager.
+ */
+class TimeoutEstimator {
+    private:
+        double smoothed_time_us;
+        double time_deviation_us;
+        bool has_sample;
+        int initial_timeout;
+        int min_timeout;
+        int max_timeout;
+    public:
+        /**
+         * @param initial_timeout_ms The timeout to use before any samples
+         * have been recorded
+         * @param min_timeout_ms The smallest timeout this will ever return
+         * @param max_timeout_ms The largest timeout this will ever return
+         */
+        TimeoutEstimator(const int initial_timeout_ms, const int min_timeout_ms, const int max_timeout_ms) :
+            smoothed_time_us(0), time_deviation_us(0), has_sample(false), initial_timeout(initial_timeout_ms),
+            min_timeout(min_timeout_ms), max_timeout(max_timeout_ms) {}
+
+        /**
+         * Records one measurement of how long the operation took.
+         * @param sample_us The measured time, in microseconds
+         */
+        void add_sample(const double sample_us);
+
+        /** @return The current estimate of how long the operation takes, in microseconds */
+        double estimate_us() const { return has_sample ? smoothed_time_us : initial_timeout * 1000.0; }
+
+        /** @return The time to wait for the operation before giving up on it, in milliseconds */
+        int timeout() const;
+};
+
+} /* namespace util */
+} /* namespace pddm */
@@ -37,6 +37,20 @@ class TimerManager {
          * @param timer_id The unique identifier for the timer to cancel.
          */
         virtual void cancel_timer(const timer_id_t timer_id) = 0;
+        /**
+         * Reads the clock that timers are measured against, so that callers
+         * can measure how long things take.
+         * @return The current time in milliseconds, relative to an arbitrary
+         * but fixed starting point.
+         */
+        virtual long long current_time_ms() const = 0;
+        /**
+         * Reads the same clock as current_time_ms() with a finer resolution,
+         * for measuring things that take less than a few milliseconds.
+         * @return The current time in microseconds, relative to the same
+         * starting point as current_time_ms()
+         */
+        virtual long long current_time_us() const = 0;
         virtual ~TimerManager() = 0;
 };
 
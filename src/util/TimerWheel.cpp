@@ -0,0 +1,187 @@
+/**
+ * @file TimerWheel.cpp
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#include "TimerWheel.h"
+
+#include <cassert>
+
+namespace pddm {
+namespace util {
+
+TimerWheel::TimerWheel(const std::uint64_t start_ms) :
+        free_head(NONE),
+        next_sequence(1),
+        next_tick(start_ms),
+        num_timers(0) {
+    list_heads.fill(NONE);
+}
+
+void TimerWheel::link(const int node_index, const int list) {
+    Node& node = nodes[node_index];
+    node.list = list;
+    node.prev = NONE;
+    node.next = list_heads[list];
+    if(node.next != NONE) {
+        nodes[node.next].prev = node_index;
+    }
+    list_heads[list] = node_index;
+}
+
+void TimerWheel::unlink(const int node_index) {
+    Node& node = nodes[node_index];
+    if(node.prev != NONE) {
+        nodes[node.prev].next = node.next;
+    } else {
+        list_heads[node.list] = node.next;
+    }
+    if(node.next != NONE) {
+        nodes[node.next].prev = node.prev;
+    }
+    node.list = NONE;
+}
+
+void TimerWheel::insert(const int node_index) {
+    const std::uint64_t expiration = nodes[node_index].expiration_ms;
+    //A timer whose slot has already been passed is due right away
+    if(expiration < next_tick) {
+        link(node_index, DUE_LIST);
+        return;
+    }
+    const std::uint64_t delay = expiration - next_tick;
+    for(int level = 0; level < WHEEL_LEVELS; ++level) {
+        const int shift = level * SLOT_BITS;
+        if(delay < (std::uint64_t(1) << (shift + SLOT_BITS)) || level == WHEEL_LEVELS - 1) {
+            //Timers beyond the last level's range wait in the farthest slot it has, and are reinserted from there
+            const std::uint64_t slot_time = level == WHEEL_LEVELS - 1 && (delay >> (shift + SLOT_BITS)) > 0 ?
+                    next_tick + (std::uint64_t(1) << (shift + SLOT_BITS)) - 1 : expiration;
+            link(node_index, level * WHEEL_SLOTS + ((slot_time >> shift) & (WHEEL_SLOTS - 1)));
+            return;
+        }
+    }
+}
+
+void TimerWheel::cascade(const int level) {
+    const int list = level * WHEEL_SLOTS + ((next_tick >> (level * SLOT_BITS)) & (WHEEL_SLOTS - 1));
+    int node_index = list_heads[list];
+    list_heads[list] = NONE;
+    while(node_index != NONE) {
+        const int next = nodes[node_index].next;
+        insert(node_index);
+        node_index = next;
+    }
+}
+
+timer_id_t TimerWheel::add(const std::uint64_t now_ms, const std::uint64_t expiration_ms, std::function<void(void)> callback) {
+    //Nothing calls pop_expired() while the wheel is empty, so next_tick may be far in the past, which would put
+    //this timer in a slot that doesn't come around until the wheel has stepped through the whole idle period
+    if(num_timers == 0 && now_ms > next_tick) {
+        next_tick = now_ms;
+    }
+    int node_index = free_head;
+    if(node_index != NONE) {
+        free_head = nodes[node_index].next;
+    } else {
+        node_index = nodes.size();
+        assert(node_index < (1 << NODE_INDEX_BITS));
+        nodes.emplace_back();
+    }
+    Node& node = nodes[node_index];
+    node.id = (next_sequence << NODE_INDEX_BITS) | node_index;
+    //Keep IDs positive and nonzero, since callers use 0 or -1 to mean no timer
+    next_sequence = next_sequence == (1 << (31 - NODE_INDEX_BITS)) - 1 ? 1 : next_sequence + 1;
+    node.expiration_ms = expiration_ms;
+    node.callback = std::move(callback);
+    insert(node_index);
+    ++num_timers;
+    return node.id;
+}
+
+void TimerWheel::cancel(const timer_id_t timer_id) {
+    if(timer_id <= 0) {
+        return;
+    }
+    const std::size_t node_index = timer_id & ((1 << NODE_INDEX_BITS) - 1);
+    //The node may have been reused by a later timer, which has a different ID
+    if(node_index >= nodes.size() || nodes[node_index].id != timer_id) {
+        return;
+    }
+    unlink(node_index);
+    Node& node = nodes[node_index];
+    node.id = NONE;
+    node.callback = nullptr;
+    node.next = free_head;
+    free_head = node_index;
+    --num_timers;
+}
+
+bool TimerWheel::pop_expired(const std::uint64_t now_ms, std::function<void(void)>& callback) {
+    while(list_heads[DUE_LIST] == NONE) {
+        if(next_tick > now_ms) {
+            return false;
+        }
+        if(num_timers == 0) {
+            //Nothing can be due, so skip ahead instead of stepping through every millisecond
+            next_tick = now_ms + 1;
+            return false;
+        }
+        //At the start of each revolution of a level, the next slot of the level above it moves down
+        for(int level = 1; level < WHEEL_LEVELS
+                && (next_tick & ((std::uint64_t(1) << (level * SLOT_BITS)) - 1)) == 0; ++level) {
+            cascade(level);
+        }
+        const int slot = next_tick & (WHEEL_SLOTS - 1);
+        int node_index = list_heads[slot];
+        while(node_index != NONE) {
+            const int next = nodes[node_index].next;
+            unlink(node_index);
+            link(node_index, DUE_LIST);
+            node_index = next;
+        }
+        ++next_tick;
+    }
+    const int node_index = list_heads[DUE_LIST];
+    callback = std::move(nodes[node_index].callback);
+    cancel(nodes[node_index].id);
+    return true;
+}
+
+std::uint64_t TimerWheel::next_deadline() const {
+    if(num_timers == 0) {
+        return 0;
+    }
+    if(list_heads[DUE_LIST] != NONE) {
+        return next_tick - 1;
+    }
+    std::uint64_t deadline = 0;
+    for(int offset = 0; offset < WHEEL_SLOTS; ++offset) {
+        if(list_heads[(next_tick + offset) & (WHEEL_SLOTS - 1)] != NONE) {
+            deadline = next_tick + offset;
+            break;
+        }
+    }
+    //A slot of a higher level moves down at the start of its block, which is the first tick at or after
+    //next_tick that is a multiple of the level's slot size
+    for(int level = 1; level < WHEEL_LEVELS; ++level) {
+        const int shift = level * SLOT_BITS;
+        const std::uint64_t slot_size = std::uint64_t(1) << shift;
+        const std::uint64_t first_block_start = (next_tick + slot_size - 1) & ~(slot_size - 1);
+        for(int offset = 0; offset < WHEEL_SLOTS; ++offset) {
+            const std::uint64_t block_start = first_block_start + offset * slot_size;
+            if(deadline != 0 && block_start >= deadline) {
+                break;
+            }
+            if(list_heads[level * WHEEL_SLOTS + ((block_start >> shift) & (WHEEL_SLOTS - 1))] != NONE) {
+                deadline = block_start;
+                break;
+            }
+        }
+    }
+    return deadline;
+}
+
+} /* namespace util */
+} /* namespace pddm */
@@ -0,0 +1,117 @@
+/**
+ * @file TimerWheel.h
+ *
+ * @date Oct 18, 2026
+ * @author edward
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "TimerManager.h"
+
+namespace pddm {
+namespace util {
+
+/**
+ * A hierarchical timing wheel, which keeps one-shot timers with a resolution
+ * of one millisecond. It has WHEEL_LEVELS levels of WHEEL_SLOTS slots each:
+ * the first level has a slot for each of the next WHEEL_SLOTS milliseconds,
+ * and each slot of a higher level covers a whole revolution of the level
+ * below it. A timer is put in the lowest level whose range reaches its
+ * expiration time, and when the wheel's time reaches the start of a
+ * higher-level slot, that slot's timers are moved down into the level below.
+ * So adding and cancelling a timer take constant time, and no timer is moved
+ * more than WHEEL_LEVELS - 1 times; timers further in the future than the
+ * wheel reaches are kept in its last slot until they are in range.
+ *
+ * Timers are kept in a pool of nodes that are reused, linked into the lists
+ * of their slots by index, so adding a timer only allocates when more timers
+ * are pending than ever before; at most 2^16 timers can be pending at once.
+ * This class is not thread-safe, and has no notion of the current time
+ * except what it is given.
+ */
+class TimerWheel {
+    private:
+        static constexpr int SLOT_BITS = 6;
+        static constexpr int WHEEL_SLOTS = 1 << SLOT_BITS;
+        static constexpr int WHEEL_LEVELS = 4;
+        /** The list of timers that have expired, but haven't been returned by pop_expired() yet */
+        static constexpr int DUE_LIST = WHEEL_LEVELS * WHEEL_SLOTS;
+        /** Timer IDs are the index of the timer's node in the low bits, and a sequence number in the high bits */
+        static constexpr int NODE_INDEX_BITS = 16;
+        static constexpr int NONE = -1;
+        struct Node {
+            /** The ID of the timer in this node, or NONE if it is free */
+            timer_id_t id;
+            std::uint64_t expiration_ms;
+            std::function<void(void)> callback;
+            /** The list this node is in: a slot index, DUE_LIST, or NONE if it is free */
+            int list;
+            int prev;
+            int next;
+        };
+        std::vector<Node> nodes;
+        /** The first node of each slot's list, followed by the first node of the due list */
+        std::array<int, DUE_LIST + 1> list_heads;
+        /** The first free node, with the rest linked through their next index */
+        int free_head;
+        /** The sequence number in the next timer's ID, which is never 0, so that no ID is 0 */
+        timer_id_t next_sequence;
+        /** The next millisecond whose timers will be moved to the due list */
+        std::uint64_t next_tick;
+        /** The number of timers in the wheel, including the due list */
+        std::size_t num_timers;
+        void link(const int node_index, const int list);
+        void unlink(const int node_index);
+        /** Puts a timer in the slot for its expiration time, relative to next_tick. */
+        void insert(const int node_index);
+        /** Moves the timers in a slot of a higher level down into the slots they are now in range of. */
+        void cascade(const int level);
+    public:
+        /**
+         * @param start_ms The current time, which the wheel starts at
+         */
+        TimerWheel(const std::uint64_t start_ms);
+        /**
+         * Adds a timer.
+         * @param now_ms The current time. If the wheel is empty, it moves
+         * ahead to this time, since it isn't advanced while it is idle.
+         * @param expiration_ms The time at which it expires
+         * @param callback The function to return when it expires
+         * @return An ID for the timer, which is never 0 or negative
+         */
+        timer_id_t add(const std::uint64_t now_ms, const std::uint64_t expiration_ms, std::function<void(void)> callback);
+        /**
+         * Removes a timer, if it is still in the wheel. IDs of timers that
+         * have already expired or been cancelled are ignored.
+         * @param timer_id The ID returned by add()
+         */
+        void cancel(const timer_id_t timer_id);
+        /**
+         * Takes one timer that has expired by a certain time out of the wheel.
+         * Timers are returned in order of their expiration time, one at a
+         * time, so that a callback can cancel other timers that expired at
+         * the same time before they are returned.
+         * @param now_ms The current time
+         * @param callback Set to the callback of the expired timer
+         * @return True if a timer had expired, false if none have
+         */
+        bool pop_expired(const std::uint64_t now_ms, std::function<void(void)>& callback);
+        /**
+         * @return The next time at which pop_expired() will have work to do:
+         * the earliest time a timer in the first level expires, or a slot of
+         * a higher level must be moved down, whichever comes first. This is
+         * never later than the earliest expiration time of any timer, unless
+         * that time has already been passed. Returns 0 if the wheel is empty.
+         */
+        std::uint64_t next_deadline() const;
+        bool empty() const { return num_timers == 0; }
+};
+
+} /* namespace util */
+} /* namespace pddm */